@@ -0,0 +1,71 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain/abi_serializer_cache.hpp>
+
+namespace eosio { namespace chain {
+
+   abi_serializer_cache::abi_serializer_cache(size_t max_size)
+   :_max_size(max_size) {
+      FC_ASSERT( _max_size > 0 );
+   }
+
+   abi_serializer_cache::serializer_ptr abi_serializer_cache::get(const account_object& account) {
+      if( types::abi_serializer::is_empty_abi(account.abi) )
+         return serializer_ptr();
+
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         auto itr = _entries.find(account.abi_version);
+         if( itr != _entries.end() ) {
+            _lru.splice(_lru.begin(), _lru, itr->second.lru_position);
+            return itr->second.serializer;
+         }
+      }
+
+      // build outside of the lock, a concurrent miss on the same ABI just builds it twice
+      types::abi abi;
+      types::abi_serializer::to_abi(account.abi, abi);
+      serializer_ptr serializer = std::make_shared<const types::abi_serializer>(abi);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto itr = _entries.find(account.abi_version);
+      if( itr != _entries.end() )
+         return itr->second.serializer;
+
+      _lru.push_front(account.abi_version);
+      _entries.emplace(account.abi_version, entry{serializer, _lru.begin()});
+      while( _entries.size() > _max_size ) {
+         _entries.erase(_lru.back());
+         _lru.pop_back();
+      }
+      return serializer;
+   }
+
+   void abi_serializer_cache::erase(const fc::sha256& abi_version) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto itr = _entries.find(abi_version);
+      if( itr != _entries.end() ) {
+         _lru.erase(itr->second.lru_position);
+         _entries.erase(itr);
+      }
+   }
+
+   void abi_serializer_cache::clear() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _entries.clear();
+      _lru.clear();
+   }
+
+   bool abi_serializer_cache::contains(const fc::sha256& abi_version)const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _entries.count(abi_version) != 0;
+   }
+
+   size_t abi_serializer_cache::size()const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _entries.size();
+   }
+
+} } // eosio::chain
@@ -41,46 +41,38 @@ namespace eosio { namespace chain {
       return signee() == expected_signee;
    }
 
-   digest_type merkle(vector<digest_type> ids) {
-      while (ids.size() > 1) {
-         if (ids.size() % 2)
-            ids.push_back(ids.back());
-         for (int i = 0; i < ids.size() / 2; ++i)
-            ids[i/2] = digest_type::hash(std::make_pair(ids[i], ids[i+1]));
-         ids.resize(ids.size() / 2);
-      }
-
-      return ids.front();
+   checksum_type signed_block::merkle_root(const incremental_merkle& transactions)
+   {
+      if (transactions.size() == 0)
+         return checksum_type();
+      return checksum_type::hash(transactions.get_root());
    }
 
    checksum_type signed_block::calculate_merkle_root()const
    {
-      if(cycles.empty())
-         return checksum_type();
-
-      vector<digest_type> ids;
+      incremental_merkle transactions;
       for (const auto& cycle : cycles)
          for (const auto& thread : cycle)
-            ids.emplace_back(thread.merkle_digest());
-
-/**
- *  Suggest moving thread::merkle_digest code to return vector of ids which get added to ids above and then calculating root over all
- */
-#warning TODO  The merkle root needs to be over all transactions, but this is currently hashing all threads merkle roots which will make proofs O(N) rather than O( LOG(N) )
+            for (const auto& leaf : thread.merkle_leaves())
+               transactions.append(leaf);
 
-      /**
-       *  This may require passing 
-       */
-#warning TODO  Add global incremental block header merkle   https://github.com/EOSIO/eos/issues/8
+      return merkle_root(transactions);
+   }
 
-      return checksum_type::hash(merkle(ids));
+   vector<digest_type> signed_block::merkle_leaves()const
+   {
+      vector<digest_type> leaves;
+      for (const auto& cycle : cycles)
+         for (const auto& thread : cycle) {
+            auto thread_leaves = thread.merkle_leaves();
+            leaves.insert(leaves.end(), thread_leaves.begin(), thread_leaves.end());
+         }
+      return leaves;
    }
 
-   digest_type thread::merkle_digest() const {
-      vector<digest_type> ids;// = generated_input;
-      /*
-      ids.reserve( ids.size() + user_input.size() + output_transactions.size() );
-      */
+   vector<digest_type> thread::merkle_leaves() const {
+      vector<digest_type> ids;
+      ids.reserve( user_input.size() + generated_input.size() );
 
       for( const auto& trx : user_input )
          ids.push_back( transaction_digest(trx) );
@@ -88,8 +80,7 @@ namespace eosio { namespace chain {
       for( const auto& trx : generated_input )
          ids.push_back( trx.id );
 
-
-      return merkle(ids);
+      return ids;
    }
 
 } }
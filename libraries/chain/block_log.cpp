@@ -3,68 +3,314 @@
  *  @copyright defined in eos/LICENSE.txt
  */
 #include <eos/chain/block_log.hpp>
-#include <fstream>
+#include <eos/chain/block_view.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <fc/compress/zlib.hpp>
 #include <fc/io/raw.hpp>
 
-#define LOG_READ  (std::ios::in | std::ios::binary)
-#define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 namespace eosio { namespace chain {
 
    namespace detail {
+      /// Starts a compressed block log; an uncompressed log starts with block 1, whose previous id is zero
+      const char compressed_log_magic[8] = { 'E', 'O', 'S', 'B', 'L', 'K', 'Z', '1' };
+
+      /// A block which has been appended, but may not have been written to the files yet
+      struct pending_block {
+         uint32_t      block_num = 0;
+         uint64_t      pos = 0;
+         /// the block's record followed by its position, exactly as it is written to the block file
+         vector<char>  data;
+      };
+
+      /// Reads a file sequentially from an offset with pread, so it can be unpacked like a stream
+      class file_reader {
+         public:
+            file_reader(int fd, uint64_t pos)
+            :fd(fd), pos(pos) {}
+
+            bool read(char* d, size_t s) {
+               while (s) {
+                  if (next == buffer.size())
+                     fill();
+                  auto n = std::min(s, buffer.size() - next);
+                  memcpy(d, buffer.data() + next, n);
+                  next += n;
+                  d += n;
+                  s -= n;
+               }
+               return true;
+            }
+
+            bool get(char& c) { return read(&c, 1); }
+
+            void skip(size_t s) {
+               auto n = std::min(s, buffer.size() - next);
+               next += n;
+               pos += s - n;
+            }
+
+            uint64_t tellg()const { return pos - (buffer.size() - next); }
+
+         private:
+            void fill() {
+               buffer.resize(buffer_size);
+               ssize_t n;
+               do {
+                  n = ::pread(fd, buffer.data(), buffer.size(), pos);
+               } while (n < 0 && errno == EINTR);
+               FC_ASSERT(n >= 0, "Unable to read block log: ${error}", ("error", strerror(errno))("pos", pos));
+               FC_ASSERT(n > 0, "Unexpected end of block log", ("pos", pos));
+               buffer.resize(n);
+               next = 0;
+               pos += n;
+            }
+
+            static const size_t buffer_size = 64 * 1024;
+
+            int           fd;
+            uint64_t      pos;
+            vector<char>  buffer;
+            size_t        next = 0;
+      };
+
+      void read_fully(int fd, char* d, size_t s, uint64_t pos) {
+         file_reader(fd, pos).read(d, s);
+      }
+
+      void write_fully(int fd, const char* d, size_t s, uint64_t pos) {
+         while (s) {
+            auto n = ::pwrite(fd, d, s, pos);
+            if (n < 0 && errno == EINTR)
+               continue;
+            FC_ASSERT(n > 0, "Unable to write block log: ${error}", ("error", strerror(errno))("pos", pos));
+            d += n;
+            s -= n;
+            pos += n;
+         }
+      }
+
+      void sync_fully(int fd) {
+         FC_ASSERT(::fsync(fd) == 0, "Unable to sync block log: ${error}", ("error", strerror(errno)));
+      }
+
       class block_log_impl {
          public:
+            ~block_log_impl() {
+               if (writer.joinable()) {
+                  {
+                     std::lock_guard<std::mutex> lock(mutex);
+                     stopping = true;
+                  }
+                  writer_wakeup.notify_all();
+                  writer.join();
+               }
+               if (block_fd >= 0)
+                  ::close(block_fd);
+               if (index_fd >= 0)
+                  ::close(index_fd);
+            }
+
             optional<signed_block>   head;
             block_id_type            head_id;
-            std::fstream             block_stream;
-            std::fstream             index_stream;
             fc::path                 block_file;
             fc::path                 index_file;
-            bool                     block_write;
-            bool                     index_write;
-
-            inline void check_block_read() {
-               if (block_write) {
-                  block_stream.close();
-                  block_stream.open(block_file.generic_string().c_str(), LOG_READ);
-                  block_write = false;
-               }
+            int                      block_fd = -1;
+            int                      index_fd = -1;
+            uint32_t                 sync_blocks = 0;
+            fc::microseconds         sync_interval;
+            /// whether records hold zlib compressed blocks; set when the log is opened
+            bool                     compressed = false;
+            /// the position of the first block
+            uint64_t                 data_start = 0;
+
+            /// guards the members below; the files are only read and written with pread and pwrite, which need no lock
+            std::mutex               mutex;
+            /// blocks in the order they were appended; the writer removes them once they are in the files
+            std::deque<pending_block> queue;
+            /// the size of the block file once every queued block has been written
+            uint64_t                 end_pos = 0;
+            uint64_t                 flush_requested = 0;
+            uint64_t                 flush_completed = 0;
+            bool                     stopping = false;
+            std::exception_ptr       write_error;
+            /// notified when blocks are queued, a flush is requested, or the writer should stop
+            std::condition_variable  writer_wakeup;
+            /// notified when queued blocks are written, a flush completes, or the writer fails
+            std::condition_variable  writer_progress;
+            std::thread              writer;
+
+            uint32_t head_num()const {
+               return head.valid() ? block_header::num_from_id(head_id) : 0;
+            }
+
+            const pending_block* find_pending(uint32_t block_num)const {
+               if (queue.empty() || block_num < queue.front().block_num || block_num > queue.back().block_num)
+                  return nullptr;
+               return &queue[block_num - queue.front().block_num];
+            }
+
+            const pending_block* find_pending_at(uint64_t pos)const {
+               if (queue.empty() || pos < queue.front().pos)
+                  return nullptr;
+               auto itr = std::lower_bound(queue.begin(), queue.end(), pos,
+                                           [](const pending_block& p, uint64_t pos) { return p.pos < pos; });
+               FC_ASSERT(itr != queue.end() && itr->pos == pos, "No block starts at position ${pos}", ("pos", pos));
+               return &*itr;
+            }
+
+            uint64_t read_index(uint32_t block_num)const {
+               uint64_t pos;
+               read_fully(index_fd, (char*)&pos, sizeof(pos), sizeof(uint64_t) * (block_num - 1));
+               return pos;
+            }
+
+            /// The record of a block is the packed block or, in a compressed log, the packed zlib stream of it
+            vector<char> encode_record(const signed_block& b)const {
+               auto packed = fc::raw::pack(b);
+               if (!compressed)
+                  return packed;
+               return fc::raw::pack(fc::zlib_compress(string(packed.begin(), packed.end())));
             }
 
-            inline void check_block_write() {
-               if (!block_write) {
-                  block_stream.close();
-                  block_stream.open(block_file.generic_string().c_str(), LOG_WRITE);
-                  block_write = true;
+            template<typename Stream>
+            signed_block read_record(Stream& s)const {
+               signed_block b;
+               if (compressed) {
+                  string stream;
+                  fc::raw::unpack(s, stream);
+                  auto packed = fc::zlib_decompress(stream);
+                  fc::datastream<const char*> ds(packed.data(), packed.size());
+                  fc::raw::unpack(ds, b);
+               } else {
+                  fc::raw::unpack(s, b);
                }
+               return b;
+            }
+
+            /// Replaces a record read from the log with the packed block it holds
+            void decompress_record(vector<char>& record)const {
+               if (!compressed)
+                  return;
+               fc::datastream<const char*> ds(record.data(), record.size());
+               string stream;
+               fc::raw::unpack(ds, stream);
+               auto packed = fc::zlib_decompress(stream);
+               record.assign(packed.begin(), packed.end());
+            }
+
+            signed_block decode_record(const char* d, size_t s)const {
+               fc::datastream<const char*> ds(d, s);
+               return read_record(ds);
+            }
+
+            signed_block decode_pending(const pending_block& pending)const {
+               return decode_record(pending.data.data(), pending.data.size() - sizeof(uint64_t));
+            }
+
+            std::pair<signed_block, uint64_t> read_block_from_file(uint64_t pos)const {
+               file_reader reader(block_fd, pos);
+               std::pair<signed_block, uint64_t> result;
+               result.first = read_record(reader);
+               result.second = reader.tellg() + sizeof(uint64_t);
+               return result;
+            }
+
+            void check_write_error()const {
+               if (write_error)
+                  std::rethrow_exception(write_error);
+            }
+
+            void sync_files() {
+               sync_fully(block_fd);
+               sync_fully(index_fd);
             }
 
-            inline void check_index_read() {
-               try {
-                  if (index_write) {
-                     index_stream.close();
-                     index_stream.open(index_file.generic_string().c_str(), LOG_READ);
-                     index_write = false;
+            void write_loop();
+      };
+
+      void block_log_impl::write_loop() {
+         try {
+            std::unique_lock<std::mutex> lock(mutex);
+            uint32_t unsynced = 0;
+            auto last_sync = fc::time_point::now();
+
+            while (true) {
+               if (!queue.empty()) {
+                  // Appends only push to the back of the queue, which leaves references to the other blocks valid,
+                  // so the blocks queued so far can be written without holding the lock
+                  vector<const pending_block*> batch;
+                  batch.reserve(queue.size());
+                  for (const auto& pending : queue)
+                     batch.push_back(&pending);
+                  lock.unlock();
+
+                  for (auto pending : batch) {
+                     write_fully(block_fd, pending->data.data(), pending->data.size(), pending->pos);
+                     write_fully(index_fd, (const char*)&pending->pos, sizeof(pending->pos),
+                                 sizeof(uint64_t) * (pending->block_num - 1));
                   }
+
+                  lock.lock();
+                  queue.erase(queue.begin(), queue.begin() + batch.size());
+                  unsynced += batch.size();
+                  writer_progress.notify_all();
                }
-               FC_LOG_AND_RETHROW()
-            }
 
-            inline void check_index_write() {
-               if (!index_write) {
-                  index_stream.close();
-                  index_stream.open(index_file.generic_string().c_str(), LOG_WRITE);
-                  index_write = true;
+               const bool drained = queue.empty();
+               const bool flush_pending = drained && flush_completed < flush_requested;
+               auto now = fc::time_point::now();
+               if (flush_pending || (drained && stopping) ||
+                   (unsynced && (unsynced >= sync_blocks || now - last_sync >= sync_interval))) {
+                  // Every flush requested so far was requested after its blocks were queued, and they are all written
+                  auto completes = flush_pending ? flush_requested : flush_completed;
+                  if (unsynced) {
+                     lock.unlock();
+                     sync_files();
+                     lock.lock();
+                     unsynced = 0;
+                     last_sync = fc::time_point::now();
+                  }
+                  flush_completed = completes;
+                  writer_progress.notify_all();
+                  if (drained && stopping)
+                     return;
+                  continue;
                }
+
+               if (!drained)
+                  continue;
+               if (unsynced)
+                  writer_wakeup.wait_for(lock, std::chrono::microseconds((last_sync + sync_interval - now).count()));
+               else
+                  writer_wakeup.wait(lock);
             }
-      };
+         } catch (const fc::exception& e) {
+            elog("Block log writer failed: ${e}", ("e", e.to_detail_string()));
+            std::lock_guard<std::mutex> lock(mutex);
+            write_error = std::current_exception();
+         } catch (const std::exception& e) {
+            elog("Block log writer failed: ${e}", ("e", e.what()));
+            std::lock_guard<std::mutex> lock(mutex);
+            write_error = std::current_exception();
+         }
+         writer_progress.notify_all();
+      }
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   block_log::block_log(const fc::path& data_dir, uint32_t sync_blocks, fc::microseconds sync_interval, bool compress)
    :my(new detail::block_log_impl()) {
-      my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
-      my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
-      open(data_dir);
+      my->sync_blocks = sync_blocks;
+      my->sync_interval = sync_interval;
+      open(data_dir, compress);
+      my->writer = std::thread([impl = my.get()] { impl->write_loop(); });
    }
 
    block_log::block_log(block_log&& other) {
@@ -72,28 +318,21 @@ namespace eosio { namespace chain {
    }
 
    block_log::~block_log() {
-      if (my) {
-         flush();
-         my.reset();
-      }
+      // the writer writes and syncs everything still queued before it stops
+      my.reset();
    }
 
-   void block_log::open(const fc::path& data_dir) {
-      if (my->block_stream.is_open())
-         my->block_stream.close();
-      if (my->index_stream.is_open())
-         my->index_stream.close();
-
+   void block_log::open(const fc::path& data_dir, bool compress) {
       if (!fc::is_directory(data_dir))
          fc::create_directories(data_dir);
       my->block_file = data_dir / "blocks.log";
       my->index_file = data_dir / "blocks.index";
 
       ilog("Opening block log at ${path}", ("path", my->block_file.generic_string()));
-      my->block_stream.open(my->block_file.generic_string().c_str(), LOG_WRITE);
-      my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-      my->block_write = true;
-      my->index_write = true;
+      my->block_fd = ::open(my->block_file.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      FC_ASSERT(my->block_fd >= 0, "Unable to open block log: ${error}", ("error", strerror(errno)));
+      my->index_fd = ::open(my->index_file.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      FC_ASSERT(my->index_fd >= 0, "Unable to open block log index: ${error}", ("error", strerror(errno)));
 
       /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to each other.
@@ -116,23 +355,33 @@ namespace eosio { namespace chain {
       auto log_size = fc::file_size(my->block_file);
       auto index_size = fc::file_size(my->index_file);
 
-      if (log_size) {
+      // The format of an existing log is kept; only a new log is created in the requested one
+      if (log_size >= sizeof(detail::compressed_log_magic)) {
+         char magic[sizeof(detail::compressed_log_magic)];
+         detail::read_fully(my->block_fd, magic, sizeof(magic), 0);
+         my->compressed = memcmp(magic, detail::compressed_log_magic, sizeof(magic)) == 0;
+      } else if (log_size == 0 && compress) {
+         detail::write_fully(my->block_fd, detail::compressed_log_magic, sizeof(detail::compressed_log_magic), 0);
+         log_size = sizeof(detail::compressed_log_magic);
+         my->compressed = true;
+      }
+      if (my->compressed != compress)
+         wlog("Block log is ${c}compressed, ignoring the requested format", ("c", my->compressed ? "" : "not "));
+      my->data_start = my->compressed ? sizeof(detail::compressed_log_magic) : 0;
+      my->end_pos = log_size;
+
+      if (log_size > my->data_start) {
          ilog("Log is nonempty");
          my->head = read_head();
          my->head_id = my->head->id();
 
          if (index_size) {
-            my->check_block_read();
-            my->check_index_read();
-
             ilog("Index is nonempty");
             uint64_t block_pos;
-            my->block_stream.seekg(-sizeof(uint64_t), std::ios::end);
-            my->block_stream.read((char*)&block_pos, sizeof(block_pos));
+            detail::read_fully(my->block_fd, (char*)&block_pos, sizeof(block_pos), log_size - sizeof(uint64_t));
 
             uint64_t index_pos;
-            my->index_stream.seekg(-sizeof(uint64_t), std::ios::end);
-            my->index_stream.read((char*)&index_pos, sizeof(index_pos));
+            detail::read_fully(my->index_fd, (char*)&index_pos, sizeof(index_pos), index_size - sizeof(uint64_t));
 
             if (block_pos < index_pos) {
                ilog("block_pos < index_pos, close and reopen index_stream");
@@ -147,114 +396,251 @@ namespace eosio { namespace chain {
          }
       } else if (index_size) {
          ilog("Index is nonempty, remove and recreate it");
-         my->index_stream.close();
-         fc::remove_all(my->index_file);
-         my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-         my->index_write = true;
+         FC_ASSERT(::ftruncate(my->index_fd, 0) == 0, "Unable to truncate block log index: ${error}",
+                   ("error", strerror(errno)));
       }
    }
 
    uint64_t block_log::append(const signed_block& b) {
       try {
-         my->check_block_write();
-         my->check_index_write();
-
-         uint64_t pos = my->block_stream.tellp();
-         FC_ASSERT(my->index_stream.tellp() == sizeof(uint64_t) * (b.block_num() - 1),
-                   "Append to index file occuring at wrong position.",
-                   ("position", (uint64_t) my->index_stream.tellp())
-                   ("expected", (b.block_num() - 1) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(b);
-         my->block_stream.write(data.data(), data.size());
-         my->block_stream.write((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
+         detail::pending_block pending;
+         pending.block_num = b.block_num();
+         pending.data = my->encode_record(b);
+
+         std::unique_lock<std::mutex> lock(my->mutex);
+         my->writer_progress.wait(lock, [this] {
+            return my->queue.size() < config::default_block_log_queue_size || my->write_error;
+         });
+         my->check_write_error();
+
+         FC_ASSERT(pending.block_num == my->head_num() + 1,
+                   "Append to block log occuring at wrong position.",
+                   ("block_num", pending.block_num)("expected", my->head_num() + 1));
+         pending.pos = my->end_pos;
+         pending.data.insert(pending.data.end(), (const char*)&pending.pos, (const char*)&pending.pos + sizeof(pending.pos));
+         my->end_pos += pending.data.size();
+
+         uint64_t pos = pending.pos;
+         my->queue.push_back(std::move(pending));
          my->head = b;
          my->head_id = b.id();
+         lock.unlock();
 
+         my->writer_wakeup.notify_one();
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
    void block_log::flush() {
-      my->block_stream.flush();
-      my->index_stream.flush();
+      std::unique_lock<std::mutex> lock(my->mutex);
+      auto requested = ++my->flush_requested;
+      my->writer_wakeup.notify_one();
+      my->writer_progress.wait(lock, [this, requested] {
+         return my->flush_completed >= requested || my->write_error;
+      });
+      my->check_write_error();
    }
 
    std::pair<signed_block, uint64_t> block_log::read_block(uint64_t pos)const {
-      my->check_block_read();
-
-      my->block_stream.seekg(pos);
-      std::pair<signed_block,uint64_t> result;
-      fc::raw::unpack(my->block_stream, result.first);
-      result.second = uint64_t(my->block_stream.tellg()) + 8;
-      return result;
+      {
+         std::lock_guard<std::mutex> lock(my->mutex);
+         if (auto pending = my->find_pending_at(pos))
+            return std::make_pair(my->decode_pending(*pending), pos + pending->data.size());
+      }
+      return my->read_block_from_file(pos);
    }
 
    optional<signed_block> block_log::read_block_by_num(uint32_t block_num)const {
       try {
          optional<signed_block> b;
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
-            b = read_block(pos).first;
-            FC_ASSERT(b->block_num() == block_num,
-                      "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
+         uint64_t pos = npos;
+         {
+            std::lock_guard<std::mutex> lock(my->mutex);
+            if (!(block_num > 0 && block_num <= my->head_num()))
+               return b;
+            if (auto pending = my->find_pending(block_num))
+               b = my->decode_pending(*pending);
+            else
+               pos = my->read_index(block_num);
          }
+         if (!b)
+            b = my->read_block_from_file(pos).first;
+         FC_ASSERT(b->block_num() == block_num,
+                   "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
          return b;
       } FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_index_read();
+   bool block_log::read_packed_block(uint32_t block_num, vector<char>& packed)const {
+      try {
+         uint64_t pos;
+         uint64_t end;
+         {
+            std::lock_guard<std::mutex> lock(my->mutex);
+            if (!(block_num > 0 && block_num <= my->head_num()))
+               return false;
+            if (auto pending = my->find_pending(block_num)) {
+               packed.assign(pending->data.begin(), pending->data.end() - sizeof(uint64_t));
+               my->decompress_record(packed);
+               return true;
+            }
+            // the record ends where the next block starts, or where the first queued block will be written
+            pos = my->read_index(block_num);
+            if (my->find_pending(block_num + 1) || block_num == my->head_num())
+               end = my->queue.empty() ? my->end_pos : my->queue.front().pos;
+            else
+               end = my->read_index(block_num + 1);
+         }
+         packed.resize(end - pos - sizeof(uint64_t));
+         detail::read_fully(my->block_fd, packed.data(), packed.size(), pos);
+         my->decompress_record(packed);
+         return true;
+      } FC_LOG_AND_RETHROW()
+   }
 
-      if (!(my->head.valid() && block_num <= block_header::num_from_id(my->head_id) && block_num > 0))
+   optional<block_id_type> block_log::read_block_id(uint32_t block_num)const {
+      vector<char> packed;
+      if (!read_packed_block(block_num, packed))
+         return {};
+      block_view view(packed.data(), packed.size());
+      FC_ASSERT(view.block_num() == block_num,
+                "Wrong block was read from block log.", ("returned", view.block_num())("expected", block_num));
+      return view.id();
+   }
+
+   vector<signed_block> block_log::read_blocks(uint32_t first, uint32_t count)const {
+      try {
+         // The records of the blocks, either in file_data or copied from the queue, without their positions
+         vector<std::pair<const char*, size_t>> records;
+         vector<char> file_data;
+         vector<vector<char>> queued;
+         uint32_t file_count;
+         uint32_t written_num;
+         uint64_t file_end;
+         {
+            std::lock_guard<std::mutex> lock(my->mutex);
+            if (!(first > 0 && first <= my->head_num()))
+               return {};
+            count = std::min(count, my->head_num() - first + 1);
+
+            written_num = my->queue.empty() ? my->head_num() : my->queue.front().block_num - 1;
+            file_count = first <= written_num ? std::min(count, written_num - first + 1) : 0;
+            file_end = my->queue.empty() ? my->end_pos : my->queue.front().pos;
+            for (uint32_t num = first + file_count; num < first + count; ++num)
+               queued.push_back(my->find_pending(num)->data);
+         }
+
+         if (file_count) {
+            // The block after the last one read, if it has been written, starts where the last one ends
+            vector<uint64_t> positions(first + file_count <= written_num ? file_count + 1 : file_count);
+            detail::read_fully(my->index_fd, (char*)positions.data(), positions.size() * sizeof(uint64_t),
+                               sizeof(uint64_t) * (first - 1));
+            if (positions.size() == file_count)
+               positions.push_back(file_end);
+
+            file_data.resize(positions.back() - positions.front());
+            detail::read_fully(my->block_fd, file_data.data(), file_data.size(), positions.front());
+            for (uint32_t i = 0; i < file_count; ++i)
+               records.emplace_back(file_data.data() + (positions[i] - positions.front()),
+                                    positions[i + 1] - positions[i] - sizeof(uint64_t));
+         }
+         for (const auto& data : queued)
+            records.emplace_back(data.data(), data.size() - sizeof(uint64_t));
+
+         vector<signed_block> blocks(count);
+         const uint32_t workers = std::min(count, std::max(1u, std::thread::hardware_concurrency()));
+         vector<std::exception_ptr> errors(workers);
+         auto decode = [&](uint32_t worker) {
+            try {
+               for (uint32_t i = worker; i < count; i += workers)
+                  blocks[i] = my->decode_record(records[i].first, records[i].second);
+            } catch (...) {
+               errors[worker] = std::current_exception();
+            }
+         };
+
+         vector<std::thread> threads;
+         for (uint32_t worker = 1; worker < workers; ++worker)
+            threads.emplace_back(decode, worker);
+         decode(0);
+         for (auto& thread : threads)
+            thread.join();
+         for (const auto& error : errors)
+            if (error)
+               std::rethrow_exception(error);
+
+         for (uint32_t i = 0; i < count; ++i)
+            FC_ASSERT(blocks[i].block_num() == first + i,
+                      "Wrong block was read from block log.", ("returned", blocks[i].block_num())("expected", first + i));
+         return blocks;
+      } FC_LOG_AND_RETHROW()
+   }
+
+   uint64_t block_log::get_block_pos(uint32_t block_num) const {
+      std::lock_guard<std::mutex> lock(my->mutex);
+      if (!(block_num > 0 && block_num <= my->head_num()))
          return npos;
-      my->index_stream.seekg(sizeof(uint64_t) * (block_num - 1));
-      uint64_t pos;
-      my->index_stream.read((char*)&pos, sizeof(pos));
-      return pos;
+      if (auto pending = my->find_pending(block_num))
+         return pending->pos;
+      return my->read_index(block_num);
    }
 
    optional<signed_block> block_log::read_head()const {
-      my->check_block_read();
+      uint64_t end_pos;
+      {
+         std::lock_guard<std::mutex> lock(my->mutex);
+         if (!my->queue.empty())
+            return my->decode_pending(my->queue.back());
+         end_pos = my->end_pos;
+      }
 
       uint64_t pos;
 
-      // Check that the file is not empty
-      my->block_stream.seekg(0, std::ios::end);
-      if (my->block_stream.tellg() <= sizeof(pos))
+      // Check that the file has a block
+      if (end_pos <= my->data_start + sizeof(pos))
          return {};
 
-      my->block_stream.seekg(-sizeof(pos), std::ios::end);
-      my->block_stream.read((char*)&pos, sizeof(pos));
-      return read_block(pos).first;
+      detail::read_fully(my->block_fd, (char*)&pos, sizeof(pos), end_pos - sizeof(pos));
+      return my->read_block_from_file(pos).first;
    }
 
-   const optional<signed_block>& block_log::head()const {
+   optional<signed_block> block_log::head()const {
+      std::lock_guard<std::mutex> lock(my->mutex);
       return my->head;
    }
 
+   uint32_t block_log::head_num()const {
+      std::lock_guard<std::mutex> lock(my->mutex);
+      return my->head_num();
+   }
+
    void block_log::construct_index() {
       ilog("Reconstructing Block Log Index...");
-      my->index_stream.close();
-      fc::remove_all(my->index_file);
-      my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-      my->index_write = true;
+      FC_ASSERT(::ftruncate(my->index_fd, 0) == 0, "Unable to truncate block log index: ${error}",
+                ("error", strerror(errno)));
 
-      uint64_t pos = 0;
+      uint64_t pos = my->data_start;
       uint64_t end_pos;
-      my->check_block_read();
+      detail::read_fully(my->block_fd, (char*)&end_pos, sizeof(end_pos), my->end_pos - sizeof(end_pos));
 
-      my->block_stream.seekg(-sizeof( uint64_t), std::ios::end);
-      my->block_stream.read((char*)&end_pos, sizeof(end_pos));
       signed_block tmp;
-
-      my->block_stream.seekg(pos);
-
-      while (pos < end_pos) {
-         fc::raw::unpack(my->block_stream, tmp);
-         my->block_stream.read((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
-      }
+      detail::file_reader reader(my->block_fd, pos);
+      vector<uint64_t> index;
+
+      // the position after each block is its own, so the last one read is that of the head block
+      do {
+         // a compressed record starts with its size, so it can be skipped without decompressing it
+         if (my->compressed) {
+            fc::unsigned_int size;
+            fc::raw::unpack(reader, size);
+            reader.skip(size.value);
+         } else {
+            fc::raw::unpack(reader, tmp);
+         }
+         reader.read((char*)&pos, sizeof(pos));
+         index.push_back(pos);
+      } while (pos < end_pos);
+      detail::write_fully(my->index_fd, (const char*)index.data(), index.size() * sizeof(uint64_t), 0);
    }
 } }
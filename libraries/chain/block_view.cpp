@@ -0,0 +1,134 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain/block_view.hpp>
+
+#include <fc/bitutil.hpp>
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      using stream = fc::datastream<const char*>;
+
+      /// The packed sizes of the fixed size fields which are skipped
+      const size_t packed_name_size = sizeof(uint64_t);
+      const size_t packed_permission_size = 2 * packed_name_size;
+      const size_t packed_signature_size = sizeof(signature_type);
+      const size_t packed_id_size = sizeof(generated_transaction_id_type);
+      /// ref_block_num, ref_block_prefix and expiration
+      const size_t packed_transaction_prefix_size = 2 + 4 + 4;
+
+      static_assert(sizeof(signature_type) == 65, "signatures are packed as 65 bytes");
+      static_assert(sizeof(generated_transaction_id_type) == 32, "ids are packed as 32 bytes");
+
+      uint32_t read_size(stream& s) {
+         fc::unsigned_int size;
+         fc::raw::unpack(s, size);
+         return size.value;
+      }
+
+      void skip(stream& s, uint64_t size) {
+         FC_ASSERT(size <= s.remaining(), "Packed data is truncated", ("size", size)("remaining", s.remaining()));
+         s.skip(size);
+      }
+
+      void skip_transaction(stream& s) {
+         skip(s, packed_transaction_prefix_size);
+         skip(s, uint64_t(read_size(s)) * packed_name_size); // scope
+         skip(s, uint64_t(read_size(s)) * packed_name_size); // read_scope
+         for (auto messages = read_size(s); messages; --messages) {
+            skip(s, 2 * packed_name_size); // code and type
+            skip(s, uint64_t(read_size(s)) * packed_permission_size);
+            skip(s, read_size(s)); // data
+         }
+      }
+
+      void skip_message_outputs(stream& s);
+
+      void skip_message_output(stream& s) {
+         for (auto notify = read_size(s); notify; --notify) {
+            skip(s, packed_name_size);
+            skip_message_output(s);
+         }
+         bool inline_trx;
+         fc::raw::unpack(s, inline_trx);
+         if (inline_trx) {
+            skip_transaction(s);
+            skip_message_outputs(s);
+         }
+         // a generated_transaction is packed as its id alone
+         skip(s, uint64_t(read_size(s)) * packed_id_size);
+      }
+
+      void skip_message_outputs(stream& s) {
+         for (auto outputs = read_size(s); outputs; --outputs)
+            skip_message_output(s);
+      }
+   }
+
+   transaction_view::transaction_view(fc::datastream<const char*>& ds)
+   :_data(ds.pos()) {
+      skip_transaction(ds);
+      _transaction_size = ds.pos() - _data;
+      skip(ds, uint64_t(read_size(ds)) * packed_signature_size);
+      _size = ds.pos() - _data;
+   }
+
+   transaction_view::transaction_view(const char* data, size_t size) {
+      stream ds(data, size);
+      *this = transaction_view(ds);
+   }
+
+   transaction_id_type transaction_view::id()const {
+      return fc::sha256::hash(_data, _transaction_size);
+   }
+
+   signed_transaction transaction_view::unpack()const {
+      stream ds(_data, _size);
+      signed_transaction trx;
+      fc::raw::unpack(ds, trx);
+      return trx;
+   }
+
+   block_view::block_view(const char* data, size_t size)
+   :_data(data), _size(size) {
+      stream ds(data, size);
+      fc::raw::unpack(ds, _header);
+      _header_size = ds.tellp();
+   }
+
+   block_id_type block_view::id()const {
+      // the same as signed_block_header::id()
+      block_id_type result = fc::sha256::hash(_data, _header_size);
+      result._hash[0] &= 0xffffffff00000000;
+      result._hash[0] += fc::endian_reverse_u32(block_num());
+      return result;
+   }
+
+   void block_view::for_each_transaction(const std::function<void(const transaction_view&)>& f)const {
+      stream ds(_data + _header_size, _size - _header_size);
+      for (auto cycles = read_size(ds); cycles; --cycles) {
+         for (auto threads = read_size(ds); threads; --threads) {
+            for (auto generated = read_size(ds); generated; --generated) {
+               skip(ds, packed_id_size);
+               skip_message_outputs(ds);
+            }
+            for (auto user = read_size(ds); user; --user) {
+               transaction_view trx(ds);
+               skip_message_outputs(ds);
+               f(trx);
+            }
+         }
+      }
+   }
+
+   signed_block block_view::unpack()const {
+      stream ds(_data, _size);
+      signed_block block;
+      fc::raw::unpack(ds, block);
+      return block;
+   }
+
+} } // eosio::chain
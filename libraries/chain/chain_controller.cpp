@@ -36,12 +36,17 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <future>
 #include <chrono>
 
 namespace eosio { namespace chain {
 bool chain_controller::is_known_block(const block_id_type& id)const
 {
-   return _fork_db.is_known_block(id) || _block_log.read_block_by_id(id);
+   if (_fork_db.is_known_block(id))
+      return true;
+   // only the header is read to check the id, the block is not decoded
+   auto logged_id = _block_log.read_block_id(block_header::num_from_id(id));
+   return logged_id && *logged_id == id;
 }
 /**
  * Only return true *if* the transaction has not expired or been invalidated. If this
@@ -56,6 +61,8 @@ bool chain_controller::is_known_transaction(const transaction_id_type& id)const
 
 block_id_type chain_controller::get_block_id_for_num(uint32_t block_num)const
 { try {
+   if (auto id = _block_log.read_block_id(block_num))
+      return *id;
    if (const auto& block = fetch_block_by_number(block_num))
       return block->id();
 
@@ -86,12 +93,18 @@ optional<signed_block> chain_controller::fetch_block_by_number(uint32_t num)cons
    return optional<signed_block>();
 }
 
-const signed_transaction& chain_controller::get_recent_transaction(const transaction_id_type& trx_id) const
+bool chain_controller::fetch_packed_block_by_number(uint32_t num, vector<char>& packed)const
 {
-   auto& index = _db.get_index<transaction_multi_index, by_trx_id>();
-   auto itr = index.find(trx_id);
-   FC_ASSERT(itr != index.end());
-   return itr->trx;
+   if (_block_log.read_packed_block(num, packed))
+      return true;
+
+   if (const auto& block = fetch_block_by_number(num)) {
+      packed.resize(fc::raw::pack_size(*block));
+      fc::datastream<char*> ds(packed.data(), packed.size());
+      fc::raw::pack(ds, *block);
+      return true;
+   }
+   return false;
 }
 
 std::vector<block_id_type> chain_controller::get_block_ids_on_fork(block_id_type head_of_fork) const
@@ -136,6 +149,29 @@ bool chain_controller::push_block(const signed_block& new_block, uint32_t skip)
    });
 } FC_CAPTURE_AND_RETHROW((new_block)) }
 
+bool chain_controller::push_block(const signed_block& new_block, uint32_t skip, const block_precomputed& precomputed)
+{
+   _precomputed_for = &new_block;
+   _precomputed_block = &precomputed;
+   auto on_exit = fc::make_scoped_exit( [&](){ _precomputed_for = nullptr; _precomputed_block = nullptr; } );
+   return push_block( new_block, skip );
+}
+
+chain_controller::block_precomputed chain_controller::precompute_block(const signed_block& b, bool signature_keys)
+{ try {
+   FC_ASSERT( b.transaction_merkle_root == b.calculate_merkle_root(), "Block transaction merkle root does not match its transactions",
+              ("transaction_merkle_root",b.transaction_merkle_root) );
+   block_precomputed result;
+   result.signee = b.signee();
+   if( signature_keys ) {
+      for (const auto& cycle : b.cycles)
+         for (const auto& thread : cycle)
+            for (const auto& trx : thread.user_input)
+               result.signature_keys.emplace_back( recover_signature_keys(trx) );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (b.block_num()) ) }
+
 bool chain_controller::_push_block(const signed_block& new_block)
 { try {
    uint32_t skip = _skip_flags;
@@ -243,17 +279,51 @@ processed_transaction chain_controller::push_transaction(const signed_transactio
    });
 } FC_CAPTURE_AND_RETHROW((trx)) }
 
-processed_transaction chain_controller::_push_transaction(const signed_transaction& trx) {
+vector<chain_controller::batch_push_result> chain_controller::push_transactions(const vector<signed_transaction>& trxs,
+                                                                               const vector<flat_set<public_key_type>>& signature_keys,
+                                                                               uint32_t skip)
+{ try {
+   FC_ASSERT( signature_keys.empty() || signature_keys.size() == trxs.size(),
+              "signature keys must be provided for every transaction or none" );
+
+   vector<batch_push_result> results(trxs.size());
+   with_skip_flags(skip, [&]() {
+      _db.with_write_lock([&]() {
+         for (size_t i = 0; i < trxs.size(); ++i) {
+            try {
+               results[i].processed = _push_transaction(trxs[i], signature_keys.empty() ? nullptr : &signature_keys[i]);
+            } catch (const fc::exception& e) {
+               results[i].error = e.dynamic_copy_exception();
+            }
+         }
+      });
+   });
+   return results;
+} FC_CAPTURE_AND_RETHROW((trxs.size())) }
+
+processed_transaction chain_controller::_push_transaction(const signed_transaction& trx,
+                                                          const flat_set<public_key_type>* signature_keys) {
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
-   if (!_pending_tx_session.valid())
+   if (!_pending_tx_session.valid()) {
       _pending_tx_session = _db.start_undo_session(true);
+      _candidate_block.reset();
+      if (_maintain_candidate_block)
+         start_candidate_block();
+   }
 
    auto temp_session = _db.start_undo_session(true);
    validate_referenced_accounts(trx);
-   check_transaction_authorization(trx);
+   check_transaction_authorization(trx, false, signature_keys);
    auto pt = apply_transaction(trx);
-   _pending_transactions.push_back(trx);
+   // a transaction the pool has no room for is undone with temp_session
+   _pending_transactions.remove_expired(head_block_time());
+   const auto& entry = _pending_transactions.add(trx);
+
+   if (_candidate_block && fits_candidate_block(entry.size())) {
+      _candidate_block->user_input_merkle.append(transaction_digest(pt));
+      _candidate_block->block_thread.user_input.emplace_back(pt);
+   }
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -301,17 +371,69 @@ signed_block chain_controller::_generate_block(
    if( !(skip & skip_producer_signature) )
       FC_ASSERT( producer_obj.signing_key == block_signing_private_key.get_public_key() );
 
-  
+   signed_block pending_block;
+   incremental_merkle transaction_merkle;
+
+   if (scheduler == block_schedule::in_single_thread && _pending_tx_session.valid() && _candidate_block &&
+       _candidate_block->previous == head_block_id()) {
+      // Transactions are evaluated against the head block, which has not changed since they were pushed, so the
+      // candidate holds the same transactions and results as scheduling them in a single thread would.
+      auto& block_thread = _candidate_block->block_thread;
+      transaction_merkle = _candidate_block->user_input_merkle;
+      for (const auto& trx : block_thread.generated_input)
+         transaction_merkle.append(trx.id);
+      if (!(block_thread.generated_input.empty() && block_thread.user_input.empty())) {
+         pending_block.cycles.emplace_back();
+         pending_block.cycles.back().emplace_back(std::move(block_thread));
+      }
+   } else {
+      _schedule_pending_block(scheduler, pending_block, transaction_merkle);
+   }
+
+   _pending_tx_session.reset();
+   _candidate_block.reset();
+
+   // We have temporarily broken the invariant that
+   // _pending_tx_session is the result of applying _pending_tx, as
+   // _pending_transactions now consists of the set of postponed transactions.
+   // However, the push_block() call below will re-create the
+   // _pending_tx_session.
+
+   pending_block.previous = head_block_id();
+   pending_block.timestamp = when;
+   pending_block.transaction_merkle_root = signed_block::merkle_root(transaction_merkle);
+
+   pending_block.producer = producer_obj.owner;
+
+   // If this block is last in a round, calculate the schedule for the new round
+   if (pending_block.block_num() % config::blocks_per_round == 0) {
+      auto new_schedule = _admin->get_next_round(_db);
+      pending_block.producer_changes = get_global_properties().active_producers - new_schedule;
+   }
+
+   if( !(skip & skip_producer_signature) )
+      pending_block.sign( block_signing_private_key );
+
+   // TODO:  Move this to _push_block() so session is restored.
+   /*
+   if( !(skip & skip_block_size_check) )
+   {
+      FC_ASSERT( fc::raw::pack_size(pending_block) <= get_global_properties().parameters.maximum_block_size );
+   }
+   */
+
+   // push_block( pending_block, skip );
+
+   return pending_block;
+} FC_CAPTURE_AND_RETHROW( (producer) ) }
+
+void chain_controller::_schedule_pending_block(block_schedule::factory scheduler, signed_block& pending_block,
+                                               incremental_merkle& transaction_merkle)
+{
    //
    // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
-   //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
+   // rebuilds it by re-applying pending transactions, in the order the
+   // scheduler puts them in the block.
    //
    _pending_tx_session.reset();
    _pending_tx_session = _db.start_undo_session(true);
@@ -326,14 +448,14 @@ signed_block chain_controller::_generate_block(
       pending.emplace_back(std::reference_wrapper<const generated_transaction> {gt.trx});
    }
    
-   for(const auto& st: _pending_transactions) {
-      pending.emplace_back(std::reference_wrapper<const signed_transaction> {st});
+   for(const auto& pt: _pending_transactions.get<transaction_pool::by_priority>()) {
+      pending.emplace_back(std::reference_wrapper<const signed_transaction> {*pt.trx});
    }
 
    auto schedule = scheduler(pending, get_global_properties());
 
-   signed_block pending_block;
    pending_block.cycles.reserve(schedule.cycles.size());
+   // the merkle root grows with each thread, so it is ready once the last transaction is in
 
    size_t invalid_transaction_count = 0;
    size_t valid_transaction_count = 0;
@@ -385,6 +507,8 @@ signed_block chain_controller::_generate_block(
        if (!(block_thread.generated_input.empty() && block_thread.user_input.empty())) {
           block_thread.generated_input.shrink_to_fit();
           block_thread.user_input.shrink_to_fit();
+          for (const auto& leaf : block_thread.merkle_leaves())
+             transaction_merkle.append(leaf);
           block_cycle.emplace_back(std::move(block_thread));
        }
      }
@@ -405,53 +529,53 @@ signed_block chain_controller::_generate_block(
       wlog( "Postponed ${n} transactions errors when processing", ("n", invalid_transaction_count) );
 
       // remove pending transactions determined to be bad during scheduling
-      if (invalid_pending.size() > 0) {
-         for (auto itr = _pending_transactions.begin(); itr != _pending_transactions.end(); ) {
-            auto& tx = *itr;
-            if (invalid_pending.find(tx.id()) != invalid_pending.end()) {
-               itr = _pending_transactions.erase(itr);
-            } else {
-               ++itr;
-            }
-         }
+      for (const auto& id : invalid_pending) {
+         _pending_transactions.remove(id);
       }
    }
+}
 
-   _pending_tx_session.reset();
-
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_transactions now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
-
-   pending_block.previous = head_block_id();
-   pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+void chain_controller::maintain_candidate_block(bool enabled) {
+   _maintain_candidate_block = enabled;
+   if (!enabled)
+      _candidate_block.reset();
+}
 
-   pending_block.producer = producer_obj.owner;
+void chain_controller::start_candidate_block() {
+   static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
+   const size_t maximum_block_size = get_global_properties().configuration.max_blk_size;
 
-   // If this block is last in a round, calculate the schedule for the new round
-   if (pending_block.block_num() % config::blocks_per_round == 0) {
-      auto new_schedule = _admin->get_next_round(_db);
-      pending_block.producer_changes = get_global_properties().active_producers - new_schedule;
-   }
+   _candidate_block = candidate_block();
+   _candidate_block->previous = head_block_id();
+   _candidate_block->max_transaction_size = maximum_block_size > max_block_header_size ?
+                                            maximum_block_size - max_block_header_size : 0;
 
-   if( !(skip & skip_producer_signature) )
-      pending_block.sign( block_signing_private_key );
+   // Generated transactions are scheduled ahead of the pushed ones, so they are applied first
+   const auto& generated = _db.get_index<generated_transaction_multi_index, generated_transaction_object::by_status>().equal_range(generated_transaction_object::PENDING);
+   vector<std::reference_wrapper<const generated_transaction>> generated_trxs;
+   for (auto iter = generated.first; iter != generated.second; ++iter)
+      generated_trxs.emplace_back(iter->trx);
 
-   // TODO:  Move this to _push_block() so session is restored.
-   /*
-   if( !(skip & skip_block_size_check) )
-   {
-      FC_ASSERT( fc::raw::pack_size(pending_block) <= get_global_properties().parameters.maximum_block_size );
+   for (const auto& trx : generated_trxs) {
+      if (!fits_candidate_block(fc::raw::pack_size(trx.get())))
+         break;
+      try {
+         auto temp_session = _db.start_undo_session(true);
+         auto processed = apply_transaction(trx.get());
+         temp_session.squash();
+         _candidate_block->block_thread.generated_input.emplace_back(processed);
+      } catch (const fc::exception& e) {
+         elog( "Generated transaction was not processed for the candidate block due to ${e}", ("e", e) );
+      }
    }
-   */
-
-   // push_block( pending_block, skip );
+}
 
-   return pending_block;
-} FC_CAPTURE_AND_RETHROW( (producer) ) }
+bool chain_controller::fits_candidate_block(size_t transaction_size) {
+   // the same limit as block_schedule::in_single_thread, which stops at the first transaction that does not fit
+   if (transaction_size > _candidate_block->max_transaction_size)
+      _candidate_block->full = true;
+   return !_candidate_block->full;
+}
 
 /**
  * Removes the most recent block from the database and undoes any changes it made.
@@ -469,8 +593,10 @@ void chain_controller::pop_block()
 
 void chain_controller::clear_pending()
 { try {
-   _pending_transactions.clear();
-   _pending_tx_session.reset();
+   _db.with_write_lock([&]() {
+      _pending_transactions.clear();
+      _pending_tx_session.reset();
+   });
 } FC_CAPTURE_AND_RETHROW() }
 
 //////////////////// private methods ////////////////////
@@ -643,12 +769,18 @@ void chain_controller::check_transaction_output(const T& expected, const T& actu
 void chain_controller::_apply_block(const signed_block& next_block)
 { try {
    uint32_t skip = _skip_flags;
+   // precompute_block already checked the merkle root and recovered the keys of this very block
+   const block_precomputed* precomputed = (_precomputed_for == &next_block) ? _precomputed_block : nullptr;
+   const flat_set<public_key_type>* signature_keys = nullptr;
+   if (precomputed && !precomputed->signature_keys.empty())
+      signature_keys = precomputed->signature_keys.data();
 
-   FC_ASSERT((skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(),
+   FC_ASSERT((skip & skip_merkle_check) || precomputed || next_block.transaction_merkle_root == next_block.calculate_merkle_root(),
              "", ("next_block.transaction_merkle_root", next_block.transaction_merkle_root)
              ("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()));
 
-   const producer_object& signing_producer = validate_block_header(skip, next_block);
+   const producer_object& signing_producer = validate_block_header(skip, next_block,
+                                                                   precomputed ? &precomputed->signee : nullptr);
    
    for (const auto& cycle : next_block.cycles)
       for (const auto& thread : cycle)
@@ -656,7 +788,7 @@ void chain_controller::_apply_block(const signed_block& next_block)
             validate_referenced_accounts(trx);
             // Check authorization, and allow irrelevant signatures.
             // If the block producer let it slide, we'll roll with it.
-            check_transaction_authorization(trx, true);
+            check_transaction_authorization(trx, true, signature_keys ? signature_keys++ : nullptr);
          }
 
    /* We do not need to push the undo state for each transaction
@@ -712,7 +844,7 @@ void chain_controller::_apply_block(const signed_block& next_block)
 namespace {
 
   auto make_get_permission(const chainbase::database& db) {
-     return [&db](const types::account_permission& permission) {
+     return [&db](const types::account_permission& permission) -> const permission_object& {
         auto key = boost::make_tuple(permission.account, permission.permission);
         return db.get<permission_object, by_owner>(key);
      };
@@ -720,7 +852,7 @@ namespace {
 
   auto make_auth_checker(const chainbase::database& db, const flat_set<public_key_type>& signingKeys) {
      auto getPermission = make_get_permission(db);
-     auto getAuthority = [getPermission](const types::account_permission& permission) {
+     auto getAuthority = [getPermission](const types::account_permission& permission) -> const shared_authority& {
         return getPermission(permission).auth;
      };
      auto depthLimit = db.get<global_property_object>().configuration.auth_depth_limit;
@@ -745,21 +877,32 @@ flat_set<public_key_type> chain_controller::get_required_keys(const signed_trans
    return checker.used_keys();
 }
 
-void chain_controller::check_transaction_authorization(const signed_transaction& trx, bool allow_unused_signatures)const {
+flat_set<public_key_type> chain_controller::recover_signature_keys(const signed_transaction& trx) {
+#warning TODO: Use a real chain_id here (where is this stored? Do we still need it?)
+   return trx.get_signature_keys(chain_id_type{});
+}
+
+void chain_controller::check_transaction_authorization(const signed_transaction& trx, bool allow_unused_signatures,
+                                                       const flat_set<public_key_type>* signature_keys)const {
    if ((_skip_flags & skip_transaction_signatures) && (_skip_flags & skip_authority_check)) {
       //ilog("Skipping auth and sigs checks");
       return;
    }
 
    auto getPermission = make_get_permission(_db);
-#warning TODO: Use a real chain_id here (where is this stored? Do we still need it?)
-   auto checker = make_auth_checker(_db, trx.get_signature_keys(chain_id_type{}));
+   auto checker = make_auth_checker(_db, signature_keys ? *signature_keys : recover_signature_keys(trx));
+
+   // Messages of a transaction commonly repeat the same declared authority, code and type; check each once
+   using relevance_key = std::tuple<types::account_name, types::permission_name, types::account_name, types::func_name>;
+   flat_set<relevance_key> relevantAuthorities;
 
    for (const auto& message : trx.messages)
       for (const auto& declaredAuthority : message.authorization) {
-         const auto& minimumPermission = lookup_minimum_permission(declaredAuthority.account,
-                                                                   message.code, message.type);
-         if ((_skip_flags & skip_authority_check) == false) {
+         if ((_skip_flags & skip_authority_check) == false &&
+             relevantAuthorities.emplace(declaredAuthority.account, declaredAuthority.permission,
+                                         message.code, message.type).second) {
+            const auto& minimumPermission = lookup_minimum_permission(declaredAuthority.account,
+                                                                      message.code, message.type);
             const auto& index = _db.get_index<permission_index>().indices();
             EOS_ASSERT(getPermission(declaredAuthority).satisfies(minimumPermission, index), tx_irrelevant_auth,
                        "Message declares irrelevant authority '${auth}'; minimum authority is ${min}",
@@ -827,7 +970,7 @@ void chain_controller::record_transaction(const signed_transaction& trx) {
    //Insert transaction into unique transactions database.
     _db.create<transaction_object>([&](transaction_object& transaction) {
         transaction.trx_id = trx.id(); /// TODO: consider caching ID
-        transaction.trx = trx;
+        transaction.expiration = trx.expiration;
     });
 }
 
@@ -1076,7 +1219,8 @@ void chain_controller::require_account(const types::account_name& name) const {
    FC_ASSERT(account != nullptr, "Account not found: ${name}", ("name", name));
 }
 
-const producer_object& chain_controller::validate_block_header(uint32_t skip, const signed_block& next_block)const {
+const producer_object& chain_controller::validate_block_header(uint32_t skip, const signed_block& next_block,
+                                                               const public_key_type* signee)const {
    EOS_ASSERT(head_block_id() == next_block.previous, block_validate_exception, "",
               ("head_block_id",head_block_id())("next.prev",next_block.previous));
    EOS_ASSERT(head_block_time() < next_block.timestamp, block_validate_exception, "",
@@ -1094,9 +1238,9 @@ const producer_object& chain_controller::validate_block_header(uint32_t skip, co
    const producer_object& producer = get_producer(get_scheduled_producer(get_slot_at_time(next_block.timestamp)));
 
    if(!(skip&skip_producer_signature))
-      EOS_ASSERT(next_block.validate_signee(producer.signing_key), block_validate_exception,
-                 "Incorrect block producer key: expected ${e} but got ${a}",
-                 ("e", producer.signing_key)("a", public_key_type(next_block.signee())));
+      EOS_ASSERT(signee ? *signee == producer.signing_key : next_block.validate_signee(producer.signing_key),
+                 block_validate_exception, "Incorrect block producer key: expected ${e} but got ${a}",
+                 ("e", producer.signing_key)("a", signee ? *signee : public_key_type(next_block.signee())));
 
    if(!(skip&skip_producer_schedule_check)) {
       EOS_ASSERT(next_block.producer == producer.owner, block_validate_exception,
@@ -1263,7 +1407,8 @@ chain_controller::chain_controller(database& database, fork_database& fork_db, b
      _per_auth_account_txn_msg_rate_limit_time_frame_sec(rate_limit.per_auth_account_time_frame_sec),
      _per_auth_account_txn_msg_rate_limit(rate_limit.per_auth_account),
      _per_code_account_txn_msg_rate_limit_time_frame_sec(rate_limit.per_code_account_time_frame_sec),
-     _per_code_account_txn_msg_rate_limit(rate_limit.per_code_account) {
+     _per_code_account_txn_msg_rate_limit(rate_limit.per_code_account),
+     _abi_serializer_cache(new abi_serializer_cache()) {
 
    if (applied_func)
       applied_irreversible_block.connect(*applied_func);
@@ -1307,18 +1452,31 @@ void chain_controller::replay() {
    const auto last_block_num = last_block->block_num();
 
    ilog("Replaying ${n} blocks...", ("n", last_block_num) );
-   for (uint32_t i = 1; i <= last_block_num; ++i) {
-      if (i % 5000 == 0)
-         std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional<signed_block> block = _block_log.read_block_by_num(i);
-      FC_ASSERT(block, "Could not find block #${n} in block_log!", ("n", i));
-      apply_block(*block, skip_producer_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_producer_schedule_check |
-                          skip_authority_check |
-                          received_block);
+   // Blocks are read and decoded a batch at a time, the next batch while the blocks of this one are applied
+   const uint32_t batch_size = 1000;
+   auto read_batch = [this, last_block_num, batch_size](uint32_t first) {
+      return _block_log.read_blocks(first, std::min(batch_size, last_block_num - first + 1));
+   };
+   auto next_batch = std::async(std::launch::async, read_batch, 1);
+   for (uint32_t first = 1; first <= last_block_num; first += batch_size) {
+      auto blocks = next_batch.get();
+      FC_ASSERT(blocks.size() == std::min(batch_size, last_block_num - first + 1),
+                "Could not find block #${n} in block_log!", ("n", first + blocks.size()));
+      if (last_block_num - first >= batch_size)
+         next_batch = std::async(std::launch::async, read_batch, first + batch_size);
+
+      for (const auto& block : blocks) {
+         auto i = block.block_num();
+         if (i % 5000 == 0)
+            std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
+         apply_block(block, skip_producer_signature |
+                            skip_transaction_signatures |
+                            skip_transaction_dupe_check |
+                            skip_tapos_check |
+                            skip_producer_schedule_check |
+                            skip_authority_check |
+                            received_block);
+      }
    }
    auto end = fc::time_point::now();
    ilog("Done replaying ${n} blocks, elapsed time: ${t} sec",
@@ -1393,6 +1551,7 @@ void chain_controller::update_global_dynamic_data(const signed_block& b) {
       dgp.time = b.timestamp;
       dgp.current_producer = b.producer;
       dgp.current_absolute_slot += missed_blocks+1;
+      dgp.block_id_merkle.append(dgp.head_block_id);
 
       // If we've missed more blocks than the bitmap stores, skip calculations and simply reset the bitmap
       if (missed_blocks < sizeof(dgp.recent_slots_filled) * 8) {
@@ -1444,12 +1603,8 @@ void chain_controller::update_last_irreversible_block()
       });
    }
 
-   // Write newly irreversible blocks to disk. First, get the number of the last block on disk...
-   auto old_last_irreversible_block = _block_log.head();
-   int last_block_on_disk = 0;
-   // If this is null, there are no blocks on disk, so the zero is correct
-   if (old_last_irreversible_block)
-      last_block_on_disk = old_last_irreversible_block->block_num();
+   // Write newly irreversible blocks to disk. First, get the number of the last block on disk, zero if there are none
+   uint32_t last_block_on_disk = _block_log.head_num();
 
    if (last_block_on_disk < new_last_irreversible_block_num)
       for (auto block_to_write = last_block_on_disk + 1;
@@ -1470,17 +1625,18 @@ void chain_controller::clear_expired_transactions()
 { try {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
+   //The oldest expirations are at the front, so this stops at the first transaction that is still live.
    auto& transaction_idx = _db.get_mutable_index<transaction_multi_index>();
    const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.rbegin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.rbegin());
+   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->expiration) )
+      transaction_idx.remove(*dedupe_index.begin());
 
    //Look for expired transactions in the pending generated list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
    auto& generated_transaction_idx = _db.get_mutable_index<generated_transaction_multi_index>();
    const auto& generated_index = generated_transaction_idx.indices().get<generated_transaction_object::by_expiration>();
-   while( (!generated_index.empty()) && (head_block_time() > generated_index.rbegin()->trx.expiration) )
-      generated_transaction_idx.remove(*generated_index.rbegin());
+   while( (!generated_index.empty()) && (head_block_time() > generated_index.begin()->trx.expiration) )
+      generated_transaction_idx.remove(*generated_index.begin());
 } FC_CAPTURE_AND_RETHROW() }
 
 using boost::container::flat_set;
@@ -1581,23 +1737,19 @@ processed_transaction chain_controller::transaction_from_variant( const fc::vari
 #undef GET_FIELD
 }
 
+abi_serializer_cache::serializer_ptr chain_controller::get_abi_serializer( name code )const {
+   return _abi_serializer_cache->get( _db.get<account_object,by_name>( code ) );
+}
+
 vector<char> chain_controller::message_to_binary( name code, name type, const fc::variant& obj )const
 { try {
-   const auto& code_account = _db.get<account_object,by_name>( code );
-   eosio::types::abi abi;
-   if( types::abi_serializer::to_abi(code_account.abi, abi) ) {
-      types::abi_serializer abis( abi );
-      return abis.variant_to_binary( abis.get_action_type( type ), obj );
-   }
+   if( auto abis = get_abi_serializer( code ) )
+      return abis->variant_to_binary( abis->get_action_type( type ), obj );
    return vector<char>();
 } FC_CAPTURE_AND_RETHROW( (code)(type)(obj) ) }
 fc::variant chain_controller::message_from_binary( name code, name type, const vector<char>& data )const {
-   const auto& code_account = _db.get<account_object,by_name>( code );
-   eosio::types::abi abi;
-   if( types::abi_serializer::to_abi(code_account.abi, abi) ) {
-      types::abi_serializer abis( abi );
-      return abis.binary_to_variant( abis.get_action_type( type ), data );
-   }
+   if( auto abis = get_abi_serializer( code ) )
+      return abis->binary_to_variant( abis->get_action_type( type ), data );
    return fc::variant();
 }
 
@@ -1621,10 +1773,9 @@ fc::variant  chain_controller::transaction_to_variant( const processed_transacti
        SET_FIELD( msg_mvo, msg, type );
        SET_FIELD( msg_mvo, msg, authorization );
 
-       const auto& code_account = _db.get<account_object,by_name>( msg.code );
-       if( !types::abi_serializer::is_empty_abi(code_account.abi) ) {
+       if( auto abis = get_abi_serializer( msg.code ) ) {
           try {
-             msg_mvo( "data", message_from_binary( msg.code, msg.type, msg.data ) ); 
+             msg_mvo( "data", abis->binary_to_variant( abis->get_action_type( msg.type ), msg.data ) );
              msg_mvo( "hex_data", msg.data );
           } catch ( ... ) {
             SET_FIELD( msg_mvo, msg, data );
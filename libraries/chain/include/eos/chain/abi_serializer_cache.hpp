@@ -0,0 +1,60 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eos/chain/account_object.hpp>
+#include <eos/types/abi_serializer.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Holds fully configured abi_serializers so that converting messages and table rows between JSON and binary
+    *  does not have to unpack and index the contract's ABI on every call.
+    *
+    *  Entries are keyed by account_object::abi_version, the hash of the packed ABI, so a setcode (or the undo of
+    *  one) selects a different entry without any coordination with the database.  Unused entries are evicted in
+    *  least recently used order once the cache holds more than max_size serializers.
+    *
+    *  All methods are thread safe; the returned serializers are immutable and may be used after they have been
+    *  evicted.
+    */
+   class abi_serializer_cache {
+      public:
+         using serializer_ptr = std::shared_ptr<const types::abi_serializer>;
+
+         explicit abi_serializer_cache(size_t max_size = default_max_size);
+
+         /**
+          *  @return the serializer for the account's current ABI, or nullptr if the account has no ABI
+          */
+         serializer_ptr get(const account_object& account);
+
+         /// Drops the serializer built from the ABI with the given hash, if any
+         void erase(const fc::sha256& abi_version);
+         void clear();
+
+         /// Whether a serializer built from the ABI with the given hash is cached
+         bool   contains(const fc::sha256& abi_version)const;
+         size_t size()const;
+
+         static const size_t default_max_size = 1024;
+
+      private:
+         using lru_list = std::list<fc::sha256>;
+         struct entry {
+            serializer_ptr      serializer;
+            lru_list::iterator  lru_position;
+         };
+
+         mutable std::mutex                      _mutex;
+         size_t                                  _max_size;
+         lru_list                                _lru;
+         std::unordered_map<fc::sha256, entry>   _entries;
+   };
+
+} } // eosio::chain
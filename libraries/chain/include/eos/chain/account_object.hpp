@@ -21,11 +21,13 @@ namespace eosio { namespace chain {
       time                creation_date;
       shared_vector<char> code;
       shared_vector<char> abi;
+      fc::sha256          abi_version; ///< hash of the packed abi, identifies it in the abi_serializer_cache
 
       void set_abi( const eosio::types::abi& _abi ) {
          abi.resize( fc::raw::pack_size( _abi ) );
          fc::datastream<char*> ds( abi.data(), abi.size() );
          fc::raw::pack( ds, _abi );
+         abi_version = fc::sha256::hash( abi.data(), abi.size() );
       }
    };
    using account_id_type = account_object::id_type;
@@ -11,8 +11,11 @@
 
 #include <fc/scoped_exit.hpp>
 
-#include <boost/range/algorithm/find.hpp>
 #include <boost/algorithm/cxx11/all_of.hpp>
+#include <boost/container/flat_map.hpp>
+
+#include <algorithm>
+#include <tuple>
 
 namespace eosio { namespace chain {
 
@@ -45,15 +48,45 @@ using meta_permission_set = boost::container::flat_multiset<meta_permission, met
  * then determine whether that list of keys is sufficient to satisfy the authority. This class takes a list of keys and
  * provides the @ref satisfied method to determine whether that list of keys satisfies a provided authority.
  *
+ * The result of checking a permission at a given depth is remembered, along with the keys it used, so a permission
+ * declared by several messages of a transaction, or reached through several accounts, is only evaluated once per
+ * checker.
+ *
  * @tparam F A callable which takes a single argument of type @ref account_permission and returns the corresponding
  * authority
  */
 template<typename F>
 class authority_checker {
+   struct permission_result {
+      bool           satisfied = false;
+      vector<uint32> keys; ///< indices of the signing keys used, if satisfied
+   };
+   using permission_key = std::tuple<types::account_name, types::permission_name, uint16>;
+
    F PermissionToAuthority;
    uint16 recursionDepthLimit;
-   vector<public_key_type> signingKeys;
-   vector<bool> usedKeys;
+   vector<public_key_type> signingKeys; ///< sorted, as they come from a flat_set
+   /// How many times each signing key has been used by the authorities checked so far; a key is used if nonzero
+   vector<uint32> keyUses;
+   /// Indices of the keys used, in order, so that the uses by an authority which is not satisfied can be undone
+   vector<uint32> usedKeyLog;
+   boost::container::flat_map<permission_key, permission_result> permissionResults;
+
+   void use_key(uint32 index) {
+      ++keyUses[index];
+      usedKeyLog.push_back(index);
+   }
+   void unuse_keys_after(size_t mark) {
+      for (auto i = mark; i < usedKeyLog.size(); ++i)
+         --keyUses[usedKeyLog[i]];
+      usedKeyLog.resize(mark);
+   }
+   vector<bool> key_markers() const {
+      vector<bool> markers(keyUses.size());
+      for (size_t i = 0; i < keyUses.size(); ++i)
+         markers[i] = keyUses[i] != 0;
+      return markers;
+   }
 
    struct weight_tally_visitor {
       using result_type = uint32;
@@ -66,9 +99,9 @@ class authority_checker {
          : checker(checker), recursionDepth(recursionDepth) {}
 
       uint32 operator()(const types::key_permission_weight& permission) {
-         auto itr = boost::find(checker.signingKeys, permission.key);
-         if (itr != checker.signingKeys.end()) {
-            checker.usedKeys[itr - checker.signingKeys.begin()] = true;
+         auto itr = std::lower_bound(checker.signingKeys.begin(), checker.signingKeys.end(), permission.key);
+         if (itr != checker.signingKeys.end() && *itr == permission.key) {
+            checker.use_key(itr - checker.signingKeys.begin());
             totalWeight += permission.weight;
          }
          return totalWeight;
@@ -86,11 +119,27 @@ public:
       : PermissionToAuthority(PermissionToAuthority),
         recursionDepthLimit(recursionDepthLimit),
         signingKeys(signingKeys.begin(), signingKeys.end()),
-        usedKeys(signingKeys.size(), false)
+        keyUses(signingKeys.size(), 0)
    {}
 
    bool satisfied(const types::account_permission& permission, uint16 depth = 0) {
-      return satisfied(PermissionToAuthority(permission), depth);
+      // Evaluating an authority does not depend on which keys are already used, so a result found before holds
+      permission_key key(permission.account, permission.permission, depth);
+      auto cached = permissionResults.find(key);
+      if (cached != permissionResults.end()) {
+         for (auto index : cached->second.keys)
+            use_key(index);
+         return cached->second.satisfied;
+      }
+
+      auto mark = usedKeyLog.size();
+      permission_result result;
+      result.satisfied = satisfied(PermissionToAuthority(permission), depth);
+      if (result.satisfied)
+         result.keys.assign(usedKeyLog.begin() + mark, usedKeyLog.end());
+      const bool isSatisfied = result.satisfied;
+      permissionResults.emplace(key, std::move(result));
+      return isSatisfied;
    }
    template<typename AuthorityType>
    bool satisfied(const AuthorityType& authority, uint16 depth = 0) {
@@ -98,9 +147,9 @@ public:
       if (depth > recursionDepthLimit)
          return false;
 
-      // Save the current used keys; if we do not satisfy this authority, the newly used keys aren't actually used
-      auto KeyReverter = fc::make_scoped_exit([this, keys = usedKeys] () mutable {
-         usedKeys = keys;
+      // If we do not satisfy this authority, the keys it used aren't actually used
+      auto KeyReverter = fc::make_scoped_exit([this, mark = usedKeyLog.size()] () {
+         unuse_keys_after(mark);
       });
 
       // Sort key permissions and account permissions together into a single set of MetaPermissions
@@ -119,13 +168,15 @@ public:
       return false;
    }
 
-   bool all_keys_used() const { return boost::algorithm::all_of_equal(usedKeys, true); }
+   bool all_keys_used() const {
+      return boost::algorithm::all_of(keyUses, [](uint32 uses) { return uses != 0; });
+   }
    flat_set<public_key_type> used_keys() const {
-      auto range = utilities::filter_data_by_marker(signingKeys, usedKeys, true);
+      auto range = utilities::filter_data_by_marker(signingKeys, key_markers(), true);
       return {range.begin(), range.end()};
    }
    flat_set<public_key_type> unused_keys() const {
-      auto range = utilities::filter_data_by_marker(signingKeys, usedKeys, false);
+      auto range = utilities::filter_data_by_marker(signingKeys, key_markers(), false);
       return {range.begin(), range.end()};
    }
 };
@@ -4,6 +4,7 @@
  */
 #pragma once
 #include <eos/chain/transaction.hpp>
+#include <eos/chain/merkle.hpp>
 
 namespace eosio { namespace chain {
 
@@ -47,14 +48,23 @@ namespace eosio { namespace chain {
       vector<processed_generated_transaction> generated_input;
       vector<processed_transaction>          user_input;
 
-      digest_type merkle_digest() const;
+      /// The digests of user_input followed by the ids of generated_input, as they are leaves of the transaction merkle
+      vector<digest_type> merkle_leaves() const;
    };
 
    using cycle = vector<thread>;
 
    struct signed_block : public signed_block_header
    {
+      /**
+       * The merkle root over the transactions of all threads of all cycles, in order, so that a transaction can be
+       * proven to be in the block with a proof of log(N) digests
+       */
       checksum_type calculate_merkle_root() const;
+      vector<digest_type> merkle_leaves() const;
+      /// The transaction_merkle_root of a block whose merkle leaves were appended to @p transactions
+      static checksum_type merkle_root(const incremental_merkle& transactions);
+
       vector<cycle> cycles;
    };
 
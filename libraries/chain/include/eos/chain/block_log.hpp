@@ -5,6 +5,7 @@
 #pragma once
 #include <fc/filesystem.hpp>
 #include <eos/chain/block.hpp>
+#include <eos/chain/config.hpp>
 
 namespace eosio { namespace chain {
 
@@ -33,33 +34,66 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * A compressed block log starts with an 8 byte magic number, and stores each block as the packed zlib stream
+    * of the packed block in place of the packed block. The packed stream starts with its size, so a linear scan
+    * of a compressed log skips from block to block without decompressing them. Whether a new log is compressed
+    * is chosen when it is created; an existing log keeps its format.
+    *
+    * Appending a block only queues it; a writer thread writes queued blocks to both files and syncs them to
+    * disk after every sync_blocks blocks or sync_interval, whichever comes first, or when flush() is called.
+    * The queue holds at most config::default_block_log_queue_size blocks, after which append waits for the
+    * writer. Blocks are read from the queue until they have been written, so a block can be read back as soon
+    * as it is appended.
+    *
+    * All public methods are safe to call from multiple threads.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         block_log(const fc::path& data_dir,
+                   uint32_t sync_blocks = config::default_block_log_sync_blocks,
+                   fc::microseconds sync_interval = fc::milliseconds(config::default_block_log_sync_interval_ms),
+                   bool compress = false);
          block_log(block_log&& other);
          ~block_log();
 
+         /// Queues b to be written and returns its offset in the file
          uint64_t append(const signed_block& b);
+         /// Waits until all of the appended blocks have been written and synced to disk
          void flush();
          std::pair<signed_block, uint64_t> read_block(uint64_t file_pos)const;
          optional<signed_block> read_block_by_num(uint32_t block_num)const;
          optional<signed_block> read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
+         /**
+          * Reads up to count blocks starting at block number first, stopping at the head block. The blocks are
+          * read from the file together and decoded on several threads.
+          */
+         vector<signed_block> read_blocks(uint32_t first, uint32_t count)const;
+         /**
+          * Reads the packed block, decompressed if the log is compressed, into packed, reusing its storage, so
+          * that it can be read in place with a block_view. Returns false if the log does not have the block.
+          */
+         bool read_packed_block(uint32_t block_num, vector<char>& packed)const;
+         /// Reads the id of a block from its packed header, without decoding the block
+         optional<block_id_type> read_block_id(uint32_t block_num)const;
 
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          optional<signed_block> read_head()const;
-         const optional<signed_block>& head()const;
+         /// A copy of the last block appended, which append may replace concurrently
+         optional<signed_block> head()const;
+         /// The number of the last block appended, or 0 if the log is empty
+         uint32_t               head_num()const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
       private:
-         void open(const fc::path& data_dir);
+         void open(const fc::path& data_dir, bool compress);
          void construct_index();
 
          std::unique_ptr<detail::block_log_impl> my;
@@ -0,0 +1,77 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eos/chain/block.hpp>
+
+#include <fc/io/datastream.hpp>
+
+#include <functional>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  A packed signed_transaction read in place. Only the sizes of its fields are read, so making a view does not
+    *  allocate, and its id is hashed from the packed bytes instead of packing the transaction again.
+    *
+    *  The view does not own the bytes it is over; they must outlive it.
+    */
+   class transaction_view {
+      public:
+         /// Reads the transaction starting at the position of ds, and leaves ds after it
+         explicit transaction_view(fc::datastream<const char*>& ds);
+         /// Reads the transaction in data, which may be followed by other bytes
+         transaction_view(const char* data, size_t size);
+
+         /// The packed signed_transaction
+         const char* data()const { return _data; }
+         size_t      size()const { return _size; }
+
+         /// The id of the transaction, hashed from the packed transaction without its signatures
+         transaction_id_type id()const;
+         signed_transaction  unpack()const;
+
+      private:
+         const char* _data = nullptr;
+         size_t      _size = 0;
+         /// the size of the packed transaction without its signatures
+         size_t      _transaction_size = 0;
+   };
+
+   /**
+    *  A packed signed_block read in place. The header is decoded when the view is made; the cycles are left
+    *  packed, and are only walked, without being decoded, to reach the user transactions in them.
+    *
+    *  The view does not own the bytes it is over; they must outlive it.
+    */
+   class block_view {
+      public:
+         /// Reads the header of the block in data, which may be followed by other bytes
+         block_view(const char* data, size_t size);
+
+         const signed_block_header& header()const { return _header; }
+         uint32_t                   block_num()const { return _header.block_num(); }
+         /// The id of the block, hashed from the packed header instead of packing it again
+         block_id_type              id()const;
+
+         /// The packed block and everything that followed it
+         const char* data()const { return _data; }
+         size_t      size()const { return _size; }
+
+         /**
+          *  Calls f with a view of each user transaction, in cycle, thread and user_input order. Generated
+          *  transactions and the outputs of the transactions are skipped.
+          */
+         void        for_each_transaction(const std::function<void(const transaction_view&)>& f)const;
+         signed_block unpack()const;
+
+      private:
+         const char*          _data = nullptr;
+         size_t               _size = 0;
+         /// the size of the packed signed_block_header
+         size_t               _header_size = 0;
+         signed_block_header  _header;
+   };
+
+} } // eosio::chain
@@ -8,6 +8,8 @@
 #include <eos/chain/permission_object.hpp>
 #include <eos/chain/fork_database.hpp>
 #include <eos/chain/block_log.hpp>
+#include <eos/chain/abi_serializer_cache.hpp>
+#include <eos/chain/transaction_pool.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/scoped_exit.hpp>
@@ -117,7 +119,12 @@ namespace eosio { namespace chain {
          block_id_type               get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>      fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>      fetch_block_by_number( uint32_t num )const;
-         const signed_transaction&    get_recent_transaction( const transaction_id_type& trx_id )const;
+         /**
+          *  Fills packed with the packed block, reusing its storage. Blocks in the block log are read as they are
+          *  stored, without decoding them.
+          *  @return false if the block is not known
+          */
+         bool                        fetch_packed_block_by_number( uint32_t num, vector<char>& packed )const;
          std::vector<block_id_type>  get_block_ids_on_fork(block_id_type head_of_fork)const;
          const generated_transaction& get_generated_transaction( const generated_transaction_id_type& id ) const;
 
@@ -140,6 +147,13 @@ namespace eosio { namespace chain {
          vector<char>       message_to_binary( name code, name type, const fc::variant& obj )const;
          fc::variant        message_from_binary( name code, name type, const vector<char>& bin )const;
 
+         /**
+          *  Returns the serializer for the ABI currently set on @a code, building and caching it if needed.
+          *  @return nullptr if the account has no ABI
+          */
+         abi_serializer_cache::serializer_ptr get_abi_serializer( name code )const;
+         abi_serializer_cache& get_abi_serializer_cache()const { return *_abi_serializer_cache; }
+
 
          /**
           *  Calculate the percent of block production slots that were missed in the
@@ -153,9 +167,60 @@ namespace eosio { namespace chain {
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
 
+         /**
+          * The context free parts of validating a block: the key that signed it and the keys that signed each of
+          * its user transactions.  They depend only on the block, so they can be computed ahead of time and on any
+          * thread with @ref precompute_block.
+          */
+         struct block_precomputed {
+            public_key_type                   signee;
+            vector<flat_set<public_key_type>> signature_keys; ///< per user transaction, in cycle, thread, user_input order
+         };
+
+         /**
+          * Computes the block_precomputed of a block, checking its transaction merkle root on the way.
+          * @param signature_keys false to leave block_precomputed::signature_keys empty, for when transaction
+          * signatures are skipped anyway
+          */
+         static block_precomputed precompute_block( const signed_block& b, bool signature_keys = true );
+
+         /**
+          * Push a block using checks previously computed by @ref precompute_block for that same block instead
+          * of repeating them.  Blocks applied while switching forks are checked as usual.
+          */
+         bool push_block( const signed_block& b, uint32_t skip, const block_precomputed& precomputed );
+
 
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
-         processed_transaction _push_transaction( const signed_transaction& trx );
+         processed_transaction _push_transaction( const signed_transaction& trx,
+                                                  const flat_set<public_key_type>* signature_keys = nullptr );
+
+         /**
+          * The outcome of pushing one transaction of a batch; exactly one of the members is set
+          */
+         struct batch_push_result {
+            optional<processed_transaction>  processed;
+            fc::exception_ptr                error;
+         };
+
+         /**
+          * Push several transactions while taking the write lock only once.  A transaction which fails does not
+          * prevent the following ones from being pushed.
+          *
+          * @param trxs the transactions to push, in order
+          * @param signature_keys either empty or, for each transaction, the keys recovered from its signatures.
+          * This allows the expensive key recovery to be performed ahead of time and outside of the write lock.
+          * @return one result per transaction, in the same order as @ref trxs
+          */
+         vector<batch_push_result> push_transactions( const vector<signed_transaction>& trxs,
+                                                      const vector<flat_set<public_key_type>>& signature_keys,
+                                                      uint32_t skip = skip_nothing );
+
+         /**
+          * Recovers the keys which signed a transaction, as its authorization is checked against them.  Keys
+          * recovered ahead of time for @ref push_transactions or @ref precompute_block must come from here.
+          */
+         static flat_set<public_key_type> recover_signature_keys( const signed_transaction& trx );
 
          /**
           * Determine which public keys are needed to sign the given transaction.
@@ -183,6 +248,16 @@ namespace eosio { namespace chain {
             block_schedule::factory scheduler
             );
 
+         /**
+          * Keep a candidate block of the pending transactions up to date as they are pushed, for a producer.
+          *
+          * The pending generated transactions are applied when the first transaction after a block is pushed, and each
+          * pushed transaction is recorded in the candidate as it is applied. Generating a block with the
+          * block_schedule::in_single_thread scheduler then only finishes and signs the candidate instead of applying
+          * every pending transaction again.
+          */
+         void maintain_candidate_block(bool enabled);
+
 
          template<typename Function>
          auto with_skip_flags( uint64_t flags, Function&& f ) -> decltype((*((Function*)nullptr))()) 
@@ -196,13 +271,18 @@ namespace eosio { namespace chain {
          template<typename Function>
          auto without_pending_transactions( Function&& f ) -> decltype((*((Function*)nullptr))()) 
          {
-            auto old_pending = std::move( _pending_transactions );
-            _pending_tx_session.reset();
+            // undoing the pending session changes the database under any readers, so it takes the write lock; the
+            // transactions are pushed again outside it, as push_transaction takes the lock itself
+            auto old_pending = _db.with_write_lock( [&]() {
+               auto pending = _pending_transactions.release();
+               _pending_tx_session.reset();
+               return pending;
+            });
             auto on_exit = fc::make_scoped_exit( [&](){ 
                for( const auto& t : old_pending ) {
                   try {
-                     if (!is_known_transaction(t.id()))
-                        push_transaction( t );
+                     if (!is_known_transaction(t.id))
+                        push_transaction( *t.trx );
                   } catch ( ... ){}
                }
             });
@@ -268,7 +348,9 @@ namespace eosio { namespace chain {
          bool should_check_scope()const                      { return !(_skip_flags&skip_scope_check);            }
 
 
-         const deque<signed_transaction>&  pending()const { return _pending_transactions; }
+         const transaction_pool&  pending()const { return _pending_transactions; }
+         /// Bounds the memory held by pending transactions, see transaction_pool
+         void set_pending_limits(const transaction_pool::limits& l) { _pending_transactions.set_limits(l); }
 
          /**
           * Enum to indicate what type of rate limiting is being performed.
@@ -322,7 +404,8 @@ namespace eosio { namespace chain {
             return f();
          }
 
-         void check_transaction_authorization(const signed_transaction& trx, bool allow_unused_signatures = false)const;
+         void check_transaction_authorization(const signed_transaction& trx, bool allow_unused_signatures = false,
+                                              const flat_set<public_key_type>* signature_keys = nullptr)const;
 
          template<typename T>
          void check_transaction_output(const T& expected, const T& actual, const path_cons_list& path)const;
@@ -392,7 +475,8 @@ namespace eosio { namespace chain {
 
          ///Steps involved in applying a new block
          ///@{
-         const producer_object& validate_block_header(uint32_t skip, const signed_block& next_block)const;
+         const producer_object& validate_block_header(uint32_t skip, const signed_block& next_block,
+                                                      const public_key_type* signee = nullptr)const;
          const producer_object& _validate_block_header(const signed_block& next_block)const;
          void create_block_summary(const signed_block& next_block);
 
@@ -406,6 +490,22 @@ namespace eosio { namespace chain {
          void spinup_db();
          void spinup_fork_db();
 
+         /// Fills the cycles of pending_block by scheduling and applying every pending transaction again
+         void _schedule_pending_block(block_schedule::factory scheduler, signed_block& pending_block,
+                                      incremental_merkle& transaction_merkle);
+
+         /// The block the pending transactions make, in the order they were applied; see maintain_candidate_block
+         struct candidate_block {
+            block_id_type       previous;
+            thread              block_thread;
+            incremental_merkle  user_input_merkle; ///< of block_thread.user_input, whose leaves precede the generated ones
+            size_t              max_transaction_size = 0;
+            bool                full = false; ///< a transaction did not fit, so no later one may be added either
+         };
+
+         void start_candidate_block();
+         bool fits_candidate_block(size_t transaction_size);
+
          producer_round calculate_next_round(const signed_block& next_block);
 
          database&                        _db;
@@ -415,11 +515,15 @@ namespace eosio { namespace chain {
          unique_ptr<chain_administration_interface> _admin;
 
          optional<database::session>      _pending_tx_session;
-         deque<signed_transaction>         _pending_transactions;
+         transaction_pool                 _pending_transactions;
+         bool                             _maintain_candidate_block = false;
+         optional<candidate_block>        _candidate_block; ///< of the transactions in _pending_tx_session
 
          bool                             _currently_applying_block = false;
          bool                             _currently_replaying_blocks = false;
          uint64_t                         _skip_flags = 0;
+         const signed_block*              _precomputed_for = nullptr;
+         const block_precomputed*         _precomputed_block = nullptr; ///< checks already made for *_precomputed_for
 
          const uint32_t                   _txn_execution_time;
          const uint32_t                   _rcvd_block_txn_execution_time;
@@ -431,6 +535,8 @@ namespace eosio { namespace chain {
 
          flat_map<uint32_t,block_id_type> _checkpoints;
 
+         unique_ptr<abi_serializer_cache> _abi_serializer_cache;
+
          typedef pair<account_name,types::name> handler_key;
 
          map< account_name, map<handler_key, apply_handler> >                   apply_handlers;
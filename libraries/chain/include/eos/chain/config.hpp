@@ -39,6 +39,9 @@ const static int default_per_auth_account = 1800;
 const static int default_per_code_account_time_frame_seconds = 18;
 const static int default_per_code_account = 18000;
 
+const static uint64 default_pending_pool_max_bytes = 256 * 1024 * 1024;
+const static uint64 default_pending_pool_account_max_bytes = 4 * 1024 * 1024;
+
 const static uint32 default_max_block_size = 5 * 1024 * 1024;
 const static uint32 default_target_block_size = 128 * 1024;
 const static uint64 default_max_storage_size = 10 * 1024;
@@ -53,6 +56,10 @@ const static uint32 default_max_inline_msg_size = 4 * 1024;
 const static uint32 default_max_gen_trx_size = 64 * 1024;
 const static uint32 producers_authority_threshold = 14;
 
+const static uint32 default_block_log_sync_blocks = 512;
+const static uint32 default_block_log_sync_interval_ms = 500;
+const static uint32 default_block_log_queue_size = 1024;
+
 const static int blocks_per_round = 21;
 const static int voted_producers_per_round = 20;
 const static int irreversible_threshold_percent = 70 * percent1;
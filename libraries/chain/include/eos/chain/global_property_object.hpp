@@ -8,6 +8,7 @@
 
 #include <eos/chain/types.hpp>
 #include <eos/chain/blockchain_configuration.hpp>
+#include <eos/chain/merkle.hpp>
 
 #include <chainbase/chainbase.hpp>
 
@@ -80,6 +81,12 @@ namespace eosio { namespace chain {
         uint64_t recent_slots_filled;
         
         uint32_t last_irreversible_block_num = 0;
+
+        /**
+         * Accumulates the merkle root of the ids of all blocks up to and including the head block, in order. The root
+         * commits to the whole chain, and a block can be proven to be part of it with log(N) digests.
+         */
+        incremental_merkle block_id_merkle;
    };
 
    using global_property_multi_index = chainbase::shared_multi_index_container<
@@ -115,6 +122,7 @@ FC_REFLECT(eosio::chain::dynamic_global_property_object,
            (current_absolute_slot)
            (recent_slots_filled)
            (last_irreversible_block_num)
+           (block_id_merkle)
           )
 
 FC_REFLECT(eosio::chain::global_property_object,
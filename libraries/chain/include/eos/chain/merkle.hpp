@@ -0,0 +1,53 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eos/chain/types.hpp>
+
+#include <fc/array.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Calculates the merkle root of a list of digests. Each level hashes its nodes in pairs, and a level with an odd
+    * number of nodes pairs its last node with itself. The root of a single digest is that digest, and the root of an
+    * empty list is a default digest.
+    */
+   digest_type merkle(vector<digest_type> ids);
+
+   /**
+    * Returns the siblings on the path from ids[index] to the root of merkle(ids), lowest level first
+    *
+    * Together with the leaf and its index they are enough to recompute the root, see @ref merkle_root_from_proof, so
+    * the proof for one of N digests has only log(N) of them.
+    */
+   vector<digest_type> merkle_proof(vector<digest_type> ids, size_t index);
+
+   /// Recomputes the merkle root from a leaf, its index, and the proof returned by @ref merkle_proof
+   digest_type merkle_root_from_proof(digest_type leaf, size_t index, const vector<digest_type>& proof);
+
+   /**
+    * @brief Accumulates the merkle root of a growing list of digests
+    *
+    * Only the roots of the complete subtrees appended so far are kept, at most one per level, so appending a digest
+    * and computing the root both take O(log N) time and the state has a fixed size, which lets it live in chainbase
+    * objects. get_root() returns the same digest as merkle() over all of the digests appended.
+    */
+   class incremental_merkle {
+      public:
+         /// The most digests an accumulator can hold is 2^max_depth - 1
+         static const size_t max_depth = 32;
+
+         void        append(const digest_type& digest);
+         digest_type get_root() const;
+         uint32_t    size() const { return node_count; }
+
+         /// The number of digests appended; bit i is set when active_nodes[i] holds the root of a subtree of 2^i
+         uint32_t                           node_count = 0;
+         fc::array<digest_type, max_depth>  active_nodes;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT(eosio::chain::incremental_merkle, (node_count)(active_nodes))
@@ -20,16 +20,17 @@ namespace eosio { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * Only the id and expiration are kept, the transaction itself is in the block. Objects are ordered by expiration,
+    * so the transactions expiring in each second form one contiguous range at the front of the index once expired.
     */
    class transaction_object : public chainbase::object<transaction_object_type, transaction_object>
    {
          OBJECT_CTOR(transaction_object)
 
          id_type             id;
-         signed_transaction  trx;
          transaction_id_type trx_id;
-
-         time_point_sec get_expiration()const { return trx.expiration; }
+         time_point_sec      expiration;
    };
 
    struct by_expiration;
@@ -39,7 +40,12 @@ namespace eosio { namespace chain {
       indexed_by<
          ordered_unique<tag<by_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_object::id_type, id)>,
          hashed_unique<tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), std::hash<transaction_id_type>>,
-         ordered_non_unique<tag<by_expiration>, const_mem_fun<transaction_object, time_point_sec, &transaction_object::get_expiration>>
+         ordered_unique<tag<by_expiration>,
+            composite_key<transaction_object,
+               BOOST_MULTI_INDEX_MEMBER(transaction_object, time_point_sec, expiration),
+               BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_object::id_type, id)
+            >
+         >
       >
    >;
 
@@ -48,4 +54,4 @@ namespace eosio { namespace chain {
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::transaction_object, eosio::chain::transaction_multi_index)
 
-FC_REFLECT( eosio::chain::transaction_object, (trx)(trx_id) )
+FC_REFLECT( eosio::chain::transaction_object, (trx_id)(expiration) )
@@ -0,0 +1,141 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eos/chain/transaction.hpp>
+#include <eos/chain/multi_index_includes.hpp>
+#include <eos/chain/config.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  The transactions this node has accepted and that are waiting to be included in a block.
+    *
+    *  Each transaction is held once, decoded, together with a single packed copy that other components (such as
+    *  the net_plugin) share instead of serializing it again.  The pool is bounded: a transaction is charged to its
+    *  payer, the first account authorizing its first message, and is rejected when the payer already holds
+    *  max_account_bytes of the pool.  When the pool as a whole is full the lowest priority, most recently added
+    *  transaction is evicted to make room for one of higher priority; otherwise the new transaction is rejected.
+    *
+    *  Transactions are ordered by priority and then arrival, which is the order the block scheduler draws them in,
+    *  and can also be looked up by id, expiration, payer and scope.
+    */
+   class transaction_pool {
+      public:
+         struct limits {
+            uint64_t max_bytes         = config::default_pending_pool_max_bytes;
+            uint64_t max_account_bytes = config::default_pending_pool_account_max_bytes;
+         };
+
+         struct entry {
+            transaction_id_type                        id;
+            std::shared_ptr<const signed_transaction>  trx;
+            std::shared_ptr<const bytes>               packed;
+            account_name                               payer;
+            time_point_sec                             expiration;
+            uint64_t                                   priority = 0;
+            uint64_t                                   sequence = 0; ///< arrival order
+
+            size_t size()const { return packed->size(); }
+         };
+
+         struct by_expiration;
+         struct by_priority;
+         struct by_payer;
+         typedef boost::multi_index_container<
+            entry,
+            indexed_by<
+               ordered_unique< tag<by_id>, member<entry, transaction_id_type, &entry::id> >,
+               ordered_non_unique< tag<by_expiration>, member<entry, time_point_sec, &entry::expiration> >,
+               ordered_unique< tag<by_priority>,
+                  composite_key< entry,
+                     member<entry, uint64_t, &entry::priority>,
+                     member<entry, uint64_t, &entry::sequence>
+                  >,
+                  composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               ordered_unique< tag<by_payer>,
+                  composite_key< entry,
+                     member<entry, account_name, &entry::payer>,
+                     member<entry, uint64_t, &entry::sequence>
+                  >
+               >
+            >
+         > entry_index;
+
+         /// one per scope of each pooled transaction
+         struct scope_entry {
+            account_name         scope;
+            uint64_t             sequence;
+            transaction_id_type  id;
+         };
+
+         struct by_scope;
+         typedef boost::multi_index_container<
+            scope_entry,
+            indexed_by<
+               ordered_unique< tag<by_scope>,
+                  composite_key< scope_entry,
+                     member<scope_entry, account_name, &scope_entry::scope>,
+                     member<scope_entry, uint64_t, &scope_entry::sequence>
+                  >
+               >
+            >
+         > scope_index;
+
+         explicit transaction_pool(const limits& l = limits());
+
+         /**
+          *  Adds trx, evicting lower priority transactions if the pool is full
+          *
+          *  @return the pooled entry
+          *  @throws tx_duplicate if trx is already pooled
+          *  @throws tx_pool_account_quota_exceeded if trx's payer would hold more than max_account_bytes
+          *  @throws tx_pool_full if there is no room for trx and nothing of lower priority to evict
+          */
+         const entry& add(const signed_transaction& trx, uint64_t priority = 0);
+
+         const entry* find(const transaction_id_type& id)const;
+         bool contains(const transaction_id_type& id)const { return find(id) != nullptr; }
+
+         void remove(const transaction_id_type& id);
+         /// Removes the transactions that expire at or before now, returning how many there were
+         size_t remove_expired(time_point_sec now);
+         void clear();
+
+         /// Empties the pool, returning its transactions in priority order
+         vector<entry> release();
+
+         /// The ids of the pooled transactions with the given scope, in arrival order
+         vector<transaction_id_type> ids_by_scope(account_name scope)const;
+         /// Bytes of the pool held by the payer's transactions
+         uint64_t account_bytes(account_name payer)const;
+
+         template<typename Tag>
+         const auto& get()const { return _entries.get<Tag>(); }
+
+         size_t   size()const  { return _entries.size(); }
+         bool     empty()const { return _entries.empty(); }
+         uint64_t bytes()const { return _bytes; }
+
+         const limits& get_limits()const { return _limits; }
+         void set_limits(const limits& l) { _limits = l; }
+
+         static account_name payer_of(const signed_transaction& trx);
+
+      private:
+         template<typename Iterator>
+         void erase(Iterator itr);
+
+         limits                          _limits;
+         entry_index                     _entries;
+         scope_index                     _scopes;
+         flat_map<account_name,uint64_t> _account_bytes;
+         uint64_t                        _bytes = 0;
+         uint64_t                        _next_sequence = 0;
+   };
+
+} } // eosio::chain
@@ -0,0 +1,92 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain/merkle.hpp>
+#include <eos/chain/exceptions.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      digest_type hash_pair(const digest_type& left, const digest_type& right) {
+         return digest_type::hash(std::make_pair(left, right));
+      }
+   }
+
+   digest_type merkle(vector<digest_type> ids) {
+      if (ids.empty())
+         return digest_type();
+
+      while (ids.size() > 1) {
+         if (ids.size() % 2)
+            ids.push_back(ids.back());
+         for (size_t i = 0; i < ids.size() / 2; ++i)
+            ids[i] = hash_pair(ids[2*i], ids[2*i+1]);
+         ids.resize(ids.size() / 2);
+      }
+
+      return ids.front();
+   }
+
+   vector<digest_type> merkle_proof(vector<digest_type> ids, size_t index) {
+      FC_ASSERT(index < ids.size(), "Merkle leaf ${index} is out of range", ("index", index)("size", ids.size()));
+
+      vector<digest_type> proof;
+      while (ids.size() > 1) {
+         if (ids.size() % 2)
+            ids.push_back(ids.back());
+         proof.push_back(ids[index ^ 1]);
+         for (size_t i = 0; i < ids.size() / 2; ++i)
+            ids[i] = hash_pair(ids[2*i], ids[2*i+1]);
+         ids.resize(ids.size() / 2);
+         index /= 2;
+      }
+
+      return proof;
+   }
+
+   digest_type merkle_root_from_proof(digest_type leaf, size_t index, const vector<digest_type>& proof) {
+      for (const auto& sibling : proof) {
+         leaf = (index % 2) ? hash_pair(sibling, leaf) : hash_pair(leaf, sibling);
+         index /= 2;
+      }
+      return leaf;
+   }
+
+   void incremental_merkle::append(const digest_type& digest) {
+      FC_ASSERT(uint64_t(node_count) + 1 < (uint64_t(1) << max_depth), "Incremental merkle is full");
+
+      // Like incrementing a binary counter: each complete subtree of the same size carries into the next level
+      digest_type node = digest;
+      size_t level = 0;
+      for (; node_count & (uint32_t(1) << level); ++level)
+         node = hash_pair(active_nodes.at(level), node);
+      active_nodes.at(level) = node;
+      ++node_count;
+   }
+
+   digest_type incremental_merkle::get_root() const {
+      if (node_count == 0)
+         return digest_type();
+
+      size_t top = 0;
+      while (node_count >> (top + 1))
+         ++top;
+
+      // Fold the subtrees from the lowest level up; carry is the rightmost node of the next level up, if there is one.
+      // Below the top, the rightmost node of a level pairs with itself unless it completes a pair.
+      digest_type carry;
+      bool has_carry = false;
+      for (size_t level = 0; level < top; ++level) {
+         if (node_count & (uint32_t(1) << level)) {
+            const auto& node = active_nodes.at(level);
+            carry = has_carry ? hash_pair(node, carry) : hash_pair(node, node);
+            has_carry = true;
+         } else if (has_carry) {
+            carry = hash_pair(carry, carry);
+         }
+      }
+      return has_carry ? hash_pair(active_nodes.at(top), carry) : active_nodes.at(top);
+   }
+
+} } // eosio::chain
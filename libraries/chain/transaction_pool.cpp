@@ -0,0 +1,114 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain/transaction_pool.hpp>
+#include <eos/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace chain {
+
+   transaction_pool::transaction_pool(const limits& l)
+   :_limits(l) {}
+
+   account_name transaction_pool::payer_of(const signed_transaction& trx) {
+      if( !trx.messages.empty() && !trx.messages.front().authorization.empty() )
+         return trx.messages.front().authorization.front().account;
+      if( !trx.scope.empty() )
+         return trx.scope.front();
+      return account_name();
+   }
+
+   const transaction_pool::entry& transaction_pool::add(const signed_transaction& trx, uint64_t priority) {
+      entry e;
+      e.id = trx.id();
+      EOS_ASSERT( !contains(e.id), tx_duplicate, "transaction is already pending", ("id", e.id) );
+
+      e.packed = std::make_shared<const bytes>(fc::raw::pack(trx));
+      e.payer = payer_of(trx);
+      e.expiration = trx.expiration;
+      e.priority = priority;
+
+      const uint64_t size = e.size();
+      EOS_ASSERT( account_bytes(e.payer) + size <= _limits.max_account_bytes, tx_pool_account_quota_exceeded,
+                  "${payer} already holds ${held} bytes of pending transactions",
+                  ("payer", e.payer)("held", account_bytes(e.payer))("limit", _limits.max_account_bytes) );
+
+      auto& by_prio = _entries.get<by_priority>();
+      while( _bytes + size > _limits.max_bytes ) {
+         EOS_ASSERT( !by_prio.empty() && std::prev(by_prio.end())->priority < priority, tx_pool_full,
+                     "no room for a transaction of ${size} bytes", ("size", size)("pool", _bytes)("limit", _limits.max_bytes) );
+         erase(std::prev(by_prio.end()));
+      }
+
+      e.trx = std::make_shared<const signed_transaction>(trx);
+      e.sequence = _next_sequence++;
+      for( const auto& scope : trx.scope )
+         _scopes.insert(scope_entry{scope, e.sequence, e.id});
+      _account_bytes[e.payer] += size;
+      _bytes += size;
+      return *_entries.insert(std::move(e)).first;
+   }
+
+   const transaction_pool::entry* transaction_pool::find(const transaction_id_type& id)const {
+      auto itr = _entries.find(id);
+      return itr == _entries.end() ? nullptr : &*itr;
+   }
+
+   template<typename Iterator>
+   void transaction_pool::erase(Iterator itr) {
+      for( const auto& scope : itr->trx->scope )
+         _scopes.erase(boost::make_tuple(scope, itr->sequence));
+      auto held = _account_bytes.find(itr->payer);
+      held->second -= itr->size();
+      if( held->second == 0 )
+         _account_bytes.erase(held);
+      _bytes -= itr->size();
+      _entries.erase(_entries.project<0>(itr));
+   }
+
+   void transaction_pool::remove(const transaction_id_type& id) {
+      auto itr = _entries.find(id);
+      if( itr != _entries.end() )
+         erase(itr);
+   }
+
+   size_t transaction_pool::remove_expired(time_point_sec now) {
+      auto& by_exp = _entries.get<by_expiration>();
+      size_t count = 0;
+      while( !by_exp.empty() && by_exp.begin()->expiration <= now ) {
+         erase(by_exp.begin());
+         ++count;
+      }
+      return count;
+   }
+
+   void transaction_pool::clear() {
+      _entries.clear();
+      _scopes.clear();
+      _account_bytes.clear();
+      _bytes = 0;
+   }
+
+   vector<transaction_pool::entry> transaction_pool::release() {
+      const auto& by_prio = _entries.get<by_priority>();
+      vector<entry> released(by_prio.begin(), by_prio.end());
+      clear();
+      return released;
+   }
+
+   vector<transaction_id_type> transaction_pool::ids_by_scope(account_name scope)const {
+      vector<transaction_id_type> ids;
+      auto range = _scopes.equal_range(boost::make_tuple(scope));
+      for( auto itr = range.first; itr != range.second; ++itr )
+         ids.push_back(itr->id);
+      return ids;
+   }
+
+   uint64_t transaction_pool::account_bytes(account_name payer)const {
+      auto itr = _account_bytes.find(payer);
+      return itr == _account_bytes.end() ? 0 : itr->second;
+   }
+
+} } // eosio::chain
@@ -7,4 +7,13 @@ namespace fc
 
   string zlib_compress(const string& in);
 
+  /** Decompresses a zlib stream, such as one returned by zlib_compress */
+  string zlib_decompress(const string& in);
+
+  /**
+   *  Compresses @a in into a gzip (RFC 1952) member, suitable for use
+   *  as an HTTP "Content-Encoding: gzip" body.
+   */
+  string gzip_compress(const string& in);
+
 } // namespace fc
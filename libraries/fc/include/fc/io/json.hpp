@@ -33,6 +33,11 @@ namespace fc
          static ostream& to_stream( ostream& out, const variant_object& v, output_formatting format = stringify_large_ints_and_doubles );
 
          static variant  from_string( const string& utf8_str, parse_type ptype = legacy_parser );
+         /**
+          *  Parses the value at the front of a stream a character at a time, leaving the rest of the stream unread.
+          *  For the legacy parsers this is the reference that from_string's in place parser follows.
+          */
+         static variant  from_stream( std::istream& in, parse_type ptype = legacy_parser );
          static variants variants_from_string( const string& utf8_str, parse_type ptype = legacy_parser );
          static string   to_string( const variant& v, output_formatting format = stringify_large_ints_and_doubles );
          static string   to_pretty_string( const variant& v, output_formatting format = stringify_large_ints_and_doubles );
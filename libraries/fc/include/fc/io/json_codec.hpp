@@ -0,0 +1,304 @@
+#pragma once
+#include <fc/io/json_reader.hpp>
+#include <fc/io/json_writer.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/optional.hpp>
+
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+namespace fc
+{
+   template<typename T> void to_json( json_writer& w, const T& v );
+   template<typename T> void from_json( json_reader& r, T& v );
+
+   namespace json_detail
+   {
+      namespace probe
+      {
+         struct generic_conversion {};
+
+         /**
+          *  As specialized as the reflection based to_variant and from_variant, so that a call which would otherwise
+          *  pick those is ambiguous, while one that finds a conversion written for the type still resolves to it.
+          */
+         template<typename T> generic_conversion to_variant( const T&, fc::variant& );
+         template<typename T> generic_conversion from_variant( const fc::variant&, T& );
+         template<typename T> generic_conversion to_variant( const std::vector<T>&, fc::variant& );
+         template<typename T> generic_conversion from_variant( const fc::variant&, std::vector<T>& );
+
+         template<typename T, typename = void>
+         struct has_custom_to_variant : std::false_type {};
+         template<typename T>
+         struct has_custom_to_variant<T, typename std::enable_if<std::is_void<
+            decltype( to_variant( std::declval<const T&>(), std::declval<fc::variant&>() ) )>::value>::type> : std::true_type {};
+
+         template<typename T, typename = void>
+         struct has_custom_from_variant : std::false_type {};
+         template<typename T>
+         struct has_custom_from_variant<T, typename std::enable_if<std::is_void<
+            decltype( from_variant( std::declval<const fc::variant&>(), std::declval<T&>() ) )>::value>::type> : std::true_type {};
+      }
+
+      /** Whether T has its own to_variant or from_variant, which the JSON must then come from */
+      template<typename T>
+      struct has_custom_variant : std::integral_constant<bool, probe::has_custom_to_variant<T>::value ||
+                                                               probe::has_custom_from_variant<T>::value> {};
+
+      template<typename T>
+      struct is_integer : std::integral_constant<bool, std::is_integral<T>::value &&
+                                                       !std::is_same<T,bool>::value && !std::is_same<T,char>::value> {};
+
+      /** Types whose members are written directly, rather than through the object built by to_variant */
+      template<typename T>
+      struct is_plain_struct : std::integral_constant<bool, fc::reflector<T>::is_defined::value &&
+                                                            !fc::reflector<T>::is_enum::value> {};
+
+      template<typename T>
+      class to_json_visitor
+      {
+         public:
+            to_json_visitor( json_writer& w, const T& v )
+            :_w(w),_val(v){}
+
+            template<typename Member, class Class, Member (Class::*member)>
+            void operator()( const char* name )const
+            {
+               add( name, _val.*member );
+            }
+
+         private:
+            template<typename M>
+            void add( const char* name, const optional<M>& v )const
+            {
+               if( v.valid() )
+                  add( name, *v );
+            }
+            template<typename M>
+            void add( const char* name, const M& v )const
+            {
+               if( !_first )
+                  _w.put( ',' );
+               _first = false;
+               _w.put( '"' );
+               _w.write_raw( name, strlen(name) );
+               _w.put( '"' );
+               _w.put( ':' );
+               to_json( _w, v );
+            }
+
+            json_writer&  _w;
+            const T&      _val;
+            mutable bool  _first = true;
+      };
+
+      template<typename T>
+      class from_json_visitor
+      {
+         public:
+            from_json_visitor( json_reader& r, const std::string& key, T& v, bool& found )
+            :_r(r),_key(key),_val(v),_found(found){}
+
+            template<typename Member, class Class, Member (Class::*member)>
+            void operator()( const char* name )const
+            {
+               if( !_found && _key == name )
+               {
+                  _found = true;
+                  from_json( _r, _val.*member );
+               }
+            }
+
+         private:
+            json_reader&        _r;
+            const std::string&  _key;
+            T&                  _val;
+            bool&               _found;
+      };
+
+      /** Anything not written directly goes through its variant */
+      template<typename T, typename = void>
+      struct codec
+      {
+         static void write( json_writer& w, const T& v ) { w.write( variant(v) ); }
+         static void read( json_reader& r, T& v )        { from_variant( r.read_variant(), v ); }
+      };
+
+      template<>
+      struct codec<variant>
+      {
+         static void write( json_writer& w, const variant& v ) { w.write( v ); }
+         static void read( json_reader& r, variant& v )        { v = r.read_variant(); }
+      };
+
+      template<>
+      struct codec<std::string>
+      {
+         static void write( json_writer& w, const std::string& v ) { w.write_string( v ); }
+         static void read( json_reader& r, std::string& v )
+         {
+            r.skip_white_space();
+            if( r.peek() == '"' )
+               v = r.read_string();
+            else
+               v = r.read_variant().as_string();
+         }
+      };
+
+      template<>
+      struct codec<bool>
+      {
+         static void write( json_writer& w, bool v ) { v ? w.write_raw( "true", 4 ) : w.write_raw( "false", 5 ); }
+         static void read( json_reader& r, bool& v ) { v = r.read_variant().as_bool(); }
+      };
+
+      template<typename T>
+      struct codec<T, typename std::enable_if<is_integer<T>::value>::type>
+      {
+         static void write( json_writer& w, T v )
+         {
+            if( std::is_signed<T>::value )
+               w.write_int64( v );
+            else
+               w.write_uint64( v );
+         }
+         static void read( json_reader& r, T& v ) { from_variant( r.read_variant(), v ); }
+      };
+
+      template<typename T>
+      struct codec<optional<T>>
+      {
+         static void write( json_writer& w, const optional<T>& v )
+         {
+            if( v.valid() )
+               to_json( w, *v );
+            else
+               w.write_raw( "null", 4 );
+         }
+         static void read( json_reader& r, optional<T>& v )
+         {
+            r.skip_white_space();
+            if( r.peek() == 'n' )
+            {
+               from_variant( r.read_variant(), v );
+               return;
+            }
+            v = T();
+            from_json( r, *v );
+         }
+      };
+
+      template<typename T>
+      struct codec<std::vector<T>, typename std::enable_if<!has_custom_variant<std::vector<T>>::value>::type>
+      {
+         static void write( json_writer& w, const std::vector<T>& v )
+         {
+            w.put( '[' );
+            for( size_t i = 0; i < v.size(); ++i )
+            {
+               if( i > 0 )
+                  w.put( ',' );
+               to_json( w, v[i] );
+            }
+            w.put( ']' );
+         }
+         static void read( json_reader& r, std::vector<T>& v )
+         {
+            r.skip_white_space();
+            if( r.peek() != '[' )
+            {
+               // let from_variant report what was found instead of an array
+               from_variant( r.read_variant(), v );
+               return;
+            }
+            v.clear();
+            r.begin_array();
+            while( r.next_element() )
+            {
+               v.emplace_back();
+               from_json( r, v.back() );
+            }
+         }
+      };
+
+      template<typename T>
+      struct codec<T, typename std::enable_if<is_plain_struct<T>::value && !has_custom_variant<T>::value>::type>
+      {
+         static void write( json_writer& w, const T& v )
+         {
+            w.put( '{' );
+            fc::reflector<T>::visit( to_json_visitor<T>( w, v ) );
+            w.put( '}' );
+         }
+         static void read( json_reader& r, T& v )
+         {
+            r.skip_white_space();
+            if( r.peek() != '{' )
+            {
+               // let from_variant report what was found instead of an object
+               from_variant( r.read_variant(), v );
+               return;
+            }
+            std::string key;
+            r.begin_object();
+            while( r.next_key( key ) )
+            {
+               bool found = false;
+               fc::reflector<T>::visit( from_json_visitor<T>( r, key, v, found ) );
+               if( !found )
+                  r.read_variant();
+            }
+         }
+      };
+   } // json_detail
+
+   /** Writes v as JSON, the same JSON as json::to_string( variant(v) ) */
+   template<typename T>
+   void to_json( json_writer& w, const T& v )
+   {
+      json_detail::codec<T>::write( w, v );
+   }
+
+   /** Reads v from JSON, the same way as from_variant( json::from_string(...), v ) */
+   template<typename T>
+   void from_json( json_reader& r, T& v )
+   {
+      json_detail::codec<T>::read( r, v );
+   }
+
+   /**
+    *  Converts between JSON and C++ types without building an fc::variant for the whole document.
+    *
+    *  Reflected structs and vectors of them are read and written member by member.  Everything else, such as
+    *  types with their own to_variant and from_variant, strings made from hashes and keys, and fc::variant
+    *  members holding ABI decoded data, goes through a variant of just that value.
+    */
+   class json_codec
+   {
+      public:
+         template<typename T>
+         static std::string to_string( const T& v, json::output_formatting format = json::stringify_large_ints_and_doubles )
+         {
+            json_writer w( format );
+            to_json( w, v );
+            return w.release();
+         }
+
+         template<typename T>
+         static void from_string( const std::string& utf8_str, T& v )
+         {
+            json_reader r( utf8_str.data(), utf8_str.data() + utf8_str.size() );
+            from_json( r, v );
+         }
+
+         template<typename T>
+         static T from_string( const std::string& utf8_str )
+         {
+            T v;
+            from_string( utf8_str, v );
+            return v;
+         }
+   };
+
+} // fc
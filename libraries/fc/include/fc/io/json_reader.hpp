@@ -0,0 +1,63 @@
+#pragma once
+#include <fc/io/json.hpp>
+
+#include <string>
+
+namespace fc
+{
+   /**
+    *  Parses JSON in place from a contiguous buffer.
+    *
+    *  Accepts exactly what json::legacy_parser accepts, but reads the characters directly rather than through a
+    *  std::istream and builds strings and numbers without intermediate std::stringstreams.  The body of a string,
+    *  where most of the bytes of a document are, is scanned a machine word at a time for the characters that end
+    *  it or need unescaping.
+    *
+    *  The buffer must outlive the reader.
+    */
+   class json_reader
+   {
+      public:
+         json_reader( const char* begin, const char* end, json::parse_type ptype = json::legacy_parser );
+
+         /** Reads the next value, throwing eof_exception if there is none */
+         variant     read_variant();
+
+         /** Reads a quoted string, the next character must be '"' */
+         std::string read_string();
+
+         /**
+          *  Reads the '{' that starts an object.  Each member is then read by calling next_key, which also consumes
+          *  the closing '}', and reading the value that follows the key.
+          */
+         void        begin_object();
+         /** Reads the next key of the current object and the ':' after it, returning false at the end of the object */
+         bool        next_key( std::string& key );
+         /** Reads the '[' that starts an array, whose elements are then read while next_element returns true */
+         void        begin_array();
+         bool        next_element();
+
+         /** Skips ' ', '\t', '\n' and '\r', returning whether anything was skipped */
+         bool        skip_white_space();
+
+         /** The next character, 0 at the end of the buffer */
+         char        peek()const { return _pos != _end ? *_pos : 0; }
+         char        get()       { return _pos != _end ? *_pos++ : 0; }
+         bool        eof()const  { return _pos == _end; }
+
+      private:
+         variant     read_object();
+         variant     read_array();
+         variant     read_number();
+         variant     read_token();
+         std::string read_unquoted();
+         char        read_escape();
+
+         const char* _pos;
+         const char* _end;
+         bool        _string_doubles;
+         uint32_t    _object_depth = 0;
+         uint32_t    _array_depth = 0;
+   };
+
+} // fc
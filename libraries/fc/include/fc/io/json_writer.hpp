@@ -0,0 +1,45 @@
+#pragma once
+#include <fc/io/json.hpp>
+
+#include <string>
+
+namespace fc
+{
+   /**
+    *  Writes JSON into a string that grows as needed, in place of a std::ostream.
+    *
+    *  Produces the same text as json::to_string.  Runs of characters that need no escaping are appended in one
+    *  piece and integers are formatted without going through the stream machinery.
+    */
+   class json_writer
+   {
+      public:
+         explicit json_writer( json::output_formatting format = json::stringify_large_ints_and_doubles, size_t reserve = 256 );
+
+         void write( const variant& v );
+         void write( const variants& a );
+         void write( const variant_object& o );
+
+         /** Writes s quoted and escaped */
+         void write_string( const char* s, size_t len );
+         void write_string( const std::string& s ) { write_string( s.data(), s.size() ); }
+
+         /** Writes i, quoted when the output formatting calls for it */
+         void write_int64( int64_t i );
+         void write_uint64( uint64_t i );
+
+         void put( char c )                        { _out.push_back( c ); }
+         void write_raw( const char* d, size_t s ) { _out.append( d, s ); }
+
+         const std::string& str()const { return _out; }
+         /** Moves the text written so far out of the writer */
+         std::string release()         { return std::move( _out ); }
+
+      private:
+         void write_digits( uint64_t u, bool negative );
+
+         std::string              _out;
+         json::output_formatting  _format;
+   };
+
+} // fc
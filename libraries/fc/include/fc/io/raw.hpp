@@ -270,10 +270,12 @@ namespace fc {
     }
 
     template<typename Stream> inline void unpack( Stream& s, fc::string& v )  {
-      std::vector<char> tmp; fc::raw::unpack(s,tmp);
-      if( tmp.size() )
-         v = fc::string(tmp.data(),tmp.data()+tmp.size());
-      else v = fc::string();
+      unsigned_int size; fc::raw::unpack( s, size );
+      FC_ASSERT( size.value < MAX_ARRAY_ALLOC_SIZE );
+      // read in place, reusing v's buffer when it is large enough
+      v.resize( size.value );
+      if( v.size() )
+        s.read( &v[0], v.size() );
     }
 
     // bip::basic_string
@@ -283,10 +285,11 @@ namespace fc {
     }
 
     template<typename Stream> inline void unpack( Stream& s, shared_string& v )  {
-      std::vector<char> tmp; fc::raw::unpack(s,tmp);
-      if( tmp.size() )
-         v = shared_string(tmp.data(),tmp.data()+tmp.size());
-      else v = shared_string();
+      unsigned_int size; fc::raw::unpack( s, size );
+      FC_ASSERT( size.value < MAX_ARRAY_ALLOC_SIZE );
+      v.resize( size.value );
+      if( v.size() )
+        s.read( &v[0], v.size() );
     }
 
     // bool
@@ -39,5 +39,7 @@ namespace fc {
          static bool          register_appender( const fc::string& type, const appender_factory::ptr& f );
 
          virtual void log( const log_message& m ) = 0;
+         /// Writes out anything the appender has buffered
+         virtual void flush() {}
    };
 }
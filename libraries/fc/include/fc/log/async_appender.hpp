@@ -0,0 +1,48 @@
+#pragma once
+#include <fc/log/appender.hpp>
+#include <fc/log/logger.hpp>
+#include <memory>
+
+namespace fc
+{
+   /**
+    *  Passes log messages to another appender from a background thread
+    *
+    *  log() only queues the message, which has not been formatted yet, on a lock free queue; the wrapped appender
+    *  formats and writes it on the background thread, and is flushed whenever the queue has been drained. When the
+    *  queue is full, messages below drop_below are dropped and counted, and the others wait for room; by default only
+    *  debug messages are dropped. The count of dropped messages is logged to the wrapped appender once there is room.
+    *
+    *  Queued messages are written before the appender is destroyed or the program exits.
+    */
+   class async_appender : public appender
+   {
+      public:
+         struct config
+         {
+            config( const fc::string& appender = "" )
+            :appender(appender),capacity(8192),drop_below(log_level::info){}
+
+            fc::string   appender;   ///< the name of the appender to write to, which must be created before this one
+            uint32_t     capacity;   ///< the most messages queued at once
+            log_level    drop_below; ///< messages below this level are dropped rather than waited for when the queue is full
+         };
+
+         async_appender( const variant& args );
+         async_appender( const config& cfg, const appender::ptr& target );
+         ~async_appender();
+
+         virtual void log( const log_message& m )override;
+         /// Waits until the messages queued so far have been written
+         virtual void flush()override;
+
+         uint64_t dropped()const;
+
+      private:
+         class impl;
+         std::unique_ptr<impl> my;
+   };
+} // namespace fc
+
+#include <fc/reflect/reflect.hpp>
+FC_REFLECT( fc::async_appender::config, (appender)(capacity)(drop_below) )
@@ -53,6 +53,7 @@ namespace fc
 
             ~console_appender();
             virtual void log( const log_message& m );
+            virtual void flush()override;
             
             void print( const std::string& text_to_print, 
                         color::type text_color = color::console_default );
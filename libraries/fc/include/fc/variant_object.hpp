@@ -2,10 +2,17 @@
 #include <fc/variant.hpp>
 #include <fc/shared_ptr.hpp>
 #include <fc/unique_ptr.hpp>
+#include <atomic>
 
 namespace fc
 {
    class mutable_variant_object;
+
+   namespace detail
+   {
+      class variant_object_index;
+      struct variant_object_index_deleter { void operator()( variant_object_index* index )const; };
+   }
    
    /**
     *  @ingroup Serializable
@@ -15,8 +22,10 @@ namespace fc
     *  Keys are kept in the order they are inserted.
     *  This dictionary implements copy-on-write
     *
-    *  @note This class is not optimized for random-access on large
-    *        sets of key-value pairs.
+    *  Objects with more than a few keys build a hash index of them the
+    *  first time a key is looked up, so that find() and operator[] do not
+    *  scan every entry.  The index is built once per object and never
+    *  changed after, so lookups from several threads need no lock.
     */
    class variant_object
    {
@@ -75,6 +84,7 @@ namespace fc
       }
       variant_object( const variant_object& );
       variant_object( variant_object&& );
+      ~variant_object();
 
       variant_object( const mutable_variant_object& );
       variant_object( mutable_variant_object&& );
@@ -86,7 +96,10 @@ namespace fc
       variant_object& operator=( const mutable_variant_object& );
 
    private:
-      std::shared_ptr< std::vector< entry > > _key_value;
+      iterator find( const char* key, size_t len )const;
+
+      std::shared_ptr< std::vector< entry > >                 _key_value;
+      mutable std::atomic< detail::variant_object_index* >   _index{nullptr}; ///< built by the first find() of a large object, owned by this object
       friend class mutable_variant_object;
    };
    /** @ingroup Serializable */
@@ -103,8 +116,10 @@ namespace fc
    *  Keys are kept in the order they are inserted.
    *  This dictionary implements copy-on-write
    *
-   *  @note This class is not optimized for random-access on large
-   *        sets of key-value pairs.
+   *  Like variant_object, large objects index their keys once they are
+   *  looked up, and the index is kept up to date as keys are added, so
+   *  building an object with set() does not scan it for every key.  Keys
+   *  must not be changed by assigning to entries through iterators.
    */
    class mutable_variant_object
    {
@@ -213,7 +228,12 @@ namespace fc
       mutable_variant_object& operator=( const mutable_variant_object& );
       mutable_variant_object& operator=( const variant_object& );
    private:
-      std::unique_ptr< std::vector< entry > > _key_value;
+      iterator find( const char* key, size_t len )const;
+      void     push_back( entry e );
+
+      std::unique_ptr< std::vector< entry > >                 _key_value;
+      mutable std::unique_ptr< detail::variant_object_index,
+                               detail::variant_object_index_deleter > _index; ///< built by the first find() of a large object
       friend class variant_object;
    };
    /** @ingroup Serializable */
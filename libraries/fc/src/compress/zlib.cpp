@@ -1,4 +1,5 @@
 #include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
 
 #include "miniz.c"
 
@@ -12,4 +13,37 @@ namespace fc
     free(compressed_message);
     return result;
   }
+
+  string zlib_decompress(const string& in)
+  {
+    size_t decompressed_length;
+    char* decompressed = (char*)tinfl_decompress_mem_to_heap(in.c_str(), in.size(), &decompressed_length, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    FC_ASSERT( decompressed != nullptr, "zlib decompression failed" );
+    string result(decompressed, decompressed_length);
+    free(decompressed);
+    return result;
+  }
+
+  string gzip_compress(const string& in)
+  {
+    // miniz only produces raw deflate or zlib streams, so wrap a raw deflate
+    // stream with the gzip header and trailer ourselves
+    static const char header[10] = { '\x1f', '\x8b', 8 /*deflate*/, 0, 0, 0, 0, 0, 0, '\xff' /*unknown os*/ };
+
+    size_t deflated_length;
+    char* deflated = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &deflated_length, TDEFL_DEFAULT_MAX_PROBES);
+    FC_ASSERT( deflated != nullptr, "gzip compression failed" );
+
+    uint32_t crc  = (uint32_t)mz_crc32(MZ_CRC32_INIT, (const unsigned char*)in.c_str(), in.size());
+    uint32_t size = (uint32_t)in.size();
+
+    string result;
+    result.reserve(sizeof(header) + deflated_length + 8);
+    result.append(header, sizeof(header));
+    result.append(deflated, deflated_length);
+    free(deflated);
+    for( int i = 0; i < 4; ++i ) result.push_back( char((crc >> (8*i)) & 0xff) );
+    for( int i = 0; i < 4; ++i ) result.push_back( char((size >> (8*i)) & 0xff) );
+    return result;
+  }
 }
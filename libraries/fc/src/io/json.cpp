@@ -1,6 +1,8 @@
 #include <fc/io/json.hpp>
+#include <fc/io/json_reader.hpp>
+#include <fc/io/json_writer.hpp>
 #include <fc/exception/exception.hpp>
-//#include <fc/io/fstream.hpp>
+#include <fc/io/fstream.hpp>
 //#include <fc/io/sstream.hpp>
 #include <fc/log/logger.hpp>
 //#include <utfcpp/utf8.h>
@@ -22,10 +24,6 @@ namespace fc
     template<typename T, json::parse_type parser_type> variants arrayFromStream( T& in );
     template<typename T, json::parse_type parser_type> variant number_from_stream( T& in );
     template<typename T> variant token_from_stream( T& in );
-    void escape_string( const std::string& str, std::ostream& os );
-    template<typename T> void to_stream( T& os, const variants& a, json::output_formatting format );
-    template<typename T> void to_stream( T& os, const variant_object& o, json::output_formatting format );
-    template<typename T> void to_stream( T& os, const variant& v, json::output_formatting format );
     std::string pretty_print( const std::string& v, uint8_t indent );
 }
 
@@ -456,16 +454,14 @@ namespace fc
    
    variant json::from_string( const std::string& utf8_str, parse_type ptype )
    { try {
-      check_string_depth( utf8_str );
+      if( ptype == legacy_parser || ptype == legacy_parser_with_string_doubles )
+         return json_reader( utf8_str.data(), utf8_str.data() + utf8_str.size(), ptype ).read_variant();
 
+      check_string_depth( utf8_str );
       std::stringstream in( utf8_str );
       //in.exceptions( std::ifstream::eofbit );
       switch( ptype )
       {
-          case legacy_parser:
-              return variant_from_stream<std::stringstream, legacy_parser>( in );
-          case legacy_parser_with_string_doubles:
-              return variant_from_stream<std::stringstream, legacy_parser_with_string_doubles>( in );
           case strict_parser:
               return json_relaxed::variant_from_stream<std::stringstream, true>( in );
           case relaxed_parser:
@@ -503,190 +499,26 @@ namespace fc
    }
    */
 
-   /**
-    *  Convert '\t', '\a', '\n', '\\' and '"'  to "\t\a\n\\\""
-    *
-    *  All other characters are printed as UTF8.
-    */
-   void escape_string( const string& str, std::ostream& os )
-   {
-      os << '"';
-      for( auto itr = str.begin(); itr != str.end(); ++itr )
-      {
-         switch( *itr )
-         {
-            case '\b':        // \x08
-               os << "\\b";
-               break;
-            case '\f':        // \x0c
-               os << "\\f";
-               break;
-            case '\n':        // \x0a
-               os << "\\n";
-               break;
-            case '\r':        // \x0d
-               os << "\\r";
-               break;
-            case '\t':        // \x09
-               os << "\\t";
-               break;
-            case '\\':
-               os << "\\\\";
-               break;
-            case '\"':
-               os << "\\\"";
-               break;
-            case '\x00': os << "\\u0000"; break;
-            case '\x01': os << "\\u0001"; break;
-            case '\x02': os << "\\u0002"; break;
-            case '\x03': os << "\\u0003"; break;
-            case '\x04': os << "\\u0004"; break;
-            case '\x05': os << "\\u0005"; break;
-            case '\x06': os << "\\u0006"; break;
-            case '\x07': os << "\\u0007"; break; // \a is not valid JSON
-         // case '\x08': os << "\\u0008"; break; // \b
-         // case '\x09': os << "\\u0009"; break; // \t
-         // case '\x0a': os << "\\u000a"; break; // \n
-            case '\x0b': os << "\\u000b"; break;
-         // case '\x0c': os << "\\u000c"; break; // \f
-         // case '\x0d': os << "\\u000d"; break; // \r
-            case '\x0e': os << "\\u000e"; break;
-            case '\x0f': os << "\\u000f"; break;
-
-            case '\x10': os << "\\u0010"; break;
-            case '\x11': os << "\\u0011"; break;
-            case '\x12': os << "\\u0012"; break;
-            case '\x13': os << "\\u0013"; break;
-            case '\x14': os << "\\u0014"; break;
-            case '\x15': os << "\\u0015"; break;
-            case '\x16': os << "\\u0016"; break;
-            case '\x17': os << "\\u0017"; break;
-            case '\x18': os << "\\u0018"; break;
-            case '\x19': os << "\\u0019"; break;
-            case '\x1a': os << "\\u001a"; break;
-            case '\x1b': os << "\\u001b"; break;
-            case '\x1c': os << "\\u001c"; break;
-            case '\x1d': os << "\\u001d"; break;
-            case '\x1e': os << "\\u001e"; break;
-            case '\x1f': os << "\\u001f"; break;
-
-            default:
-               os << *itr;
-               //toUTF8( *itr, os );
-         }
-      }
-      os << '"';
-   }
    std::ostream& json::to_stream( std::ostream& out, const std::string& str )
    {
-        escape_string( str, out );
+        json_writer w( stringify_large_ints_and_doubles, str.size() + 2 );
+        w.write_string( str );
+        out.write( w.str().data(), w.str().size() );
         return out;
    }
 
-   template<typename T>
-   void to_stream( T& os, const variants& a, json::output_formatting format )
-   {
-      os << '[';
-      auto itr = a.begin();
-
-      while( itr != a.end() )
-      {
-         to_stream( os, *itr, format );
-         ++itr;
-         if( itr != a.end() )
-            os << ',';
-      }
-      os << ']';
-   }
-   template<typename T>
-   void to_stream( T& os, const variant_object& o, json::output_formatting format )
-   {
-       os << '{';
-       auto itr = o.begin();
-
-       while( itr != o.end() )
-       {
-          escape_string( itr->key(), os );
-          os << ':';
-          to_stream( os, itr->value(), format );
-          ++itr;
-          if( itr != o.end() )
-             os << ',';
-       }
-       os << '}';
-   }
-
-   template<typename T>
-   void to_stream( T& os, const variant& v, json::output_formatting format )
-   {
-      switch( v.get_type() )
-      {
-         case variant::null_type:
-              os << "null";
-              return;
-         case variant::int64_type:
-         {
-              int64_t i = v.as_int64();
-              if( format == json::stringify_large_ints_and_doubles &&
-                  i > 0xffffffff )
-                 os << '"'<<v.as_string()<<'"';
-              else
-                 os << i;
-
-              return;
-         }
-         case variant::uint64_type:
-         {
-              uint64_t i = v.as_uint64();
-              if( format == json::stringify_large_ints_and_doubles &&
-                  i > 0xffffffff )
-                 os << '"'<<v.as_string()<<'"';
-              else
-                 os << i;
-
-              return;
-         }
-         case variant::double_type:
-              if (format == json::stringify_large_ints_and_doubles)
-                 os << '"'<<v.as_string()<<'"';
-              else
-                 os << v.as_string();
-              return;
-         case variant::bool_type:
-              os << v.as_string();
-              return;
-         case variant::string_type:
-              escape_string( v.get_string(), os );
-              return;
-         case variant::blob_type:
-              escape_string( v.as_string(), os );
-              return;
-         case variant::array_type:
-           {
-              const variants&  a = v.get_array();
-              to_stream( os, a, format );
-              return;
-           }
-         case variant::object_type:
-           {
-              const variant_object& o =  v.get_object();
-              to_stream(os, o, format );
-              return;
-           }
-      }
-   }
-
    std::string   json::to_string( const variant& v, output_formatting format /* = stringify_large_ints_and_doubles */ )
    {
-      std::stringstream ss;
-      fc::to_stream( ss, v, format );
-      return ss.str();
+      json_writer w( format );
+      w.write( v );
+      return w.release();
    }
 
 
     std::string pretty_print( const std::string& v, uint8_t indent ) {
       int level = 0;
-      std::stringstream ss;
+      std::string out;
+      out.reserve( v.size() + v.size() / 2 );
       bool first = false;
       bool quote = false;
       bool escape = false;
@@ -697,30 +529,30 @@ namespace fc
                 if( quote )
                   escape = true;
               } else { escape = false; }
-              ss<<v[i];
+              out += v[i];
               break;
             case ':':
               if( !quote ) {
-                ss<<": ";
+                out += ": ";
               } else {
-                ss<<':';
+                out += ':';
               }
               break;
             case '"':
               if( first ) {
-                 ss<<'\n';
-                 for( int i = 0; i < level*indent; ++i ) ss<<' ';
+                 out += '\n';
+                 out.append( level*indent, ' ' );
                  first = false;
               }
               if( !escape ) {
                 quote = !quote;
               }
               escape = false;
-              ss<<'"';
+              out += '"';
               break;
             case '{':
             case '[':
-              ss<<v[i];
+              out += v[i];
               if( !quote ) {
                 ++level;
                 first = true;
@@ -732,27 +564,27 @@ namespace fc
             case ']':
               if( !quote ) {
                 if( v[i-1] != '[' && v[i-1] != '{' ) {
-                  ss<<'\n';
+                  out += '\n';
                 }
                 --level;
                 if( !first ) {
-                  for( int i = 0; i < level*indent; ++i ) ss<<' ';
+                  out.append( level*indent, ' ' );
                 }
                 first = false;
-                ss<<v[i];
+                out += v[i];
                 break;
               } else {
                 escape = false;
-                ss<<v[i];
+                out += v[i];
               }
               break;
             case ',':
               if( !quote ) {
-                ss<<',';
+                out += ',';
                 first = true;
               } else {
                 escape = false;
-                ss<<',';
+                out += ',';
               }
               break;
             case 'n':
@@ -762,14 +594,14 @@ namespace fc
               //No break; fall through to default case
             default:
               if( first ) {
-                 ss<<'\n';
-                 for( int i = 0; i < level*indent; ++i ) ss<<' ';
+                 out += '\n';
+                 out.append( level*indent, ' ' );
                  first = false;
               }
-              ss << v[i];
+              out += v[i];
          }
       }
-      return ss.str();
+      return out;
     }
 
 
@@ -789,8 +621,9 @@ namespace fc
       }
       else
       {
+       auto str = json::to_string( v, format );
        std::ofstream o(fi.generic_string().c_str());
-       fc::to_stream( o, v, format );
+       o.write( str.c_str(), str.size() );
       }
    }
    variant json::from_file( const fc::path& p, parse_type ptype )
@@ -798,13 +631,15 @@ namespace fc
       //auto tmp = std::make_shared<fc::ifstream>( p, ifstream::binary );
       //auto tmp = std::make_shared<std::ifstream>( p.generic_string().c_str(), std::ios::binary );
       //buffered_istream bi( tmp );
+      if( ptype == legacy_parser || ptype == legacy_parser_with_string_doubles )
+      {
+         std::string str;
+         read_file_contents( p, str );
+         return json_reader( str.data(), str.data() + str.size(), ptype ).read_variant();
+      }
       boost::filesystem::ifstream bi( p, std::ios::binary );
       switch( ptype )
       {
-          case legacy_parser:
-              return variant_from_stream<boost::filesystem::ifstream, legacy_parser>( bi );
-          case legacy_parser_with_string_doubles:
-              return variant_from_stream<boost::filesystem::ifstream, legacy_parser_with_string_doubles>( bi );
           case strict_parser:
               return json_relaxed::variant_from_stream<boost::filesystem::ifstream, true>( bi );
           case relaxed_parser:
@@ -813,38 +648,42 @@ namespace fc
               FC_ASSERT( false, "Unknown JSON parser type {ptype}", ("ptype", ptype) );
       }
    }
-   /*
-   variant json::from_stream( buffered_istream& in, parse_type ptype )
+   variant json::from_stream( std::istream& in, parse_type ptype )
    {
       switch( ptype )
       {
           case legacy_parser:
-              return variant_from_stream<fc::buffered_istream, legacy_parser>( in );
+              return variant_from_stream<std::istream, legacy_parser>( in );
           case legacy_parser_with_string_doubles:
-              return variant_from_stream<fc::buffered_istream, legacy_parser_with_string_doubles>( in );
+              return variant_from_stream<std::istream, legacy_parser_with_string_doubles>( in );
           case strict_parser:
-              return json_relaxed::variant_from_stream<buffered_istream, true>( in );
+              return json_relaxed::variant_from_stream<std::istream, true>( in );
           case relaxed_parser:
-              return json_relaxed::variant_from_stream<buffered_istream, false>( in );
+              return json_relaxed::variant_from_stream<std::istream, false>( in );
           default:
               FC_ASSERT( false, "Unknown JSON parser type {ptype}", ("ptype", ptype) );
       }
    }
-   */
 
    std::ostream& json::to_stream( std::ostream& out, const variant& v, output_formatting format /* = stringify_large_ints_and_doubles */ )
    {
-      fc::to_stream( out, v, format );
+      json_writer w( format );
+      w.write( v );
+      out.write( w.str().data(), w.str().size() );
       return out;
    }
    std::ostream& json::to_stream( std::ostream& out, const variants& v, output_formatting format /* = stringify_large_ints_and_doubles */ )
    {
-      fc::to_stream( out, v, format );
+      json_writer w( format );
+      w.write( v );
+      out.write( w.str().data(), w.str().size() );
       return out;
    }
    std::ostream& json::to_stream( std::ostream& out, const variant_object& v, output_formatting format /* = stringify_large_ints_and_doubles */ )
    {
-      fc::to_stream( out, v, format );
+      json_writer w( format );
+      w.write( v );
+      out.write( w.str().data(), w.str().size() );
       return out;
    }
 
@@ -0,0 +1,341 @@
+#include <fc/io/json_reader.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/string.hpp>
+#include <fc/variant_object.hpp>
+
+#include <ctype.h>
+#include <string.h>
+
+namespace fc
+{
+   namespace
+   {
+      const uint64_t low_bits  = 0x0101010101010101ull;
+      const uint64_t high_bits = 0x8080808080808080ull;
+
+      /** non-zero if any of the bytes of w is b */
+      inline uint64_t has_byte( uint64_t w, uint8_t b )
+      {
+         uint64_t x = w ^ (low_bits * b);
+         return (x - low_bits) & ~x & high_bits;
+      }
+
+      /** The first character in [p, end) that ends a run of plain string characters, or end */
+      inline const char* find_string_special( const char* p, const char* end )
+      {
+         while( end - p >= 8 )
+         {
+            uint64_t w;
+            memcpy( &w, p, sizeof(w) );
+            if( has_byte( w, '"' ) | has_byte( w, '\\' ) | has_byte( w, 0x04 ) )
+               break;
+            p += 8;
+         }
+         while( p != end && *p != '"' && *p != '\\' && *p != 0x04 )
+            ++p;
+         return p;
+      }
+
+      /** The characters of null, true and false */
+      inline bool is_keyword_char( char c )
+      {
+         switch( c )
+         {
+            case 'n':
+            case 'u':
+            case 'l':
+            case 't':
+            case 'r':
+            case 'e':
+            case 'f':
+            case 'a':
+            case 's':
+               return true;
+            default:
+               return false;
+         }
+      }
+
+      inline bool is_token_char( char c )
+      {
+         return isalnum( static_cast<unsigned char>(c) ) || c == '_' || c == '-' || c == '.' || c == ':' || c == '/';
+      }
+   }
+
+   json_reader::json_reader( const char* begin, const char* end, json::parse_type ptype )
+   :_pos(begin),_end(end),_string_doubles( ptype == json::legacy_parser_with_string_doubles )
+   {
+      FC_ASSERT( ptype == json::legacy_parser || ptype == json::legacy_parser_with_string_doubles,
+                 "json_reader only implements the legacy parsers", ("ptype", ptype) );
+   }
+
+   bool json_reader::skip_white_space()
+   {
+      const char* start = _pos;
+      while( _pos != _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r') )
+         ++_pos;
+      return _pos != start;
+   }
+
+   char json_reader::read_escape()
+   {
+      ++_pos; // '\\'
+      if( eof() )
+         FC_THROW_EXCEPTION( parse_error_exception, "Stream ended with '\\'" );
+      switch( char c = *_pos++ )
+      {
+         case 't':
+            return '\t';
+         case 'n':
+            return '\n';
+         case 'r':
+            return '\r';
+         default:
+            return c;
+      }
+   }
+
+   std::string json_reader::read_string()
+   {
+      if( peek() != '"' )
+      {
+         char c = peek();
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '\"' but read '${char}'",
+                             ("char", string(&c, (&c) + 1) ) );
+      }
+      ++_pos;
+
+      std::string token;
+      while( true )
+      {
+         const char* run = find_string_special( _pos, _end );
+         token.append( _pos, run );
+         _pos = run;
+         if( eof() || *_pos == 0x04 )
+            FC_THROW_EXCEPTION( parse_error_exception, "EOF before closing '\"' in string '${token}'",
+                                ("token", token) );
+         if( *_pos == '"' )
+         {
+            ++_pos;
+            return token;
+         }
+         token.push_back( read_escape() );
+      }
+   }
+
+   /** Reads the rest of a malformed number or token, which is taken to be an unquoted string */
+   std::string json_reader::read_unquoted()
+   {
+      std::string token;
+      while( !eof() )
+      {
+         char c = *_pos;
+         switch( c )
+         {
+            case '\\':
+               token.push_back( read_escape() );
+               break;
+            case '\t':
+            case ' ':
+            case '\0':
+            case '\n':
+               ++_pos;
+               return token;
+            default:
+               if( !is_token_char( c ) )
+                  return token;
+               token.push_back( c );
+               ++_pos;
+         }
+      }
+      return token;
+   }
+
+   void json_reader::begin_object()
+   {
+      if( peek() != '{' )
+      {
+         char c = peek();
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '{', but read '${char}'",
+                             ("char", string(&c, &c + 1)) );
+      }
+      FC_ASSERT( ++_object_depth < 100, "object graph too deep", ("object depth", _object_depth) );
+      ++_pos;
+   }
+
+   bool json_reader::next_key( std::string& key )
+   {
+      while( true )
+      {
+         skip_white_space();
+         switch( peek() )
+         {
+            case '}':
+               ++_pos;
+               --_object_depth;
+               return false;
+            case ',':
+               ++_pos;
+               continue;
+         }
+         key = read_string();
+         skip_white_space();
+         if( peek() != ':' )
+            FC_THROW_EXCEPTION( parse_error_exception, "Expected ':' after key \"${key}\"", ("key", key) );
+         ++_pos;
+         return true;
+      }
+   }
+
+   void json_reader::begin_array()
+   {
+      if( peek() != '[' )
+         FC_THROW_EXCEPTION( parse_error_exception, "Expected '['" );
+      FC_ASSERT( ++_array_depth < 100, "object graph too deep", ("array depth", _array_depth) );
+      ++_pos;
+   }
+
+   bool json_reader::next_element()
+   {
+      while( true )
+      {
+         skip_white_space();
+         switch( peek() )
+         {
+            case ']':
+               ++_pos;
+               --_array_depth;
+               return false;
+            case ',':
+               ++_pos;
+               continue;
+         }
+         return true;
+      }
+   }
+
+   variant json_reader::read_object()
+   {
+      mutable_variant_object obj;
+      std::string key;
+      begin_object();
+      while( next_key( key ) )
+      {
+         auto val = read_variant();
+         obj( std::move(key), std::move(val) );
+      }
+      return variant( std::move(obj) );
+   }
+
+   variant json_reader::read_array()
+   {
+      variants ar;
+      begin_array();
+      while( next_element() )
+         ar.push_back( read_variant() );
+      return variant( std::move(ar) );
+   }
+
+   variant json_reader::read_number()
+   {
+      const char* start = _pos;
+      bool dot = false;
+      bool neg = false;
+      if( peek() == '-' )
+      {
+         neg = true;
+         ++_pos;
+      }
+      for( ; !eof(); ++_pos )
+      {
+         char c = *_pos;
+         if( c == '.' )
+         {
+            if( dot )
+               FC_THROW_EXCEPTION( parse_error_exception, "Can't parse a number with two decimal places" );
+            dot = true;
+         }
+         else if( c < '0' || c > '9' )
+         {
+            if( isalnum( static_cast<unsigned char>(c) ) )
+            {
+               std::string str( start, _pos );
+               return str + read_unquoted();
+            }
+            break;
+         }
+      }
+
+      std::string str( start, _pos );
+      if( str == "-." || str == "." ) // check the obviously wrong things we could have encountered
+         FC_THROW_EXCEPTION( parse_error_exception, "Can't parse token \"${token}\" as a JSON numeric constant", ("token", str) );
+      if( dot )
+         return _string_doubles ? variant( std::move(str) ) : variant( to_double(str) );
+      if( neg )
+         return to_int64( str );
+      return to_uint64( str );
+   }
+
+   variant json_reader::read_token()
+   {
+      const char* start = _pos;
+      while( !eof() && is_keyword_char( *_pos ) )
+         ++_pos;
+
+      const size_t len = _pos - start;
+      if( len == 4 && memcmp( start, "null", 4 ) == 0 )
+         return variant();
+      if( len == 4 && memcmp( start, "true", 4 ) == 0 )
+         return true;
+      if( len == 5 && memcmp( start, "false", 5 ) == 0 )
+         return false;
+
+      // a partial token ("tru") or something that is not one at all ("falfe"); a strict JSON parser would signal
+      // this as an error, but it is read as an unquoted string
+      std::string str( start, _pos );
+      return str + read_unquoted();
+   }
+
+   variant json_reader::read_variant()
+   {
+      skip_white_space();
+      if( eof() )
+         FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
+
+      switch( char c = *_pos )
+      {
+         case '"':
+            return read_string();
+         case '{':
+            return read_object();
+         case '[':
+            return read_array();
+         case '-':
+         case '.':
+         case '0':
+         case '1':
+         case '2':
+         case '3':
+         case '4':
+         case '5':
+         case '6':
+         case '7':
+         case '8':
+         case '9':
+            return read_number();
+         // null, true, false, or 'warning' / string
+         case 'n':
+         case 't':
+         case 'f':
+            return read_token();
+         case 0x04: // ^D end of transmission
+            FC_THROW_EXCEPTION( eof_exception, "unexpected end of file" );
+         case 0:
+            return variant();
+         default:
+            FC_THROW_EXCEPTION( parse_error_exception, "Unexpected char '${c}' in \"${s}\"",
+                                ("c", c)("s", read_unquoted()) );
+      }
+   }
+
+} // fc
@@ -0,0 +1,156 @@
+#include <fc/io/json_writer.hpp>
+#include <fc/variant_object.hpp>
+
+namespace fc
+{
+   json_writer::json_writer( json::output_formatting format, size_t reserve )
+   :_format(format)
+   {
+      _out.reserve( reserve );
+   }
+
+   void json_writer::write_digits( uint64_t u, bool negative )
+   {
+      char buf[21];
+      char* p = buf + sizeof(buf);
+      do {
+         *--p = char('0' + u % 10);
+         u /= 10;
+      } while( u != 0 );
+      if( negative )
+         *--p = '-';
+      _out.append( p, buf + sizeof(buf) );
+   }
+
+   void json_writer::write_int64( int64_t i )
+   {
+      const bool quote = _format == json::stringify_large_ints_and_doubles && i > 0xffffffff;
+      if( quote ) _out.push_back( '"' );
+      write_digits( i < 0 ? 0 - uint64_t(i) : uint64_t(i), i < 0 );
+      if( quote ) _out.push_back( '"' );
+   }
+
+   void json_writer::write_uint64( uint64_t i )
+   {
+      const bool quote = _format == json::stringify_large_ints_and_doubles && i > 0xffffffff;
+      if( quote ) _out.push_back( '"' );
+      write_digits( i, false );
+      if( quote ) _out.push_back( '"' );
+   }
+
+   /**
+    *  Escapes '"', '\\' and the control characters, using the short forms where JSON has them.
+    *
+    *  All other characters are written as is, as UTF8.
+    */
+   void json_writer::write_string( const char* s, size_t len )
+   {
+      static const char hex[] = "0123456789abcdef";
+
+      _out.reserve( _out.size() + len + 2 );
+      _out.push_back( '"' );
+      const char* const end = s + len;
+      const char* run = s;
+      for( const char* p = s; p != end; ++p )
+      {
+         const unsigned char c = *p;
+         if( c >= 0x20 && c != '"' && c != '\\' )
+            continue;
+
+         _out.append( run, p );
+         run = p + 1;
+         switch( c )
+         {
+            case '\b': _out.append( "\\b", 2 ); break;
+            case '\f': _out.append( "\\f", 2 ); break;
+            case '\n': _out.append( "\\n", 2 ); break;
+            case '\r': _out.append( "\\r", 2 ); break;
+            case '\t': _out.append( "\\t", 2 ); break;
+            case '\\': _out.append( "\\\\", 2 ); break;
+            case '"':  _out.append( "\\\"", 2 ); break;
+            default:
+            {
+               const char u[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+               _out.append( u, sizeof(u) );
+            }
+         }
+      }
+      _out.append( run, end );
+      _out.push_back( '"' );
+   }
+
+   void json_writer::write( const variants& a )
+   {
+      _out.push_back( '[' );
+      auto itr = a.begin();
+      while( itr != a.end() )
+      {
+         write( *itr );
+         ++itr;
+         if( itr != a.end() )
+            _out.push_back( ',' );
+      }
+      _out.push_back( ']' );
+   }
+
+   void json_writer::write( const variant_object& o )
+   {
+      _out.push_back( '{' );
+      auto itr = o.begin();
+      while( itr != o.end() )
+      {
+         write_string( itr->key() );
+         _out.push_back( ':' );
+         write( itr->value() );
+         ++itr;
+         if( itr != o.end() )
+            _out.push_back( ',' );
+      }
+      _out.push_back( '}' );
+   }
+
+   void json_writer::write( const variant& v )
+   {
+      switch( v.get_type() )
+      {
+         case variant::null_type:
+            _out.append( "null", 4 );
+            return;
+         case variant::int64_type:
+            write_int64( v.as_int64() );
+            return;
+         case variant::uint64_type:
+            write_uint64( v.as_uint64() );
+            return;
+         case variant::double_type:
+            if( _format == json::stringify_large_ints_and_doubles )
+            {
+               _out.push_back( '"' );
+               _out.append( v.as_string() );
+               _out.push_back( '"' );
+            }
+            else
+               _out.append( v.as_string() );
+            return;
+         case variant::bool_type:
+            if( v.as_bool() )
+               _out.append( "true", 4 );
+            else
+               _out.append( "false", 5 );
+            return;
+         case variant::string_type:
+            write_string( v.get_string() );
+            return;
+         case variant::blob_type:
+            write_string( v.as_string() );
+            return;
+         case variant::array_type:
+            write( v.get_array() );
+            return;
+         case variant::object_type:
+            write( v.get_object() );
+            return;
+      }
+   }
+
+} // fc
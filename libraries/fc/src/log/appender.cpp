@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <string>
 #include <fc/log/console_appender.hpp>
+#include <fc/log/async_appender.hpp>
 #include <fc/log/file_appender.hpp>
 #include <fc/log/gelf_appender.hpp>
 #include <fc/variant.hpp>
@@ -42,6 +43,7 @@ namespace fc {
    }
    
    static bool reg_console_appender = appender::register_appender<console_appender>( "console" );
+   static bool reg_async_appender = appender::register_appender<async_appender>( "async" );
 //   static bool reg_file_appender = appender::register_appender<file_appender>( "file" );
 //  static bool reg_gelf_appender = appender::register_appender<gelf_appender>( "gelf" );
 
@@ -0,0 +1,234 @@
+#include <fc/log/async_appender.hpp>
+#include <fc/log/log_message.hpp>
+#include <fc/log/logger_config.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/variant.hpp>
+
+#include <boost/lockfree/queue.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace fc {
+
+   class async_appender::impl {
+   public:
+      impl( const config& c, const appender::ptr& t );
+      ~impl();
+
+      void log( const log_message& m );
+      void flush();
+      void stop();
+
+      /// the writers still running, which are drained when the program exits
+      static std::mutex&         running_mutex();
+      static std::set<impl*>&    running();
+      static void                stop_running();
+
+      config                               cfg;
+      appender::ptr                        target;
+      boost::lockfree::queue<log_message*> queue;
+      std::atomic<uint64_t>                queued{0};
+      std::atomic<uint64_t>                written{0};
+      std::atomic<uint64_t>                dropped{0};
+      std::atomic<bool>                    sleeping{false};
+      std::atomic<bool>                    done{false};
+
+   private:
+      void run();
+      void drain();
+      void write( const log_message& m );
+      void report_drops();
+
+      uint64_t                             _reported_drops = 0;
+      bool                                 _stopped = false;
+      std::mutex                           _mutex;
+      std::condition_variable              _wake;
+      std::condition_variable              _drained;
+      std::thread                          _writer;
+   };
+
+   std::mutex& async_appender::impl::running_mutex() {
+      static std::mutex* m = new std::mutex;
+      return *m;
+   }
+   std::set<async_appender::impl*>& async_appender::impl::running() {
+      static std::set<impl*>* s = new std::set<impl*>;
+      return *s;
+   }
+   void async_appender::impl::stop_running() {
+      std::set<impl*> writers;
+      {
+         std::lock_guard<std::mutex> lock( running_mutex() );
+         writers.swap( running() );
+      }
+      for( auto w : writers )
+         w->stop();
+   }
+
+   async_appender::impl::impl( const config& c, const appender::ptr& t )
+   :cfg(c),target(t),queue(c.capacity)
+   {
+      FC_ASSERT( cfg.capacity > 0, "an async appender needs room for at least one message" );
+      {
+         std::lock_guard<std::mutex> lock( running_mutex() );
+         static bool stop_at_exit = std::atexit( stop_running ) == 0;
+         (void)stop_at_exit;
+         running().insert( this );
+      }
+      _writer = std::thread( [this]() { run(); } );
+   }
+
+   async_appender::impl::~impl()
+   {
+      {
+         std::lock_guard<std::mutex> lock( running_mutex() );
+         running().erase( this );
+      }
+      stop();
+   }
+
+   void async_appender::impl::stop()
+   {
+      if( !_writer.joinable() )
+         return;
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         done = true;
+         _wake.notify_one();
+      }
+      _writer.join();
+      // messages pushed by a log() that had not yet seen done
+      drain();
+   }
+
+   void async_appender::impl::log( const log_message& m )
+   {
+      // once the writer has stopped at exit, anything logged later is written by the caller
+      if( done ) {
+         write( m );
+         return;
+      }
+
+      auto msg = new log_message( m );
+      while( !queue.bounded_push( msg ) ) {
+         if( m.get_context().get_log_level() < cfg.drop_below ) {
+            delete msg;
+            ++dropped;
+            return;
+         }
+         if( done ) {
+            delete msg;
+            write( m );
+            return;
+         }
+         std::this_thread::yield();
+      }
+      ++queued;
+
+      // pairs with the fence in run(), so either the writer sees the message or we see it going to sleep,
+      // and with stop(), so either it drains the message after the writer exits or we see done
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      if( done ) {
+         drain();
+         return;
+      }
+      if( sleeping ) {
+         std::lock_guard<std::mutex> lock( _mutex );
+         _wake.notify_one();
+      }
+   }
+
+   void async_appender::impl::flush()
+   {
+      uint64_t until = queued;
+      std::unique_lock<std::mutex> lock( _mutex );
+      _wake.notify_one();
+      _drained.wait( lock, [&]() { return written >= until || _stopped; } );
+   }
+
+   void async_appender::impl::run()
+   {
+      set_thread_name( "log" );
+      while( true ) {
+         uint64_t before = written;
+         drain();
+         if( written != before ) {
+            report_drops();
+            try { target->flush(); } catch( ... ) {}
+         }
+
+         std::unique_lock<std::mutex> lock( _mutex );
+         _drained.notify_all();
+         if( done ) {
+            if( queue.empty() )
+               break;
+            continue;
+         }
+         sleeping = true;
+         std::atomic_thread_fence( std::memory_order_seq_cst );
+         if( queue.empty() )
+            _wake.wait_for( lock, std::chrono::milliseconds( 100 ) );
+         sleeping = false;
+      }
+      report_drops();
+      try { target->flush(); } catch( ... ) {}
+
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stopped = true;
+      _drained.notify_all();
+   }
+
+   void async_appender::impl::drain()
+   {
+      log_message* msg = nullptr;
+      while( queue.pop( msg ) ) {
+         write( *msg );
+         delete msg;
+         ++written;
+      }
+   }
+
+   void async_appender::impl::write( const log_message& m )
+   {
+      try {
+         target->log( m );
+      } catch( ... ) {
+      }
+   }
+
+   void async_appender::impl::report_drops()
+   {
+      uint64_t d = dropped;
+      if( d == _reported_drops )
+         return;
+      write( FC_LOG_MESSAGE( warn, "dropped ${n} log messages because the queue was full",
+                             ("n", d - _reported_drops) ) );
+      _reported_drops = d;
+   }
+
+   async_appender::async_appender( const variant& args )
+   {
+      auto cfg = args.as<config>();
+      auto target = appender::get( cfg.appender );
+      FC_ASSERT( target, "async appender needs the appender '${a}' to be created before it", ("a", cfg.appender) );
+      my.reset( new impl( cfg, target ) );
+   }
+
+   async_appender::async_appender( const config& cfg, const appender::ptr& target )
+   :my( new impl( cfg, target ) ){}
+
+   async_appender::~async_appender() {}
+
+   void async_appender::log( const log_message& m ) { my->log( m ); }
+
+   void async_appender::flush() { my->flush(); }
+
+   uint64_t async_appender::dropped()const { return my->dropped; }
+
+} // namespace fc
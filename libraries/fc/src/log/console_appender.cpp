@@ -82,7 +82,8 @@ namespace fc {
    }
 
    boost::mutex& log_mutex() {
-    static boost::mutex m; return m;
+    // never destroyed, so messages written while the program exits can still take it
+    static boost::mutex* m = new boost::mutex; return *m;
    }
 
    void console_appender::log( const log_message& m ) {
@@ -150,4 +151,9 @@ namespace fc {
       if( my->cfg.flush ) fflush( out );
    }
 
+   void console_appender::flush()
+   {
+      fflush( my->cfg.stream == stream::std_error ? stderr : stdout );
+   }
+
 }
@@ -47,7 +47,12 @@ namespace fc
    :my( std::make_shared<detail::log_context_impl>() )
    {
       my->level       = ll;
-      my->file        = fc::path(file).filename().generic_string(); // TODO truncate filename
+      // just the file name, found without building a path, since this runs on every message logged
+      const char* name = file;
+      for( const char* p = file; *p; ++p )
+         if( *p == '/' || *p == '\\' )
+            name = p + 1;
+      my->file        = name;
       my->line        = line;
       my->method      = method;
       my->timestamp   = time_point::now();
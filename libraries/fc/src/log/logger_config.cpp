@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <string>
 #include <fc/log/console_appender.hpp>
+#include <fc/log/async_appender.hpp>
 #include <fc/log/file_appender.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/exception/exception.hpp>
@@ -23,6 +24,7 @@ namespace fc {
    {
       try {
       static bool reg_console_appender = appender::register_appender<console_appender>( "console" );
+      static bool reg_async_appender = appender::register_appender<async_appender>( "async" );
       static bool reg_file_appender = false;//appender::register_appender<file_appender>( "file" );
       get_logger_map().clear();
       get_appender_map().clear();
@@ -48,7 +50,7 @@ namespace fc {
             if( ap ) { lgr.add_appender(ap); }
          }
       }
-      return reg_console_appender || reg_file_appender;
+      return reg_console_appender || reg_async_appender || reg_file_appender;
       } catch ( exception& e )
       {
          std::cerr<<e.to_detail_string()<<"\n";
@@ -65,11 +67,13 @@ namespace fc {
                c.push_back(  mutable_variant_object( "level","warn")("color", "brown") );
                c.push_back(  mutable_variant_object( "level","error")("color", "red") );
 
+      // only written through async_stderr, which flushes it once the queued messages are written
       cfg.appenders.push_back( 
              appender_config( "stderr", "console", 
                  mutable_variant_object()
                      ( "stream","std_error")
                      ( "level_colors", c ) 
+                     ( "flush", false )
                  ) ); 
       cfg.appenders.push_back( 
              appender_config( "stdout", "console", 
@@ -77,11 +81,17 @@ namespace fc {
                      ( "stream","std_out") 
                      ( "level_colors", c ) 
                  ) ); 
+      // the default logger writes to stderr from a background thread, so logging does not hold up the caller
+      cfg.appenders.push_back(
+             appender_config( "async_stderr", "async",
+                 mutable_variant_object()
+                     ( "appender", "stderr" )
+                 ) );
       
       logger_config dlc;
       dlc.name = "default";
       dlc.level = log_level::debug;
-      dlc.appenders.push_back("stderr");
+      dlc.appenders.push_back("async_stderr");
       cfg.loggers.push_back( dlc );
       return cfg;
    }
@@ -1,10 +1,94 @@
 #include <fc/variant_object.hpp>
 #include <fc/exception/exception.hpp>
 #include <assert.h>
+#include <string.h>
 
 
 namespace fc
 {
+   namespace detail
+   {
+      /** objects with fewer keys than this are searched linearly */
+      const size_t min_indexed_size = 8;
+
+      /**
+       *  An open addressing hash table of the positions of the keys of an object.  Only the first of duplicate keys
+       *  is indexed, so lookups find the same entry a linear search would.
+       */
+      class variant_object_index
+      {
+         public:
+            typedef std::vector<variant_object::entry> entries;
+
+            explicit variant_object_index( const entries& e ) { rebuild( e ); }
+
+            /** the position of the first entry with key, or e.size() if there is none */
+            size_t find( const entries& e, const char* key, size_t len )const
+            {
+               for( size_t slot = hash( key, len ) & _mask; _slots[slot] != 0; slot = (slot + 1) & _mask )
+               {
+                  const string& k = e[_slots[slot] - 1].key();
+                  if( k.size() == len && memcmp( k.data(), key, len ) == 0 )
+                     return _slots[slot] - 1;
+               }
+               return e.size();
+            }
+
+            /** indexes e.back(), which has just been appended */
+            void add( const entries& e )
+            {
+               if( (_count + 1) * 2 > _slots.size() )
+                  rebuild( e );
+               else
+                  insert( e, e.size() - 1 );
+            }
+
+         private:
+            /** FNV-1a */
+            static uint64_t hash( const char* key, size_t len )
+            {
+               uint64_t h = 14695981039346656037ull;
+               for( size_t i = 0; i < len; ++i )
+                  h = (h ^ uint8_t(key[i])) * 1099511628211ull;
+               return h;
+            }
+
+            void rebuild( const entries& e )
+            {
+               size_t n = 16;
+               while( n < e.size() * 4 )
+                  n <<= 1;
+               _slots.assign( n, 0 );
+               _mask = n - 1;
+               _count = 0;
+               for( size_t i = 0; i < e.size(); ++i )
+                  insert( e, i );
+            }
+
+            void insert( const entries& e, size_t pos )
+            {
+               const string& k = e[pos].key();
+               size_t slot = hash( k.data(), k.size() ) & _mask;
+               for( ; _slots[slot] != 0; slot = (slot + 1) & _mask )
+               {
+                  if( e[_slots[slot] - 1].key() == k )
+                     return;
+               }
+               _slots[slot] = uint32_t(pos + 1);
+               ++_count;
+            }
+
+            std::vector<uint32_t>  _slots; ///< position + 1, 0 when empty
+            size_t                 _mask = 0;
+            size_t                 _count = 0;
+      };
+
+      void variant_object_index_deleter::operator()( variant_object_index* index )const
+      {
+         delete index;
+      }
+   }
+
    // ---------------------------------------------------------------
    // entry
 
@@ -63,14 +147,34 @@ namespace fc
 
    variant_object::iterator variant_object::find( const string& key )const
    {
-      return find( key.c_str() );
+      return find( key.data(), key.size() );
    }
 
    variant_object::iterator variant_object::find( const char* key )const
    {
+      return find( key, strlen(key) );
+   }
+
+   variant_object::iterator variant_object::find( const char* key, size_t len )const
+   {
+      const auto& entries = *_key_value;
+      if( entries.size() >= detail::min_indexed_size )
+      {
+         // the object may be looked up from several threads; the first index published is kept and never changed
+         auto index = _index.load( std::memory_order_acquire );
+         if( !index )
+         {
+            auto built = new detail::variant_object_index( entries );
+            if( _index.compare_exchange_strong( index, built, std::memory_order_acq_rel, std::memory_order_acquire ) )
+               index = built;
+            else
+               delete built;
+         }
+         return begin() + index->find( entries, key, len );
+      }
       for( auto itr = begin(); itr != end(); ++itr )
       {
-         if( itr->key() == key )
+         if( itr->key().size() == len && memcmp( itr->key().data(), key, len ) == 0 )
          {
             return itr;
          }
@@ -107,6 +211,7 @@ namespace fc
        _key_value->emplace_back(entry(fc::move(key), fc::move(val)));
    }
 
+   // a copy builds its own index when it is first looked up, so no object's index is shared or replaced
    variant_object::variant_object( const variant_object& obj )
    :_key_value( obj._key_value )
    {
@@ -114,19 +219,24 @@ namespace fc
    }
 
    variant_object::variant_object( variant_object&& obj)
-   : _key_value( fc::move(obj._key_value) )
+   : _key_value( fc::move(obj._key_value) ), _index( obj._index.exchange( nullptr ) )
    {
       obj._key_value = std::make_shared<std::vector<entry>>();
       assert( _key_value != nullptr );
    }
 
+   variant_object::~variant_object()
+   {
+      delete _index.load();
+   }
+
    variant_object::variant_object( const mutable_variant_object& obj )
       : _key_value(std::make_shared<std::vector<entry>>(*obj._key_value))
    {
    }
 
    variant_object::variant_object( mutable_variant_object&& obj )
-   : _key_value(fc::move(obj._key_value))
+   : _key_value(fc::move(obj._key_value)), _index(obj._index.release())
    {
       assert( _key_value != nullptr );
    }
@@ -136,6 +246,7 @@ namespace fc
       if (this != &obj)
       {
          fc_swap(_key_value, obj._key_value );
+         _index = obj._index.exchange( _index.load() );
          assert( _key_value != nullptr );
       }
       return *this;
@@ -146,6 +257,7 @@ namespace fc
       if (this != &obj)
       {
          _key_value = obj._key_value;
+         delete _index.exchange( nullptr );
       }
       return *this;
    }
@@ -153,13 +265,16 @@ namespace fc
    variant_object& variant_object::operator=( mutable_variant_object&& obj )
    {
       _key_value = fc::move(obj._key_value);
+      delete _index.exchange( obj._index.release() );
       obj._key_value.reset( new std::vector<entry>() );
       return *this;
    }
 
    variant_object& variant_object::operator=( const mutable_variant_object& obj )
    {
-      *_key_value = *obj._key_value;
+      // copies of this object share the old entries, so they must not be overwritten
+      _key_value = std::make_shared<std::vector<entry>>( *obj._key_value );
+      delete _index.exchange( nullptr );
       return *this;
    }
 
@@ -199,31 +314,36 @@ namespace fc
 
    mutable_variant_object::iterator mutable_variant_object::find( const string& key )const
    {
-      return find( key.c_str() );
+      return find( key.data(), key.size() );
    }
 
    mutable_variant_object::iterator mutable_variant_object::find( const char* key )const
    {
-      for( auto itr = begin(); itr != end(); ++itr )
-      {
-         if( itr->key() == key )
-         {
-            return itr;
-         }
-      }
-      return end();
+      return find( key, strlen(key) );
    }
 
    mutable_variant_object::iterator mutable_variant_object::find( const string& key )
    {
-      return find( key.c_str() );
+      return find( key.data(), key.size() );
    }
 
    mutable_variant_object::iterator mutable_variant_object::find( const char* key )
    {
+      return find( key, strlen(key) );
+   }
+
+   mutable_variant_object::iterator mutable_variant_object::find( const char* key, size_t len )const
+   {
+      const auto& entries = *_key_value;
+      if( entries.size() >= detail::min_indexed_size )
+      {
+         if( !_index )
+            _index.reset( new detail::variant_object_index( entries ) );
+         return begin() + _index->find( entries, key, len );
+      }
       for( auto itr = begin(); itr != end(); ++itr )
       {
-         if( itr->key() == key )
+         if( itr->key().size() == len && memcmp( itr->key().data(), key, len ) == 0 )
          {
             return itr;
          }
@@ -231,6 +351,13 @@ namespace fc
       return end();
    }
 
+   void mutable_variant_object::push_back( entry e )
+   {
+      _key_value->push_back( fc::move(e) );
+      if( _index )
+         _index->add( *_key_value );
+   }
+
    const variant& mutable_variant_object::operator[]( const string& key )const
    {
       return (*this)[key.c_str()];
@@ -251,7 +378,7 @@ namespace fc
    {
       auto itr = find( key );
       if( itr != end() ) return itr->value();
-      _key_value->emplace_back(entry(key, variant()));
+      push_back( entry(key, variant()) );
       return _key_value->back().value();
    }
 
@@ -282,13 +409,14 @@ namespace fc
    }
 
    mutable_variant_object::mutable_variant_object( mutable_variant_object&& obj )
-      : _key_value(fc::move(obj._key_value))
+      : _key_value(fc::move(obj._key_value)), _index(fc::move(obj._index))
    {
    }
 
    mutable_variant_object& mutable_variant_object::operator=( const variant_object& obj )
    {
       *_key_value = *obj._key_value;
+      _index.reset();
       return *this;
    }
 
@@ -297,6 +425,7 @@ namespace fc
       if (this != &obj)
       {
          _key_value = fc::move(obj._key_value);
+         _index = fc::move(obj._index);
       }
       return *this;
    }
@@ -306,6 +435,7 @@ namespace fc
       if (this != &obj)
       {
          *_key_value = *obj._key_value;
+         _index.reset();
       }
       return *this;
    }
@@ -322,6 +452,7 @@ namespace fc
          if( itr->key() == key )
          {
             _key_value->erase(itr);
+            _index.reset();
             return;
          }
       }
@@ -330,14 +461,14 @@ namespace fc
    /** replaces the value at \a key with \a var or insert's \a key if not found */
    mutable_variant_object& mutable_variant_object::set( string key, variant var )
    {
-      auto itr = find( key.c_str() );
+      auto itr = find( key );
       if( itr != end() )
       {
          itr->set( fc::move(var) );
       }
       else
       {
-         _key_value->push_back( entry( fc::move(key), fc::move(var) ) );
+         push_back( entry( fc::move(key), fc::move(var) ) );
       }
       return *this;
    }
@@ -347,7 +478,7 @@ namespace fc
     */
    mutable_variant_object& mutable_variant_object::operator()( string key, variant var )
    {
-      _key_value->push_back( entry( fc::move(key), fc::move(var) ) );
+      push_back( entry( fc::move(key), fc::move(var) ) );
       return *this;
    }
 
@@ -201,6 +201,7 @@ void apply_eos_setcode(apply_context& context) {
 
 
    const auto& account = db.get<account_object,by_name>(msg.account);
+   context.mutable_controller.get_abi_serializer_cache().erase(account.abi_version);
 //   wlog( "set code: ${size}", ("size",msg.code.size()));
    db.modify( account, [&]( auto& a ) {
       /** TODO: consider whether a microsecond level local timestamp is sufficient to detect code version changes*/
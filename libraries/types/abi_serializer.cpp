@@ -20,23 +20,28 @@ namespace eosio { namespace types {
       return fc::variant(temp);
    }
 
+   template <typename T>
+   fc::variant unpack_built_in( fc::datastream<const char*>& stream, bool is_array ) {
+      if( is_array )
+         return variantFromStream<vector<T>>(stream);
+      return variantFromStream<T>(stream);
+   }
+
+   template <typename T>
+   void pack_built_in( const fc::variant& var, fc::datastream<char*>& ds, bool is_array ) {
+      if( is_array )
+         fc::raw::pack( ds, var.as<vector<T>>() );
+      else
+         fc::raw::pack( ds,  var.as<T>());
+   }
+
    template <typename T>
    auto packUnpack() {
-      return std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
-         []( fc::datastream<const char*>& stream, bool is_array) -> fc::variant  {
-            if( is_array )
-               return variantFromStream<vector<T>>(stream);
-            return variantFromStream<T>(stream);
-         },
-         []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array ){
-            if( is_array )
-               fc::raw::pack( ds, var.as<vector<T>>() );
-            else
-               fc::raw::pack( ds,  var.as<T>());
-         }
-      );
+      return std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>( &unpack_built_in<T>, &pack_built_in<T> );
    }
 
+   constexpr uint32_t abi_serializer::npos;
+
    abi_serializer::abi_serializer( const abi& abi ) {
       configure_built_in_types();
       set_abi(abi);
@@ -103,6 +108,7 @@ namespace eosio { namespace types {
       structs.clear();
       actions.clear();
       tables.clear();
+      table_index_types.clear();
 
       for( const auto& td : abi.types ) {
          FC_ASSERT(is_type(td.type), "invalid type", ("type",td.type));
@@ -115,8 +121,10 @@ namespace eosio { namespace types {
       for( const auto& a : abi.actions )
          actions[a.action_name] = a.type;
 
-      for( const auto& t : abi.tables )
+      for( const auto& t : abi.tables ) {
          tables[t.table_name] = t.type;
+         table_index_types[t.table_name] = t.index_type;
+      }
 
       /**
        *  The ABI vector may contain duplicates which would make it
@@ -126,6 +134,116 @@ namespace eosio { namespace types {
       FC_ASSERT( structs.size() == abi.structs.size() );
       FC_ASSERT( actions.size() == abi.actions.size() );
       FC_ASSERT( tables.size() == abi.tables.size() );
+
+      compile_type_plans();
+   }
+
+   void abi_serializer::compile_type_plans() {
+      type_plans.clear();
+      type_plan_index.clear();
+
+      auto compile_with_array = [&]( const type_name& type ) {
+         compile_type_plan(type);
+         compile_type_plan(type_name(string(type) + "[]"));
+      };
+
+      for( const auto& bt : built_in_types )
+         compile_with_array(bt.first);
+      for( const auto& td : typedefs )
+         compile_with_array(td.first);
+      for( const auto& st : structs )
+         compile_with_array(st.first);
+      for( const auto& a : actions )
+         compile_type_plan(a.second);
+      for( const auto& t : tables )
+         compile_type_plan(t.second);
+   }
+
+   /**
+    *  Returns the index of the plan for type, compiling it and the types it refers to as needed. Types
+    *  that cannot be resolved (unknown names, circular typedefs or bases) get an unknown_kind plan so
+    *  that set_abi accepts the same ABIs as before and validate() or the first use reports the error.
+    *  Nothing here may throw or recurse on a cycle, since set_abi runs before the ABI is validated.
+    */
+   uint32_t abi_serializer::compile_type_plan(const type_name& type) {
+      auto itr = type_plan_index.find(type);
+      if( itr != type_plan_index.end() ) return itr->second;
+
+      type_name rtype;
+      const bool resolved = try_resolve_type(type, rtype);
+
+      if( resolved && rtype != type ) {
+         auto index = compile_type_plan(rtype);
+         type_plan_index[type] = index;
+         return index;
+      }
+
+      /// register the plan before compiling the types it refers to so that recursive structs terminate
+      auto index = uint32_t(type_plans.size());
+      type_plan_index[type] = index;
+      type_plans.emplace_back();
+      type_plans.back().name = type;
+      if( !resolved ) return index; ///< circular typedef
+
+      if( is_array(type) ) {
+         auto element = compile_type_plan(array_type(type));
+         const auto& element_plan = type_plans[element];
+         auto& plan = type_plans[index];
+         if( element_plan.kind == type_plan::built_in_kind && !element_plan.is_array ) {
+            plan.kind     = type_plan::built_in_kind;
+            plan.is_array = true;
+            plan.unpack   = element_plan.unpack;
+            plan.pack     = element_plan.pack;
+         } else {
+            /// the element plan may still be compiling (a struct with a field of an array of itself) or may never
+            /// resolve, so its kind is only looked at when the array is used
+            plan.kind    = type_plan::array_kind;
+            plan.element = element;
+         }
+         return index;
+      }
+
+      auto btype = built_in_types.find(type);
+      if( btype != built_in_types.end() ) {
+         auto& plan = type_plans[index];
+         plan.kind   = type_plan::built_in_kind;
+         plan.unpack = btype->second.first;
+         plan.pack   = btype->second.second;
+         return index;
+      }
+
+      /// collect the struct and its bases, most derived first
+      vector<const struct_t*> chain;
+      for( auto st = structs.find(type); ; ) {
+         if( st == structs.end() ) return index;
+         for( const auto* seen : chain )
+            if( seen == &st->second ) return index; ///< circular base
+         chain.push_back(&st->second);
+         if( st->second.base == type_name() ) break;
+         type_name base;
+         if( !try_resolve_type(st->second.base, base) ) return index; ///< base through a circular typedef
+         st = structs.find(base);
+      }
+
+      vector<type_plan::field_plan> fields;
+      for( auto st = chain.rbegin(); st != chain.rend(); ++st ) {
+         for( const auto& f : (*st)->fields ) {
+            type_plan::field_plan field;
+            field.name = f.name;
+            field.type = compile_type_plan(f.type);
+            fields.emplace_back(std::move(field));
+         }
+      }
+      auto& plan = type_plans[index];
+      plan.kind   = type_plan::struct_kind;
+      plan.fields = std::move(fields);
+      return index;
+   }
+
+   const abi_serializer::type_plan& abi_serializer::get_type_plan(const type_name& type)const {
+      auto itr = type_plan_index.find(type);
+      FC_ASSERT( itr != type_plan_index.end(), "Unknown type ${type}", ("type",type) );
+      return type_plans[itr->second];
    }
    
    bool abi_serializer::is_array(const type_name& type)const {
@@ -139,9 +257,13 @@ namespace eosio { namespace types {
 
    bool abi_serializer::is_type(const type_name& rtype)const {
       auto type = array_type(rtype);
-      if( built_in_types.find(type) != built_in_types.end() ) return true;
-      if( typedefs.find(type) != typedefs.end() ) return is_type(typedefs.find(type)->second);
-      if( structs.find(type) != structs.end() ) return true;
+      /// a chain of typedefs longer than there are typedefs must loop, and a loop names no type
+      for( size_t steps = 0; steps <= typedefs.size(); ++steps ) {
+         if( built_in_types.find(type) != built_in_types.end() ) return true;
+         auto td = typedefs.find(type);
+         if( td == typedefs.end() ) return structs.find(type) != structs.end();
+         type = array_type(td->second);
+      }
       return false;
    }
 
@@ -188,35 +310,52 @@ namespace eosio { namespace types {
       } FC_CAPTURE_AND_RETHROW( (t)  ) }
    }
 
+   bool abi_serializer::try_resolve_type(const type_name& type, type_name& resolved)const {
+      resolved = type;
+      for( size_t steps = 0; steps <= typedefs.size(); ++steps ) {
+         auto itr = typedefs.find(resolved);
+         if( itr == typedefs.end() ) return true;
+         resolved = itr->second;
+      }
+      return false;
+   }
+
    type_name abi_serializer::resolve_type(const type_name& type)const  {
-      auto itr = typedefs.find(type);
-      if( itr != typedefs.end() )
-         return resolve_type(itr->second);
-      return type;
+      type_name resolved;
+      FC_ASSERT( try_resolve_type(type, resolved), "Circular reference in type ${type}", ("type",type) );
+      return resolved;
    }
 
-   void abi_serializer::binary_to_variant(const type_name& type, fc::datastream<const char *>& stream,
-                                          fc::mutable_variant_object& obj)const {
-      const auto& st = get_struct(type);
-      if( st.base != type_name() ) {
-         binary_to_variant(resolve_type(st.base), stream, obj);
-      }
-      for( const auto& field : st.fields ) {
-         obj( field.name, binary_to_variant(resolve_type(field.type), stream) );
+   fc::variant abi_serializer::binary_to_variant(const type_plan& plan, fc::datastream<const char *>& stream)const
+   {
+      switch( plan.kind ) {
+         case type_plan::built_in_kind:
+            return plan.unpack(stream, plan.is_array);
+         case type_plan::struct_kind: {
+            fc::mutable_variant_object mvo;
+            mvo.reserve(plan.fields.size());
+            for( const auto& field : plan.fields )
+               mvo.set( field.name, binary_to_variant(type_plans[field.type], stream) );
+            return fc::variant( std::move(mvo) );
+         }
+         case type_plan::array_kind: {
+            const auto& element = type_plans[plan.element];
+            fc::unsigned_int size;
+            fc::raw::unpack( stream, size );
+            fc::variants vars;
+            vars.reserve( std::min<size_t>(size.value, stream.remaining()) );
+            for( uint32_t i = 0; i < size.value; ++i )
+               vars.emplace_back( binary_to_variant(element, stream) );
+            return fc::variant( std::move(vars) );
+         }
+         default:
+            FC_ASSERT( !"unknown type", "Unknown type ${type}", ("type",plan.name) );
       }
    }
 
    fc::variant abi_serializer::binary_to_variant(const type_name& type, fc::datastream<const char *>& stream)const
    {
-      type_name rtype = resolve_type(type);
-      auto btype = built_in_types.find(array_type(rtype) );
-      if( btype != built_in_types.end() ) {
-         return btype->second.first(stream, is_array(rtype));
-      }
-      
-      fc::mutable_variant_object mvo;
-      binary_to_variant(rtype, stream, mvo);
-      return fc::variant( std::move(mvo) );
+      return binary_to_variant(get_type_plan(type), stream);
    }
 
    fc::variant abi_serializer::binary_to_variant(const type_name& type, const bytes& binary)const{
@@ -224,41 +363,51 @@ namespace eosio { namespace types {
       return binary_to_variant(type, ds);
    }
 
-   void abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var, fc::datastream<char *>& ds)const
-   { try {
-      auto rtype = resolve_type(type);
-
-      auto btype = built_in_types.find(array_type(rtype));
-      if( btype != built_in_types.end() ) {
-         btype->second.second(var, ds, is_array(rtype));
-      } else {
-         
-         const auto& st = get_struct(rtype);
-         const auto& vo = var.get_object();
-
-         if( st.base != type_name() ) {
-            variant_to_binary(resolve_type(st.base), var, ds);
-         }
-         for( const auto& field : st.fields ) {
-            if( vo.contains( string(field.name).c_str() ) ) {
-               variant_to_binary(field.type, vo[field.name], ds);
-            }
-            else {
+   void abi_serializer::variant_to_binary(const type_plan& plan, const fc::variant& var, fc::datastream<char *>& ds)const
+   {
+      switch( plan.kind ) {
+         case type_plan::built_in_kind:
+            plan.pack(var, ds, plan.is_array);
+            break;
+         case type_plan::struct_kind: {
+            const auto& vo = var.get_object();
+            for( const auto& field : plan.fields ) {
+               auto itr = vo.find( field.name );
                /// TODO: default construct field and write it out
-               FC_ASSERT( !"missing field in variant object", "Missing '${f}' in variant object", ("f",field.name) );
+               FC_ASSERT( itr != vo.end(), "Missing '${f}' in variant object for ${type}", ("f",field.name)("type",plan.name) );
+               variant_to_binary(type_plans[field.type], itr->value(), ds);
             }
+            break;
+         }
+         case type_plan::array_kind: {
+            const auto& element = type_plans[plan.element];
+            const auto& vars = var.get_array();
+            fc::raw::pack( ds, fc::unsigned_int(vars.size()) );
+            for( const auto& v : vars )
+               variant_to_binary(element, v, ds);
+            break;
          }
+         default:
+            FC_ASSERT( !"unknown type", "Unknown type ${type}", ("type",plan.name) );
       }
+   }
+
+   void abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var, fc::datastream<char *>& ds)const
+   { try {
+      variant_to_binary(get_type_plan(type), var, ds);
    } FC_CAPTURE_AND_RETHROW( (type)(var) ) }
 
    bytes abi_serializer::variant_to_binary(const type_name& type, const fc::variant& var)const {
-      if( !is_type(type) ) {
+      auto itr = type_plan_index.find(type);
+      if( itr == type_plan_index.end() ) {
          return var.as<bytes>();
       }
 
       bytes temp( 1024*1024 );
       fc::datastream<char*> ds(temp.data(), temp.size() );
-      variant_to_binary(type, var, ds);
+      try {
+         variant_to_binary(type_plans[itr->second], var, ds);
+      } FC_CAPTURE_AND_RETHROW( (type)(var) )
       temp.resize(ds.tellp());
       return temp;
    }
@@ -273,5 +422,10 @@ namespace eosio { namespace types {
       if( itr != tables.end() ) return itr->second;
       return type_name();
    }
+   string abi_serializer::get_table_index_type(name table)const {
+      auto itr = table_index_types.find(table);
+      if( itr != table_index_types.end() ) return itr->second;
+      return string();
+   }
 
 } }
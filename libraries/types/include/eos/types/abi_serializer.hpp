@@ -15,9 +15,12 @@ using std::pair;
 /**
  *  Describes the binary representation message and table contents so that it can
  *  be converted to and from JSON.
+ *
+ *  set_abi compiles every type the ABI can name into a type_plan so that conversions
+ *  do not look up type names per field; the maps below must not be modified directly.
  */
 struct abi_serializer {
-   abi_serializer(){ configure_built_in_types(); }
+   abi_serializer(){ configure_built_in_types(); compile_type_plans(); }
    abi_serializer( const abi& abi );
    void set_abi(const abi& abi);
 
@@ -25,9 +28,10 @@ struct abi_serializer {
    map<type_name, struct_t>  structs;
    map<name,type_name>       actions;
    map<name,type_name>       tables;
+   map<name,string>          table_index_types;
 
-   typedef std::function<fc::variant(fc::datastream<const char*>&, bool)>  unpack_function;
-   typedef std::function<void(const fc::variant&, fc::datastream<char*>&, bool)>  pack_function;
+   typedef fc::variant (*unpack_function)(fc::datastream<const char*>&, bool);
+   typedef void        (*pack_function)(const fc::variant&, fc::datastream<char*>&, bool);
    
    map<type_name, pair<unpack_function, pack_function>> built_in_types;
    void configure_built_in_types();
@@ -46,6 +50,7 @@ struct abi_serializer {
 
    type_name get_action_type(name action)const;
    type_name get_table_type(name action)const;
+   string    get_table_index_type(name table)const;
 
    fc::variant binary_to_variant(const type_name& type, const bytes& binary)const;
    bytes       variant_to_binary(const type_name& type, const fc::variant& var)const;
@@ -71,7 +76,40 @@ struct abi_serializer {
    }
 
    private:
-   void binary_to_variant(const type_name& type, fc::datastream<const char*>& stream, fc::mutable_variant_object& obj)const;
+   static constexpr uint32_t npos = uint32_t(-1);
+
+   /**
+    *  A type with its typedefs, array element and base structs already resolved. Fields
+    *  refer to the plan of their type by index into type_plans.
+    */
+   struct type_plan {
+      enum kind_type : uint8_t { unknown_kind, built_in_kind, struct_kind, array_kind };
+
+      struct field_plan {
+         string   name;
+         uint32_t type = npos;
+      };
+
+      kind_type          kind = unknown_kind;
+      type_name          name;
+      bool               is_array = false; ///< built_in_kind only, the value is a vector of the built in type
+      unpack_function    unpack = nullptr;
+      pack_function      pack = nullptr;
+      uint32_t           element = npos;   ///< array_kind only, arrays of built in types are built_in_kind
+      vector<field_plan> fields;           ///< struct_kind only, includes the fields of all base structs
+   };
+
+   vector<type_plan>        type_plans;
+   map<type_name, uint32_t> type_plan_index;
+
+   /// Follows the typedefs from type to the type they name, @return false if they loop
+   bool     try_resolve_type(const type_name& type, type_name& resolved)const;
+   void     compile_type_plans();
+   uint32_t compile_type_plan(const type_name& type);
+   const type_plan& get_type_plan(const type_name& type)const;
+
+   fc::variant binary_to_variant(const type_plan& plan, fc::datastream<const char*>& stream)const;
+   void        variant_to_binary(const type_plan& plan, const fc::variant& var, fc::datastream<char*>& ds)const;
 };
 
 } } // eosio::types
@@ -7,6 +7,7 @@
 #include <eos/chain/exceptions.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/io/json_codec.hpp>
 
 namespace eosio {
 
@@ -23,8 +24,8 @@ void account_history_api_plugin::plugin_initialize(const variables_map&) {}
    [this, api_handle](string, string body, url_response_callback cb) mutable { \
           try { \
              if (body.empty()) body = "{}"; \
-             auto result = api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()); \
-             cb(200, fc::json::to_string(result)); \
+             auto result = api_handle.call_name(fc::json_codec::from_string<api_namespace::call_name ## _params>(body)); \
+             cb(200, fc::json_codec::to_string(result)); \
           } catch (fc::eof_exception& e) { \
              error_results results{400, "Bad Request", e.to_string()}; \
              cb(400, fc::json::to_string(results)); \
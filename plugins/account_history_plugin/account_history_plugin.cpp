@@ -24,6 +24,9 @@
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext.hpp>
 
+#include <deque>
+#include <mutex>
+
 namespace fc { class variant; }
 
 namespace eosio {
@@ -49,23 +52,31 @@ public:
 
    chain_plugin* chain_plug;
    static const int64_t DEFAULT_TRANSACTION_TIME_LIMIT;
+   static const size_t BLOCK_CACHE_SIZE;
    int64_t transactions_time_limit = DEFAULT_TRANSACTION_TIME_LIMIT;
    std::set<account_name> filter_on;
 
 private:
-   struct block_comp
+   /// A copy of where a history object says its transaction is, which can be used outside of the database lock
+   struct transaction_location
    {
-      bool operator()(const block_id_type& a, const block_id_type& b) const
+      transaction_id_type transaction_id;
+      block_id_type       block_id;
+      uint32_t            cycle_index;
+      uint32_t            thread_index;
+      uint32_t            trx_index;
+
+      template<typename HistoryObject>
+      static transaction_location of(const HistoryObject& obj)
       {
-         return chain::block_header::num_from_id(a) > chain::block_header::num_from_id(b);
+         return { obj.transaction_id, obj.block_id, obj.cycle_index, obj.thread_index, obj.trx_index };
       }
    };
-   typedef std::multimap<block_id_type, transaction_id_type, block_comp> block_transaction_id_map;
 
-   optional<block_id_type> find_block_id(const chainbase::database& db, const transaction_id_type& transaction_id) const;
-   processed_transaction find_transaction(const chain::transaction_id_type&  transaction_id, const signed_block& block) const;
+   optional<transaction_location> find_location(const chainbase::database& db, const transaction_id_type& transaction_id) const;
+   processed_transaction fetch_transaction(const transaction_location& location) const;
+   std::shared_ptr<const signed_block> fetch_block(const block_id_type& block_id) const;
    bool is_scope_relevant(const eosio::types::vector<account_name>& scope);
-   get_transactions_results ordered_transactions(const block_transaction_id_map& block_transaction_ids, const fc::time_point& start_time, const uint32_t begin, const uint32_t end) const;
    static void add(chainbase::database& db, const vector<types::key_permission_weight>& keys, const account_name& account_name, const permission_name& permission);
    template<typename MultiIndex, typename LookupType>
    static void remove(chainbase::database& db, const account_name& account_name, const permission_name& permission)
@@ -88,8 +99,13 @@ private:
    static const permission_name OWNER;
    static const permission_name ACTIVE;
    static const permission_name RECOVERY;
+
+   /// the blocks read most recently, most recent first, since a page of transactions often comes from a few blocks
+   mutable std::mutex block_cache_mutex;
+   mutable std::deque<std::shared_ptr<const signed_block>> block_cache;
 };
 const int64_t account_history_plugin_impl::DEFAULT_TRANSACTION_TIME_LIMIT = 3;
+const size_t account_history_plugin_impl::BLOCK_CACHE_SIZE = 16;
 const account_name account_history_plugin_impl::NEW_ACCOUNT = "newaccount";
 const account_name account_history_plugin_impl::UPDATE_AUTH = "updateauth";
 const account_name account_history_plugin_impl::DELETE_AUTH = "deleteauth";
@@ -97,42 +113,69 @@ const permission_name account_history_plugin_impl::OWNER = "owner";
 const permission_name account_history_plugin_impl::ACTIVE = "active";
 const permission_name account_history_plugin_impl::RECOVERY = "recovery";
 
-optional<block_id_type> account_history_plugin_impl::find_block_id(const chainbase::database& db, const transaction_id_type& transaction_id) const
+optional<account_history_plugin_impl::transaction_location> account_history_plugin_impl::find_location(const chainbase::database& db, const transaction_id_type& transaction_id) const
 {
-   optional<block_id_type> block_id;
+   optional<transaction_location> location;
    const auto& trx_idx = db.get_index<transaction_history_multi_index, by_trx_id>();
    auto transaction_history = trx_idx.find( transaction_id );
    if (transaction_history != trx_idx.end())
-      block_id = transaction_history->block_id;
+      location = transaction_location::of(*transaction_history);
 
-   return block_id;
+   return location;
 }
 
-processed_transaction account_history_plugin_impl::find_transaction(const chain::transaction_id_type&  transaction_id, const chain::signed_block& block) const
+std::shared_ptr<const signed_block> account_history_plugin_impl::fetch_block(const block_id_type& block_id) const
 {
-   for (const auto& cycle : block.cycles)
-      for (const auto& thread : cycle)
-         for (const auto& trx : thread.user_input)
-            if (trx.id() == transaction_id)
-               return trx;
-
-   // ERROR in indexing logic
-   FC_THROW("Transaction with ID ${tid} was indexed as being in block ID ${bid}, but was not found in that block", ("tid", transaction_id)("bid", block.id()));
+   {
+      std::lock_guard<std::mutex> lock(block_cache_mutex);
+      auto cached = std::find_if(block_cache.begin(), block_cache.end(), [&block_id](const auto& block) {
+         return block->id() == block_id;
+      });
+      if (cached != block_cache.end())
+      {
+         auto block = *cached;
+         block_cache.erase(cached);
+         block_cache.push_front(block);
+         return block;
+      }
+   }
+
+   optional<signed_block> fetched = chain_plug->chain().fetch_block_by_id(block_id);
+   if (!fetched)
+      return nullptr;
+   auto block = std::make_shared<const signed_block>(std::move(*fetched));
+
+   std::lock_guard<std::mutex> lock(block_cache_mutex);
+   block_cache.push_front(block);
+   if (block_cache.size() > BLOCK_CACHE_SIZE)
+      block_cache.pop_back();
+   return block;
+}
+
+processed_transaction account_history_plugin_impl::fetch_transaction(const transaction_location& location) const
+{
+   auto block = fetch_block(location.block_id);
+   FC_ASSERT(block, "Transaction with ID ${tid} was indexed as being in block ID ${bid}, but no such block was found", ("tid", location.transaction_id)("bid", location.block_id));
+
+   // ERROR in indexing logic if the transaction is not where it was indexed
+   const auto& cycles = block->cycles;
+   FC_ASSERT(location.cycle_index < cycles.size() &&
+             location.thread_index < cycles[location.cycle_index].size() &&
+             location.trx_index < cycles[location.cycle_index][location.thread_index].user_input.size() &&
+             cycles[location.cycle_index][location.thread_index].user_input[location.trx_index].id() == location.transaction_id,
+             "Transaction with ID ${tid} was indexed as being in block ID ${bid}, but was not found in that block", ("tid", location.transaction_id)("bid", location.block_id));
+   return cycles[location.cycle_index][location.thread_index].user_input[location.trx_index];
 }
 
 processed_transaction account_history_plugin_impl::get_transaction(const chain::transaction_id_type&  transaction_id) const
 {
    const auto& db = chain_plug->chain().get_database();
-   optional<block_id_type> block_id;
+   optional<transaction_location> location;
    db.with_read_lock( [&]() {
-      block_id = find_block_id(db, transaction_id);
+      location = find_location(db, transaction_id);
    } );
-   if( block_id.valid() )
-   {
-      auto block = chain_plug->chain().fetch_block_by_id(*block_id);
-      FC_ASSERT(block, "Transaction with ID ${tid} was indexed as being in block ID ${bid}, but no such block was found", ("tid", transaction_id)("bid", block_id));
-      return find_transaction(transaction_id, *block);
-   }
+   if( location.valid() )
+      return fetch_transaction(*location);
 
 #warning TODO: lookup of recent transactions
    FC_THROW_EXCEPTION(chain::unknown_transaction_exception,
@@ -144,112 +187,75 @@ get_transactions_results account_history_plugin_impl::get_transactions(const acc
    fc::time_point start_time = fc::time_point::now();
    const auto& db = chain_plug->chain().get_database();
 
-   block_transaction_id_map block_transaction_ids;
+   // Results are numbered from the account's most recent transaction, which has the highest seq
+   const uint32_t begin = skip_seq ? *skip_seq : 0;
+   vector<transaction_location> locations;
    db.with_read_lock( [&]() {
-      const auto& account_idx = db.get_index<account_transaction_history_multi_index, by_account_name>();
-      auto range = account_idx.equal_range( account_name );
-      for (auto obj = range.first; obj != range.second; ++obj)
-      {
-         optional<block_id_type> block_id = find_block_id(db, obj->transaction_id);
-         FC_ASSERT(block_id, "Transaction with ID ${tid} was tracked for ${account}, but no corresponding block id was found", ("tid", obj->transaction_id)("account", account_name));
-         block_transaction_ids.emplace(std::make_pair(*block_id,  obj->transaction_id));
-      }
+      for (const auto* obj : account_transaction_history_page(db, account_name, skip_seq, num_seq))
+         locations.push_back(transaction_location::of(*obj));
    } );
 
-   uint32_t begin, end;
-   const auto size = block_transaction_ids.size();
-   if (!skip_seq)
-   {
-      begin = 0;
-      end = size;
-   }
-   else
+   get_transactions_results results;
+   results.transactions.reserve(locations.size());
+   for (const auto& location : locations)
    {
-      begin = *skip_seq;
+      const auto pretty_trx = chain_plug->chain().transaction_to_variant(fetch_transaction(location));
+      results.transactions.emplace_back(ordered_transaction_results{uint32_t(begin + results.transactions.size()), location.transaction_id, pretty_trx});
 
-      if (!num_seq)
-         end = size;
-      else
+      // just check after finding each transaction to avoid spending all our time checking
+      if (results.transactions.size() < locations.size() && time_exceeded(start_time))
       {
-         end = begin + *num_seq;
-         if (end > size)
-            end = size;
+         results.time_limit_exceeded_error = true;
+         return results;
       }
-
-      if (begin > size - 1 || begin >= end)
-         return get_transactions_results();
    }
 
-   return ordered_transactions(block_transaction_ids, start_time, begin, end);
+   return results;
 }
 
-get_transactions_results account_history_plugin_impl::ordered_transactions(const block_transaction_id_map& block_transaction_ids, const fc::time_point& start_time, const uint32_t begin, const uint32_t end) const
+uint32_t next_account_transaction_seq(const chainbase::database& db, const account_name& account_name)
 {
-   get_transactions_results results;
-   results.transactions.reserve(end - begin);
-
-   auto block_transaction = block_transaction_ids.cbegin();
+   const auto& seq_idx = db.get_index<account_transaction_history_multi_index, by_account_seq>();
+   auto next = seq_idx.upper_bound( boost::make_tuple( account_name ) );
+   if (next == seq_idx.begin())
+      return 0;
+   --next;
+   return next->name == account_name ? next->seq + 1 : 0;
+}
 
-   uint32_t current = 0;
-   // keep iterating through each equal range
-   while (block_transaction != block_transaction_ids.cend() && !time_exceeded(start_time))
+std::vector<const account_transaction_history_object*> account_transaction_history_page(const chainbase::database& db,
+                                                                                        const account_name& account_name,
+                                                                                        const optional<uint32_t>& skip_seq,
+                                                                                        const optional<uint32_t>& num_seq)
+{
+   const uint32_t size = next_account_transaction_seq(db, account_name);
+   uint32_t begin = 0;
+   uint32_t end = size;
+   if (skip_seq)
    {
-      optional<signed_block> block = chain_plug->chain().fetch_block_by_id(block_transaction->first);
-      FC_ASSERT(block, "Transaction with ID ${tid} was indexed as being in block ID ${bid}, but no such block was found", ("tid", block_transaction->second)("bid", block_transaction->first));
-
-      auto range = block_transaction_ids.equal_range(block_transaction->first);
-
-      std::set<transaction_id_type> trans_ids_for_block;
-      for (block_transaction = range.first; block_transaction != range.second; ++block_transaction)
-      {
-         trans_ids_for_block.insert(block_transaction->second);
-      }
-
-      const uint32_t trx_after_block = current + trans_ids_for_block.size();
-      if (trx_after_block <= begin)
-      {
-         current = trx_after_block;
-         continue;
-      }
-      for (auto cycle = block->cycles.crbegin(); cycle != block->cycles.crend() && current < trx_after_block; ++cycle)
-      {
-         for (auto thread = cycle->crbegin(); thread != cycle->crend() && current < trx_after_block; ++thread)
-         {
-            for (auto trx = thread->user_input.crbegin(); trx != thread->user_input.crend() && current < trx_after_block; ++trx)
-            {
-               if(trans_ids_for_block.count(trx->id()))
-               {
-                  if(++current > begin)
-                  {
-                     const auto pretty_trx = chain_plug->chain().transaction_to_variant(*trx);
-                     results.transactions.emplace_back(ordered_transaction_results{(current - 1), trx->id(), pretty_trx});
-
-                     if(current >= end)
-                     {
-                        return results;
-                     }
-                  }
+      begin = *skip_seq;
+      if (num_seq && *num_seq < size - std::min(begin, size))
+         end = begin + *num_seq;
+   }
 
-                  // just check after finding transaction or transitioning to next block to avoid spending all our time checking
-                  if (time_exceeded(start_time))
-                  {
-                     results.time_limit_exceeded_error = true;
-                     return results;
-                  }
-               }
-            }
-         }
-      }
+   std::vector<const account_transaction_history_object*> page;
+   if (begin >= end)
+      return page;
 
-      // just check after finding transaction or transitioning to next block to avoid spending all our time checking
-      if (time_exceeded(start_time))
-      {
-         results.time_limit_exceeded_error = true;
-         return results;
-      }
+   // result i is the transaction with seq size - 1 - (begin + i)
+   const auto& seq_idx = db.get_index<account_transaction_history_multi_index, by_account_seq>();
+   auto obj = seq_idx.find( boost::make_tuple( account_name, size - 1 - begin ) );
+   page.reserve(end - begin);
+   while (true)
+   {
+      FC_ASSERT(obj != seq_idx.end() && obj->name == account_name && obj->seq == size - 1 - begin - page.size(),
+                "Transaction history of ${account} is missing seq ${seq}", ("account", account_name)("seq", size - 1 - begin - page.size()));
+      page.push_back(&*obj);
+      if (page.size() == end - begin)
+         break;
+      --obj;
    }
-
-   return results;
+   return page;
 }
 
 bool account_history_plugin_impl::time_exceeded(const fc::time_point& start_time) const
@@ -292,25 +298,37 @@ void account_history_plugin_impl::applied_block(const signed_block& block)
    const auto block_id = block.id();
    auto& db = chain_plug->chain().get_mutable_database();
    const bool check_relevance = filter_on.size();
-   for (const auto& cycle : block.cycles)
+   for (uint32_t cycle_index = 0; cycle_index < block.cycles.size(); ++cycle_index)
    {
-      for (const auto& thread : cycle)
+      const auto& cycle = block.cycles[cycle_index];
+      for (uint32_t thread_index = 0; thread_index < cycle.size(); ++thread_index)
       {
-         for (const auto& trx : thread.user_input)
+         const auto& thread = cycle[thread_index];
+         for (uint32_t trx_index = 0; trx_index < thread.user_input.size(); ++trx_index)
          {
+            const auto& trx = thread.user_input[trx_index];
             if (check_relevance && !is_scope_relevant(trx.scope))
                continue;
 
-            db.create<transaction_history_object>([&block_id,&trx](transaction_history_object& transaction_history) {
-               transaction_history.block_id = block_id;
-               transaction_history.transaction_id = trx.id();
+            const auto trx_id = trx.id();
+            auto set_location = [&](auto& history) {
+               history.transaction_id = trx_id;
+               history.block_id = block_id;
+               history.cycle_index = cycle_index;
+               history.thread_index = thread_index;
+               history.trx_index = trx_index;
+            };
+            db.create<transaction_history_object>([&set_location](transaction_history_object& transaction_history) {
+               set_location(transaction_history);
             });
 
             for (const auto& account_name : trx.scope)
             {
-               db.create<account_transaction_history_object>([&trx,&account_name](account_transaction_history_object& account_transaction_history) {
+               const auto seq = next_account_transaction_seq(db, account_name);
+               db.create<account_transaction_history_object>([&set_location,&account_name,seq](account_transaction_history_object& account_transaction_history) {
                   account_transaction_history.name = account_name;
-                  account_transaction_history.transaction_id = trx.id();
+                  account_transaction_history.seq = seq;
+                  set_location(account_transaction_history);
                });
             }
 
@@ -21,6 +21,7 @@ namespace std {
 
 namespace eosio {
 using chain::account_name;
+using chain::block_id_type;
 using chain::shared_vector;
 using chain::transaction_id_type;
 using namespace boost::multi_index;
@@ -30,17 +31,29 @@ class account_transaction_history_object : public chainbase::object<chain::accou
 
    id_type                            id;
    account_name                       name;
+   /// the number of transactions of the account before this one, so the transactions of an account can be paged
+   uint32_t                           seq = 0;
    transaction_id_type                transaction_id;
+   /// where the transaction is in the block, so it can be read without searching the block for it
+   block_id_type                      block_id;
+   uint32_t                           cycle_index = 0;
+   uint32_t                           thread_index = 0;
+   uint32_t                           trx_index = 0;
 };
 
 struct by_id;
-struct by_account_name;
+struct by_account_seq;
 struct by_account_name_trx_id;
 using account_transaction_history_multi_index = chainbase::shared_multi_index_container<
    account_transaction_history_object,
    indexed_by<
       ordered_unique<tag<by_id>, BOOST_MULTI_INDEX_MEMBER(account_transaction_history_object, account_transaction_history_object::id_type, id)>,
-      hashed_non_unique<tag<by_account_name>, BOOST_MULTI_INDEX_MEMBER(account_transaction_history_object, account_name, name), std::hash<account_name>>,
+      ordered_unique<tag<by_account_seq>,
+         composite_key< account_transaction_history_object,
+            member<account_transaction_history_object, account_name, &account_transaction_history_object::name>,
+            member<account_transaction_history_object, uint32_t, &account_transaction_history_object::seq>
+         >
+      >,
       hashed_unique<tag<by_account_name_trx_id>,
          composite_key< account_transaction_history_object,
             member<account_transaction_history_object, account_name, &account_transaction_history_object::name>,
@@ -53,9 +66,24 @@ using account_transaction_history_multi_index = chainbase::shared_multi_index_co
 
 typedef chainbase::generic_index<account_transaction_history_multi_index> account_transaction_history_index;
 
+/// The number of transactions recorded for the account, which is the seq its next transaction is given
+uint32_t next_account_transaction_seq(const chainbase::database& db, const account_name& account_name);
+
+/**
+ *  The page of the account's transaction history which get_transactions returns, newest first.  The page skips
+ *  the skip_seq most recent transactions and holds at most num_seq of them; num_seq is only used with skip_seq.
+ *  A skip_seq at or past the account's oldest transaction gives an empty page.
+ *
+ *  The objects are only valid while the caller holds the database lock.
+ */
+std::vector<const account_transaction_history_object*> account_transaction_history_page(const chainbase::database& db,
+                                                                                        const account_name& account_name,
+                                                                                        const fc::optional<uint32_t>& skip_seq,
+                                                                                        const fc::optional<uint32_t>& num_seq);
+
 }
 
 CHAINBASE_SET_INDEX_TYPE( eosio::account_transaction_history_object, eosio::account_transaction_history_multi_index )
 
-FC_REFLECT( eosio::account_transaction_history_object, (name)(transaction_id) )
+FC_REFLECT( eosio::account_transaction_history_object, (name)(seq)(transaction_id)(block_id)(cycle_index)(thread_index)(trx_index) )
 
@@ -17,6 +17,10 @@ class transaction_history_object : public chainbase::object<chain::transaction_h
    id_type             id;
    block_id_type       block_id;
    transaction_id_type transaction_id;
+   /// where the transaction is in the block, so it can be read without searching the block for it
+   uint32_t            cycle_index = 0;
+   uint32_t            thread_index = 0;
+   uint32_t            trx_index = 0;
 };
 
 struct by_id;
@@ -35,5 +39,5 @@ typedef chainbase::generic_index<transaction_history_multi_index> transaction_hi
 
 CHAINBASE_SET_INDEX_TYPE( eosio::transaction_history_object, eosio::transaction_history_multi_index )
 
-FC_REFLECT( eosio::transaction_history_object, (block_id)(transaction_id) )
+FC_REFLECT( eosio::transaction_history_object, (block_id)(transaction_id)(cycle_index)(thread_index)(trx_index) )
 
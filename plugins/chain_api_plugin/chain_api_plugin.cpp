@@ -6,6 +6,9 @@
 #include <eos/chain/exceptions.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/io/json_codec.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/io/raw_variant.hpp>
 
 namespace eosio {
 
@@ -26,13 +29,26 @@ chain_api_plugin::~chain_api_plugin(){}
 void chain_api_plugin::set_program_options(options_description&, options_description&) {}
 void chain_api_plugin::plugin_initialize(const variables_map&) {}
 
-#define CALL(api_name, api_handle, api_namespace, call_name, http_response_code) \
+namespace {
+   /// encodes a successful result in the format the client negotiated
+   template<typename T>
+   string format_result(const T& result, response_format format) {
+      if (format == response_format::binary) {
+         auto packed = fc::raw::pack(result);
+         return string(packed.begin(), packed.end());
+      }
+      return fc::json_codec::to_string(result);
+   }
+}
+
+#define CALL(api_name, api_handle, api_namespace, call_name, http_response_code, INVOKE) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [this, api_handle](string, string body, url_response_callback cb) mutable { \
+   [this, api_handle](string, string body, response_format format, url_response_callback cb) mutable { \
           try { \
              if (body.empty()) body = "{}"; \
-             auto result = api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()); \
-             cb(http_response_code, fc::json::to_string(result)); \
+             auto params = fc::json_codec::from_string<api_namespace::call_name ## _params>(body); \
+             auto result = INVOKE(api_handle.call_name(params)); \
+             cb(http_response_code, format_result(result, format)); \
           } catch (chain::tx_missing_sigs& e) { \
              error_results results{401, "UnAuthorized", e.to_string()}; \
              cb(401, fc::json::to_string(results)); \
@@ -53,8 +69,12 @@ void chain_api_plugin::plugin_initialize(const variables_map&) {}
           } \
        }}
 
-#define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
-#define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
+/// read only calls run on the http threads, concurrently with each other, under the database read lock
+#define INVOKE_WITH_READ_LOCK(expr) my->db.get_database().with_read_lock([&]() { return expr; })
+#define INVOKE_DIRECT(expr) expr
+
+#define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code, INVOKE_WITH_READ_LOCK)
+#define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code, INVOKE_DIRECT)
 
 void chain_api_plugin::plugin_startup() {
    ilog( "starting chain_api_plugin" );
@@ -62,19 +82,25 @@ void chain_api_plugin::plugin_startup() {
    auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
    auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
 
-   app().get_plugin<http_plugin>().add_api({
+   auto& http = app().get_plugin<http_plugin>();
+   http.add_negotiated_api({
       CHAIN_RO_CALL(get_info, 200),
       CHAIN_RO_CALL(get_block, 200),
+      CHAIN_RO_CALL(get_transaction_proof, 200),
       CHAIN_RO_CALL(get_account, 200),
       CHAIN_RO_CALL(get_code, 200),
       CHAIN_RO_CALL(get_table_rows, 200),
       CHAIN_RO_CALL(abi_json_to_bin, 200),
       CHAIN_RO_CALL(abi_bin_to_json, 200),
-      CHAIN_RO_CALL(get_required_keys, 200),
+      CHAIN_RO_CALL(get_required_keys, 200)
+   }, true);
+   // calls which modify the chain state are dispatched to the application thread
+   http.add_negotiated_api({
       CHAIN_RW_CALL(push_block, 202),
       CHAIN_RW_CALL(push_transaction, 202),
-      CHAIN_RW_CALL(push_transactions, 202)
-   });
+      CHAIN_RW_CALL(push_transactions, 202),
+      CHAIN_RW_CALL(push_transaction_batch, 202)
+   }, false);
 }
 
 void chain_api_plugin::plugin_shutdown() {}
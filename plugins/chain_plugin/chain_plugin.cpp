@@ -24,6 +24,9 @@
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
 
+#include <future>
+#include <thread>
+
 namespace eosio {
 
 using namespace eosio;
@@ -45,6 +48,9 @@ using txn_msg_rate_limits = chain_controller::txn_msg_rate_limits;
 class chain_plugin_impl {
 public:
    bfs::path                        block_log_dir;
+   uint32_t                         block_log_sync_blocks = config::default_block_log_sync_blocks;
+   fc::microseconds                 block_log_sync_interval = fc::milliseconds(config::default_block_log_sync_interval_ms);
+   bool                             block_log_compress = false;
    bfs::path                        genesis_file;
    chain::time                      genesis_timestamp;
    uint32_t                         skip_flags = chain_controller::skip_nothing;
@@ -59,6 +65,14 @@ public:
    uint32_t                         txn_execution_time;
    uint32_t                         create_block_txn_execution_time;
    txn_msg_rate_limits              rate_limits;
+   chain::transaction_pool::limits  pending_limits;
+   /// the plugin irreversible blocks are written to, when there is one
+   db_plugin*                       external_db = nullptr;
+
+   uint32_t                                          validation_threads = 0;
+   boost::asio::io_service                           validation_ios;
+   unique_ptr<boost::asio::io_service::work>         validation_work;
+   vector<std::thread>                               validation_thread_pool;
 };
 
 #ifdef NDEBUG
@@ -85,6 +99,12 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("genesis-timestamp", bpo::value<string>(), "override the initial timestamp in the Genesis State file")
          ("block-log-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the block log (absolute path or relative to application data dir)")
+         ("block-log-sync-blocks", bpo::value<uint32_t>()->default_value(config::default_block_log_sync_blocks),
+          "Sync the block log to disk after this many irreversible blocks have been written to it.")
+         ("block-log-sync-interval-ms", bpo::value<uint32_t>()->default_value(config::default_block_log_sync_interval_ms),
+          "Sync the block log to disk at least this often (in milliseconds) while blocks are being written to it.")
+         ("block-log-compress", bpo::bool_switch()->default_value(false),
+          "Compress each block in a new block log. An existing block log keeps its format.")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
          ("rcvd-block-trans-execution-time", bpo::value<uint32_t>()->default_value(default_received_block_transaction_execution_time),
           "Limits the maximum time (in milliseconds) that is allowed a transaction's code to execute from a received block.")
@@ -100,6 +120,12 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
            "The time frame, in seconds, that the per-code-account-transaction-msg-rate-limit is imposed over.")
           ("per-code-account-transaction-msg-rate-limit", bpo::value<uint32_t>()->default_value(config::default_per_code_account),
            "Limits the maximum rate of transaction messages that an account's code is allowed each per-code-account-transaction-msg-rate-limit-time-frame-sec.")
+         ("pending-pool-max-mb", bpo::value<uint64_t>()->default_value(config::default_pending_pool_max_bytes / (1024*1024)),
+          "Limits the memory (in MB) held by pending transactions. When full, a new transaction is rejected unless it has a higher priority than one already pending.")
+         ("pending-pool-account-max-kb", bpo::value<uint64_t>()->default_value(config::default_pending_pool_account_max_bytes / 1024),
+          "Limits the memory (in KB) held by the pending transactions of any one account.")
+         ("validation-threads", bpo::value<uint32_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+          "Number of worker threads used to decode transactions and recover their signing keys outside of the chain lock.")
          ;
    cli.add_options()
          ("replay-blockchain", bpo::bool_switch()->default_value(false),
@@ -139,6 +165,9 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       else
          my->block_log_dir = bld;
    }
+   my->block_log_sync_blocks = options.at("block-log-sync-blocks").as<uint32_t>();
+   my->block_log_sync_interval = fc::milliseconds(options.at("block-log-sync-interval-ms").as<uint32_t>());
+   my->block_log_compress = options.at("block-log-compress").as<bool>();
 
    if (options.at("replay-blockchain").as<bool>()) {
       ilog("Replay requested: wiping database");
@@ -190,6 +219,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
    my->rate_limits.per_code_account_time_frame_sec = fc::time_point_sec(options.at("per-code-account-transaction-msg-rate-limit-time-frame-sec").as<uint32_t>());
    my->rate_limits.per_code_account = options.at("per-code-account-transaction-msg-rate-limit").as<uint32_t>();
+
+   my->pending_limits.max_bytes = options.at("pending-pool-max-mb").as<uint64_t>() * 1024 * 1024;
+   my->pending_limits.max_account_bytes = options.at("pending-pool-account-max-kb").as<uint64_t>() * 1024;
+
+   my->validation_threads = options.at("validation-threads").as<uint32_t>();
+   FC_ASSERT( my->validation_threads > 0, "validation-threads must be greater than 0" );
 }
 
 void chain_plugin::plugin_startup() 
@@ -200,6 +235,7 @@ void chain_plugin::plugin_startup()
       if (plugin->get_state() != registered) {
          ilog("Blockchain configured with external database.");
          applied_func = [plugin](const chain::signed_block& b) { plugin->applied_irreversible_block(b); };
+         my->external_db = plugin;
       }
    }
 
@@ -215,7 +251,8 @@ void chain_plugin::plugin_startup()
    native_contract::native_contract_chain_initializer initializer(genesis);
 
    my->fork_db = fork_database();
-   my->block_logger = block_log(my->block_log_dir);
+   my->block_logger = block_log(my->block_log_dir, my->block_log_sync_blocks, my->block_log_sync_interval,
+                                    my->block_log_compress);
    my->chain_id = genesis.compute_chain_id();
    my->chain = chain_controller(db, *my->fork_db, *my->block_logger,
                                 initializer, native_contract::make_administrator(),
@@ -224,6 +261,7 @@ void chain_plugin::plugin_startup()
                                 my->create_block_txn_execution_time,
                                 my->rate_limits,
                                 applied_func);
+   my->chain->set_pending_limits(my->pending_limits);
 
    if(!my->readonly) {
       ilog("starting chain in read/write mode");
@@ -233,13 +271,22 @@ void chain_plugin::plugin_startup()
    ilog("Blockchain started; head block is #${num}, genesis timestamp is ${ts}",
         ("num", my->chain->head_block_num())("ts", genesis.initial_timestamp.to_iso_string()));
 
+   my->validation_work.reset(new boost::asio::io_service::work(my->validation_ios));
+   for (uint32_t i = 0; i < my->validation_threads; ++i)
+      my->validation_thread_pool.emplace_back([this]() { my->validation_ios.run(); });
+
 } FC_CAPTURE_AND_RETHROW( (my->genesis_file.generic_string()) ) }
 
 void chain_plugin::plugin_shutdown() {
+   my->validation_work.reset();
+   my->validation_ios.stop();
+   for (auto& t : my->validation_thread_pool)
+      t.join();
+   my->validation_thread_pool.clear();
 }
 
 chain_apis::read_write chain_plugin::get_read_write_api() {
-   return chain_apis::read_write(chain(), my->skip_flags);
+   return chain_apis::read_write(chain(), my->skip_flags, my->validation_ios, my->validation_threads);
 }
 
 bool chain_plugin::accept_block(const chain::signed_block& block, bool currently_syncing) {
@@ -250,9 +297,26 @@ bool chain_plugin::accept_block(const chain::signed_block& block, bool currently
            ("p", block.producer));
    }
 
+   // wait for the external database here, where no chain lock is held, so API calls are not held up by it
+   if (my->external_db)
+      my->external_db->wait_for_queue_space();
    return chain().push_block(block, my->skip_flags);
 }
 
+bool chain_plugin::accept_block(const chain::signed_block& block, bool currently_syncing,
+                                const chain::chain_controller::block_precomputed& precomputed) {
+   if (currently_syncing && block.block_num() % 10000 == 0) {
+      ilog("Syncing Blockchain --- Got block: #${n} time: ${t} producer: ${p}",
+           ("t", block.timestamp)
+           ("n", block.block_num())
+           ("p", block.producer));
+   }
+
+   if (my->external_db)
+      my->external_db->wait_for_queue_space();
+   return chain().push_block(block, my->skip_flags, precomputed);
+}
+
 void chain_plugin::accept_transaction(const chain::signed_transaction& trx) {
    chain().push_transaction(trx, my->skip_flags);
 }
@@ -294,30 +358,21 @@ read_only::get_info_results read_only::get_info(const read_only::get_info_params
       db.head_block_time(),
       db.head_block_producer(),
       std::bitset<64>(db.get_dynamic_global_properties().recent_slots_filled).to_string(),
-      __builtin_popcountll(db.get_dynamic_global_properties().recent_slots_filled) / 64.0
+      __builtin_popcountll(db.get_dynamic_global_properties().recent_slots_filled) / 64.0,
+      db.get_dynamic_global_properties().block_id_merkle.get_root()
    };
 }
 
-types::abi getAbi( const chain_controller& db, const name& account ) {
-   const auto& d = db.get_database();
-   const auto& code_accnt  = d.get<account_object,by_name>( account );
-
-   eosio::types::abi abi;
-   types::abi_serializer::to_abi(code_accnt.abi, abi);
-   return abi;
-}
-
-string getTableType( const types::abi& abi, const name& tablename ) {
-   for( const auto& t : abi.tables ) {
-      if( t.table_name == tablename ){
-         return t.index_type;
-      }
-   }
-   FC_ASSERT( !"ABI does not define table", "Table ${table} not specified in ABI", ("table",tablename) );
+string getTableType( const types::abi_serializer& abis, const name& tablename ) {
+   auto table_type = abis.get_table_index_type( tablename );
+   FC_ASSERT( table_type.size(), "Table ${table} not specified in ABI", ("table",tablename) );
+   return table_type;
 }
 
 read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const types::abi abi = getAbi( db, p.code );
+   const auto abis = db.get_abi_serializer( p.code );
+   FC_ASSERT( abis, "No ABI set for ${code}", ("code",p.code) );
+   const types::abi_serializer& abi = *abis;
    auto table_type = getTableType( abi, p.table );
    auto table_key = PRIMARY;
 
@@ -338,7 +393,7 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       if( table_key == TERTIARY )
          return get_table_rows_ex<chain::key64x64x64_value_index, chain::by_scope_tertiary>(p,abi);
    }
-   FC_ASSERT( false, "invalid table type/key ${type}/${key}", ("type",table_type)("key",table_key)("code_abi",abi));
+   FC_ASSERT( false, "invalid table type/key ${type}/${key}", ("type",table_type)("key",table_key)("code",p.code));
 }
 
 read_only::get_block_results read_only::get_block(const read_only::get_block_params& params) const {
@@ -355,6 +410,25 @@ read_only::get_block_results read_only::get_block(const read_only::get_block_par
                       "Could not find block: ${block}", ("block", params.block_num_or_id));
 }
 
+read_only::get_transaction_proof_results read_only::get_transaction_proof(const read_only::get_transaction_proof_params& params) const {
+   const auto block = get_block(get_block_params{params.block_num_or_id});
+
+   // the leaves are the transaction ids, in the order the block stores them
+   const auto leaves = block.merkle_leaves();
+   auto leaf = std::find(leaves.begin(), leaves.end(), params.transaction_id);
+   FC_ASSERT(leaf != leaves.end(), "Transaction ${id} is not in block ${block}",
+             ("id", params.transaction_id)("block", params.block_num_or_id));
+
+   get_transaction_proof_results result;
+   result.block_id = block.id;
+   result.block_num = block.block_num;
+   result.transaction_merkle_root = block.transaction_merkle_root;
+   result.leaf_index = leaf - leaves.begin();
+   result.leaf_count = leaves.size();
+   result.proof = chain::merkle_proof(leaves, result.leaf_index);
+   return result;
+}
+
 read_write::push_block_results read_write::push_block(const read_write::push_block_params& params) {
    db.push_block(params, chain_controller::validation_steps::skip_nothing);
    return read_write::push_block_results();
@@ -368,18 +442,95 @@ read_write::push_transaction_results read_write::push_transaction(const read_wri
 }
 
 read_write::push_transactions_results read_write::push_transactions(const read_write::push_transactions_params& params) {
-   FC_ASSERT( params.size() <= 1000, "Attempt to push too many transactions at once" );
+   return push_transaction_batch(push_transaction_batch_params{params, false});
+}
+
+template<typename F>
+void read_write::parallel_for(size_t n, F&& f)const {
+   const size_t chunks = std::min<size_t>(validation_threads, n);
+   vector<std::future<void>> done;
+   done.reserve(chunks);
+   for (size_t c = 0; c < chunks; ++c) {
+      auto task = std::make_shared<std::packaged_task<void()>>([&f, c, chunks, n]() {
+         for (size_t i = c; i < n; i += chunks)
+            f(i);
+      });
+      done.emplace_back(task->get_future());
+      validation_ios.post([task]() { (*task)(); });
+   }
+   for (auto& d : done)
+      d.get();
+}
+
+read_write::push_transaction_batch_results read_write::push_transaction_batch(const read_write::push_transaction_batch_params& params) {
+   const auto& items = params.transactions;
+   FC_ASSERT( items.size() <= 1000, "Attempt to push too many transactions at once" );
 
-   push_transactions_results result;
-   result.reserve(params.size());
-   for( const auto& item : params ) {
+   const auto& database = db.get_database();
+   const bool recover_keys = !(skip_flags & chain_controller::skip_transaction_signatures);
+   const size_t n = items.size();
+
+   vector<chain::signed_transaction>     decoded(n);
+   vector<flat_set<public_key_type>>     keys(recover_keys ? n : 0);
+   vector<chain::transaction_id_type>    ids(n);
+   vector<optional<string>>              errors(n);
+
+   // ABI decoding, hashing and signature recovery do not need the write lock
+   parallel_for(n, [&](size_t i) {
       try {
-        result.emplace_back( push_transaction( item ) ); 
-      } catch ( const fc::exception& e ) {
-        result.emplace_back( read_write::push_transaction_results{ chain::transaction_id_type(), 
-                          fc::mutable_variant_object( "error", e.to_detail_string() ) } );
+         decoded[i] = database.with_read_lock([&]() {
+            return chain::signed_transaction(db.transaction_from_variant(items[i]));
+         });
+         ids[i] = decoded[i].id();
+
+         if (recover_keys)
+            keys[i] = chain_controller::recover_signature_keys(decoded[i]);
+      } catch (const fc::exception& e) {
+         errors[i] = e.to_detail_string();
       }
+   });
+
+   vector<chain::signed_transaction>  to_push;
+   vector<flat_set<public_key_type>>  to_push_keys;
+   vector<size_t>                     to_push_index;
+   to_push.reserve(n);
+   to_push_index.reserve(n);
+   for (size_t i = 0; i < n; ++i) {
+      if (errors[i])
+         continue;
+      to_push.emplace_back(std::move(decoded[i]));
+      if (recover_keys)
+         to_push_keys.emplace_back(std::move(keys[i]));
+      to_push_index.push_back(i);
    }
+
+   auto pushed = db.push_transactions(to_push, to_push_keys, skip_flags);
+
+   vector<optional<chain::processed_transaction>> processed(n);
+   for (size_t p = 0; p < pushed.size(); ++p) {
+      auto i = to_push_index[p];
+      if (pushed[p].error)
+         errors[i] = pushed[p].error->to_detail_string();
+      else
+         processed[i] = std::move(pushed[p].processed);
+   }
+
+   push_transaction_batch_results result(n);
+   parallel_for(n, [&](size_t i) {
+      if (errors[i]) {
+         result[i] = push_transaction_results{ chain::transaction_id_type(),
+                                               fc::mutable_variant_object( "error", *errors[i] ) };
+         return;
+      }
+      result[i].transaction_id = ids[i];
+      if (!params.ids_only) {
+         try {
+            result[i].processed = database.with_read_lock([&]() { return db.transaction_to_variant(*processed[i]); });
+         } catch (const fc::exception& e) {
+            result[i].processed = fc::mutable_variant_object( "error", e.to_detail_string() );
+         }
+      }
+   });
    return result;
 }
 
@@ -12,6 +12,7 @@
 #include <eos/database_plugin/database_plugin.hpp>
 
 #include <boost/container/flat_set.hpp>
+#include <boost/asio/io_service.hpp>
 
 namespace fc { class variant; }
 
@@ -60,6 +61,7 @@ public:
       types::account_name   head_block_producer;
       string                recent_slots;
       double                participation_rate = 0;
+      chain::digest_type    block_id_merkle_root; ///< merkle root of the ids of all blocks up to the head block
    };
    get_info_results get_info(const get_info_params&) const;
 
@@ -155,6 +157,26 @@ public:
 
    get_block_results get_block(const get_block_params& params) const;
 
+   struct get_transaction_proof_params {
+      string                     block_num_or_id;
+      chain::transaction_id_type transaction_id;
+   };
+
+   /**
+    * Proves that a transaction is in a block: hashing transaction_id up through proof from position leaf_index gives
+    * the merkle root whose checksum is the transaction_merkle_root of the block header.
+    */
+   struct get_transaction_proof_results {
+      chain::block_id_type       block_id;
+      uint32_t                   block_num = 0;
+      chain::checksum_type       transaction_merkle_root;
+      uint32_t                   leaf_index = 0;
+      uint32_t                   leaf_count = 0;
+      vector<chain::digest_type> proof;
+   };
+
+   get_transaction_proof_results get_transaction_proof(const get_transaction_proof_params& params) const;
+
    struct get_table_rows_params {
       bool        json = false;
       name        scope;
@@ -204,13 +226,10 @@ public:
    }
  
    template <typename IndexType, typename Scope>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const types::abi& abi )const {
+   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const types::abi_serializer& abis )const {
       read_only::get_table_rows_result result;
       const auto& d = db.get_database();
    
-      types::abi_serializer abis;
-      abis.set_abi(abi);
-   
       const auto& idx = d.get_index<IndexType, Scope>();
       auto lower = idx.lower_bound( boost::make_tuple(p.scope, p.code, p.table   ) );
       auto upper = idx.upper_bound( boost::make_tuple(p.scope, p.code, name(uint64_t(p.table)+1) ) );
@@ -246,8 +265,15 @@ public:
 class read_write {
    chain_controller& db;
    uint32_t skip_flags;
+   boost::asio::io_service& validation_ios;
+   uint32_t validation_threads;
+
+   /// calls f(i) for every i in [0,n) on the validation threads and waits for all of them to finish
+   template<typename F>
+   void parallel_for(size_t n, F&& f)const;
 public:
-   read_write(chain_controller& db, uint32_t skip_flags) : db(db), skip_flags(skip_flags) {}
+   read_write(chain_controller& db, uint32_t skip_flags, boost::asio::io_service& validation_ios, uint32_t validation_threads)
+      : db(db), skip_flags(skip_flags), validation_ios(validation_ios), validation_threads(validation_threads) {}
 
    using push_block_params = chain::signed_block;
    using push_block_results = empty;
@@ -264,6 +290,18 @@ public:
    using push_transactions_params  = vector<push_transaction_params>;
    using push_transactions_results = vector<push_transaction_results>;
    push_transactions_results push_transactions(const push_transactions_params& params);
+
+   /**
+    *  Transactions are decoded, hashed and have their signing keys recovered in parallel outside of the
+    *  chain lock, then all of them are pushed while holding the write lock once.  When ids_only is set the
+    *  processed transactions are not converted back to JSON.
+    */
+   struct push_transaction_batch_params {
+      vector<push_transaction_params> transactions;
+      bool                            ids_only = false;
+   };
+   using push_transaction_batch_results = vector<push_transaction_results>;
+   push_transaction_batch_results push_transaction_batch(const push_transaction_batch_params& params);
 };
 } // namespace chain_apis
 
@@ -284,6 +322,9 @@ public:
    chain_apis::read_write get_read_write_api();
 
    bool accept_block(const chain::signed_block& block, bool currently_syncing);
+   /// accept a block whose context free checks were made ahead of time with chain_controller::precompute_block
+   bool accept_block(const chain::signed_block& block, bool currently_syncing,
+                     const chain::chain_controller::block_precomputed& precomputed);
    void accept_transaction(const chain::signed_transaction& trx);
 
    bool block_is_on_preferred_chain(const chain::block_id_type& block_id);
@@ -312,11 +353,15 @@ FC_REFLECT( eosio::chain_apis::permission, (perm_name)(parent)(required_auth) )
 FC_REFLECT(eosio::chain_apis::empty, )
 FC_REFLECT(eosio::chain_apis::read_only::get_info_results,
   (head_block_num)(last_irreversible_block_num)(head_block_id)(head_block_time)(head_block_producer)
-  (recent_slots)(participation_rate))
+  (recent_slots)(participation_rate)(block_id_merkle_root))
 FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id))
   
 FC_REFLECT_DERIVED( eosio::chain_apis::read_only::get_block_results, (eosio::chain::signed_block), (id)(block_num)(refBlockPrefix) );
+FC_REFLECT( eosio::chain_apis::read_only::get_transaction_proof_params, (block_num_or_id)(transaction_id) )
+FC_REFLECT( eosio::chain_apis::read_only::get_transaction_proof_results,
+            (block_id)(block_num)(transaction_merkle_root)(leaf_index)(leaf_count)(proof) )
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
+FC_REFLECT( eosio::chain_apis::read_write::push_transaction_batch_params, (transactions)(ids_only) )
   
 FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(table_key)(scope)(code)(table)(lower_bound)(upper_bound)(limit) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more) );
@@ -16,7 +16,9 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
-#include <queue>
+#include <deque>
+#include <map>
+#include <set>
 
 #ifdef MONGODB
 #include <bsoncxx/builder/basic/kvp.hpp>
@@ -24,6 +26,7 @@
 #include <bsoncxx/builder/stream/document.hpp>
 #include <bsoncxx/json.hpp>
 
+#include <mongocxx/bulk_write.hpp>
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
 #endif
@@ -54,11 +57,12 @@ public:
    ~db_plugin_impl();
 
    void applied_irreversible_block(const signed_block&);
-   void process_irreversible_block(const signed_block&);
-   void _process_irreversible_block(const signed_block&);
+   void wait_for_queue_space();
 
    void init();
    void wipe_database();
+   void start();
+   db_plugin::queue_status get_queue_status();
 
    std::set<account_name> filter_on;
    static types::abi eos_abi; // cached for common use
@@ -71,19 +75,79 @@ public:
    mongocxx::client mongo_conn;
    mongocxx::collection accounts;
 
-   size_t queue_size = 0;
+   size_t queue_size = 256;
+   size_t batch_size = 1000;
+   uint32_t conversion_threads = 2;
    size_t processed = 0;
-   std::queue<signed_block> queue;
-   boost::mutex mtx;
-   boost::condition_variable condtion;
-   boost::thread consum_thread;
-   boost::atomic<bool> done{false};
    boost::atomic<bool> startup{true};
 
-   void consum_blocks();
+   /// The documents for a block and its relevant transactions and messages
+   struct converted_block {
+      fc::optional<bsoncxx::document::value>  block_doc;
+      std::vector<bsoncxx::document::value>   trans_docs;
+      std::vector<bsoncxx::document::value>   msgs_docs;
+   };
+
+   /// A block on its way to MongoDB; converted on any of the conversion threads, then written in order
+   struct block_job {
+      signed_block     block;
+      converted_block  docs;
+      bool             converted = false;
+      bool             failed = false;
+   };
+
+   /**
+    * Blocks are converted to BSON on several threads and written by one, in the order they became irreversible.
+    * Every block not yet written is in jobs, which is bounded by queue_size; the ones not yet being converted
+    * are also in to_convert.
+    */
+   std::deque<std::shared_ptr<block_job>> jobs;
+   std::deque<std::shared_ptr<block_job>> to_convert;
+   boost::mutex mtx;
+   boost::condition_variable convert_condition;   ///< a block was queued, or shutting down
+   boost::condition_variable converted_condition; ///< a block was converted, or shutting down
+   boost::condition_variable written_condition;   ///< blocks were written, making room in the queue
+   std::vector<boost::thread> convert_threads;
+   boost::thread write_thread;
+   bool done{false};
+
+   /// the backpressure on the chain, see db_plugin::queue_status
+   size_t max_queued = 0;
+   uint64_t blocks_written = 0;
+   uint32_t queue_full_waits = 0;
+   fc::microseconds queue_full_wait_time;
+   static const fc::microseconds queue_status_interval; ///< how often the writer logs the queue status
+
+   db_plugin::queue_status current_queue_status() const; ///< requires mtx to be held
+   void wait_for_queue_space(boost::mutex::scoped_lock& lock); ///< requires mtx to be held by lock
+   void convert_blocks();
+   void write_blocks();
+   void stop_on_failure();
+   converted_block convert_block(const signed_block& block);
+   void write_batch(const std::vector<std::shared_ptr<block_job>>& batch);
+   void verify_start(const signed_block& block);
+
+   /// Where a message is in the chain: the block number and the number of messages before it in the block
+   using message_position = std::pair<uint32_t, uint32_t>;
+   using abi_serializer_ptr = std::shared_ptr<const types::abi_serializer>;
+
+   /**
+    * The ABI of each contract, by the position of the setcode message which set it. Blocks are converted out of
+    * order, so the ABI a message is decoded with is the last one set before the message.
+    */
+   std::map<account_name, std::map<message_position, abi_serializer_ptr>> abis;
+   std::set<account_name> abis_to_prune; ///< the accounts with more than one ABI in abis
+   abi_serializer_ptr eos_abi_serializer;
+   boost::mutex abi_mtx;
+
+   void load_abis();
+   void register_abis(const signed_block& block);
+   void prune_abis(uint32_t written_block_num);
+   abi_serializer_ptr find_abi(const account_name& code, const message_position& position);
+   void add_data(bsoncxx::builder::basic::document& msg_doc, const chain::message& msg, const message_position& position);
 
    bool is_scope_relevant(const eosio::types::vector<account_name>& scope);
-   void update_account(const chain::message& msg);
+   void update_accounts(const signed_block& block);
 
    static const func_name newaccount;
    static const func_name transfer;
@@ -99,6 +163,7 @@ public:
 };
 
 types::abi db_plugin_impl::eos_abi;
+const fc::microseconds db_plugin_impl::queue_status_interval = fc::seconds(60);
 
 const func_name db_plugin_impl::newaccount = "newaccount";
 const func_name db_plugin_impl::transfer = "transfer";
@@ -115,15 +180,28 @@ const std::string db_plugin_impl::accounts_col = "Accounts";
 
 void db_plugin_impl::applied_irreversible_block(const signed_block& block) {
    try {
+      // ABIs are registered in block order, before any later block can be converted
+      register_abis(block);
+
+      auto job = std::make_shared<block_job>();
+      job->block = block;
+
+      boost::mutex::scoped_lock lock(mtx);
       if (startup) {
-         // on startup we don't want to queue, instead push back on caller
-         process_irreversible_block(block);
-      } else {
-         boost::mutex::scoped_lock lock(mtx);
-         queue.push(block);
-         lock.unlock();
-         condtion.notify_one();
+         // This is called under the chain's write lock. Once the node has started, chain_plugin waits for room before
+         // it pushes a block instead, so that API calls are not held up by MongoDB. Blocks replayed at startup come
+         // from the chain_controller constructor, before any API call is served, and wait here.
+         wait_for_queue_space(lock);
       }
+      if (done) {
+         // the writer has stopped on an error, and the application is shutting down
+         return;
+      }
+      jobs.push_back(job);
+      to_convert.push_back(job);
+      max_queued = std::max(max_queued, jobs.size());
+      lock.unlock();
+      convert_condition.notify_one();
    } catch (fc::exception& e) {
       elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
    } catch (std::exception& e) {
@@ -133,88 +211,162 @@ void db_plugin_impl::applied_irreversible_block(const signed_block& block) {
    }
 }
 
-void db_plugin_impl::consum_blocks() {
+void db_plugin_impl::wait_for_queue_space() {
+   boost::mutex::scoped_lock lock(mtx);
+   wait_for_queue_space(lock);
+}
+
+void db_plugin_impl::wait_for_queue_space(boost::mutex::scoped_lock& lock) {
+   if (jobs.size() < queue_size || done) {
+      return;
+   }
+   auto start = fc::time_point::now();
+   ++queue_full_waits;
+   while (jobs.size() >= queue_size && !done) {
+      written_condition.wait(lock);
+   }
+   queue_full_wait_time += fc::time_point::now() - start;
+}
+
+db_plugin::queue_status db_plugin_impl::get_queue_status() {
+   boost::mutex::scoped_lock lock(mtx);
+   return current_queue_status();
+}
+
+db_plugin::queue_status db_plugin_impl::current_queue_status() const {
+   return { uint32_t(jobs.size()), uint32_t(queue_size), uint32_t(max_queued), blocks_written,
+            queue_full_waits, queue_full_wait_time };
+}
+
+/**
+ * Called by a conversion or write thread which can no longer run. Without it, the chain would wait forever for room
+ * in the queue, so the other threads are stopped and the application is asked to quit.
+ */
+void db_plugin_impl::stop_on_failure() {
+   {
+      boost::mutex::scoped_lock lock(mtx);
+      done = true;
+   }
+   convert_condition.notify_all();
+   converted_condition.notify_all();
+   written_condition.notify_all();
+   elog("db_plugin can no longer write blocks to MongoDB, shutting down");
+   app().quit();
+}
+
+void db_plugin_impl::convert_blocks() {
    try {
-      signed_block block;
-      size_t size = 0;
       while (true) {
          boost::mutex::scoped_lock lock(mtx);
-         while (queue.empty() && !done) {
-            condtion.wait(lock);
+         while (to_convert.empty() && !done) {
+            convert_condition.wait(lock);
          }
-         size = queue.size();
-         if (size > 0) {
-            block = queue.front();
-            queue.pop();
-            lock.unlock();
-            // warn if queue size greater than 75%
-            if (size > (queue_size * 0.75)) {
-               wlog("queue size: ${q}", ("q", size + 1));
-            } else if (done) {
-               ilog("draining queue, size: ${q}", ("q", size + 1));
-            }
-            process_irreversible_block(block);
-            continue;
-         } else if (done) {
+         if (to_convert.empty()) {
             break;
          }
+         auto job = to_convert.front();
+         to_convert.pop_front();
+         lock.unlock();
+
+         try {
+            job->docs = convert_block(job->block);
+         } catch (fc::exception& e) {
+            elog("FC Exception while converting block ${e}", ("e", e.to_string()));
+            job->failed = true;
+         } catch (std::exception& e) {
+            elog("STD Exception while converting block ${e}", ("e", e.what()));
+            job->failed = true;
+         } catch (...) {
+            elog("Unknown exception while converting block");
+            job->failed = true;
+         }
+
+         lock.lock();
+         job->converted = true;
+         lock.unlock();
+         converted_condition.notify_all();
       }
-      ilog("db_plugin consum thread shutdown gracefully");
    } catch (fc::exception& e) {
-      elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
+      elog("FC Exception in db_plugin conversion thread ${e}", ("e", e.to_string()));
+      stop_on_failure();
    } catch (std::exception& e) {
-      elog("STD Exception while consuming block ${e}", ("e", e.what()));
+      elog("STD Exception in db_plugin conversion thread ${e}", ("e", e.what()));
+      stop_on_failure();
    } catch (...) {
-      elog("Unknown exception while consuming block");
+      elog("Unknown exception in db_plugin conversion thread");
+      stop_on_failure();
    }
 }
 
-namespace {
+void db_plugin_impl::write_blocks() {
+   try {
+      std::vector<std::shared_ptr<block_job>> batch;
+      auto next_status = fc::time_point::now() + queue_status_interval;
+      while (true) {
+         boost::mutex::scoped_lock lock(mtx);
+         while (!(!jobs.empty() && jobs.front()->converted) && !(done && jobs.empty())) {
+            converted_condition.wait(lock);
+         }
+         if (jobs.empty()) {
+            break;
+         }
+         if (done) {
+            ilog("draining queue, size: ${q}", ("q", jobs.size()));
+         }
 
-   auto find_account(mongocxx::collection& accounts, const account_name& name) {
-      using bsoncxx::builder::stream::document;
-      document find_acc{};
-      find_acc << "name" << name.to_string();
-      auto account = accounts.find_one(find_acc.view());
-      if (!account) {
-         FC_THROW("Unable to find account ${n}", ("n", name));
+         // write the converted blocks at the front of the queue together, up to about batch_size documents
+         size_t docs = 0;
+         for (auto job = jobs.begin(); job != jobs.end() && (*job)->converted && docs < batch_size; ++job) {
+            batch.push_back(*job);
+            docs += 1 + (*job)->docs.trans_docs.size() + (*job)->docs.msgs_docs.size();
+         }
+         lock.unlock();
+
+         write_batch(batch);
+         // later blocks are decoded with the last ABI set up to here, so no older one is needed any more
+         prune_abis(batch.back()->block.block_num());
+
+         lock.lock();
+         jobs.erase(jobs.begin(), jobs.begin() + batch.size());
+         blocks_written += batch.size();
+         fc::optional<db_plugin::queue_status> status;
+         if (fc::time_point::now() >= next_status) {
+            status = current_queue_status();
+            next_status = fc::time_point::now() + queue_status_interval;
+         }
+         lock.unlock();
+         written_condition.notify_all();
+         batch.clear();
+
+         if (status) {
+            ilog("db_plugin queue: ${s}", ("s", *status));
+         }
       }
-      return *account;
+      ilog("db_plugin write thread shutdown gracefully");
+   } catch (fc::exception& e) {
+      elog("FC Exception while writing blocks ${e}", ("e", e.to_string()));
+      stop_on_failure();
+   } catch (std::exception& e) {
+      elog("STD Exception while writing blocks ${e}", ("e", e.what()));
+      stop_on_failure();
+   } catch (...) {
+      elog("Unknown exception while writing blocks");
+      stop_on_failure();
    }
+}
 
-  void add_data(bsoncxx::builder::basic::document& msg_doc,
-                mongocxx::collection& accounts,
-                const chain::message& msg)
-  {
-     using bsoncxx::builder::basic::kvp;
-     try {
-        types::abi_serializer abis;
-        if (msg.code == config::eos_contract_name) {
-           abis.set_abi(db_plugin_impl::eos_abi);
-        } else {
-           auto from_account = find_account(accounts, msg.code);
-           auto abi = fc::json::from_string(bsoncxx::to_json(from_account.view()["abi"].get_document())).as<types::abi>();
-           abis.set_abi(abi);
-        }
-        auto v = abis.binary_to_variant(abis.get_action_type(msg.type), msg.data);
-        auto json = fc::json::to_string(v);
-        try {
-           const auto& value = bsoncxx::from_json(json);
-           msg_doc.append(kvp("data", value));
-           return;
-        } catch (std::exception& e) {
-           elog("Unable to convert EOS JSON to MongoDB JSON: ${e}", ("e", e.what()));
-           elog("  EOS JSON: ${j}", ("j", json));
-        }
-     } catch (fc::exception& e) {
-        elog("Unable to convert message.data to ABI type: ${t}, what: ${e}", ("t", msg.type)("e", e.to_string()));
-     } catch (std::exception& e) {
-        elog("Unable to convert message.data to ABI type: ${t}, std what: ${e}", ("t", msg.type)("e", e.what()));
-     } catch (...) {
-        elog("Unable to convert message.data to ABI type: ${t}", ("t", msg.type));
+namespace {
+
+  template<typename Collection>
+  void insert_docs(Collection& col, std::vector<bsoncxx::document::value>& docs, const std::string& name) {
+     if (docs.empty())
+        return;
+     mongocxx::options::insert opts;
+     opts.ordered(false);
+     if (!col.insert_many(docs, opts)) {
+        elog("Bulk insert of ${n} documents into ${c} failed", ("n", docs.size())("c", name));
      }
-     // if anything went wrong just store raw hex_data
-     msg_doc.append(kvp("hex_data", fc::variant(msg.data).as_string()));
+     docs.clear();
   }
 
   void verify_last_block(mongocxx::collection& blocks, const std::string& prev_block_id) {
@@ -235,34 +387,180 @@ namespace {
          FC_THROW("Existing blocks found in database");
       }
    }
+
+   asset get_asset(const bsoncxx::document::view& doc, const char* key) {
+      auto element = doc[key];
+      if (!element)
+         return asset();
+      return asset::from_string(element.get_utf8().value.to_string());
+   }
 }
 
-void db_plugin_impl::process_irreversible_block(const signed_block& block) {
-  try {
-     _process_irreversible_block(block);
-  } catch (fc::exception& e) {
-     elog("FC Exception while processing block ${e}", ("e", e.to_string()));
-  } catch (std::exception& e) {
-     elog("STD Exception while processing block ${e}", ("e", e.what()));
-  } catch (...) {
-     elog("Unknown exception while processing block");
-  }
+void db_plugin_impl::verify_start(const signed_block& block) {
+   auto blocks = mongo_conn[db_name][blocks_col]; // Blocks
+   if (block.block_num() < 2) {
+      // verify on start we have no previous blocks
+      verify_no_blocks(blocks);
+   } else {
+      // verify on restart we have previous block
+      verify_last_block(blocks, block.previous.str());
+   }
 }
 
-void db_plugin_impl::_process_irreversible_block(const signed_block& block)
-{
-   using namespace bsoncxx::types;
-   using namespace bsoncxx::builder;
-   using bsoncxx::builder::basic::kvp;
+void db_plugin_impl::write_batch(const std::vector<std::shared_ptr<block_job>>& batch) {
+   std::vector<bsoncxx::document::value> blocks_docs;
+   std::vector<bsoncxx::document::value> trans_docs;
+   std::vector<bsoncxx::document::value> msgs_docs;
+
+   for (const auto& job : batch) {
+      if (job->failed)
+         continue;
+      try {
+         if (processed == 0) {
+            verify_start(job->block);
+         }
+         // accounts are updated block by block, so the balances read for a block include the blocks before it
+         update_accounts(job->block);
+      } catch (fc::exception& e) {
+         elog("FC Exception while processing block ${e}", ("e", e.to_string()));
+         continue;
+      } catch (std::exception& e) {
+         elog("STD Exception while processing block ${e}", ("e", e.what()));
+         continue;
+      }
 
-   bool transactions_in_block = false;
-   mongocxx::options::bulk_write bulk_opts;
-   bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_trans{bulk_opts};
+      auto& docs = job->docs;
+      blocks_docs.push_back(std::move(*docs.block_doc));
+      std::move(docs.trans_docs.begin(), docs.trans_docs.end(), std::back_inserter(trans_docs));
+      std::move(docs.msgs_docs.begin(), docs.msgs_docs.end(), std::back_inserter(msgs_docs));
+      ++processed;
+   }
 
    auto blocks = mongo_conn[db_name][blocks_col]; // Blocks
    auto trans = mongo_conn[db_name][trans_col]; // Transactions
    auto msgs = mongo_conn[db_name][msgs_col]; // Messages
+   try {
+      insert_docs(msgs, msgs_docs, msgs_col);
+      insert_docs(blocks, blocks_docs, blocks_col);
+      insert_docs(trans, trans_docs, trans_col);
+   } catch (std::exception& e) {
+      elog("STD Exception while writing blocks ${e}", ("e", e.what()));
+   }
+}
+
+void db_plugin_impl::load_abis() {
+   using bsoncxx::builder::stream::document;
+   using bsoncxx::builder::stream::open_document;
+   using bsoncxx::builder::stream::close_document;
+   using bsoncxx::builder::stream::finalize;
+
+   eos_abi_serializer = std::make_shared<const types::abi_serializer>(eos_abi);
+
+   // ABIs set before the blocks this run will see come from the accounts written so far
+   auto with_abi = document{} << "abi" << open_document << "$exists" << true << close_document << finalize;
+   for (auto&& account : accounts.find(with_abi.view())) {
+      const auto name = account["name"].get_utf8().value.to_string();
+      try {
+         auto abi = fc::json::from_string(bsoncxx::to_json(account["abi"].get_document())).as<types::abi>();
+         abis[account_name(name)][message_position()] = std::make_shared<const types::abi_serializer>(abi);
+      } catch (fc::exception& e) {
+         elog("Unable to load the ABI of ${n}: ${e}", ("n", name)("e", e.to_string()));
+      }
+   }
+}
+
+void db_plugin_impl::register_abis(const signed_block& block) {
+   uint32_t msg_num = 0;
+   for (const auto& cycle : block.cycles) {
+      for (const auto& thread : cycle) {
+         for (const auto& trx : thread.user_input) {
+            for (const auto& msg : trx.messages) {
+               if (msg.code == config::eos_contract_name && msg.type == setcode) {
+                  auto set = msg.as<types::setcode>();
+                  try {
+                     auto serializer = std::make_shared<const types::abi_serializer>(set.code_abi);
+                     boost::mutex::scoped_lock lock(abi_mtx);
+                     auto& versions = abis[set.account];
+                     versions[message_position(block.block_num(), msg_num)] = serializer;
+                     if (versions.size() > 1)
+                        abis_to_prune.insert(set.account);
+                  } catch (fc::exception& e) {
+                     elog("Unable to load the ABI of ${n}: ${e}", ("n", set.account)("e", e.to_string()));
+                  }
+               }
+               ++msg_num;
+            }
+         }
+      }
+   }
+}
+
+void db_plugin_impl::prune_abis(uint32_t written_block_num) {
+   const message_position after_written(written_block_num + 1, 0);
+   boost::mutex::scoped_lock lock(abi_mtx);
+   for (auto account = abis_to_prune.begin(); account != abis_to_prune.end();) {
+      auto& versions = abis[*account];
+      auto next = versions.lower_bound(after_written);
+      if (next != versions.begin())
+         versions.erase(versions.begin(), std::prev(next));
+      if (versions.size() > 1)
+         ++account;
+      else
+         account = abis_to_prune.erase(account);
+   }
+}
+
+db_plugin_impl::abi_serializer_ptr db_plugin_impl::find_abi(const account_name& code, const message_position& position) {
+   if (code == config::eos_contract_name)
+      return eos_abi_serializer;
+
+   boost::mutex::scoped_lock lock(abi_mtx);
+   auto account_abis = abis.find(code);
+   if (account_abis == abis.end())
+      return nullptr;
+   auto next = account_abis->second.lower_bound(position);
+   if (next == account_abis->second.begin())
+      return nullptr;
+   return std::prev(next)->second;
+}
+
+void db_plugin_impl::add_data(bsoncxx::builder::basic::document& msg_doc, const chain::message& msg,
+                              const message_position& position)
+{
+   using bsoncxx::builder::basic::kvp;
+   try {
+      auto abis = find_abi(msg.code, position);
+      if (!abis) {
+         FC_THROW("Unable to find the ABI of account ${n}", ("n", msg.code));
+      }
+      auto v = abis->binary_to_variant(abis->get_action_type(msg.type), msg.data);
+      auto json = fc::json::to_string(v);
+      try {
+         const auto& value = bsoncxx::from_json(json);
+         msg_doc.append(kvp("data", value));
+         return;
+      } catch (std::exception& e) {
+         elog("Unable to convert EOS JSON to MongoDB JSON: ${e}", ("e", e.what()));
+         elog("  EOS JSON: ${j}", ("j", json));
+      }
+   } catch (fc::exception& e) {
+      elog("Unable to convert message.data to ABI type: ${t}, what: ${e}", ("t", msg.type)("e", e.to_string()));
+   } catch (std::exception& e) {
+      elog("Unable to convert message.data to ABI type: ${t}, std what: ${e}", ("t", msg.type)("e", e.what()));
+   } catch (...) {
+      elog("Unable to convert message.data to ABI type: ${t}", ("t", msg.type));
+   }
+   // if anything went wrong just store raw hex_data
+   msg_doc.append(kvp("hex_data", fc::variant(msg.data).as_string()));
+}
+
+db_plugin_impl::converted_block db_plugin_impl::convert_block(const signed_block& block)
+{
+   using namespace bsoncxx::types;
+   using namespace bsoncxx::builder;
+   using bsoncxx::builder::basic::kvp;
+
+   converted_block result;
 
    stream::document block_doc{};
    const auto block_id = block.id();
@@ -270,21 +568,10 @@ void db_plugin_impl::_process_irreversible_block(const signed_block& block)
    const auto prev_block_id_str = block.previous.str();
    auto block_num = block.block_num();
 
-   if (processed == 0) {
-      if (startup) {
-         // verify on start we have no previous blocks
-         verify_no_blocks(blocks);
-         FC_ASSERT(block_num < 2, "Expected start of block, instead received block_num: ${bn}", ("bn", block_num));
-         // Currently we are creating a 'fake' block in chain_controller::initialize_chain() since initial accounts
-         // and producers are not written to the block log. If this is the fake block, indicate it as block_num 0.
-         if (block_num == 1 && block.producer == config::eos_contract_name) {
-            block_num = 0;
-         }
-      } else {
-         // verify on restart we have previous block
-         verify_last_block(blocks, prev_block_id_str);
-      }
-
+   // Currently we are creating a 'fake' block in chain_controller::initialize_chain() since initial accounts
+   // and producers are not written to the block log. If this is the fake block, indicate it as block_num 0.
+   if (block_num == 1 && block.producer == config::eos_contract_name) {
+      block_num = 0;
    }
 
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -299,13 +586,16 @@ void db_plugin_impl::_process_irreversible_block(const signed_block& block)
    auto blk_doc = block_doc << "transactions" << stream::open_array;
 
    int32_t trx_num = -1;
+   uint32_t msg_num = 0;
    const bool check_relevance = !filter_on.empty();
    for (const auto& cycle : block.cycles) {
       for (const auto& thread : cycle) {
          for (const auto& trx : thread.user_input) {
             ++trx_num;
-            if (check_relevance && !is_scope_relevant(trx.scope))
+            if (check_relevance && !is_scope_relevant(trx.scope)) {
+               msg_num += trx.messages.size();
                continue;
+            }
 
             auto txn_oid = bsoncxx::oid{};
             blk_doc = blk_doc << txn_oid; // add to transaction.messages array
@@ -337,7 +627,6 @@ void db_plugin_impl::_process_irreversible_block(const signed_block& block)
                   << stream::close_array
                   << "messages" << stream::open_array;
 
-            mongocxx::bulk_write bulk_msgs{bulk_opts};
             int32_t i = 0;
             for (const auto& msg : trx.messages) {
                auto msg_oid = bsoncxx::oid{};
@@ -357,210 +646,206 @@ void db_plugin_impl::_process_irreversible_block(const signed_block& block)
                }));
                msg_doc.append(kvp("handler_account_name", msg.code.to_string()));
                msg_doc.append(kvp("type", msg.type.to_string()));
-               add_data(msg_doc, accounts, msg);
+               add_data(msg_doc, msg, message_position(block.block_num(), msg_num));
                msg_doc.append(kvp("createdAt", b_date{now}));
-               mongocxx::model::insert_one insert_msg{msg_doc.view()};
-               bulk_msgs.append(insert_msg);
-
-               // eos account update
-               if (msg.code == config::eos_contract_name) {
-                  try {
-                     update_account(msg);
-                  } catch(fc::exception& e) {
-                     elog("Unable to update account ${e}", ("e", e.to_string()));
-                  }
-               }
+               result.msgs_docs.push_back(msg_doc.extract());
 
                ++i;
+               ++msg_num;
             }
 
-            if (!trx.messages.empty()) {
-               auto result = msgs.bulk_write(bulk_msgs);
-               if (!result) {
-                  elog("Bulk message insert failed for block: ${bid}, transaction: ${trx}", ("bid", block_id)("trx", trx.id()));
-               }
-            }
-
-            auto complete_doc = trx_doc << stream::close_array
-                 << "createdAt" << b_date{now}
-                 << stream::finalize;
-            mongocxx::model::insert_one insert_op{complete_doc.view()};
-            transactions_in_block = true;
-            bulk_trans.append(insert_op);
-
+            result.trans_docs.push_back(trx_doc << stream::close_array
+                                                << "createdAt" << b_date{now}
+                                                << stream::finalize);
          }
       }
    }
 
-   auto blk_complete = blk_doc << stream::close_array
-                               << "createdAt" << b_date{now}
-                               << stream::finalize;
-
-   if (!blocks.insert_one(blk_complete.view())) {
-      elog("Failed to insert block ${bid}", ("bid", block_id));
-   }
-
-   if (transactions_in_block) {
-      auto result = trans.bulk_write(bulk_trans);
-      if (!result) {
-         elog("Bulk transaction insert failed for block: ${bid}", ("bid", block_id));
-      }
-   }
+   result.block_doc = blk_doc << stream::close_array
+                              << "createdAt" << b_date{now}
+                              << stream::finalize;
+   return result;
+}
 
-   ++processed;
+namespace {
+   /// The balances of an account in the Accounts collection, as the messages of a block change them
+   struct account_state {
+      fc::optional<bsoncxx::oid>  id; ///< not set for an account created by the block
+      asset                       eos_balance;
+      asset                       staked_balance;
+      asset                       unstaking_balance;
+      fc::optional<std::string>   abi_json;
+      bool                        changed = false;
+   };
 }
 
 // For now providing some simple account processing to maintain eos_balance
-void db_plugin_impl::update_account(const chain::message& msg) {
+void db_plugin_impl::update_accounts(const signed_block& block) {
    using bsoncxx::builder::basic::kvp;
-   using bsoncxx::builder::stream::document;
-   using bsoncxx::builder::stream::open_document;
-   using bsoncxx::builder::stream::close_document;
-   using bsoncxx::builder::stream::finalize;
+   using bsoncxx::builder::basic::sub_array;
+   using bsoncxx::builder::basic::sub_document;
    using namespace bsoncxx::types;
 
-   if (msg.code != config::eos_contract_name)
+   // the eos contract messages of the relevant transactions, which are the only ones that change accounts
+   std::vector<const chain::message*> eos_msgs;
+   std::set<std::string> names;
+   const bool check_relevance = !filter_on.empty();
+   for (const auto& cycle : block.cycles) {
+      for (const auto& thread : cycle) {
+         for (const auto& trx : thread.user_input) {
+            if (check_relevance && !is_scope_relevant(trx.scope))
+               continue;
+            for (const auto& msg : trx.messages) {
+               if (msg.code != config::eos_contract_name)
+                  continue;
+               if (msg.type == transfer) {
+                  auto transfer = msg.as<types::transfer>();
+                  names.insert(transfer.from.to_string());
+                  names.insert(transfer.to.to_string());
+               } else if (msg.type == newaccount) {
+                  names.insert(msg.as<types::newaccount>().creator.to_string());
+               } else if (msg.type == lock) {
+                  auto lock = msg.as<types::lock>();
+                  names.insert(lock.from.to_string());
+                  names.insert(lock.to.to_string());
+               } else if (msg.type == unlock) {
+                  names.insert(msg.as<types::unlock>().account.to_string());
+               } else if (msg.type == claim) {
+                  names.insert(msg.as<types::claim>().account.to_string());
+               } else if (msg.type == setcode) {
+                  names.insert(msg.as<types::setcode>().account.to_string());
+               } else {
+                  continue;
+               }
+               eos_msgs.push_back(&msg);
+            }
+         }
+      }
+   }
+   if (eos_msgs.empty())
       return;
 
-   if (msg.type == transfer) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto transfer = msg.as<types::transfer>();
-      auto from_name = transfer.from.to_string();
-      auto to_name = transfer.to.to_string();
-      auto from_account = find_account(accounts, transfer.from);
-      auto to_account = find_account(accounts, transfer.to);
-
-      asset from_balance = asset::from_string(from_account.view()["eos_balance"].get_utf8().value.to_string());
-      asset to_balance = asset::from_string(to_account.view()["eos_balance"].get_utf8().value.to_string());
-      from_balance -= eosio::types::share_type(transfer.amount);
-      to_balance += eosio::types::share_type(transfer.amount);
-
-      document update_from{};
-      update_from << "$set" << open_document << "eos_balance" << from_balance.to_string()
-                  << "updatedAt" << b_date{now}
-                  << close_document;
-      document update_to{};
-      update_to << "$set" << open_document << "eos_balance" << to_balance.to_string()
-                << "updatedAt" << b_date{now}
-                << close_document;
-
-      accounts.update_one(document{} << "_id" << from_account.view()["_id"].get_oid() << finalize, update_from.view());
-      accounts.update_one(document{} << "_id" << to_account.view()["_id"].get_oid() << finalize, update_to.view());
-
-   } else if (msg.type == newaccount) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto newaccount = msg.as<types::newaccount>();
-
-      // find creator to update its balance
-      auto from_name = newaccount.creator.to_string();
-      document find_from{};
-      find_from << "name" << from_name;
-      auto from_account = accounts.find_one(find_from.view());
-      if (!from_account) {
-         elog("Unable to find account ${n}", ("n", from_name));
-         return;
+   // read every account the block touches at once
+   std::map<std::string, account_state> states;
+   bsoncxx::builder::basic::document filter;
+   filter.append(kvp("name", [&names](sub_document in) {
+      in.append(kvp("$in", [&names](sub_array arr) {
+         for (const auto& name : names)
+            arr.append(name);
+      }));
+   }));
+   for (auto&& account : accounts.find(filter.view())) {
+      auto& state = states[account["name"].get_utf8().value.to_string()];
+      state.id = account["_id"].get_oid().value;
+      state.eos_balance = get_asset(account, "eos_balance");
+      state.staked_balance = get_asset(account, "staked_balance");
+      state.unstaking_balance = get_asset(account, "unstaking_balance");
+   }
+
+   auto find_state = [&states](const account_name& name) -> account_state* {
+      auto state = states.find(name.to_string());
+      if (state == states.end()) {
+         elog("Unable to find account ${n}", ("n", name));
+         return nullptr;
       }
-      // decrease creator by deposit amount
-      auto from_view = from_account->view();
-      asset from_balance = asset::from_string(from_view["eos_balance"].get_utf8().value.to_string());
-      from_balance -= newaccount.deposit;
-      document update_from{};
-      update_from << "$set" << open_document << "eos_balance" << from_balance.to_string() << close_document;
-      accounts.update_one(find_from.view(), update_from.view());
-
-      // create new account with staked deposit amount
-      bsoncxx::builder::stream::document doc{};
-      doc << "name" << newaccount.name.to_string()
-          << "eos_balance" << asset().to_string()
-          << "staked_balance" << newaccount.deposit.to_string()
-          << "unstaking_balance" << asset().to_string()
-          << "createdAt" << b_date{now}
-          << "updatedAt" << b_date{now};
-      if (!accounts.insert_one(doc.view())) {
-         elog("Failed to insert account ${n}", ("n", newaccount.name));
+      state->second.changed = true;
+      return &state->second;
+   };
+
+   for (const auto msg : eos_msgs) {
+      try {
+         if (msg->type == transfer) {
+            auto transfer = msg->as<types::transfer>();
+            auto from = find_state(transfer.from);
+            auto to = find_state(transfer.to);
+            if (!from || !to)
+               continue;
+            from->eos_balance -= eosio::types::share_type(transfer.amount);
+            to->eos_balance += eosio::types::share_type(transfer.amount);
+         } else if (msg->type == newaccount) {
+            auto newaccount = msg->as<types::newaccount>();
+            // decrease creator by deposit amount, and create new account with staked deposit amount
+            auto from = find_state(newaccount.creator);
+            if (!from)
+               continue;
+            from->eos_balance -= newaccount.deposit;
+            auto& created = states[newaccount.name.to_string()];
+            created.staked_balance = newaccount.deposit;
+            created.changed = true;
+         } else if (msg->type == lock) {
+            auto lock = msg->as<types::lock>();
+            auto from = find_state(lock.from);
+            auto to = find_state(lock.to);
+            if (!from || !to)
+               continue;
+            from->eos_balance -= lock.amount;
+            to->staked_balance += lock.amount;
+         } else if (msg->type == unlock) {
+            auto unlock = msg->as<types::unlock>();
+            auto from = find_state(unlock.account);
+            if (!from)
+               continue;
+            auto deltaStake = from->unstaking_balance - unlock.amount;
+            from->staked_balance += deltaStake;
+            from->unstaking_balance = unlock.amount;
+            // TODO: proxies and last_unstaking_time
+         } else if (msg->type == claim) {
+            auto claim = msg->as<types::claim>();
+            auto from = find_state(claim.account);
+            if (!from)
+               continue;
+            from->unstaking_balance -= claim.amount;
+            from->eos_balance += claim.amount;
+         } else if (msg->type == setcode) {
+            auto setcode = msg->as<types::setcode>();
+            auto from = find_state(setcode.account);
+            if (!from)
+               continue;
+            from->abi_json = fc::json::to_string(setcode.code_abi);
+         }
+      } catch (fc::exception& e) {
+         elog("Unable to update account ${e}", ("e", e.to_string()));
       }
+   }
 
-   } else if (msg.type == lock) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto lock = msg.as<types::lock>();
-      auto from_account = find_account(accounts, lock.from);
-      auto to_account = find_account(accounts, lock.to);
-
-      asset from_balance = asset::from_string(from_account.view()["eos_balance"].get_utf8().value.to_string());
-      asset to_balance = asset::from_string(to_account.view()["stacked_balance"].get_utf8().value.to_string());
-      from_balance -= lock.amount;
-      to_balance += lock.amount;
-
-      document update_from{};
-      update_from << "$set" << open_document << "eos_balance" << from_balance.to_string()
-                  << "updatedAt" << b_date{now}
-                  << close_document;
-      document update_to{};
-      update_to << "$set" << open_document << "stacked_balance" << to_balance.to_string()
-                << "updatedAt" << b_date{now}
-                << close_document;
-
-      accounts.update_one(document{} << "_id" << from_account.view()["_id"].get_oid() << finalize, update_from.view());
-      accounts.update_one(document{} << "_id" << to_account.view()["_id"].get_oid() << finalize, update_to.view());
-
-   } else if (msg.type == unlock) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto unlock = msg.as<types::unlock>();
-      auto from_account = find_account(accounts, unlock.account);
-
-      asset unstack_balance = asset::from_string(from_account.view()["unstacking_balance"].get_utf8().value.to_string());
-      asset stack_balance = asset::from_string(from_account.view()["stacked_balance"].get_utf8().value.to_string());
-      auto deltaStake = unstack_balance - unlock.amount;
-      stack_balance += deltaStake;
-      unstack_balance = unlock.amount;
-      // TODO: proxies and last_unstaking_time
-
-      document update_from{};
-      update_from << "$set" << open_document
-                  << "staked_balance" << stack_balance.to_string()
-                  << "unstacking_balance" << unstack_balance.to_string()
-                  << "updatedAt" << b_date{now}
-                  << close_document;
-
-      accounts.update_one(document{} << "_id" << from_account.view()["_id"].get_oid() << finalize, update_from.view());
-
-   } else if (msg.type == claim) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto claim = msg.as<types::claim>();
-      auto from_account = find_account(accounts, claim.account);
-
-      asset balance = asset::from_string(from_account.view()["eos_balance"].get_utf8().value.to_string());
-      asset unstack_balance = asset::from_string(from_account.view()["unstacking_balance"].get_utf8().value.to_string());
-      unstack_balance -= claim.amount;
-      balance += claim.amount;
-
-      document update_from{};
-      update_from << "$set" << open_document
-                  << "eos_balance" << balance.to_string()
-                  << "unstacking_balance" << unstack_balance.to_string()
-                  << "updatedAt" << b_date{now}
-                  << close_document;
-
-      accounts.update_one(document{} << "_id" << from_account.view()["_id"].get_oid() << finalize, update_from.view());
-
-   } else if (msg.type == setcode) {
-      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
-      auto setcode = msg.as<types::setcode>();
-      auto from_account = find_account(accounts, setcode.account);
+   // write every change of the block at once
+   auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
+   mongocxx::options::bulk_write bulk_opts;
+   bulk_opts.ordered(false);
+   mongocxx::bulk_write bulk{bulk_opts};
+   bool any_changed = false;
+   for (const auto& named_state : states) {
+      const auto& state = named_state.second;
+      if (!state.changed)
+         continue;
+      any_changed = true;
+
+      bsoncxx::builder::basic::document fields;
+      fields.append(kvp("eos_balance", state.eos_balance.to_string()),
+                    kvp("staked_balance", state.staked_balance.to_string()),
+                    kvp("unstaking_balance", state.unstaking_balance.to_string()),
+                    kvp("updatedAt", b_date{now}));
+      if (state.abi_json) {
+         auto abi = bsoncxx::from_json(*state.abi_json);
+         fields.append(kvp("abi", b_document{abi.view()}));
+      }
 
-      document update_from{};
-      update_from << "$set" << open_document
-                  << "abi" << bsoncxx::from_json(fc::json::to_string(setcode.code_abi))
-                  << "updatedAt" << b_date{now}
-                  << close_document;
+      if (state.id) {
+         bsoncxx::builder::basic::document find_doc;
+         find_doc.append(kvp("_id", b_oid{*state.id}));
+         bsoncxx::builder::basic::document update_doc;
+         update_doc.append(kvp("$set", b_document{fields.view()}));
+         bulk.append(mongocxx::model::update_one{find_doc.extract(), update_doc.extract()});
+      } else {
+         fields.append(kvp("name", named_state.first),
+                       kvp("createdAt", b_date{now}));
+         bulk.append(mongocxx::model::insert_one{fields.extract()});
+      }
+   }
 
-      accounts.update_one(document{} << "_id" << from_account.view()["_id"].get_oid() << finalize, update_from.view());
+   if (any_changed && !accounts.bulk_write(bulk)) {
+      elog("Bulk account update failed for block: ${bid}", ("bid", block.id()));
    }
 }
 
@@ -581,15 +866,30 @@ db_plugin_impl::db_plugin_impl()
 
 db_plugin_impl::~db_plugin_impl() {
    try {
-      done = true;
-      condtion.notify_one();
-
-      consum_thread.join();
+      {
+         boost::mutex::scoped_lock lock(mtx);
+         done = true;
+      }
+      convert_condition.notify_all();
+      converted_condition.notify_all();
+      written_condition.notify_all();
+
+      for (auto& thread : convert_threads)
+         thread.join();
+      // the conversion threads are gone, so wake the writer to finish whatever they converted last
+      converted_condition.notify_all();
+      write_thread.join();
    } catch (std::exception& e) {
-      elog("Exception on db_plugin shutdown of consum thread: ${e}", ("e", e.what()));
+      elog("Exception on db_plugin shutdown of db_plugin threads: ${e}", ("e", e.what()));
    }
 }
 
+void db_plugin_impl::start() {
+   for (uint32_t i = 0; i < conversion_threads; ++i)
+      convert_threads.emplace_back([this] { convert_blocks(); });
+   write_thread = boost::thread([this] { write_blocks(); });
+}
+
 void db_plugin_impl::wipe_database() {
    ilog("db wipe_database");
 
@@ -645,6 +945,8 @@ void db_plugin_impl::init() {
       blocks.create_index(bsoncxx::from_json(R"xxx({ "block_num" : 1 })xxx"));
       blocks.create_index(bsoncxx::from_json(R"xxx({ "block_id" : 1 })xxx"));
    }
+
+   load_abis();
 }
 
 #endif /* MONGODB */
@@ -668,7 +970,11 @@ void db_plugin::set_program_options(options_description& cli, options_descriptio
          ("filter-on-accounts,f", bpo::value<std::vector<std::string>>()->composing(),
           "Track only transactions whose scopes involve the listed accounts. Default is to track all transactions.")
          ("queue-size,q", bpo::value<uint>()->default_value(256),
-         "The queue size between EOSd and MongoDB process thread.")
+         "The most blocks waiting to be written to MongoDB before the chain waits for them.")
+         ("mongodb-conversion-threads", bpo::value<uint32_t>()->default_value(2),
+         "The number of threads converting blocks to MongoDB documents.")
+         ("mongodb-batch-size", bpo::value<uint>()->default_value(1000),
+         "The number of documents written to MongoDB at once.")
          ("mongodb-uri,m", bpo::value<std::string>(),
          "MongoDB URI connection string, see: https://docs.mongodb.com/master/reference/connection-string/."
                " If not specified then plugin is disabled. Default database 'EOS' is used if not specified in URI.")
@@ -693,6 +999,21 @@ void db_plugin::applied_irreversible_block(const signed_block& block) {
 }
 
 
+void db_plugin::wait_for_queue_space() {
+#ifdef MONGODB
+   if (my->configured)
+      my->wait_for_queue_space();
+#endif
+}
+
+db_plugin::queue_status db_plugin::get_queue_status() {
+#ifdef MONGODB
+   if (my->configured)
+      return my->get_queue_status();
+#endif
+   return queue_status();
+}
+
 void db_plugin::plugin_initialize(const variables_map& options)
 {
 #ifdef MONGODB
@@ -703,9 +1024,16 @@ void db_plugin::plugin_initialize(const variables_map& options)
          auto foa = options.at("filter-on-accounts").as<std::vector<std::string>>();
          for (auto filter_account : foa)
             my->filter_on.emplace(filter_account);
-      } else if (options.count("queue-size")) {
+      }
+      if (options.count("queue-size")) {
          auto size = options.at("queue-size").as<uint>();
-         my->queue_size = size;
+         my->queue_size = std::max(size, 1u);
+      }
+      if (options.count("mongodb-conversion-threads")) {
+         my->conversion_threads = std::max(options.at("mongodb-conversion-threads").as<uint32_t>(), 1u);
+      }
+      if (options.count("mongodb-batch-size")) {
+         my->batch_size = std::max(options.at("mongodb-batch-size").as<uint>(), 1u);
       }
 
       std::string uri_str = options.at("mongodb-uri").as<std::string>();
@@ -720,6 +1048,8 @@ void db_plugin::plugin_initialize(const variables_map& options)
          my->wipe_database();
       }
       my->init();
+      // start writing now, so the blocks of a replay are written while the replay goes on
+      my->start();
    } else {
       wlog("eosio::db_plugin configured, but no --mongodb-uri specified.");
       wlog("db_plugin disabled.");
@@ -733,8 +1063,6 @@ void db_plugin::plugin_startup()
    if (my->configured) {
       ilog("starting db plugin");
 
-      my->consum_thread = boost::thread([this] { my->consum_blocks(); });
-
       // chain_controller is created and has resynced or replayed if needed
       my->startup = false;
    }
@@ -33,6 +33,20 @@ class db_plugin : public plugin<db_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((chain_plugin))
 
+   /**
+    * How far writing to MongoDB is behind the chain, and how often the chain has had to wait for it. Received blocks
+    * wait for room in the queue before they are pushed, outside of the chain's locks; blocks produced by this node do
+    * not wait, so the queue may grow past max_queue_size while the node produces.
+    */
+   struct queue_status {
+      uint32_t          queue_size = 0;         ///< blocks received but not yet written
+      uint32_t          max_queue_size = 0;     ///< the most blocks queued before the chain waits
+      uint32_t          max_queued = 0;         ///< the longest the queue has been
+      uint64_t          blocks_written = 0;
+      uint32_t          queue_full_waits = 0;   ///< the number of blocks the chain waited to queue
+      fc::microseconds  queue_full_wait_time;   ///< the total time the chain waited
+   };
+
    db_plugin();
    virtual ~db_plugin();
 
@@ -41,6 +55,9 @@ public:
    // This may only be called after plugin_initialize() and before plugin_startup()!
    void wipe_database();
    void applied_irreversible_block(const chain::signed_block& block);
+   /// Waits until there is room in the queue for another block; called before a block is pushed to the chain
+   void wait_for_queue_space();
+   queue_status get_queue_status();
 
    void plugin_initialize(const variables_map& options);
    void plugin_startup();
@@ -52,3 +69,6 @@ private:
 
 }
 
+FC_REFLECT(eosio::db_plugin::queue_status,
+           (queue_size)(max_queue_size)(max_queued)(blocks_written)(queue_full_waits)(queue_full_wait_time))
+
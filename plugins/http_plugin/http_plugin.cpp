@@ -8,9 +8,13 @@
 #include <fc/log/logger_config.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/io/json.hpp>
+#include <fc/compress/zlib.hpp>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -21,12 +25,14 @@
 
 #include <thread>
 #include <memory>
+#include <cstdlib>
 
 namespace eosio {
    namespace asio = boost::asio;
 
    using std::map;
    using std::string;
+   using std::vector;
    using boost::optional;
    using boost::asio::ip::tcp;
    using std::shared_ptr;
@@ -80,17 +86,134 @@ namespace eosio {
 
    using websocket_server_type = websocketpp::server<detail::asio_with_stub_log>;
 
+   struct url_handler_entry {
+      negotiated_url_handler handler;
+      bool                   async = false; ///< run on an http thread instead of the application thread
+   };
+
+   /// what the client told us it can accept for a single request
+   struct request_encoding {
+      response_format format = response_format::json;
+      bool            gzip = false;
+   };
+
    class http_plugin_impl {
       public:
-         //shared_ptr<std::thread>  http_thread;
-         //asio::io_service         http_ios;
-         map<string,url_handler>  url_handlers;
+         vector<std::thread>               http_threads;
+         asio::io_service                  http_ios;
+         optional<asio::io_service::work>  http_work;
+         uint16_t                          thread_pool_size = 2;
+         size_t                            gzip_min_size = 32*1024;
+
+         map<string,url_handler_entry>  url_handlers;
+         boost::shared_mutex            url_handlers_mutex;
          optional<tcp::endpoint>  listen_endpoint;
          string                   access_control_allow_origin;
          string                   access_control_allow_headers;
          bool                     access_control_allow_credentials = false;
 
          websocket_server_type    server;
+
+         void add_handler(const string& url, const negotiated_url_handler& handler, bool async) {
+            boost::unique_lock<boost::shared_mutex> lock(url_handlers_mutex);
+            url_handlers[url] = url_handler_entry{handler, async};
+         }
+
+         optional<url_handler_entry> find_handler(const string& url) {
+            boost::shared_lock<boost::shared_mutex> lock(url_handlers_mutex);
+            auto itr = url_handlers.find(url);
+            if (itr == url_handlers.end())
+               return optional<url_handler_entry>();
+            return itr->second;
+         }
+
+         /**
+          *  Whether an Accept-Encoding header value allows a gzip response. A coding given q=0 is refused, and
+          *  gzip is also allowed through * unless it is listed itself.
+          */
+         static bool accepts_gzip(const string& accept_encoding) {
+            optional<bool> gzip, any;
+            vector<string> codings;
+            boost::split(codings, accept_encoding, boost::is_any_of(","));
+            for (const auto& coding : codings) {
+               vector<string> params;
+               boost::split(params, coding, boost::is_any_of(";"));
+               auto name = boost::to_lower_copy(boost::trim_copy(params[0]));
+               double q = 1;
+               for (size_t i = 1; i < params.size(); ++i) {
+                  auto param = boost::to_lower_copy(boost::erase_all_copy(params[i], " "));
+                  if (boost::starts_with(param, "q="))
+                     q = std::strtod(param.c_str() + 2, nullptr);
+               }
+               if (name == "gzip" || name == "x-gzip")
+                  gzip = q > 0;
+               else if (name == "*")
+                  any = q > 0;
+            }
+            if (gzip)
+               return *gzip;
+            return any && *any;
+         }
+
+         static request_encoding parse_request_encoding(const websocket_server_type::connection_ptr& con) {
+            request_encoding enc;
+            if (con->get_request_header("Accept").find("application/octet-stream") != string::npos)
+               enc.format = response_format::binary;
+            enc.gzip = accepts_gzip(con->get_request_header("Accept-Encoding"));
+            return enc;
+         }
+
+         /**
+          *  Completes a deferred response on the http io_service, this may be
+          *  called from any thread.
+          */
+         void send_response(websocket_server_type::connection_ptr con, request_encoding enc, int code, string body) {
+            http_ios.post([this, con, enc, code, body = std::move(body)]() mutable {
+               try {
+                  if (enc.format == response_format::binary && code >= 200 && code < 300)
+                     con->replace_header("Content-type", "application/octet-stream");
+                  if (gzip_min_size && body.size() >= gzip_min_size) {
+                     // whether this response is compressed depends on the request, so caches must key on it
+                     con->append_header("Vary", "Accept-Encoding");
+                     if (enc.gzip) {
+                        body = fc::gzip_compress(body);
+                        con->append_header("Content-Encoding", "gzip");
+                     }
+                  }
+                  con->set_body(std::move(body));
+                  con->set_status(websocketpp::http::status_code::value(code));
+                  con->send_http_response();
+               } catch (const std::exception& e) {
+                  elog("http: unable to send response: ${e}", ("e", e.what()));
+               }
+            });
+         }
+
+         void send_error(websocket_server_type::connection_ptr con, const string& details) {
+            error_results results{websocketpp::http::status_code::internal_server_error,
+                                  "Internal Service Error", details};
+            send_response(con, request_encoding(), websocketpp::http::status_code::internal_server_error,
+                          fc::json::to_string(results));
+         }
+
+         /// invokes the handler, reporting any escaping exception on the connection
+         void call_handler(const negotiated_url_handler& handler, websocket_server_type::connection_ptr con,
+                           const string& resource, const string& body) {
+            try {
+               auto enc = parse_request_encoding(con);
+               handler(resource, body, enc.format, [con, enc, this](int code, string body) {
+                  send_response(con, enc, code, std::move(body));
+               });
+            } catch (const fc::exception& e) {
+               elog("http: ${e}", ("e", e.to_detail_string()));
+               send_error(con, e.to_detail_string());
+            } catch (const std::exception& e) {
+               elog("http: ${e}", ("e", e.what()));
+               send_error(con, e.what());
+            } catch (...) {
+               send_error(con, "unknown exception");
+            }
+         }
    };
 
    http_plugin::http_plugin():my(new http_plugin_impl()){}
@@ -120,6 +243,12 @@ namespace eosio {
                 if (v) ilog("configured http with Access-Control-Allow-Credentials: true");
              })->default_value(false),
              "Specify if Access-Control-Allow-Credentials: true should be returned on each request.")
+
+            ("http-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
+             "Number of worker threads in the http thread pool.")
+
+            ("http-gzip-min-size", bpo::value<size_t>()->default_value(my->gzip_min_size),
+             "Minimum response size, in bytes, to gzip when the client accepts it. 0 disables compression.")
             ;
    }
 
@@ -144,101 +273,134 @@ namespace eosio {
          // uint32_t addr = my->listen_endpoint->address().to_v4().to_ulong();
          // auto fcep = fc::ip::endpoint (addr,my->listen_endpoint->port());
       }
+
+      my->thread_pool_size = options.at("http-threads").as<uint16_t>();
+      FC_ASSERT(my->thread_pool_size > 0, "http-threads must be greater than 0");
+      my->gzip_min_size = options.at("http-gzip-min-size").as<size_t>();
    }
 
    void http_plugin::plugin_startup() {
       if(my->listen_endpoint) {
-
-         //my->http_thread = std::make_shared<std::thread>([&](){
-            ilog("start processing http thread");
-            try {
-               my->server.clear_access_channels(websocketpp::log::alevel::all);
-               my->server.init_asio(&app().get_io_service()); //&my->http_ios);
-               my->server.set_reuse_addr(true);
-
-               my->server.set_http_handler([&](connection_hdl hdl) {
-                  auto con = my->server.get_con_from_hdl(hdl);
-                  try {
-                     //ilog("handle http request: ${url}", ("url",con->get_uri()->str()));
-                     //ilog("${body}", ("body", con->get_request_body()));
-
-                     if (!my->access_control_allow_origin.empty()) {
-                        con->append_header("Access-Control-Allow-Origin", my->access_control_allow_origin);
-                     }
-                     if (!my->access_control_allow_headers.empty()) {
-                        con->append_header("Access-Control-Allow-Headers", my->access_control_allow_headers);
-                     }
-                     if (my->access_control_allow_credentials) {
-                        con->append_header("Access-Control-Allow-Credentials", "true");
-                     }
-                     con->append_header("Content-type", "application/json");
+         try {
+            my->server.clear_access_channels(websocketpp::log::alevel::all);
+            my->server.init_asio(&my->http_ios);
+            my->server.set_reuse_addr(true);
+
+            my->server.set_http_handler([&](connection_hdl hdl) {
+               auto con = my->server.get_con_from_hdl(hdl);
+               try {
+                  //ilog("handle http request: ${url}", ("url",con->get_uri()->str()));
+                  //ilog("${body}", ("body", con->get_request_body()));
+
+                  if (!my->access_control_allow_origin.empty()) {
+                     con->append_header("Access-Control-Allow-Origin", my->access_control_allow_origin);
+                  }
+                  if (!my->access_control_allow_headers.empty()) {
+                     con->append_header("Access-Control-Allow-Headers", my->access_control_allow_headers);
+                  }
+                  if (my->access_control_allow_credentials) {
+                     con->append_header("Access-Control-Allow-Credentials", "true");
+                  }
+                  con->append_header("Content-type", "application/json");
+                  auto resource = con->get_uri()->get_resource();
+                  auto entry = my->find_handler(resource);
+                  if(entry) {
+                     // the response is sent by url_response_callback, possibly from another thread
+                     con->defer_http_response();
                      auto body = con->get_request_body();
-                     auto resource = con->get_uri()->get_resource();
-                     auto handler_itr = my->url_handlers.find(resource);
-                     if(handler_itr != my->url_handlers.end()) {
-                        handler_itr->second(resource, body, [con,this](int code, string body) {
-                           con->set_body(body);
-                           con->set_status(websocketpp::http::status_code::value(code));
-                        });
+                     if (entry->async) {
+                        my->call_handler(entry->handler, con, resource, body);
                      } else {
-                        wlog("404 - not found: ${ep}", ("ep",resource));
-                        error_results results{websocketpp::http::status_code::not_found,
-                                              "Not Found", "Unknown Endpoint"};
-                        con->set_body(fc::json::to_string(results));
-                        con->set_status(websocketpp::http::status_code::not_found);
+                        app().get_io_service().post([this, con, resource, body, handler = entry->handler]() {
+                           my->call_handler(handler, con, resource, body);
+                        });
                      }
-                  } catch( const fc::exception& e ) {
-                     elog( "http: ${e}", ("e",e.to_detail_string()));
-                     error_results results{websocketpp::http::status_code::internal_server_error,
-                                           "Internal Service Error", e.to_detail_string()};
-                     con->set_body(fc::json::to_string(results));
-                     con->set_status(websocketpp::http::status_code::internal_server_error);
-                  } catch( const std::exception& e ) {
-                     elog( "http: ${e}", ("e",e.what()));
-                     error_results results{websocketpp::http::status_code::internal_server_error,
-                                           "Internal Service Error", e.what()};
+                  } else {
+                     wlog("404 - not found: ${ep}", ("ep",resource));
+                     error_results results{websocketpp::http::status_code::not_found,
+                                           "Not Found", "Unknown Endpoint"};
                      con->set_body(fc::json::to_string(results));
-                     con->set_status(websocketpp::http::status_code::internal_server_error);
-                  } catch( ... ) {
-                     error_results results{websocketpp::http::status_code::internal_server_error,
-                                           "Internal Service Error", "unknown exception"};
-                     con->set_body(fc::json::to_string(results));
-                     con->set_status(websocketpp::http::status_code::internal_server_error);
+                     con->set_status(websocketpp::http::status_code::not_found);
                   }
-               });
-
-               ilog("start listening for http requests");
-               my->server.listen(*my->listen_endpoint);
-               my->server.start_accept();
+               } catch( const fc::exception& e ) {
+                  elog( "http: ${e}", ("e",e.to_detail_string()));
+                  error_results results{websocketpp::http::status_code::internal_server_error,
+                                        "Internal Service Error", e.to_detail_string()};
+                  con->set_body(fc::json::to_string(results));
+                  con->set_status(websocketpp::http::status_code::internal_server_error);
+               } catch( const std::exception& e ) {
+                  elog( "http: ${e}", ("e",e.what()));
+                  error_results results{websocketpp::http::status_code::internal_server_error,
+                                        "Internal Service Error", e.what()};
+                  con->set_body(fc::json::to_string(results));
+                  con->set_status(websocketpp::http::status_code::internal_server_error);
+               } catch( ... ) {
+                  error_results results{websocketpp::http::status_code::internal_server_error,
+                                        "Internal Service Error", "unknown exception"};
+                  con->set_body(fc::json::to_string(results));
+                  con->set_status(websocketpp::http::status_code::internal_server_error);
+               }
+            });
+
+            ilog("start listening for http requests");
+            my->server.listen(*my->listen_endpoint);
+            my->server.start_accept();
+         } catch ( const fc::exception& e ){
+            elog( "http: ${e}", ("e",e.to_detail_string()));
+            throw;
+         } catch ( const std::exception& e ){
+            elog( "http: ${e}", ("e",e.what()));
+            throw;
+         } catch (...) {
+            elog("error thrown from http io service");
+            throw;
+         }
 
-           //    my->http_ios.run();
+         ilog("starting ${n} http threads", ("n", my->thread_pool_size));
+         my->http_work.emplace(my->http_ios);
+         for (uint16_t i = 0; i < my->thread_pool_size; ++i) {
+            my->http_threads.emplace_back([this]() {
+               try {
+                  my->http_ios.run();
+               } catch ( const fc::exception& e ){
+                  elog( "http: ${e}", ("e",e.to_detail_string()));
+               } catch ( const std::exception& e ){
+                  elog( "http: ${e}", ("e",e.what()));
+               } catch (...) {
+                  elog("error thrown from http io service");
+               }
                ilog("http io service exit");
-            } catch ( const fc::exception& e ){
-               elog( "http: ${e}", ("e",e.to_detail_string()));
-            } catch ( const std::exception& e ){
-               elog( "http: ${e}", ("e",e.what()));
-            } catch (...) {
-                elog("error thrown from http io service");
-            }
-         //});
-
+            });
+         }
       }
    }
 
    void http_plugin::plugin_shutdown() {
-     // if(my->http_thread) {
-         if(my->server.is_listening())
-             my->server.stop_listening();
-     //    my->http_ios.stop();
-     //    my->http_thread->join();
-     //    my->http_thread.reset();
-     // }
+      if(my->server.is_listening())
+         my->server.stop_listening();
+      my->http_work.reset();
+      my->http_ios.stop();
+      for (auto& t : my->http_threads)
+         t.join();
+      my->http_threads.clear();
    }
 
    void http_plugin::add_handler(const string& url, const url_handler& handler) {
       ilog( "add api url: ${c}", ("c",url) );
-      app().get_io_service().post([=](){
-        my->url_handlers.insert(std::make_pair(url,handler));
-      });
+      my->add_handler(url, [handler](string url, string body, response_format, url_response_callback cb) {
+         handler(std::move(url), std::move(body), std::move(cb));
+      }, false);
+   }
+
+   void http_plugin::add_async_handler(const string& url, const url_handler& handler) {
+      ilog( "add async api url: ${c}", ("c",url) );
+      my->add_handler(url, [handler](string url, string body, response_format, url_response_callback cb) {
+         handler(std::move(url), std::move(body), std::move(cb));
+      }, true);
+   }
+
+   void http_plugin::add_negotiated_handler(const string& url, const negotiated_url_handler& handler, bool async) {
+      ilog( "add api url: ${c}", ("c",url) );
+      my->add_handler(url, handler, async);
    }
 }
@@ -39,19 +39,48 @@ namespace eosio {
     */
    using api_description = std::map<string, url_handler>;
 
+   /**
+    * @brief Response body formats a client can ask for through the Accept header
+    */
+   enum class response_format {
+      json,   ///< application/json, the default
+      binary  ///< application/octet-stream, the fc::raw packed result
+   };
+
+   /**
+    * @brief Callback type for a URL handler which supports content negotiation
+    *
+    * The handler must encode successful (2xx) responses in the requested
+    * format; error responses are always JSON.
+    *
+    * Arguments: url, request_body, requested_format, response_callback
+    **/
+   using negotiated_url_handler = std::function<void(string,string,response_format,url_response_callback)>;
+   using negotiated_api_description = std::map<string, negotiated_url_handler>;
+
    /**
     *  This plugin starts an HTTP server and dispatches queries to
     *  registered handles based upon URL. The handler is passed the
     *  URL that was requested and a callback method that should be
     *  called with the response code and body.
     *
-    *  The handler will be called from the appbase application io_service
-    *  thread.  The callback can be called from any thread and will 
-    *  automatically propagate the call to the http thread.
+    *  Handlers registered with add_handler() will be called from the appbase
+    *  application io_service thread.  Handlers registered with
+    *  add_async_handler() are called directly from one of the HTTP worker
+    *  threads and must therefore be safe to run concurrently with each other
+    *  and with the application thread.  In both cases the callback can be
+    *  called from any thread and will automatically propagate the call to the
+    *  http threads.
     *
-    *  The HTTP service will run in its own thread with its own io_service to
-    *  make sure that HTTP request processing does not interfer with other
-    *  plugins.  
+    *  Handlers registered with add_negotiated_api() are additionally told
+    *  whether the client asked for a JSON or a packed binary response.
+    *  Responses larger than a configurable threshold are gzip compressed
+    *  when the client's Accept-Encoding allows it, and carry
+    *  Vary: Accept-Encoding either way.
+    *
+    *  The HTTP service will run in its own pool of threads with its own
+    *  io_service to make sure that HTTP request processing does not interfer
+    *  with other plugins.
     */
    class http_plugin : public appbase::plugin<http_plugin>
    {
@@ -66,11 +95,26 @@ namespace eosio {
         void plugin_startup();
         void plugin_shutdown();
 
+        /// handler will be dispatched to the appbase application thread
         void add_handler(const string& url, const url_handler&);
+        /// handler will run on an http worker thread, it must be thread safe
+        void add_async_handler(const string& url, const url_handler&);
+
         void add_api(const api_description& api) {
            for (const auto& call : api) 
               add_handler(call.first, call.second);
         }
+        void add_async_api(const api_description& api) {
+           for (const auto& call : api)
+              add_async_handler(call.first, call.second);
+        }
+
+        /// @param async if true the handlers run on the http threads, otherwise on the application thread
+        void add_negotiated_handler(const string& url, const negotiated_url_handler&, bool async);
+        void add_negotiated_api(const negotiated_api_description& api, bool async) {
+           for (const auto& call : api)
+              add_negotiated_handler(call.first, call.second, async);
+        }
 
       private:
         std::unique_ptr<class http_plugin_impl> my;
@@ -0,0 +1,129 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/net_plugin/compact_block.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+namespace eosio {
+
+   compact_block_message make_compact_block( const signed_block& sb, uint64_t salt ) {
+      compact_block_message cbm;
+      cbm.block_header = sb;
+      cbm.salt = salt;
+      cbm.cycles.reserve( sb.cycles.size() );
+      for( const auto& cyc : sb.cycles) {
+        cbm.cycles.emplace_back( compact_cycle() );
+        compact_cycle &ccyc = cbm.cycles.back();
+        ccyc.reserve( cyc.size() );
+        for( const auto& thr : cyc) {
+          ccyc.emplace_back( compact_thread() );
+          compact_thread &cthr = ccyc.back();
+          cthr.generated_input = thr.generated_input;
+          cthr.user_input.reserve( thr.user_input.size() );
+          for( const auto &ui : thr.user_input) {
+            cthr.user_input.emplace_back( compact_transaction{ compact_short_id( salt, ui.id() ), ui.output } );
+          }
+        }
+      }
+      return cbm;
+   }
+
+   pending_compact_block::pending_compact_block( compact_block_message msg )
+      :_compact( std::move(msg) ) {
+      // duplicate short ids keep the first position, the others are fetched
+      for( const auto &cyc : _compact.cycles ) {
+        for( const auto &thr : cyc ) {
+          for( const auto &ct : thr.user_input ) {
+            _wanted.emplace( ct.short_id, _transactions.size() );
+            _transactions.emplace_back();
+          }
+        }
+      }
+      _matched.resize( _transactions.size() );
+   }
+
+   bool pending_compact_block::match( const transaction_id_type& id, const vector<char>& packed ) {
+      return match( compact_short_id( _compact.salt, id ), id, packed );
+   }
+
+   bool pending_compact_block::match( uint64_t short_id, const transaction_id_type& id, const vector<char>& packed ) {
+      auto w = _wanted.find( short_id );
+      if( w == _wanted.end() ) {
+        return false;
+      }
+      // a short id matched by two different transactions cannot be resolved locally
+      if( _transactions[w->second] ) {
+        if( _matched[w->second] != id ) {
+          _collided.insert( w->second );
+        }
+        return false;
+      }
+      try {
+        _transactions[w->second] = fc::raw::unpack<signed_transaction>( packed );
+      } catch( const fc::exception &ex ) {
+        elog( "unable to unpack cached transaction ${id}", ("id",id) );
+        return false;
+      }
+      _matched[w->second] = id;
+      return true;
+   }
+
+   void pending_compact_block::end_matching() {
+      for( auto index : _collided ) {
+        _transactions[index].reset();
+      }
+      _missing.clear();
+      for( uint32_t i = 0; i < _transactions.size(); ++i ) {
+        if( !_transactions[i] ) {
+          _missing.push_back( i );
+        }
+      }
+      _wanted.clear();
+      _matched.clear();
+      _collided.clear();
+   }
+
+   bool pending_compact_block::add_missing( const vector<signed_transaction>& trxs ) {
+      if( trxs.size() != _missing.size() ) {
+        return false;
+      }
+      for( size_t i = 0; i < _missing.size(); ++i ) {
+        _transactions[_missing[i]] = trxs[i];
+      }
+      _missing.clear();
+      return true;
+   }
+
+   optional<signed_block> pending_compact_block::block()const {
+      signed_block sb;
+      static_cast<signed_block_header&>(sb) = _compact.block_header;
+
+      auto trx = _transactions.begin();
+      for( const auto &cyc : _compact.cycles ) {
+        sb.cycles.emplace_back( eosio::chain::cycle() );
+        auto &sbcycle = sb.cycles.back();
+        for( const auto &thr : cyc ) {
+          sbcycle.emplace_back( eosio::chain::thread() );
+          auto &sbthread = sbcycle.back();
+          sbthread.generated_input = thr.generated_input;
+          sbthread.user_input.reserve( thr.user_input.size() );
+          for( const auto &ct : thr.user_input ) {
+            if( !*trx ) {
+              return optional<signed_block>();
+            }
+            sbthread.user_input.emplace_back( **trx++ );
+            sbthread.user_input.back().output = ct.output;
+          }
+        }
+      }
+
+      if( sb.calculate_merkle_root() != sb.transaction_merkle_root ) {
+        return optional<signed_block>();
+      }
+      return sb;
+   }
+
+} // namespace eosio
@@ -0,0 +1,68 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eos/net_plugin/protocol.hpp>
+
+#include <set>
+#include <unordered_map>
+
+namespace eosio {
+
+   /// The compact form of a block, with each user transaction replaced by its short id under salt
+   compact_block_message make_compact_block( const signed_block& sb, uint64_t salt );
+
+   /**
+    * A compact block received from a peer, being rebuilt from the transactions this
+    * node already has. The user transactions are resolved by position, in cycle,
+    * thread, user_input order:
+    *  - match is given each transaction known locally, and keeps those whose short
+    *    id is in the block;
+    *  - end_matching lists the positions still missing, to request from the peer;
+    *  - add_missing fills them in from the peer's reply;
+    *  - block puts the signed block back together.
+    *
+    * A short id may stand for more than one transaction: two local transactions can
+    * collide on it, and a block can hold the same short id twice. Only the first
+    * position with a short id is matched locally, and a position matched by two
+    * different transactions is dropped, so both cases are fetched from the peer.
+    */
+   class pending_compact_block {
+   public:
+      explicit pending_compact_block( compact_block_message msg );
+
+      const compact_block_message& compact()const { return _compact; }
+      /// the number of user transactions in the block
+      size_t transaction_count()const { return _transactions.size(); }
+      /// the positions of the user transactions that were not resolved, set by end_matching
+      const vector<uint32_t>& missing()const { return _missing; }
+
+      /// offers a transaction known locally, returning whether it was kept for a position of the block
+      bool match( const transaction_id_type& id, const vector<char>& packed );
+      /// as match, for a transaction whose short id under the block's salt is already known
+      bool match( uint64_t short_id, const transaction_id_type& id, const vector<char>& packed );
+      void end_matching();
+
+      /// fills in the missing transactions in the order of missing(), false if trxs does not have one for each
+      bool add_missing( const vector<signed_transaction>& trxs );
+
+      /**
+       * @return the rebuilt block, or nothing if a transaction is unresolved or the transaction
+       * merkle root does not match, which happens when a short id resolved to the wrong transaction
+       */
+      optional<signed_block> block()const;
+
+   private:
+      compact_block_message                 _compact;
+      vector<optional<signed_transaction>>  _transactions;
+      vector<uint32_t>                      _missing;
+
+      /// used while matching: the first position of each short id, the id matched
+      /// to each position, and the positions matched by two different transactions
+      std::unordered_map<uint64_t, uint32_t>  _wanted;
+      vector<transaction_id_type>             _matched;
+      std::set<uint32_t>                      _collided;
+   };
+
+} // namespace eosio
@@ -0,0 +1,218 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <fc/exception/exception.hpp>
+#include <fc/io/datastream.hpp>
+
+#include <boost/asio/buffer.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string.h>
+
+namespace eosio {
+
+   /**
+    * Fixed size slabs shared by the receive buffers of all connections. Up to
+    * max_free released slabs are kept for reuse and the rest are freed, so the
+    * memory held for idle connections stays bounded however many peers come
+    * and go.
+    */
+   class slab_pool : public std::enable_shared_from_this<slab_pool> {
+   public:
+      using slab_ptr = std::shared_ptr<char>;
+
+      slab_pool( size_t slab_size, size_t max_free )
+         :_slab_size( slab_size ), _max_free( max_free ) {}
+
+      ~slab_pool() {
+         for( auto s : _free ) {
+            delete[] s;
+         }
+      }
+
+      slab_ptr acquire() {
+         char* s = nullptr;
+         {
+            std::lock_guard<std::mutex> g( _mtx );
+            if( !_free.empty() ) {
+               s = _free.back();
+               _free.pop_back();
+            }
+            ++_in_use;
+         }
+         if( !s ) {
+            s = new char[_slab_size];
+         }
+         std::weak_ptr<slab_pool> pool = shared_from_this();
+         return slab_ptr( s, [pool]( char* s ) {
+               if( auto p = pool.lock() ) {
+                  p->release( s );
+               } else {
+                  delete[] s;
+               }
+            });
+      }
+
+      size_t slab_size()const { return _slab_size; }
+
+      /// number of slabs currently held by buffers
+      size_t in_use()const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return _in_use;
+      }
+
+   private:
+      void release( char* s ) {
+         {
+            std::lock_guard<std::mutex> g( _mtx );
+            --_in_use;
+            if( _free.size() < _max_free ) {
+               _free.push_back( s );
+               return;
+            }
+         }
+         delete[] s;
+      }
+
+      const size_t         _slab_size;
+      const size_t         _max_free;
+      mutable std::mutex   _mtx;
+      std::vector<char*>   _free;
+      size_t               _in_use = 0;
+   };
+
+   class message_buffer;
+
+   /**
+    * A read only fc stream over part of a message_buffer, so that messages
+    * can be unpacked straight from the slabs they were received into.
+    */
+   class message_stream {
+   public:
+      message_stream( const message_buffer& buf, size_t pos, size_t size )
+         :_buf( buf ), _start( pos ), _pos( pos ), _end( pos + size ) {}
+
+      inline bool read( char* d, size_t s );
+      inline bool get( unsigned char& c ) { return get( *(char*)&c ); }
+      inline bool get( char& c ) { return read( &c, 1 ); }
+      inline void skip( size_t s );
+      inline size_t tellp()const { return _pos - _start; }
+      inline size_t remaining()const { return _end - _pos; }
+
+   private:
+      const message_buffer& _buf;
+      size_t                _start;
+      size_t                _pos;
+      size_t                _end;
+   };
+
+   /**
+    * Receive buffer made of a chain of slabs from a slab_pool. Slabs are
+    * appended as data arrives and handed back to the pool as soon as every
+    * message in them has been read, so a connection only holds as much
+    * memory as its unread data needs. Offsets are relative to the read
+    * position.
+    */
+   class message_buffer {
+   public:
+      explicit message_buffer( std::shared_ptr<slab_pool> pool )
+         :_pool( std::move( pool ) ) {}
+
+      /// space for the next read from the socket, growing the chain by one slab when little is left
+      std::vector<boost::asio::mutable_buffer> write_buffers() {
+         const size_t slab_size = _pool->slab_size();
+         if( _write_pos == _slabs.size() * slab_size ) {
+            _slabs.push_back( _pool->acquire() );
+         }
+         std::vector<boost::asio::mutable_buffer> bufs;
+         size_t index = _write_pos / slab_size;
+         size_t offset = _write_pos % slab_size;
+         bufs.emplace_back( _slabs[index].get() + offset, slab_size - offset );
+         if( slab_size - offset < slab_size / 4 ) {
+            if( index + 1 == _slabs.size() ) {
+               _slabs.push_back( _pool->acquire() );
+            }
+            bufs.emplace_back( _slabs[index + 1].get(), slab_size );
+         }
+         return bufs;
+      }
+
+      /// marks bytes of the space given by write_buffers as filled
+      void advance_write( size_t bytes ) { _write_pos += bytes; }
+
+      size_t bytes_to_read()const { return _write_pos - _read_pos; }
+
+      /// copies size bytes starting offset bytes past the read position
+      void copy( size_t offset, size_t size, char* d )const {
+         FC_ASSERT( offset + size <= bytes_to_read(), "read past the end of the message buffer" );
+         const size_t slab_size = _pool->slab_size();
+         size_t pos = _read_pos + offset;
+         while( size > 0 ) {
+            size_t in_slab = pos % slab_size;
+            size_t n = std::min( size, slab_size - in_slab );
+            memcpy( d, _slabs[pos / slab_size].get() + in_slab, n );
+            d += n;
+            pos += n;
+            size -= n;
+         }
+      }
+
+      /// a stream over size bytes starting offset bytes past the read position
+      message_stream stream( size_t offset, size_t size )const {
+         return message_stream( *this, offset, size );
+      }
+
+      /// consumes bytes, returning the slabs that were fully read to the pool
+      void advance_read( size_t bytes ) {
+         FC_ASSERT( bytes <= bytes_to_read(), "read past the end of the message buffer" );
+         _read_pos += bytes;
+         if( _read_pos == _write_pos ) {
+            // keep one slab for the next read
+            _slabs.resize( std::min<size_t>( _slabs.size(), 1 ) );
+            _read_pos = _write_pos = 0;
+            return;
+         }
+         const size_t slab_size = _pool->slab_size();
+         while( _read_pos >= slab_size ) {
+            _slabs.pop_front();
+            _read_pos -= slab_size;
+            _write_pos -= slab_size;
+         }
+      }
+
+      /// drops any unread data, such as a partial message left by a closed connection
+      void reset() {
+         _slabs.clear();
+         _read_pos = _write_pos = 0;
+      }
+
+   private:
+      std::shared_ptr<slab_pool>       _pool;
+      std::deque<slab_pool::slab_ptr>  _slabs;
+      size_t                           _read_pos = 0; ///< from the start of the first slab
+      size_t                           _write_pos = 0; ///< from the start of the first slab
+   };
+
+   inline bool message_stream::read( char* d, size_t s ) {
+      if( _end - _pos >= s ) {
+         _buf.copy( _pos, s, d );
+         _pos += s;
+         return true;
+      }
+      fc::detail::throw_datastream_range_error( "read", _end - _start, int64_t(-((_end - _pos) - 1)) );
+   }
+
+   inline void message_stream::skip( size_t s ) {
+      if( _end - _pos < s ) {
+         fc::detail::throw_datastream_range_error( "skip", _end - _start, int64_t(-((_end - _pos) - 1)) );
+      }
+      _pos += s;
+   }
+
+} // namespace eosio
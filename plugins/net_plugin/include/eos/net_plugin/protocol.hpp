@@ -1,6 +1,7 @@
 #pragma once
 #include <eos/chain/block.hpp>
 #include <eos/chain/types.hpp>
+#include <fc/crypto/city.hpp>
 #include <chrono>
 
 namespace eosio {
@@ -32,7 +33,7 @@ namespace eosio {
     bad_transaction ///< the peer sent a transaction that failed verification
   };
 
-  const string reason_str( go_away_reason rsn ) {
+  inline const string reason_str( go_away_reason rsn ) {
     switch (rsn ) {
     case no_reason : return "no reason";
     case self : return "self connect";
@@ -70,7 +71,7 @@ namespace eosio {
     normal
   };
 
-  const string modes_str( id_list_modes m ) {
+  inline const string modes_str( id_list_modes m ) {
     switch( m ) {
     case none : return "none";
     case catch_up : return "catch up";
@@ -100,22 +101,51 @@ namespace eosio {
     ordered_blk_ids req_blocks;
   };
 
-  struct processed_trans_summary {
-    transaction_id_type id;
-    vector<message_output> outmsgs;
-  };
+   /**
+    *  A user transaction of a compact block. The transaction itself is identified by a
+    *  short id salted per block, so that short id collisions are not repeatable across
+    *  blocks or peers; the receiver resolves it from the transactions it already has.
+    */
+   struct compact_transaction {
+      uint64_t               short_id = 0;
+      vector<message_output> output;
+   };
 
-  struct thread_ids {
-    vector<transaction_id_type> gen_trx; // is this necessary to send?
-    vector<processed_trans_summary> user_trx;
-  };
+   struct compact_thread {
+      vector<processed_generated_transaction> generated_input;
+      vector<compact_transaction>             user_input;
+   };
+
+   using compact_cycle = vector<compact_thread>;
 
-  using cycle_ids = vector<thread_ids>;
-   struct block_summary_message {
-      signed_block_header         block_header;
-      vector<cycle_ids>           trx_ids;
+   struct compact_block_message {
+      signed_block_header    block_header;
+      uint64_t               salt = 0;
+      vector<compact_cycle>  cycles;
    };
 
+   /**
+    *  Requests the user transactions of a compact block that the receiver could not
+    *  resolve, by position in cycle, thread, user_input order.
+    */
+   struct compact_block_request_message {
+      block_id_type      block_id;
+      vector<uint32_t>   indexes;
+   };
+
+   /// the reply to a compact_block_request_message, empty if the block is not available
+   struct compact_block_transactions_message {
+      block_id_type              block_id;
+      vector<signed_transaction> transactions;
+   };
+
+   inline uint64_t compact_short_id( uint64_t salt, const transaction_id_type& id ) {
+      char buf[sizeof(salt) + sizeof(id)];
+      memcpy( buf, &salt, sizeof(salt) );
+      memcpy( buf + sizeof(salt), id.data(), sizeof(id) );
+      return fc::city_hash64( buf, sizeof(buf) );
+   }
+
    struct sync_request_message {
       uint32_t start_block;
       uint32_t end_block;
@@ -127,9 +157,11 @@ namespace eosio {
                                       notice_message,
                                       request_message,
                                       sync_request_message,
-                                      block_summary_message,
+                                      compact_block_message,
                                       signed_transaction,
-                                      signed_block>;
+                                      signed_block,
+                                      compact_block_request_message,
+                                      compact_block_transactions_message>;
 
 } // namespace eosio
 
@@ -142,9 +174,11 @@ FC_REFLECT( eosio::handshake_message,
             (os)(agent)(generation) )
 FC_REFLECT( eosio::go_away_message, (reason)(node_id) )
 FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
-FC_REFLECT( eosio::processed_trans_summary, (id)(outmsgs) )
-FC_REFLECT( eosio::thread_ids, (gen_trx)(user_trx) )
-FC_REFLECT( eosio::block_summary_message, (block_header)(trx_ids) )
+FC_REFLECT( eosio::compact_transaction, (short_id)(output) )
+FC_REFLECT( eosio::compact_thread, (generated_input)(user_input) )
+FC_REFLECT( eosio::compact_block_message, (block_header)(salt)(cycles) )
+FC_REFLECT( eosio::compact_block_request_message, (block_id)(indexes) )
+FC_REFLECT( eosio::compact_block_transactions_message, (block_id)(transactions) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
@@ -196,8 +230,8 @@ State:
 
       if notice message update list of transactions known by remote peer
       if trx message then insert into global state as unvalidated
-      if blk summary message then insert into global state *if* we know of all dependent transactions
-         else close connection
+      if compact block message then rebuild the block from known transactions and
+         request only the ones that are missing from the peer
 
 
     if my head block < the LIB of a peer and my head block age > block interval * round_size/2 then
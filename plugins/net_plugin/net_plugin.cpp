@@ -6,9 +6,12 @@
 
 #include <eos/net_plugin/net_plugin.hpp>
 #include <eos/net_plugin/protocol.hpp>
+#include <eos/net_plugin/compact_block.hpp>
+#include <eos/net_plugin/message_buffer.hpp>
 #include <eos/chain/chain_controller.hpp>
 #include <eos/chain/exceptions.hpp>
 #include <eos/chain/block.hpp>
+#include <eos/chain/block_view.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/io/raw.hpp>
@@ -16,12 +19,18 @@
 #include <fc/container/flat.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/crypto/rand.hpp>
+#include <fc/bloom_filter.hpp>
 #include <fc/exception/exception.hpp>
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/intrusive/set.hpp>
+#include <boost/lockfree/queue.hpp>
+
+#include <atomic>
+#include <thread>
 
 namespace eosio {
   using std::vector;
@@ -38,6 +47,7 @@ namespace eosio {
 
   class connection;
   class sync_manager;
+  struct received_message;
 
 
   using connection_ptr = std::shared_ptr<connection>;
@@ -46,12 +56,60 @@ namespace eosio {
   using socket_ptr = std::shared_ptr<tcp::socket>;
 
   using net_message_ptr = shared_ptr<net_message>;
+  using frame_ptr = shared_ptr<const vector<char>>;
+
+  constexpr auto     message_header_size = 4;
+
+  using packed_txn_ptr = shared_ptr<const vector<char>>;
+
+  /**
+   * Wraps a packed message, whose type has the given net_message tag, in a
+   * complete net_message frame, length header included, so that it can be
+   * written to a peer as is.
+   */
+  frame_ptr packed_frame( uint32_t tag, const vector<char>& packed ) {
+    const unsigned_int which( tag );
+    uint32_t payload_size = fc::raw::pack_size( which ) + packed.size();
+    auto frame = std::make_shared<vector<char>>( message_header_size + payload_size );
+    fc::datastream<char*> ds( frame->data(), frame->size() );
+    ds.write( reinterpret_cast<char*>(&payload_size), message_header_size );
+    fc::raw::pack( ds, which );
+    ds.write( packed.data(), packed.size() );
+    return frame;
+  }
+
+  frame_ptr txn_frame( const vector<char>& packed ) {
+    return packed_frame( net_message::tag<signed_transaction>::value, packed );
+  }
+
+  /**
+   * Packs msg as a complete frame, length header included.
+   */
+  frame_ptr pack_frame( const net_message& msg ) {
+    uint32_t payload_size = fc::raw::pack_size( msg );
+    auto frame = std::make_shared<vector<char>>( message_header_size + payload_size );
+    fc::datastream<char*> ds( frame->data(), frame->size() );
+    ds.write( reinterpret_cast<char*>(&payload_size), message_header_size );
+    fc::raw::pack( ds, msg );
+    return frame;
+  }
+
+  /**
+   * The packed form of txn, shared with the chain's pending transaction pool
+   * when it holds txn so that each transaction is serialized only once.
+   */
+  packed_txn_ptr pack_txn( const signed_transaction& txn, const transaction_id_type& id ) {
+    if( auto pooled = app().find_plugin<chain_plugin>()->chain().pending().find( id ) ) {
+      return pooled->packed;
+    }
+    return std::make_shared<const vector<char>>( fc::raw::pack( txn ) );
+  }
 
   struct node_transaction_state {
     transaction_id_type id;
     fc::time_point      received;
     fc::time_point_sec  expires;
-    vector<char>        packed_transaction; /// the received raw bundle
+    packed_txn_ptr      packed_transaction; /// the packed transaction, see pack_txn
     uint32_t            block_num = -1; /// block transaction was included in
     bool                validated = false; /// whether or not our node has validated it
   };
@@ -66,15 +124,13 @@ namespace eosio {
 
   struct update_entry {
     const signed_transaction &txn;
-    update_entry (const signed_transaction &msg) : txn(msg) {}
+    const transaction_id_type &id;
+    update_entry (const signed_transaction &msg, const transaction_id_type &txnid) : txn(msg), id(txnid) {}
 
     void operator() (node_transaction_state& nts) {
       nts.received = fc::time_point::now();
       nts.validated = true;
-      size_t bufsiz = fc::raw::pack_size(txn);
-      nts.packed_transaction.resize(bufsiz);
-      fc::datastream<char*> ds( nts.packed_transaction.data(), bufsiz );
-      fc::raw::pack( ds, txn );
+      nts.packed_transaction = pack_txn( txn, id );
     }
   };
 
@@ -107,6 +163,21 @@ namespace eosio {
 
   class net_plugin_impl {
   public:
+    /** \name Network Threads
+     *  Sockets are read, written and decoded on net_ios. Everything that
+     *  touches the chain or the peer bookkeeping stays on the application
+     *  thread.
+     *  @{
+     */
+    boost::asio::io_service                   net_ios;
+    unique_ptr<boost::asio::io_service::work> net_work;
+    vector<std::thread>                       net_threads;
+    uint32_t                                  net_thread_count = 0;
+
+    boost::lockfree::queue<received_message*> inbound{64}; ///< decoded messages waiting for the application thread
+    std::atomic<bool>                         inbound_posted{false};
+    /** @} */
+
     unique_ptr<tcp::acceptor>     acceptor;
     tcp::endpoint                 listen_endpoint;
     string                        p2p_address;
@@ -116,14 +187,18 @@ namespace eosio {
     vector<string>                supplied_peers;
 
     std::set< connection_ptr >    connections;
+    shared_ptr<slab_pool>         buffer_pool;
     bool                          done = false;
     unique_ptr< sync_manager >    sync_master;
+    uint32_t                      sync_threads = 0;
 
     unique_ptr<boost::asio::steady_timer> connector_check;
     unique_ptr<boost::asio::steady_timer> transaction_check;
     unique_ptr<boost::asio::steady_timer> keepalive_timer;
+    unique_ptr<boost::asio::steady_timer> notice_timer;
     boost::asio::steady_timer::duration   connector_period;
     boost::asio::steady_timer::duration   txn_exp_period;
+    boost::asio::steady_timer::duration   txn_notice_period;
     boost::asio::steady_timer::duration   resp_expected_period;
     boost::asio::steady_timer::duration   keepalive_interval{std::chrono::seconds{32}};
 
@@ -137,15 +212,28 @@ namespace eosio {
     bool                          send_whole_blocks;
 
     node_transaction_index        local_txns;
-    ordered_txn_ids               pending_notify;
+    ordered_txn_ids               pending_notify; ///< ids announced to peers on the next notice_timer tick
 
     shared_ptr<tcp::resolver>     resolver;
 
     void connect( connection_ptr c );
     void connect( connection_ptr c, tcp::resolver::iterator endpoint_itr );
+    void connected( connection_ptr c, tcp::resolver::iterator endpoint_itr, const boost::system::error_code& err );
     void start_session( connection_ptr c );
     void start_listen_loop( );
     void start_read_message( connection_ptr c);
+    /** \brief Decode complete messages in the receive buffer and read more
+     *
+     * Runs on the connection's strand. Stops reading while the application
+     * thread has too many of this connection's messages still to handle.
+     */
+    void read_messages( connection_ptr c );
+    /** \brief Hand a decoded message to the application thread, called on a network thread
+     */
+    void post_inbound( received_message* msg );
+    /** \brief Handle every message in the inbound queue, called on the application thread
+     */
+    void dispatch_inbound();
 
     void close( connection_ptr c );
     size_t count_open_sockets () const;
@@ -180,13 +268,38 @@ namespace eosio {
     void handle_message( connection_ptr c, const notice_message &msg);
     void handle_message( connection_ptr c, const request_message &msg);
     void handle_message( connection_ptr c, const sync_request_message &msg);
-    void handle_message( connection_ptr c, const block_summary_message &msg);
+    void handle_message( connection_ptr c, const compact_block_message &msg);
+    void handle_message( connection_ptr c, const compact_block_request_message &msg);
+    void handle_message( connection_ptr c, const compact_block_transactions_message &msg);
     void handle_message( connection_ptr c, const signed_transaction &msg);
-    void handle_message( connection_ptr c, const signed_block &msg);
+    /** \brief Process a signed_block, relaying it as the frame it arrived in when there is one
+     *
+     * id is the id of the block, when it has already been hashed from the frame
+     */
+    void handle_message( connection_ptr c, const signed_block &msg, frame_ptr frame = frame_ptr(),
+                         const optional<block_id_type>& id = optional<block_id_type>() );
+
+    /** \name Compact Blocks
+     *  @{
+     */
+    /** \brief Rebuild the block from pcb and apply it, falling back to fetching the
+     *  whole block from the peer if the rebuilt block does not match its header.
+     */
+    void accept_compact_block( connection_ptr c, const pending_compact_block &pcb );
+    /** \brief Relay a compact block to every current peer not known to have it
+     */
+    void send_compact_block( const compact_block_message &msg, connection_ptr from );
+    /** @} */
 
     void start_conn_timer( );
     void start_txn_timer( );
     void start_monitors( );
+    /** \brief Add a transaction id to the next batch of notices
+     */
+    void queue_notice( const transaction_id_type& id );
+    /** \brief Send each peer one notice_message with the pending_notify ids it is not known to have
+     */
+    void send_pending_notices( );
 
     void expire_txns( );
     void connection_monitor( );
@@ -209,41 +322,72 @@ namespace eosio {
   /**
    * default value initializers
    */
-  constexpr auto     def_buffer_size_mb = 4;
-  constexpr auto     def_buffer_size = 1024*1024*def_buffer_size_mb;
   constexpr auto     def_max_clients = 20; // 0 for unlimited clients
   constexpr auto     def_conn_retry_wait = std::chrono::seconds (30);
   constexpr auto     def_txn_expire_wait = std::chrono::seconds (3);
+  constexpr auto     def_txn_notice_wait = std::chrono::milliseconds (100);
+  constexpr auto     def_txn_filter_size = 20000; // ids per generation of a peer's inventory filter
+  constexpr auto     def_txn_filter_fpp = 0.0001;
   constexpr auto     def_resp_expected_wait = std::chrono::seconds (1);
   constexpr auto     def_network_version = 0;
   constexpr auto     def_sync_rec_span = 10;
+  constexpr auto     def_sync_window = 1000;
+  constexpr auto     def_sync_max_in_flight = 4; // chunks outstanding per peer
   constexpr auto     def_max_just_send = 1300 * 3; // "mtu" * 3
-  constexpr auto     def_send_whole_blocks = true;
-
-  constexpr auto     message_header_size = 4;
+  constexpr auto     def_send_whole_blocks = false;
+  constexpr auto     def_max_pending_compact = 8;
+  constexpr auto     def_max_message_size = 2 * config::default_max_block_size; // larger lengths drop the peer
+  constexpr auto     def_slab_size = 64*1024;
+  constexpr auto     def_max_free_slabs = 1024; // slabs kept for reuse, up to 64MB
+  constexpr auto     def_net_threads = 2;
+  constexpr auto     def_max_inbound_pending = 256; // messages per peer decoded but not yet handled
 
   /**
-   *  Index by id
-   *  Index by is_known, block_num, validated_time, this is the order we will broadcast
-   *  to peer.
-   *  Index by is_noticed, validated_time
-   *
+   * The transaction ids a peer is known to have, because it sent them or we
+   * sent or announced them to it. Ids go into the current filter and when it
+   * holds generation_size of them it becomes the previous filter, so ids age
+   * out after about two generations without being tracked one by one. A
+   * false positive only means a peer is not sent a transaction it may lack.
    */
-  struct transaction_state {
-    transaction_id_type id;
-    bool                is_known_by_peer = false; ///< true if we sent or received this trx to this peer or received notice from peer
-    bool                is_noticed_to_peer = false; ///< have we sent peer notice we know it (true if we receive from this peer)
-    uint32_t            block_num = -1; ///< the block number the transaction was included in
-    time_point          validated_time; ///< infinity for unvalidated
-    time_point          requested_time; /// incase we fetch large trx
-  };
+  class rolling_bloom_filter {
+  public:
+    explicit rolling_bloom_filter( uint32_t generation_size )
+      :generation_size( generation_size ) {
+      fc::bloom_parameters params;
+      params.projected_element_count = generation_size;
+      params.false_positive_probability = def_txn_filter_fpp;
+      params.compute_optimal_parameters();
+      current = fc::bloom_filter( params );
+      previous = current;
+    }
 
-  typedef multi_index_container<
-    transaction_state,
-    indexed_by<
-      ordered_unique< tag<by_id>, member<transaction_state, transaction_id_type, &transaction_state::id > >
-      >
-    > transaction_state_index;
+    bool contains( const transaction_id_type& id ) const {
+      return current.contains( id.data(), id.data_size() ) || previous.contains( id.data(), id.data_size() );
+    }
+
+    /// returns false if id was already present
+    bool insert( const transaction_id_type& id ) {
+      if( contains( id ) ) {
+        return false;
+      }
+      if( current.element_count() >= generation_size ) {
+        std::swap( current, previous );
+        current.clear();
+      }
+      current.insert( id.data(), id.data_size() );
+      return true;
+    }
+
+    void clear() {
+      current.clear();
+      previous.clear();
+    }
+
+  private:
+    uint32_t          generation_size;
+    fc::bloom_filter  current;
+    fc::bloom_filter  previous;
+  };
 
   /**
    *
@@ -275,69 +419,97 @@ namespace eosio {
   struct sync_state {
     sync_state(uint32_t start = 0, uint32_t end = 0, uint32_t last_acted = 0)
       :start_block ( start ), end_block( end ), last( last_acted ),
-       start_time (time_point::now()), block_cache()
+       received( 0 ), start_time (time_point::now())
     {}
     uint32_t     start_block;
     uint32_t     end_block;
     uint32_t     last; ///< last sent or received
+    uint32_t     received; ///< blocks received so far, which may arrive out of order
     time_point   start_time; ///< time request made or received
-    deque<vector<char> > block_cache;
   };
 
   using sync_state_ptr = shared_ptr< sync_state >;
 
+  /**
+   * A block received while syncing that is waiting in the sync window for
+   * its predecessors to be applied. precomputed is null when the block was
+   * not prepared on a sync worker thread.
+   */
+  struct sync_block {
+    shared_ptr<signed_block>                            block;
+    shared_ptr<chain_controller::block_precomputed>     precomputed;
+    connection_wptr                                     source;
+  };
+
+  /**
+   * A packed message, length header included, waiting on the network thread
+   * to be written. close_after is set for go_away messages.
+   */
+  struct queued_message {
+    frame_ptr    frame;
+    bool         close_after;
+  };
+
+  /**
+   * A message decoded on a network thread, waiting for the application
+   * thread. Signed blocks are in block, with the frame they arrived in and
+   * the id hashed from the packed header, and msg is left empty.
+   */
+  struct received_message {
+    connection_ptr              conn;
+    net_message                 msg;
+    shared_ptr<signed_block>    block;
+    block_id_type               block_id;
+    frame_ptr                   frame;
+  };
+
   struct handshake_initializer {
     static void populate (handshake_message &hello);
   };
 
   class connection : public std::enable_shared_from_this<connection> {
   public:
-    connection( string endpoint,
-                size_t send_buf_size = def_buffer_size,
-                size_t recv_buf_size = def_buffer_size );
+    explicit connection( string endpoint );
 
-    connection( socket_ptr s,
-                size_t send_buf_size = def_buffer_size,
-                size_t recv_buf_size = def_buffer_size );
+    explicit connection( socket_ptr s );
     ~connection();
     void initialize ();
 
     block_state_index       block_state;
-    transaction_state_index trx_state;
-    sync_state_ptr          sync_receiving;  // we are requesting info from this peer
+    rolling_bloom_filter    trx_inventory;
+    deque<sync_state_ptr>   sync_receiving;  // chunks we requested from this peer, in request order
     sync_state_ptr          sync_requested;  // this peer is requesting info from us
+    deque<sync_state_ptr>   sync_requests_pending; // further chunks this peer requested, served in order
+    uint32_t                sync_span;       // blocks per chunk requested from this peer
+    double                  sync_rate;       // moving average of the blocks per second this peer syncs to us
+    time_point              sync_mark;       // when the last chunk from this peer completed
     socket_ptr              socket;
+    bool                    socket_open;     // as last seen by the application thread
+    uint32_t                writes_pending;  // frames handed to the network thread and not yet written
+
+    /** \name Network Thread State
+     *  Only touched by handlers running on strand.
+     *  @{
+     */
+    boost::asio::io_service::strand strand;
+    message_buffer          pending_message_buffer; // received data, in slabs shared with all connections
+    deque<queued_message>   out_queue;
+    bool                    read_paused;
+    /** @} */
+    std::atomic<uint32_t>   inbound_pending; // messages decoded and not yet handled by the application thread
 
-    //#warning ("TODO: Rework Message Caching for efficiency")
-    // WHat I mean here is that incoming data should be read in chunks that are as
-    // large as possible. We can query the recv buffer size. When using async_read_some(),
-    // we will frequently end a read in the middle of a message. That could happen with
-    // small messages, in which a simple "normalize" call could reset the buffer and allow a
-    // subsequent read to pick up the rest. In the case of very large messages, we should allow
-    // for the creation of a secondary buffer big enough to hold the entire message. Better
-    // still would be to have a mempool class that has a series of fixed size blocks that can
-    // be used scatter-gather style.
-
-    vector<char>            pending_message_buffer;
-    uint32_t                pending_message_write_index;
-    uint32_t                pending_message_read_index;
-    vector<char>            send_buffer;
-    vector<char>            blk_buffer;
-
-    deque< vector<char> >   txn_queue;
-    size_t                  txn_in_flight;
-    bool                    halt_txn_send;
+    deque< packed_txn_ptr > txn_queue;
 
     fc::sha256              node_id;
     handshake_message       last_handshake;
     int16_t                 sent_handshake_count;
-    deque<net_message>      out_queue;
     bool                    connecting;
     bool                    syncing;
     string                  peer_addr;
     unique_ptr<boost::asio::steady_timer> response_expected;
     optional<request_message> pending_fetch;
     go_away_reason         no_retry;
+    map<block_id_type, pending_compact_block> pending_compact_blocks;
 
     /** \name Peer Timestamps
      *  Time message handling
@@ -399,33 +571,33 @@ namespace eosio {
     void stop_send();
 
     void enqueue( const net_message &msg );
+    /** \brief Queue a message that is already packed, length header included
+     */
+    void enqueue_frame( frame_ptr frame, bool close_after = false );
     bool enqueue_sync_block ();
     void send_next_message();
     void send_next_txn();
+    /** \brief Write the frame at the front of out_queue, called on strand
+     */
+    void write_next();
+    /** \brief Account for a frame the network thread finished writing
+     */
+    void write_done( bool close_after );
 
     void sync_wait ();
     void fetch_wait ();
     void sync_timeout (boost::system::error_code ec);
     void fetch_timeout (boost::system::error_code ec);
 
-    /** \brief Adjust the pending message buffer
-     *
-     * This method is called to adjust the size of the
-     * pending_message_buffer when there is a partial message
-     * in the buffer of message_length. There may be
-     * additional messages earlier in the buffer that
-     * can be removed
-     */
-    void adjust_buffer_size(uint32_t message_length);
-
-    /** \brief Process the next message from the pending message buffer
+    /** \brief Decode the next message from the pending message buffer
      *
-     * Process the next message from the pending_message_buffer.
+     * Decode the next message from the pending_message_buffer and hand it
+     * to the application thread. Called on strand.
      * message_length is the already determined length of the data
      * part of the message and impl in the net plugin implementation
      * that will handle the message.
      * Returns true is successful. Returns false if an error was
-     * encountered unpacking or processing the message.
+     * encountered unpacking the message.
      */
     bool process_next_message(net_plugin_impl& impl, uint32_t message_length);
 
@@ -436,26 +608,6 @@ namespace eosio {
   const fc::string connection::logger_name("connection");
   fc::logger connection::logger(connection::logger_name);
 
-  struct precache : public fc::visitor<void> {
-    connection_ptr c;
-    size_t message_size;
-    precache( connection_ptr conn, size_t msg_size) : c(conn), message_size(msg_size) {}
-
-    void operator()(const signed_block &msg) const
-    {
-      c->blk_buffer.resize(message_size);
-      memcpy(c->blk_buffer.data(),
-             &c->pending_message_buffer[c->pending_message_read_index+message_header_size],
-             message_size);
-    }
-
-    template <typename T>
-    void operator()(const T &msg) const
-    {
-      //no-op
-    }
-  };
-
   struct msgHandler : public fc::visitor<void> {
     net_plugin_impl &impl;
     connection_ptr c;
@@ -468,23 +620,44 @@ namespace eosio {
     }
   };
 
+  /**
+   * Fetches irreversible blocks from all peers at once. Each peer has up to
+   * def_sync_max_in_flight chunks outstanding, sized to how fast it served the
+   * previous ones. Received blocks wait in a window of at most sync_window_size
+   * blocks past head until they can be applied in order. When sync worker
+   * threads are running, blocks are deserialized and their signatures recovered
+   * on them before being handed back to the application thread.
+   */
   class sync_manager {
   public:
     uint32_t            sync_known_lib_num;
     uint32_t            sync_last_requested_num;
     uint32_t            sync_req_span;
+    uint32_t            sync_window_size;
 
-    deque<sync_state_ptr> full_chunks;
-    deque<sync_state_ptr> partial_chunks;
+    deque<sync_state_ptr> partial_chunks; ///< chunks taken back from peers, ordered by start_block
+    map<uint32_t, sync_block> sync_window;
     deque<block_id_type> _blocks;
     chain_plugin * chain_plug;
 
+    boost::asio::io_service                       worker_ios;
+    unique_ptr<boost::asio::io_service::work>     worker_work;
+    vector<std::thread>                           worker_threads;
+
   public:
-    sync_manager (uint32_t span);
+    sync_manager (uint32_t span, uint32_t window_size);
     bool syncing ();
-    void assign_chunk (connection_ptr c);
-    void apply_chunk (sync_state_ptr ss);
-    void take_chunk (connection_ptr c);
+    void start_workers (uint32_t count);
+    void stop_workers ();
+    bool has_workers () const { return !worker_threads.empty(); }
+
+    void request_more (connection_ptr c);
+    void request_all ();
+    void drop_chunks (connection_ptr c, bool penalize);
+    void reset_requests ();
+    void precompute_block (connection_ptr c, shared_ptr<signed_block> block);
+    void recv_block (connection_ptr c, sync_block blk);
+    void apply_window ();
     void start_sync (connection_ptr c, uint32_t target);
 
     void set_blocks_to_fetch (vector<block_id_type>);
@@ -500,22 +673,26 @@ namespace eosio {
 
   //---------------------------------------------------------------------------
 
-  connection::connection( string endpoint,
-                          size_t send_buf_size,
-                          size_t recv_buf_size )
+  connection::connection( string endpoint )
       : block_state(),
-        trx_state(),
+        trx_inventory(def_txn_filter_size),
         sync_receiving(),
         sync_requested(),
-        socket( std::make_shared<tcp::socket>( std::ref( app().get_io_service() ))),
-        pending_message_buffer(recv_buf_size),
-        pending_message_write_index(0),
-        pending_message_read_index(0),
-        send_buffer(send_buf_size),
+        sync_requests_pending(),
+        sync_span(def_sync_rec_span),
+        sync_rate(0),
+        sync_mark(),
+        socket( std::make_shared<tcp::socket>( std::ref( my_impl->net_ios ))),
+        socket_open(false),
+        writes_pending(0),
+        strand(my_impl->net_ios),
+        pending_message_buffer(my_impl->buffer_pool),
+        out_queue(),
+        read_paused(false),
+        inbound_pending(0),
         node_id(),
         last_handshake(),
         sent_handshake_count(0),
-        out_queue(),
         connecting (false),
         syncing (false),
         peer_addr (endpoint),
@@ -527,22 +704,26 @@ namespace eosio {
       initialize();
     }
 
-  connection::connection( socket_ptr s,
-                          size_t send_buf_size,
-                          size_t recv_buf_size )
+  connection::connection( socket_ptr s )
       : block_state(),
-        trx_state(),
+        trx_inventory(def_txn_filter_size),
         sync_receiving(),
         sync_requested(),
+        sync_requests_pending(),
+        sync_span(def_sync_rec_span),
+        sync_rate(0),
+        sync_mark(),
         socket( s ),
-        pending_message_buffer(recv_buf_size),
-        pending_message_write_index(0),
-        pending_message_read_index(0),
-        send_buffer(send_buf_size),
+        socket_open(true),
+        writes_pending(0),
+        strand(my_impl->net_ios),
+        pending_message_buffer(my_impl->buffer_pool),
+        out_queue(),
+        read_paused(false),
+        inbound_pending(0),
         node_id(),
         last_handshake(),
         sent_handshake_count(0),
-        out_queue(),
         connecting (false),
         syncing (false),
         peer_addr (),
@@ -565,10 +746,13 @@ namespace eosio {
       auto *rnd = node_id.data();
       rnd[0] = 0;
       response_expected.reset(new boost::asio::steady_timer (app().get_io_service()));
+      if( my_impl->sync_master ) {
+        sync_span = my_impl->sync_master->sync_req_span;
+      }
     }
 
   bool connection::connected () {
-    return (socket->is_open() && !connecting);
+    return (socket_open && !connecting);
   }
 
   bool connection::current () {
@@ -584,25 +768,34 @@ namespace eosio {
 
   void connection::reset () {
       sync_requested.reset();
+      sync_requests_pending.clear();
       block_state.clear();
-      trx_state.clear();
+      trx_inventory.clear();
+      pending_compact_blocks.clear();
     }
 
     void connection::close () {
-      if (socket) {
-        socket->close();
-      }
+      socket_open = false;
       connecting = false;
       syncing = false;
-      out_queue.clear();
+      writes_pending = 0;
+      pending_compact_blocks.clear();
       if (response_expected) {
         response_expected->cancel();
       }
+      connection_ptr self = shared_from_this();
+      strand.post( [self]( ) {
+          boost::system::error_code ec;
+          self->socket->close( ec );
+          self->out_queue.clear();
+          self->pending_message_buffer.reset();
+          self->read_paused = false;
+        });
     }
 
   void connection::txn_send_pending (const vector<transaction_id_type> &ids) {
     for (auto t : my_impl->local_txns){
-      if (t.packed_transaction.size()) {
+      if (t.packed_transaction) {
         bool found = false;
         for (auto l : ids) {
           if ( l == t.id) {
@@ -621,7 +814,7 @@ namespace eosio {
     for (auto t : ids) {
       auto n = my_impl->local_txns.get<by_id>().find(t);
       if (n != my_impl->local_txns.end() &&
-          n->packed_transaction.size()) {
+          n->packed_transaction) {
         txn_queue.push_back( n->packed_transaction );
       }
     }
@@ -733,12 +926,8 @@ namespace eosio {
   }
 
   void connection::stop_send() {
-    if (txn_in_flight > 0) {
-      halt_txn_send = true;
-    }
-    else {
-      txn_queue.clear();
-    }
+    // frames already handed to the network thread are still written
+    txn_queue.clear();
   }
 
     void connection::send_handshake ( ) {
@@ -776,10 +965,24 @@ namespace eosio {
   }
 
   void connection::enqueue( const net_message &m ) {
-    out_queue.push_back( m );
-    if( out_queue.size() == 1 ) {
-      send_next_message();
+    if (m.contains<sync_request_message>()) {
+      sync_wait( );
+    } else if (m.contains<request_message>()) {
+      pending_fetch = m.get<request_message>();
+      fetch_wait( );
     }
+    enqueue_frame( pack_frame( m ), m.contains<go_away_message>() );
+  }
+
+  void connection::enqueue_frame( frame_ptr frame, bool close_after ) {
+    ++writes_pending;
+    connection_ptr self = shared_from_this();
+    strand.post( [self, frame, close_after]( ) {
+        self->out_queue.push_back( queued_message{ frame, close_after } );
+        if( self->out_queue.size() == 1 ) {
+          self->write_next();
+        }
+      });
   }
 
   bool connection::enqueue_sync_block ( ) {
@@ -788,11 +991,16 @@ namespace eosio {
 
     if (num == sync_requested->end_block) {
       sync_requested.reset();
+      if( !sync_requests_pending.empty() ) {
+        sync_requested = sync_requests_pending.front();
+        sync_requests_pending.pop_front();
+      }
     }
     try {
-      fc::optional<signed_block> sb = cc.fetch_block_by_number(num);
-      if (sb) {
-        enqueue( *sb );
+      // irreversible blocks are sent as they are in the block log, without decoding them
+      vector<char> packed;
+      if (cc.fetch_packed_block_by_number(num, packed)) {
+        enqueue_frame( packed_frame( net_message::tag<signed_block>::value, packed ) );
         return true;
       }
     } catch ( ... ) {
@@ -802,80 +1010,55 @@ namespace eosio {
   }
 
   void connection::send_next_message() {
-    if( !out_queue.size() ) {
+    if( writes_pending == 0 ) {
       if( !sync_requested || !enqueue_sync_block( ) ) {
         send_next_txn ();
       }
-      return;
-    }
-
-    auto& m = out_queue.front();
-    if (m.contains<sync_request_message>()) {
-      sync_wait( );
-    } else if (m.contains<request_message>()) {
-      pending_fetch = m.get<request_message>();
-      fetch_wait( );
     }
+  }
 
-    uint32_t payload_size = fc::raw::pack_size( m );
-    char * header = reinterpret_cast<char*>(&payload_size);
-    size_t header_size = sizeof(payload_size);
-
-    size_t buffer_size = header_size + payload_size;
-
-    fc::datastream<char*> ds( send_buffer.data(), buffer_size);
-    ds.write( header, header_size );
-    fc::raw::pack( ds, m );
-    boost::asio::async_write( *socket, boost::asio::buffer( send_buffer, buffer_size ),
-                              [this]( boost::system::error_code ec, std::size_t /*bytes_transferred*/ ) {
-                                if( ec ) {
-                                  elog( "Error sending message: ${msg}", ("msg",ec.message() ) );
-                                } else  {
-                                  if (out_queue.size()) {
-                                    if (out_queue.front().contains<go_away_message>()) {
-                                      close();
-                                      return;
-                                    }
-                                    out_queue.pop_front();
+  void connection::write_next() {
+    connection_ptr self = shared_from_this();
+    frame_ptr frame = out_queue.front().frame;
+    boost::asio::async_write( *socket, boost::asio::buffer( frame->data(), frame->size() ),
+                              strand.wrap( [self, frame]( boost::system::error_code ec, std::size_t /*bytes_transferred*/ ) {
+                                  if( ec ) {
+                                    elog( "Error sending message: ${msg}", ("msg",ec.message() ) );
+                                    return;
+                                  }
+                                  // the queue may have been cleared by close() while the write was in flight
+                                  if( self->out_queue.empty() || self->out_queue.front().frame != frame ) {
+                                    return;
+                                  }
+                                  bool close_after = self->out_queue.front().close_after;
+                                  self->out_queue.pop_front();
+                                  app().get_io_service().post( [self, close_after]( ) {
+                                      self->write_done( close_after );
+                                    });
+                                  if( !self->out_queue.empty() && !close_after ) {
+                                    self->write_next();
                                   }
-                                  send_next_message();
-                                }
-                              });
+                                }));
   }
 
-  void connection::send_next_txn() {
-    if( !txn_queue.size() || halt_txn_send) {
+  void connection::write_done( bool close_after ) {
+    if( close_after ) {
+      close();
       return;
     }
+    if( writes_pending > 0 && --writes_pending == 0 ) {
+      send_next_message();
+    }
+  }
 
+  void connection::send_next_txn() {
+    // hand the network thread up to about 64KB of transactions at a time
     ssize_t limit = 65535;
-    while (txn_in_flight < txn_queue.size() && limit > 0 ) {
-      limit -= txn_queue[txn_in_flight].size();
-      if (limit >= 0 || txn_in_flight == 0) {
-        txn_in_flight++;
-      }
-    }
-    for (size_t i = 0; i < txn_in_flight; i++) {
-      boost::asio::async_write( *socket, boost::asio::buffer(txn_queue[i], txn_queue[i].size()),
-                                [this, i]( boost::system::error_code ec, std::size_t /*bytes_transferred*/ ) {
-                                  if( ec ) {
-                                    elog( "Error sending txn block: ${msg}", ("msg",ec.message() ) );
-                                  } else  {
-                                    if (i == txn_in_flight - 1) {
-                                      if (halt_txn_send) {
-                                        txn_queue.clear();
-                                        txn_in_flight = 0;
-                                        halt_txn_send = false;
-                                      }
-                                      else {
-                                        while (txn_in_flight-- > 0) {
-                                          txn_queue.pop_front();
-                                        }
-                                      }
-                                      send_next_message();
-                                    }
-                                  }
-                                });
+    while( !txn_queue.empty() && limit > 0 ) {
+      auto frame = txn_frame( *txn_queue.front() );
+      limit -= frame->size();
+      enqueue_frame( frame );
+      txn_queue.pop_front();
     }
   }
 
@@ -893,14 +1076,14 @@ namespace eosio {
 
   void connection::sync_timeout( boost::system::error_code ec ) {
     if( !ec ) {
-      if( sync_receiving && sync_receiving->last < sync_receiving->end_block) {
+      if( !sync_receiving.empty() ) {
         enqueue( (sync_request_message) {0,0});
-        my_impl->sync_master->take_chunk (shared_from_this());
+        my_impl->sync_master->drop_chunks (shared_from_this(), true);
       }
     }
     else if( ec == boost::asio::error::operation_aborted) {
-      if( !connected()) {
-        my_impl->sync_master->take_chunk (shared_from_this());
+      if( !connected() && !sync_receiving.empty() ) {
+        my_impl->sync_master->drop_chunks (shared_from_this(), false);
       }
     }
     else {
@@ -936,207 +1119,289 @@ namespace eosio {
     }
   }
 
-  void connection::adjust_buffer_size(uint32_t message_length) {
-    uint32_t current_buffer_size = pending_message_buffer.size();
-    if (current_buffer_size - pending_message_read_index + 1 < message_length)
-
-      // Not enough room in the buffer, grow the buffer, first move remaining
-      // unprocessed data to the beginning of the buffer
-      if (pending_message_read_index != 0) {
-        memmove(&pending_message_buffer[0],
-                &pending_message_buffer[pending_message_read_index],
-                pending_message_write_index - pending_message_read_index);
-        pending_message_write_index -= pending_message_read_index;
-        pending_message_read_index = 0;
-      }
-
-
-      // See if we need to grow the buffer or if there is enough space now.
-      uint32_t bytes_needed = message_length - current_buffer_size - pending_message_read_index + 1;
-      if (bytes_needed > 0) {
-        // Grow the buffer by some multiplier of the current size.
-        // Note that the buffer size will never shrink in the current implementation.
-        // The eventual solution will be to use a chain of buffers using scatter/gather
-        uint32_t multiplier = (bytes_needed / current_buffer_size) + 2;
-        uint32_t new_size = current_buffer_size * multiplier;
-        pending_message_buffer.resize(new_size);
-      }
-    }
-
   bool connection::process_next_message(net_plugin_impl& impl, uint32_t message_length) {
+    unique_ptr<received_message> msg( new received_message{ shared_from_this() } );
     try {
-      fc::datastream<const char*> ds(&pending_message_buffer[pending_message_read_index + message_header_size],
-                                     message_length);
-      net_message msg;
-      fc::raw::unpack(ds, msg);
-      precache pc( shared_from_this(), message_length );
-      msg.visit( pc);
-      msgHandler m(impl, shared_from_this() );
-      msg.visit(m);
+      auto ds = pending_message_buffer.stream( message_header_size, message_length );
+      fc::unsigned_int which;
+      fc::raw::unpack( ds, which );
+      if( which.value == net_message::tag<signed_block>::value ) {
+        // blocks are kept as received so they can be relayed without packing them again
+        auto frame = std::make_shared<vector<char>>( message_header_size + message_length );
+        pending_message_buffer.copy( 0, frame->size(), frame->data() );
+        block_view view( frame->data() + message_header_size + ds.tellp(), message_length - ds.tellp() );
+        msg->block = std::make_shared<signed_block>( view.unpack() );
+        msg->block_id = view.id();
+        msg->frame = frame;
+      }
+      else {
+        auto mds = pending_message_buffer.stream( message_header_size, message_length );
+        fc::raw::unpack( mds, msg->msg );
+        if( msg->msg.contains<time_message>() ) {
+          // stamped here so the time spent waiting for the application thread is not counted
+          msg->msg.get<time_message>().dst = get_time();
+        }
+      }
     } catch(  const fc::exception& e ) {
       edump((e.to_detail_string() ));
-      impl.close( shared_from_this() );
+      connection_ptr self = shared_from_this();
+      app().get_io_service().post( [self]( ) {
+          my_impl->close( self );
+        });
       return false;
     }
-    pending_message_read_index += message_header_size + message_length;
+    pending_message_buffer.advance_read( message_header_size + message_length );
+    ++inbound_pending;
+    impl.post_inbound( msg.release() );
     return true;
   }
 
 
   //-----------------------------------------------------------
 
-  sync_manager::sync_manager( uint32_t span )
+  sync_manager::sync_manager( uint32_t span, uint32_t window_size )
     :sync_known_lib_num( 0 )
     ,sync_last_requested_num( 0 )
     ,sync_req_span( span )
+    ,sync_window_size( window_size )
   {
     chain_plug = app( ).find_plugin<chain_plugin>( );
   }
 
   bool sync_manager::syncing( ) {
     fc_dlog(logger, "ours = ${ours} known = ${known} head = ${head}",("ours",sync_last_requested_num)("known",sync_known_lib_num)("head",chain_plug->chain( ).head_block_num( )));
-    return( sync_last_requested_num != sync_known_lib_num ||
-            chain_plug->chain( ).head_block_num( ) < sync_last_requested_num );
+    return chain_plug->chain( ).head_block_num( ) < sync_known_lib_num;
   }
 
-  void sync_manager::assign_chunk( connection_ptr c ) {
-    uint32_t start = 0;
-    uint32_t end = 0;
+  void sync_manager::start_workers( uint32_t count ) {
+    worker_work.reset( new boost::asio::io_service::work( worker_ios ) );
+    for( uint32_t i = 0; i < count; ++i ) {
+      worker_threads.emplace_back( [this]( ) { worker_ios.run( ); } );
+    }
+  }
+
+  void sync_manager::stop_workers( ) {
+    worker_work.reset( );
+    worker_ios.stop( );
+    for( auto &t : worker_threads ) {
+      t.join( );
+    }
+    worker_threads.clear( );
+  }
 
-    if( !partial_chunks.empty( ) ) {
-      c->sync_receiving = partial_chunks.front( );
-      partial_chunks.pop_front( );
-      start = c->sync_receiving->last + 1;
-      end = c->sync_receiving->end_block;
+  void sync_manager::request_more( connection_ptr c ) {
+    if( !c->connected( ) || !syncing( ) ) {
+      return;
     }
-    else if( sync_last_requested_num != sync_known_lib_num ) {
-      start = sync_last_requested_num + 1;
-      end = ( start + sync_req_span - 1 );
-      if( end > sync_known_lib_num )
-        end = sync_known_lib_num;
-      if( end > 0 && end >= start ) {
-        fc_dlog(logger, "conn ${n} recv blks ${s} to ${e}",("n",c->peer_name() )("s",start)("e",end));
-        c->sync_receiving.reset(new sync_state( start, end, sync_last_requested_num ) );
+    uint32_t head = chain_plug->chain( ).head_block_num( );
+    uint32_t peer_lib = c->last_handshake.last_irreversible_block_num;
+    uint32_t limit = std::min( { sync_known_lib_num, head + sync_window_size, peer_lib } );
+    if( sync_last_requested_num < head ) {
+      sync_last_requested_num = head;
+    }
+
+    while( c->sync_receiving.size( ) < def_sync_max_in_flight ) {
+      sync_state_ptr ss;
+      for( auto pos = partial_chunks.begin( ); pos != partial_chunks.end( ); ) {
+        if( ( *pos )->end_block <= head ) {
+          pos = partial_chunks.erase( pos );
+        }
+        else if( ( *pos )->end_block <= peer_lib ) {
+          uint32_t start = std::max( ( *pos )->start_block, head + 1 );
+          ss = std::make_shared<sync_state>( start, ( *pos )->end_block, start - 1 );
+          partial_chunks.erase( pos );
+          break;
+        }
+        else {
+          ++pos;
+        }
+      }
+      if( !ss ) {
+        if( sync_last_requested_num >= limit ) {
+          break;
+        }
+        uint32_t start = sync_last_requested_num + 1;
+        uint32_t end = std::min( start + c->sync_span - 1, limit );
+        ss = std::make_shared<sync_state>( start, end, start - 1 );
+        sync_last_requested_num = end;
       }
+      fc_dlog(logger, "conn ${n} recv blks ${s} to ${e}",("n",c->peer_name() )("s",ss->start_block)("e",ss->end_block));
+      c->sync_receiving.push_back( ss );
+      c->enqueue( (sync_request_message){ss->start_block, ss->end_block} );
     }
-    else {
-      fc_dlog(logger, "conn ${n} resetting sync recv",("n",c->peer_name() ));
-      c->sync_receiving.reset ( );
+  }
+
+  void sync_manager::request_all( ) {
+    if( !syncing( ) ) {
+      return;
     }
-    if( end > 0 && end >= start ) {
-      c->enqueue( (sync_request_message){start, end} );
-      sync_last_requested_num = end;
+    // the best scoring peers get the next chunks
+    vector<connection_ptr> peers;
+    for( auto &c : my_impl->connections ) {
+      if( c->connected( ) ) {
+        peers.push_back( c );
+      }
+    }
+    std::stable_sort( peers.begin( ), peers.end( ), []( const connection_ptr &a, const connection_ptr &b ) {
+        return a->sync_rate > b->sync_rate;
+      });
+    for( auto &c : peers ) {
+      request_more( c );
     }
   }
 
-    struct postcache : public fc::visitor<void> {
-      chain_plugin * chain_plug;
-      postcache (chain_plugin *cp) : chain_plug (cp) {}
+  void sync_manager::drop_chunks( connection_ptr c, bool penalize ) {
+    for( auto &ss : c->sync_receiving ) {
+      fc_dlog(logger, "conn ${n} losing recv blks ${s} to ${e}",("n",c->peer_name() )("s",ss->start_block)("e",ss->end_block));
+      auto pos = partial_chunks.begin( );
+      while( pos != partial_chunks.end( ) && ( *pos )->start_block < ss->start_block ) {
+        ++pos;
+      }
+      partial_chunks.insert( pos, ss );
+    }
+    c->sync_receiving.clear( );
+    if( penalize ) {
+      c->sync_rate /= 2;
+      c->sync_span = std::max( c->sync_span / 2, 1u );
+    }
+    request_all( );
+  }
 
-      void operator( )(const signed_block &block) const
-      {
-        try {
-          chain_plug->accept_block( block,true );
-        } catch( const unlinkable_block_exception &ex ) {
-          elog( "post cache: unlinkable_block_exception accept block #${n}",("n",block.block_num()));
-        } catch (const assert_exception &ex) {
-          elog ("post cache: unable to accept block on assert exception ${n}",("n",ex.what()));
-        } catch (const fc::exception &ex) {
-          elog ("post cache: accept_block threw a non-assert exception ${x}", ("x",ex.what()));
-        } catch (...) {
-          elog ("post cache: unknown error accepting cached block");
+  void sync_manager::reset_requests( ) {
+    sync_window.clear( );
+    partial_chunks.clear( );
+    for( auto &c : my_impl->connections ) {
+      if( !c->sync_receiving.empty( ) ) {
+        c->sync_receiving.clear( );
+        if( c->connected( ) ) {
+          c->enqueue( (sync_request_message){0,0} );
         }
       }
+    }
+    sync_last_requested_num = chain_plug->chain( ).head_block_num( );
+    request_all( );
+  }
 
-      template <typename T> void operator()(const T &msg) const { /* no-op */ }
-    };
+  void sync_manager::precompute_block( connection_ptr c, shared_ptr<signed_block> block ) {
+    bool signature_keys = !chain_plug->is_skipping_transaction_signatures( );
+    worker_ios.post( [this, c, block, signature_keys]( ) {
+        sync_block blk;
+        blk.source = c;
+        blk.block = block;
+        try {
+          blk.precomputed = std::make_shared<chain_controller::block_precomputed>(
+            chain_controller::precompute_block( *blk.block, signature_keys ) );
+        } catch( const fc::exception &ex ) {
+          // left for accept_block to reject on the application thread
+          fc_dlog(logger, "unable to precompute block #${n}: ${x}",("n",blk.block->block_num())("x",ex.what()));
+        }
+        app( ).get_io_service( ).post( [this, c, blk]( ) {
+            recv_block( c, blk );
+          });
+      });
+  }
 
-    void sync_manager::apply_chunk( sync_state_ptr ss) {
-      postcache pc(chain_plug);
-      for( auto & blk : ss->block_cache) {
-        auto block = fc::raw::unpack<net_message>( blk );
-        block.visit( pc);
+  void sync_manager::recv_block( connection_ptr c, sync_block blk ) {
+    uint32_t num = blk.block->block_num( );
+    auto chunk = std::find_if( c->sync_receiving.begin( ), c->sync_receiving.end( ), [num]( const sync_state_ptr &ss ) {
+        return ss->start_block <= num && num <= ss->end_block;
+      });
+    if( chunk != c->sync_receiving.end( ) ) {
+      sync_state_ptr ss = *chunk;
+      ss->last = std::max( ss->last, num );
+      if( ++ss->received == ss->end_block - ss->start_block + 1 ) {
+        // score the peer on the time since it started on this chunk
+        time_point now = time_point::now( );
+        fc::microseconds elapsed = now - std::max( ss->start_time, c->sync_mark );
+        double rate = ss->received * 1000000.0 / std::max<int64_t>( elapsed.count( ), 1 );
+        c->sync_rate = c->sync_rate > 0 ? 0.75 * c->sync_rate + 0.25 * rate : rate;
+        c->sync_mark = now;
+        if( elapsed < fc::microseconds( std::chrono::duration_cast<std::chrono::microseconds>( my_impl->resp_expected_period ).count( ) / 4 ) ) {
+          c->sync_span = std::min( c->sync_span * 2, std::max( sync_window_size / def_sync_max_in_flight, 1u ) );
+        }
+        c->sync_receiving.erase( chunk );
       }
     }
+    else {
+      fc_dlog(logger, "conn ${n} sent block #${b} outside of its chunks",("n",c->peer_name())("b",num));
+    }
 
-    void sync_manager::take_chunk( connection_ptr c) {
-      if( !c->sync_receiving) {
-        elog( "take_chunk called, but sync_receiving is empty");
-        return;
-      }
-      sync_state_ptr ss;
-      c->sync_receiving.swap(ss);
-      fc_dlog(logger, "conn ${n} losing recv blks ${s} to ${e}",("n",c->peer_name() )("s",ss->start_block)("e",ss->end_block));
+    uint32_t head = chain_plug->chain( ).head_block_num( );
+    if( num > head && num <= head + sync_window_size ) {
+      sync_window.emplace( num, std::move( blk ) );
+    }
+    apply_window( );
 
-      if( !ss->block_cache.empty()) {
-        if( ss->last < ss->end_block) {
-          partial_chunks.push_back( ss );
-          return;
-        }
+    if( !c->sync_receiving.empty( ) ) {
+      c->sync_wait( );
+    }
+    request_all( );
+  }
 
-        if( ss->start_block != chain_plug->chain().last_irreversible_block_num() + 1) {
-          bool found = false;
-          for( auto pos = full_chunks.begin(); !found && pos != full_chunks.end(); ++pos) {
-            if( ss->end_block <( *pos)->start_block) {
-              full_chunks.insert( pos,ss);
-              found = true;
-            }
-          }
-          if( !found) {
-            full_chunks.push_back( ss); //either full chunks is empty or pos ran off the end
-          }
+  void sync_manager::apply_window( ) {
+    chain_controller &cc = chain_plug->chain( );
+    bool applied = false;
+    while( !sync_window.empty( ) && sync_window.begin( )->first <= cc.head_block_num( ) + 1 ) {
+      auto blk = sync_window.begin( );
+      if( blk->first <= cc.head_block_num( ) ) {
+        sync_window.erase( blk );
+        continue;
+      }
+      bool accepted = false;
+      try {
+        if( blk->second.precomputed ) {
+          chain_plug->accept_block( *blk->second.block, true, *blk->second.precomputed );
         }
         else {
-          apply_chunk( ss);
+          chain_plug->accept_block( *blk->second.block, true );
         }
-      }
-      while( !full_chunks.empty()) {
-        auto chunk = full_chunks.front();
-        if( chunk->start_block == chain_plug->chain().head_block_num() + 1) {
-          apply_chunk( chunk);
-          if( chunk->last == chunk->end_block ) {
-            full_chunks.pop_front();
-          }
-          else {
-            chunk->start_block = chunk->last+1;
-            break;
-          }
+        accepted = true;
+      } catch( const unlinkable_block_exception &ex ) {
+        elog( "sync window: unlinkable_block_exception accept block #${n}",("n",blk->first));
+      } catch( const assert_exception &ex ) {
+        elog( "sync window: unable to accept block on assert exception ${n}",("n",ex.what()));
+      } catch( const fc::exception &ex ) {
+        elog( "sync window: accept_block threw a non-assert exception ${x}",( "x",ex.what()));
+      } catch( ... ) {
+        elog( "sync window: unknown error accepting block");
+      }
+      if( !accepted ) {
+        auto source = blk->second.source.lock( );
+        if( source ) {
+          source->sync_rate = 0;
+          source->sync_span = 1;
+          source->enqueue( go_away_message( go_away_reason::unlinkable ) );
         }
-        else
-          break;
+        // everything requested past the bad block is refetched
+        reset_requests( );
+        return;
       }
+      sync_window.erase( blk );
+      applied = true;
+    }
 
-      if( chain_plug->chain().head_block_num() == sync_known_lib_num ) {
-        handshake_message hello;
-        handshake_initializer::populate(hello);
-        fc_dlog(logger, "All caught up with last known last irreversible block resending handshake");
-        for( auto &ci : my_impl->connections) {
-          if( ci->current()) {
-            hello.generation = ++ci->sent_handshake_count;
-            fc_dlog(logger, "send to ${p}", ("p",ci->peer_name()));
-            ci->enqueue( hello );
-          }
+    if( applied && cc.head_block_num( ) == sync_known_lib_num ) {
+      handshake_message hello;
+      handshake_initializer::populate(hello);
+      fc_dlog(logger, "All caught up with last known last irreversible block resending handshake");
+      for( auto &ci : my_impl->connections) {
+        if( ci->current()) {
+          hello.generation = ++ci->sent_handshake_count;
+          fc_dlog(logger, "send to ${p}", ("p",ci->peer_name()));
+          ci->enqueue( hello );
         }
       }
-      if( c->connected()) {
-        assign_chunk( c);
-      }
     }
+  }
 
-    void sync_manager::start_sync( connection_ptr c, uint32_t target) {
-      if( !syncing()) {
-        sync_last_requested_num = chain_plug->chain().head_block_num();
-      }
-      ilog( "Catching up with chain, our last req is ${cc}, theirs is ${t}",
-           ( "cc",sync_last_requested_num)("t",target));
-      if( target > sync_known_lib_num) {
-        sync_known_lib_num = target;
-      }
-      if( c->sync_receiving && c->sync_receiving->end_block > 0) {
-        return;
-      }
-      assign_chunk( c);
+  void sync_manager::start_sync( connection_ptr c, uint32_t target) {
+    if( target > sync_known_lib_num) {
+      sync_known_lib_num = target;
     }
+    ilog( "Catching up with chain, our last req is ${cc}, theirs is ${t}",
+          ( "cc",sync_last_requested_num)("t",target));
+    request_more( c);
+  }
 
   void sync_manager::reassign_fetch( connection_ptr c) {
 #warning( "TODO: migrate remaining fetch requests to other peers");
@@ -1175,30 +1440,40 @@ namespace eosio {
       auto current_endpoint = *endpoint_itr;
       ++endpoint_itr;
       c->connecting = true;
-      c->socket->async_connect( current_endpoint,
-                           [c, endpoint_itr, this]
-                          (  const boost::system::error_code& err ) {
-                             if( !err ) {
-                               start_session( c );
-                             } else {
-                               if( endpoint_itr != tcp::resolver::iterator() ) {
-                                 c->close();
-                                 connect( c, endpoint_itr );
-                               }
-                               else {
-                                 elog( "connection failed to ${peer}: ${error}",
-                                       ( "peer", c->peer_name())("error",err.message()));
-                                 c->connecting = false;
-                                 c->close();
-                               }
-                             }
-                           } );
+      c->strand.post( [c, current_endpoint, endpoint_itr, this]( ) {
+          c->socket->async_connect( current_endpoint,
+                                    [c, endpoint_itr, this]( const boost::system::error_code& ec ) {
+                                      app().get_io_service().post( [c, endpoint_itr, ec, this]( ) {
+                                          connected( c, endpoint_itr, ec );
+                                        });
+                                    });
+        });
+    }
+
+    void net_plugin_impl::connected( connection_ptr c, tcp::resolver::iterator endpoint_itr, const boost::system::error_code& err ) {
+      if( !err ) {
+        c->socket_open = true;
+        start_session( c );
+      } else {
+        if( endpoint_itr != tcp::resolver::iterator() ) {
+          c->close();
+          connect( c, endpoint_itr );
+        }
+        else {
+          elog( "connection failed to ${peer}: ${error}",
+                ( "peer", c->peer_name())("error",err.message()));
+          c->connecting = false;
+          c->close();
+        }
+      }
     }
 
     void net_plugin_impl::start_session( connection_ptr con ) {
-      boost::asio::ip::tcp::no_delay option( true );
-      con->socket->set_option( option );
-      start_read_message( con );
+      con->strand.post( [con, this]( ) {
+          boost::system::error_code ec;
+          con->socket->set_option( boost::asio::ip::tcp::no_delay( true ), ec );
+          start_read_message( con );
+        });
       con->send_handshake( );
 
       // for now, we can just use the application main loop.
@@ -1208,7 +1483,7 @@ namespace eosio {
 
 
     void net_plugin_impl::start_listen_loop( ) {
-      auto socket = std::make_shared<tcp::socket>( std::ref( app().get_io_service() ) );
+      auto socket = std::make_shared<tcp::socket>( std::ref( net_ios ) );
       acceptor->async_accept( *socket, [socket,this]( boost::system::error_code ec ) {
           if( !ec ) {
             if( max_client_count == 0 || num_clients < max_client_count ) {
@@ -1231,52 +1506,104 @@ namespace eosio {
     void net_plugin_impl::start_read_message( connection_ptr conn ) {
       connection_wptr c( conn);
       conn->socket->async_read_some(
-        boost::asio::buffer(&conn->pending_message_buffer[conn->pending_message_write_index],
-                            conn->pending_message_buffer.size() - conn->pending_message_write_index),
-        [this,c]( boost::system::error_code ec, std::size_t bytes_transferred ) {
+        conn->pending_message_buffer.write_buffers(),
+        conn->strand.wrap( [this,c]( boost::system::error_code ec, std::size_t bytes_transferred ) {
+          connection_ptr conn = c.lock();
+          if (!conn) {
+            return;
+          }
           if( !ec ) {
-            connection_ptr conn = c.lock();
-            if (!conn) {
-              return;
-            }
-            conn->pending_message_write_index += bytes_transferred;
-            while (conn->pending_message_read_index < conn->pending_message_write_index) {
-              uint32_t bytes_in_buffer = conn->pending_message_write_index - conn->pending_message_read_index;
-              if (bytes_in_buffer < message_header_size) {
-                break;
-              } else {
-                // Ignore byte-ordering concerns
-                uint32_t message_length;
-                memcpy(&message_length, &conn->pending_message_buffer[conn->pending_message_read_index], sizeof(message_length));
-                if (bytes_in_buffer >= message_header_size + message_length) {
-                  if (!conn->process_next_message(*this, message_length)) {
-                    return;
-                  }
-                } else {
-                  conn->adjust_buffer_size(message_length);
-                  break;
-                }
+            conn->pending_message_buffer.advance_write( bytes_transferred );
+            read_messages( conn );
+          } else if( ec != boost::asio::error::operation_aborted ) {
+            elog( "Error reading message from connection: ${m}",( "m", ec.message() ) );
+            app().get_io_service().post( [this, conn]( ) {
+                close( conn );
+              });
+          }
+        })
+      );
+    }
+
+    void net_plugin_impl::read_messages( connection_ptr conn ) {
+      while (conn->pending_message_buffer.bytes_to_read() >= message_header_size) {
+        if (conn->inbound_pending >= def_max_inbound_pending) {
+          // dispatch_inbound resumes reading once the application thread catches up
+          conn->read_paused = true;
+          return;
+        }
+        // Ignore byte-ordering concerns
+        uint32_t message_length;
+        conn->pending_message_buffer.copy( 0, sizeof(message_length), reinterpret_cast<char*>(&message_length) );
+        if (message_length > def_max_message_size) {
+          elog( "message of ${l} bytes is too large",( "l",message_length) );
+          app().get_io_service().post( [this, conn]( ) {
+              close( conn );
+            });
+          return;
+        }
+        if (conn->pending_message_buffer.bytes_to_read() < message_header_size + message_length) {
+          break;
+        }
+        if (!conn->process_next_message(*this, message_length)) {
+          return;
+        }
+      }
+      start_read_message(conn);
+    }
+
+    void net_plugin_impl::post_inbound( received_message* msg ) {
+      inbound.push( msg );
+      if( !inbound_posted.exchange( true ) ) {
+        app().get_io_service().post( [this]( ) {
+            dispatch_inbound( );
+          });
+      }
+    }
+
+    void net_plugin_impl::dispatch_inbound( ) {
+      // cleared first so that a message pushed while draining posts another dispatch
+      inbound_posted = false;
+      received_message* next;
+      while( inbound.pop( next ) ) {
+        unique_ptr<received_message> msg( next );
+        connection_ptr c = msg->conn;
+        if( c->socket_open ) {
+          try {
+            if( msg->block ) {
+              if( !c->sync_receiving.empty() && sync_master->has_workers() ) {
+                // blocks we are syncing are checked on a sync worker
+                sync_master->precompute_block( c, msg->block );
+              }
+              else {
+                handle_message( c, *msg->block, msg->frame, msg->block_id );
               }
             }
-            if (conn->pending_message_read_index == conn->pending_message_write_index) {
-              // Buffer is empty, reset indices
-              conn->pending_message_read_index = 0;
-              conn->pending_message_write_index = 0;
+            else {
+              msgHandler m( *this, c );
+              msg->msg.visit( m );
             }
-            start_read_message(conn);
-          } else {
-            elog( "Error reading message from connection: ${m}",( "m", ec.message() ) );
-            close( c.lock() );
+          } catch( const fc::exception& e ) {
+            edump((e.to_detail_string() ));
+            close( c );
           }
         }
-      );
+        if( --c->inbound_pending == def_max_inbound_pending / 2 ) {
+          c->strand.post( [this, c]( ) {
+              if( c->read_paused && c->socket->is_open() ) {
+                c->read_paused = false;
+                read_messages( c );
+              }
+            });
+        }
+      }
     }
 
   size_t net_plugin_impl::count_open_sockets () const
   {
     size_t count = 0;
     for( auto &c : connections) {
-      if (c->socket->is_open())
+      if (c->socket_open)
         ++count;
     }
     return count;
@@ -1285,9 +1612,14 @@ namespace eosio {
 
     template<typename VerifierFunc>
     void net_plugin_impl::send_all( const net_message &msg, VerifierFunc verify) {
+      // packed once and shared by every peer it goes to
+      frame_ptr frame;
       for( auto &c : connections) {
         if( c->current() && verify( c)) {
-          c->enqueue( msg );
+          if( !frame ) {
+            frame = pack_frame( msg );
+          }
+          c->enqueue_frame( frame, msg.contains<go_away_message>() );
         }
       }
     }
@@ -1400,10 +1732,7 @@ namespace eosio {
   }
 
     void net_plugin_impl::handle_message (connection_ptr c, const time_message &msg) {
-      /* We've already lost however many microseconds it took to dispatch
-       * the message, but it can't be helped.
-       */
-      msg.dst = c->get_time();
+      // msg.dst was set by the network thread when the message was read
 
       // If the transmit timestamp is zero, the peer is horribly broken.
       if(msg.xmt == 0)
@@ -1458,11 +1787,10 @@ namespace eosio {
         req.req_trx.pending = 0;
         for( const auto& t : msg.known_trx.ids ) {
           const auto &tx = my_impl->local_txns.get<by_id>( ).find( t );
+          c->trx_inventory.insert( t );
           if( tx == my_impl->local_txns.end( ) ) {
-            c->trx_state.insert( ( transaction_state ){ t,true,true,( uint32_t ) - 1,
-                fc::time_point( ),fc::time_point( ) } );
             if( !sync_master->syncing( ) ) {
-              fwd.known_trx.ids.push_back( t );
+              queue_notice( t );
             }
             req.req_trx.ids.push_back( t );
           }
@@ -1495,8 +1823,7 @@ namespace eosio {
           }
         }
       }
-      if( msg.known_trx.pending == 0 && (fwd.known_trx.ids.size() > 0 ||
-                                         fwd.known_blocks.ids.size() > 0) ) {
+      if( msg.known_trx.pending == 0 && fwd.known_blocks.ids.size() > 0 ) {
         send_all( fwd, [c,fwd](connection_ptr cptr) -> bool {
             return cptr != c;
           });
@@ -1541,117 +1868,163 @@ namespace eosio {
       fc_dlog(logger, "got a sync_request_message from ${p}", ("p",c->peer_name()));
       if( msg.end_block == 0) {
         c->sync_requested.reset();
+        c->sync_requests_pending.clear();
+      } else if( c->sync_requested) {
+        c->sync_requests_pending.emplace_back( std::make_shared<sync_state>( msg.start_block,msg.end_block,msg.start_block-1));
       } else {
         c->sync_requested.reset(new sync_state( msg.start_block,msg.end_block,msg.start_block-1));
         c->enqueue_sync_block();
       }
     }
 
-    void net_plugin_impl::handle_message( connection_ptr c, const block_summary_message &msg) {
-      fc_dlog(logger, "got a block_summary_message from ${p}", ("p",c->peer_name()));
-      fc_dlog(logger, "bsm header = ${h}",("h",msg.block_header));
-      fc_dlog(logger, "txn count = ${c}", ("c",msg.trx_ids.size()));
+    void net_plugin_impl::handle_message( connection_ptr c, const compact_block_message &msg) {
+      block_id_type blk_id = msg.block_header.id();
+      fc_dlog(logger, "got a compact_block_message #${n} from ${p}", ("n",msg.block_header.block_num())("p",c->peer_name()));
 
-      const auto& itr = c->block_state.get<by_id>();
-      auto bs = itr.find(msg.block_header.id());
+      auto bs = c->block_state.find(blk_id);
       if( bs == c->block_state.end()) {
-        c->block_state.insert( (block_state){msg.block_header.id(),true,true,fc::time_point()});
-        send_all( msg, [c](connection_ptr cptr) -> bool {
-            return cptr != c;
-          });
-      } else {
-        if( !bs->is_known) {
-          c->block_state.modify (bs, make_known());
-          send_all( msg, [c](connection_ptr cptr) -> bool {
-              return cptr != c;
-            });
-        }
+        c->block_state.insert( (block_state){blk_id,true,true,fc::time_point()});
+      } else if( !bs->is_known) {
+        c->block_state.modify (bs, make_known());
       }
 
-      signed_block sb;
-      bool fetch_error = false;
       chain_controller &cc = chain_plug->chain();
-      if( !cc.is_known_block(msg.block_header.id()) ) {
-        sb.previous = msg.block_header.previous;
-        sb.timestamp = msg.block_header.timestamp;
-        sb.transaction_merkle_root = msg.block_header.transaction_merkle_root;
-        sb.producer_changes = msg.block_header.producer_changes;
-        sb.producer = msg.block_header.producer;
-        sb.producer_signature = msg.block_header.producer_signature;
-
-        for( auto &cyc : msg.trx_ids ) {
-          fc_dlog(logger, "cycle count = ${c}", ("c",cyc.size()));
-          if( cyc.size() == 0 ) {
-            continue;
-          }
-          sb.cycles.emplace_back( eosio::chain::cycle( ) );
-          eosio::chain::cycle &sbcycle = sb.cycles.back( );
-          for( auto &cyc_thr_id : cyc ) {
-            fc_dlog(logger, "cycle user theads count = ${c}", ("c",cyc_thr_id.user_trx.size()));
-            if (cyc_thr_id.user_trx.size() == 0) {
-              continue;
-            }
-            sbcycle.emplace_back( eosio::chain::thread( ) );
-            eosio::chain::thread &cyc_thr = sbcycle.back();
-            /*
-            for( auto &gt : cyc_thr_id.gen_trx ) {
-              try {
-                auto gen = cc.get_generated_transaction( gt );
-                cyc_thr.generated_input.push_back( processed_generated_transaction( gen ) );
-              } catch ( const exception &ex) {
-                fetch_error = true;
-                elog( "unable to retieve generated transaction, caught {ex}", ("ex",ex) );
-                break;
-              } catch ( ... ) {
-                fetch_error = true;
-                elog( "unable to retieve generated transaction" );
-                break;
-              }
-            }
-            */
-            for( auto &ut : cyc_thr_id.user_trx ) {
-              // auto ltxn = local_txns.get<by_id>().find(ut);
-
-              try {
-                processed_transaction pt(cc.get_recent_transaction(ut.id));
-                pt.output = ut.outmsgs;
-                cyc_thr.user_input.emplace_back(pt);
-
-                fc_dlog(logger, "Found the transaction");
-              } catch ( const exception &ex) {
-                fetch_error = true;
-                elog( "unable to retieve user transaction, caught {ex}", ("ex",ex) );
-                break;
-              } catch ( ... ) {
-                fetch_error = true;
-                elog( "unable to retieve user transaction" );
-                break;
-              }
-            }
-            if( fetch_error ){
-              break;
+      if( cc.is_known_block(blk_id) || c->pending_compact_blocks.count(blk_id) ) {
+        return;
+      }
+
+      pending_compact_block pcb( msg );
+      for( const auto &t : local_txns ) {
+        if( t.packed_transaction ) {
+          pcb.match( t.id, *t.packed_transaction );
+        }
+      }
+      pcb.end_matching();
+
+      fc_dlog(logger, "compact block #${n} has ${t} transactions, ${m} missing",
+              ("n",msg.block_header.block_num())("t",pcb.transaction_count())("m",pcb.missing().size()));
+
+      if( pcb.missing().empty() ) {
+        accept_compact_block( c, pcb );
+        return;
+      }
+
+      // drop requests for blocks that were applied or passed by in the meantime
+      uint32_t head_num = cc.head_block_num();
+      for( auto itr = c->pending_compact_blocks.begin(); itr != c->pending_compact_blocks.end(); ) {
+        if( itr->second.compact().block_header.block_num() <= head_num ||
+            c->pending_compact_blocks.size() >= def_max_pending_compact ) {
+          itr = c->pending_compact_blocks.erase( itr );
+        } else {
+          ++itr;
+        }
+      }
+      c->enqueue( compact_block_request_message{ blk_id, pcb.missing() } );
+      c->pending_compact_blocks.emplace( blk_id, std::move(pcb) );
+    }
+
+    void net_plugin_impl::handle_message( connection_ptr c, const compact_block_request_message &msg) {
+      fc_dlog(logger, "got a compact_block_request_message for ${n} transactions from ${p}", ("n",msg.indexes.size())("p",c->peer_name()));
+      compact_block_transactions_message reply;
+      reply.block_id = msg.block_id;
+
+      optional<signed_block> b;
+      try {
+        b = chain_plug->chain().fetch_block_by_id( msg.block_id );
+      } catch( const assert_exception &ex ) {
+        elog( "caught assert on fetch_block_by_id, ${ex}",("ex",ex.what()));
+      }
+      if( b ) {
+        vector<const processed_transaction*> user_input;
+        for( const auto &cyc : b->cycles ) {
+          for( const auto &thr : cyc ) {
+            for( const auto &ut : thr.user_input ) {
+              user_input.push_back( &ut );
             }
           }
-          if( fetch_error ){
+        }
+        reply.transactions.reserve( msg.indexes.size() );
+        for( auto index : msg.indexes ) {
+          if( index >= user_input.size() ) {
+            reply.transactions.clear();
             break;
           }
+          reply.transactions.emplace_back( *user_input[index] );
         }
+      }
+      c->enqueue( reply );
+    }
 
-        try {
-          fc_dlog(logger, "calling accept block, fetcherror = ${fe}",("fe",fetch_error));
-          if( !fetch_error )
-            chain_plug->accept_block( sb, false );
-        } catch( const unlinkable_block_exception &ex) {
-          elog( "caught unlinkable block exception #${n}",("n",sb.block_num()));
-          c->enqueue( go_away_message( go_away_reason::unlinkable ));
-        } catch( const assert_exception &ex) {
-            // received a block due to out of sequence
-          elog( "caught assertion on block #${n} ${ex}",
-                ("n",sb.block_num())("ex",ex.what()));
-        } catch( ... ) {
-          elog( "unable to accept block, reason unknown" );
-        }
+    void net_plugin_impl::handle_message( connection_ptr c, const compact_block_transactions_message &msg) {
+      fc_dlog(logger, "got ${n} compact block transactions from ${p}", ("n",msg.transactions.size())("p",c->peer_name()));
+      auto itr = c->pending_compact_blocks.find( msg.block_id );
+      if( itr == c->pending_compact_blocks.end() ) {
+        return;
+      }
+      pending_compact_block pcb = std::move( itr->second );
+      c->pending_compact_blocks.erase( itr );
+
+      if( pcb.add_missing( msg.transactions ) ) {
+        accept_compact_block( c, pcb );
+      } else {
+        fc_dlog(logger, "peer could not supply the missing transactions, requesting the whole block");
+        request_message req;
+        req.req_trx.mode = id_list_modes::none;
+        req.req_blocks.mode = id_list_modes::normal;
+        req.req_blocks.ids.push_back( msg.block_id );
+        c->enqueue( req );
+      }
+    }
+
+    void net_plugin_impl::accept_compact_block( connection_ptr c, const pending_compact_block &pcb ) {
+      const auto &msg = pcb.compact();
+      auto sb = pcb.block();
+      if( !sb ) {
+        // a short id resolved to the wrong transaction, get the block as the producer made it
+        wlog( "compact block #${n} did not rebuild, requesting the whole block", ("n",msg.block_header.block_num()));
+        request_message req;
+        req.req_trx.mode = id_list_modes::none;
+        req.req_blocks.mode = id_list_modes::normal;
+        req.req_blocks.ids.push_back( msg.block_header.id() );
+        c->enqueue( req );
+        return;
       }
+
+      try {
+        chain_plug->accept_block( *sb, false );
+      } catch( const unlinkable_block_exception &ex) {
+        elog( "caught unlinkable block exception #${n}",("n",sb->block_num()));
+        c->enqueue( go_away_message( go_away_reason::unlinkable ));
+        return;
+      } catch( const assert_exception &ex) {
+        // received a block due to out of sequence
+        elog( "caught assertion on block #${n} ${ex}",
+              ("n",sb->block_num())("ex",ex.what()));
+        return;
+      } catch( ... ) {
+        elog( "unable to accept block, reason unknown" );
+        return;
+      }
+      send_compact_block( msg, c );
+    }
+
+    void net_plugin_impl::send_compact_block( const compact_block_message &msg, connection_ptr from ) {
+      block_id_type blk_id = msg.block_header.id();
+      send_all( msg, [from, blk_id](connection_ptr c) -> bool {
+          if( c == from ) {
+            return false;
+          }
+          const auto& bs = c->block_state.find(blk_id);
+          if( bs == c->block_state.end()) {
+            c->block_state.insert( (block_state){blk_id,true,true,fc::time_point()});
+            return true;
+          }
+          if( !bs->is_known ) {
+            c->block_state.modify( bs, make_known() );
+            return true;
+          }
+          return false;
+        });
     }
 
     void net_plugin_impl::handle_message( connection_ptr c, const signed_transaction &msg) {
@@ -1675,31 +2048,22 @@ namespace eosio {
       }
 
       if (entry != local_txns.end( ) ) {
-        local_txns.modify( entry, update_entry( msg ) );
+        local_txns.modify( entry, update_entry( msg, txnid ) );
       }
       else {
         cache_txn (txnid, msg);
       }
 
-      auto tx = c->trx_state.find(txnid);
-      if( tx == c->trx_state.end()) {
-        c->trx_state.insert((transaction_state){txnid,true,true,(uint32_t)msg.ref_block_num,
-              fc::time_point(),fc::time_point()});
-      } else {
-        struct trx_mod {
-          uint16 block;
-          trx_mod( uint16 bn) : block(bn) {}
-          void operator( )( transaction_state &t) {
-            t.is_known_by_peer = true;
-            t.block_num = static_cast<uint32_t>(block);
-          }
-        };
-        c->trx_state.modify(tx,trx_mod(msg.ref_block_num));
-      }
+      c->trx_inventory.insert( txnid );
 
       try {
         chain_plug->accept_transaction( msg );
         fc_dlog(logger, "chain accepted transaction" );
+        // it was cached before the pool held it, share the pool's packed copy from now on
+        auto cached = local_txns.get<by_id>().find( txnid );
+        if( cached != local_txns.end() ) {
+          local_txns.modify( cached, update_entry( msg, txnid ) );
+        }
       } catch( const fc::exception &ex) {
         // received a block due to out of sequence
         elog( "accept txn threw  ${m}",("m",ex.what()));
@@ -1710,10 +2074,15 @@ namespace eosio {
 
     }
 
-  void net_plugin_impl::handle_message( connection_ptr c, const signed_block &msg) {
+  void net_plugin_impl::handle_message( connection_ptr c, const signed_block &msg, frame_ptr frame,
+                                        const optional<block_id_type>& id ) {
     fc_dlog(logger, "got signed_block #${n} from ${p}", ("n",msg.block_num())("p",c->peer_name()));
+    if( !c->sync_receiving.empty()) {
+      sync_master->recv_block( c, sync_block{ std::make_shared<signed_block>( msg ), nullptr, c } );
+      return;
+    }
     chain_controller &cc = chain_plug->chain();
-    block_id_type blk_id = msg.id();
+    block_id_type blk_id = id ? *id : msg.id();
     try {
       if( cc.is_known_block(blk_id)) {
         return;
@@ -1726,34 +2095,15 @@ namespace eosio {
     fc::microseconds age( fc::time_point::now() - msg.timestamp);
     fc_dlog(logger, "got signed_block #${n} from ${p} block age in secs = ${age}",("n",msg.block_num())("p",c->peer_name())("age",age.to_seconds()));
 
-    bool has_chunk = false;
     uint32_t num = msg.block_num();
     bool syncing = sync_master->syncing();
     if( syncing ) {
-      has_chunk =( c->sync_receiving && c->sync_receiving->end_block > 0);
-
-      if( !has_chunk) {
-        if (c->sync_receiving)
-          elog("got a block while syncing but sync_receiving end block == 0 #${n}",
-             ( "n",num));
-        else
-          elog("got a block while syncing but no sync_receiving set #${n}",
-             ( "n",num));
-      }
-      else {
-        if( c->sync_receiving->last + 1 != num) {
-          wlog( "expected block ${next} but got ${num} ihnotinh got now",("next",c->sync_receiving->last+1)("num",num));
-          return;
-        }
-        c->sync_receiving->last = num;
-      }
+      elog("got a block while syncing but no chunk requested from this peer #${n}", ( "n",num));
     }
-    bool accepted = false;
     fc_dlog(logger, "last irreversible block = ${lib}", ("lib", cc.last_irreversible_block_num()));
     if( !syncing || num == cc.head_block_num()+1 ) {
       try {
         chain_plug->accept_block(msg, syncing);
-        accepted = true;
       } catch( const unlinkable_block_exception &ex) {
         elog( "handle signed block: unlinkable_block_exception accept block #${n} syncing",("n",num));
         c->enqueue( go_away_message( go_away_reason::unlinkable ));
@@ -1766,35 +2116,32 @@ namespace eosio {
       }
     }
 
-    if( has_chunk) {
-      if( !accepted) {
-        c->sync_receiving->block_cache.emplace_back(std::move(c->blk_buffer));
-      }
-
-      if( num == c->sync_receiving->end_block) {
-        sync_master->take_chunk( c);
-      } else {
-        c->sync_wait( );
-      }
-    }
-    else {
-      if (age < fc::seconds(3) && fc::raw::pack_size(msg) < just_send_it_max && !c->syncing ) {
-        fc_dlog(logger, "forwarding the signed block");
-        send_all( msg, [c, blk_id, num](connection_ptr conn) -> bool {
-            bool sendit = false;
-            if ( c != conn && !conn->syncing ) {
-              auto b = conn->block_state.get<by_id>().find(blk_id);
-              if (b == conn->block_state.end()) {
-                conn->block_state.insert( (block_state){blk_id,true,true,fc::time_point()});
-                sendit = true;
-              } else if (!b->is_known) {
-                conn->block_state.modify(b,make_known());
-                sendit = true;
-              }
+    if (age < fc::seconds(3) && fc::raw::pack_size(msg) < just_send_it_max && !c->syncing ) {
+      fc_dlog(logger, "forwarding the signed block");
+      auto verify = [c, blk_id, num](connection_ptr conn) -> bool {
+          bool sendit = false;
+          if ( c != conn && !conn->syncing ) {
+            auto b = conn->block_state.get<by_id>().find(blk_id);
+            if (b == conn->block_state.end()) {
+              conn->block_state.insert( (block_state){blk_id,true,true,fc::time_point()});
+              sendit = true;
+            } else if (!b->is_known) {
+              conn->block_state.modify(b,make_known());
+              sendit = true;
             }
-            fc_dlog(logger, "${action} block ${num} to ${c}",("action", sendit ? "sending " : "skipping ")("num",num)("c", conn->peer_name() ));
-            return sendit;
-          });
+          }
+          fc_dlog(logger, "${action} block ${num} to ${c}",("action", sendit ? "sending " : "skipping ")("num",num)("c", conn->peer_name() ));
+          return sendit;
+        };
+      if( frame ) {
+        for( auto &conn : connections ) {
+          if( conn->current() && verify( conn ) ) {
+            conn->enqueue_frame( frame );
+          }
+        }
+      }
+      else {
+        send_all( msg, verify );
       }
     }
   }
@@ -1833,7 +2180,7 @@ namespace eosio {
               wlog ("Peer keepalive ticked sooner than expected: ${m}", ("m", ec.message()));
           }
           for (auto &c : connections ) {
-            if (c->socket->is_open()) {
+            if (c->socket_open) {
               c->send_time();
             }
           }
@@ -1866,7 +2213,7 @@ namespace eosio {
       vector <connection_ptr> discards;
       num_clients = 0;
       for( auto &c : connections ) {
-        if( !c->socket->is_open() && !c->connecting) {
+        if( !c->socket_open && !c->connecting) {
           if( c->peer_addr.length() > 0) {
             connect(c);
           }
@@ -1891,26 +2238,21 @@ namespace eosio {
       if( c->peer_addr.empty( ) ) {
         --num_clients;
       }
-      if( c->sync_receiving)
-        sync_master->take_chunk( c);
       c->close();
+      if( !c->sync_receiving.empty())
+        sync_master->drop_chunks( c, false);
     }
 
 
   size_t net_plugin_impl::cache_txn (const transaction_id_type txnid,
                                      const signed_transaction& txn ) {
-      size_t packsiz = fc::raw::pack_size(txn);
-      size_t bufsiz = packsiz + sizeof(packsiz);
-      vector<char> buff(bufsiz);
-      fc::datastream<char*> ds( buff.data(), bufsiz);
-      ds.write( reinterpret_cast<char*>(&packsiz), sizeof(packsiz) );
-
-      fc::raw::pack( ds, txn );
+      packed_txn_ptr packed = pack_txn( txn, txnid );
+      size_t bufsiz = packed->size();
 
       uint16_t bn = static_cast<uint16_t>(txn.ref_block_num);
       node_transaction_state nts = {txnid,time_point::now(),
                                     txn.expiration,
-                                    buff,
+                                    packed,
                                     bn, true};
       local_txns.insert(nts);
       return bufsiz;
@@ -1927,33 +2269,52 @@ namespace eosio {
       fc_dlog(logger, "bufsiz = ${bs} max = ${max}",("bs", (uint32_t)bufsiz)("max", just_send_it_max));
 
       if( bufsiz <= just_send_it_max) {
-        send_all( txn, [txn, txnid](connection_ptr c) -> bool {
-            const auto& bs = c->trx_state.find(txnid);
-            bool unknown = bs == c->trx_state.end();
+        send_all( txn, [txnid](connection_ptr c) -> bool {
+            bool unknown = c->trx_inventory.insert( txnid );
             if( unknown) {
-              c->trx_state.insert(transaction_state({txnid,true,true,(uint32_t)-1,
-                      fc::time_point(),fc::time_point() }));
               fc_dlog(logger, "sending whole txn to ${n}", ("n",c->peer_name() ) );
             }
             return unknown;
           });
       }
       else {
-        fc_dlog(logger, "pending_notify, mode = ${m}, pending count = ${p}",("m",modes_str(pending_notify.mode))("p",pending_notify.pending));
-        pending_notify.ids.push_back( txnid );
-        notice_message nm = { pending_notify, ordered_blk_ids( ) };
-        send_all( nm, [txn, txnid](connection_ptr c) -> bool {
-            const auto& bs = c->trx_state.find(txnid);
-            bool unknown = bs == c->trx_state.end();
-            if( unknown) {
-              fc_dlog(logger, "sending notice to ${n}", ("n",c->peer_name() ) );
-              c->trx_state.insert(transaction_state({txnid,false,true,(uint32_t)-1,
-                      fc::time_point(),fc::time_point() }));
+        queue_notice( txnid );
+      }
+    }
+
+    void net_plugin_impl::queue_notice( const transaction_id_type& id ) {
+      // announced with the others that arrive before the notice timer fires
+      if( pending_notify.ids.empty() ) {
+        notice_timer->expires_from_now( txn_notice_period );
+        notice_timer->async_wait( [this]( boost::system::error_code ec ) {
+            if( !ec ) {
+              send_pending_notices( );
             }
-            return unknown;
           });
-        pending_notify.ids.clear();
       }
+      pending_notify.ids.push_back( id );
+    }
+
+    void net_plugin_impl::send_pending_notices( ) {
+      fc_dlog(logger, "announcing ${n} transactions",("n",pending_notify.ids.size()));
+      for( auto &c : connections ) {
+        if( !c->current( ) ) {
+          continue;
+        }
+        notice_message nm;
+        nm.known_trx.mode = pending_notify.mode;
+        nm.known_trx.pending = pending_notify.pending;
+        for( const auto &id : pending_notify.ids ) {
+          if( c->trx_inventory.insert( id ) ) {
+            nm.known_trx.ids.push_back( id );
+          }
+        }
+        if( !nm.known_trx.ids.empty( ) ) {
+          fc_dlog(logger, "sending notice of ${n} transactions to ${p}", ("n",nm.known_trx.ids.size())("p",c->peer_name() ) );
+          c->enqueue( nm );
+        }
+      }
+      pending_notify.ids.clear();
     }
 
     /**
@@ -1969,53 +2330,12 @@ namespace eosio {
         return;
       }
 
-      block_summary_message bsm = {sb, vector<cycle_ids>()};
-      vector<cycle_ids> &trxs = bsm.trx_ids;
-      if( !sb.cycles.empty()) {
-        for( const auto& cyc : sb.cycles) {
-          fc_dlog(logger, "cyc.size = ${cs}",( "cs", cyc.size()));
-          if( cyc.empty() ) {
-            continue;
-          }
-          trxs.emplace_back (cycle_ids());
-          cycle_ids &cycs = trxs.back();
-          fc_dlog(logger, "trxs.size = ${ts} cycles.size = ${cs}",("ts", trxs.size())("cs", cycs.size()));
-          for( const auto& thr : cyc) {
-            fc_dlog(logger, "user txns = ${ui} generated = ${gi}",("ui",thr.user_input.size( ))("gi",thr.generated_input.size( )));
-            if( thr.user_input.size( ) == 0 ) {
-              continue;
-            }
-            cycs.emplace_back (thread_ids());
-            thread_ids &thd_ids = cycs.back();
-
-            for( auto gi : thr.generated_input ) {
-              thd_ids.gen_trx.emplace_back( gi.id );
-            }
-
-            for( auto &ui : thr.user_input) {
-              processed_trans_summary pts ({ui.id( ),ui.output });
-              thd_ids.user_trx.emplace_back( pts );
-              fc_dlog(logger, "user txn has ${m} messages, summary has ${ms}", ("m",ui.output.size())("ms",pts.outmsgs.size()));
-            }
-          }
-        }
-      }
+      uint64_t salt;
+      fc::rand_pseudo_bytes( reinterpret_cast<char*>(&salt), sizeof(salt) );
+      auto cbm = make_compact_block( sb, salt );
 
-      fc_dlog(logger, "sending bsm with ${c} transactions",("c",trxs.size()));
-      fc_dlog(logger, "bsm header = ${h} txns = ${t}",("h",bsm.block_header)("t",bsm.trx_ids.size()));
-      if (bsm.trx_ids.size() > 0) {
-        fc_dlog(logger, "cycles.size = ${cs}",("cs", bsm.trx_ids[0].size()));
-        if (bsm.trx_ids[0].size()) {
-        }
-      }
-      send_all( bsm,[sb](connection_ptr c) -> bool {
-          const auto& bs = c->block_state.find(sb.id());
-          if( bs == c->block_state.end()) {
-            c->block_state.insert( (block_state){sb.id(),true,true,fc::time_point()});
-            return true;
-          }
-          return false;
-        });
+      fc_dlog(logger, "sending compact block #${n} with ${c} cycles",("n",sb.block_num())("c",cbm.cycles.size()));
+      send_compact_block( cbm, connection_ptr() );
     }
 
   void
@@ -2075,7 +2395,11 @@ namespace eosio {
      ( "remote-endpoint", bpo::value< vector<string> >()->composing(), "The IP address and port of a remote peer to sync with.")
      ( "public-endpoint", bpo::value<string>(), "Overrides the advertised listen endpointlisten ip address.")
      ( "agent-name", bpo::value<string>()->default_value("EOS Test Agent"), "The name supplied to identify this node amongst the peers.")
-      ( "send-whole-blocks", bpo::value<bool>()->default_value(def_send_whole_blocks), "True to always send full blocks, false to send block summaries" )
+      ( "send-whole-blocks", bpo::value<bool>()->default_value(def_send_whole_blocks), "True to always send full blocks, false to send compact blocks that peers rebuild from the transactions they already have" )
+     ( "net-threads", bpo::value<uint32_t>()->default_value(def_net_threads), "Number of threads that read, write and decode peer messages apart from the application thread")
+     ( "sync-threads", bpo::value<uint32_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "Number of worker threads that deserialize blocks and recover their signatures while syncing, 0 to do it on the main thread")
+     ( "sync-window", bpo::value<uint32_t>()->default_value(def_sync_window), "Maximum number of blocks past head that are fetched ahead while syncing")
+     ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_rec_span), "Number of blocks first requested per chunk from a peer while syncing, adjusted afterwards to how fast the peer is")
      ( "log-level-net-plugin", bpo::value<string>()->default_value("info"), "Log level: one of 'all', 'debug', 'info', 'warn', 'error', or 'off'")
       ;
   }
@@ -2105,12 +2429,20 @@ namespace eosio {
     my->network_version = def_network_version;
     my->send_whole_blocks = def_send_whole_blocks;
 
-    my->sync_master.reset( new sync_manager( def_sync_rec_span ) );
+    uint32_t sync_window = options.at( "sync-window" ).as<uint32_t>();
+    uint32_t sync_span = options.at( "sync-fetch-span" ).as<uint32_t>();
+    FC_ASSERT( sync_window > 0 && sync_span > 0, "sync-window and sync-fetch-span must be greater than 0" );
+    my->sync_master.reset( new sync_manager( std::min( sync_span, sync_window ), sync_window ) );
+    my->sync_threads = options.at( "sync-threads" ).as<uint32_t>();
+    my->net_thread_count = options.at( "net-threads" ).as<uint32_t>();
+    FC_ASSERT( my->net_thread_count > 0, "net-threads must be greater than 0" );
 
     my->connector_period = def_conn_retry_wait;
     my->txn_exp_period = def_txn_expire_wait;
+    my->txn_notice_period = def_txn_notice_wait;
     my->resp_expected_period = def_resp_expected_wait;
     my->just_send_it_max = def_max_just_send;
+    my->buffer_pool = std::make_shared<slab_pool>( def_slab_size, def_max_free_slabs );
     my->max_client_count = def_max_clients;
     my->num_clients = 0;
 
@@ -2161,6 +2493,7 @@ namespace eosio {
     ilog ("my node_id is ${id}",("id",my->node_id));
 
     my->keepalive_timer.reset(new boost::asio::steady_timer (app().get_io_service()));
+    my->notice_timer.reset(new boost::asio::steady_timer (app().get_io_service()));
     my->ticker();
     my->pending_notify.mode = id_list_modes::normal;
     my->pending_notify.pending = 0;
@@ -2178,6 +2511,15 @@ namespace eosio {
 
     my->chain_plug->chain().on_pending_transaction.connect( &net_plugin_impl::transaction_ready);
     my->start_monitors();
+    my->sync_master->start_workers( my->sync_threads );
+
+    ilog( "starting ${n} net threads", ("n", my->net_thread_count) );
+    my->net_work.reset( new boost::asio::io_service::work( my->net_ios ) );
+    for( uint32_t i = 0; i < my->net_thread_count; ++i ) {
+      my->net_threads.emplace_back( [this]( ) {
+          my->net_ios.run( );
+        });
+    }
 
     for( auto seed_node : my->supplied_peers ) {
       connection_ptr c = std::make_shared<connection>(seed_node);
@@ -2190,6 +2532,7 @@ namespace eosio {
     try {
       ilog( "shutdown.." );
       my->done = true;
+      my->sync_master->stop_workers();
       if( my->acceptor ) {
         ilog( "close acceptor" );
         my->acceptor->close();
@@ -2197,12 +2540,21 @@ namespace eosio {
         ilog( "close ${s} connections",( "s",my->connections.size()) );
         auto cons = my->connections;
         for( auto con : cons ) {
-          con->socket->close();
           my->close( con);
         }
 
         my->acceptor.reset(nullptr);
       }
+      my->net_work.reset();
+      my->net_ios.stop();
+      for( auto &t : my->net_threads ) {
+        t.join();
+      }
+      my->net_threads.clear();
+      received_message* msg;
+      while( my->inbound.pop( msg ) ) {
+        delete msg;
+      }
       ilog( "exit shutdown" );
     } FC_CAPTURE_AND_RETHROW() }
 
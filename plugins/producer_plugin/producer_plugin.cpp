@@ -160,6 +160,9 @@ void producer_plugin::plugin_startup()
             new_chain_banner(chain);
          my->_production_skip_flags |= eosio::chain::chain_controller::skip_undo_history_check;
       }
+      // with a single thread, the block to produce can be built as transactions arrive instead of in the slot
+      if (my->_production_scheduler == eosio::chain::block_schedule::in_single_thread)
+         chain.maintain_candidate_block(true);
       my->schedule_production_loop();
    } else
       elog("No producers configured! Please add producer IDs and private keys to configuration.");
@@ -13,10 +13,14 @@
 #include <ostream>
 #include <string>
 #include <boost/asio.hpp>
+#include <boost/algorithm/string.hpp>
+#include <fc/optional.hpp>
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
 #include <fc/exception/exception.hpp>
 
+#include "httpc.hpp"
+
 using boost::asio::ip::tcp;
 
 fc::variant call( const std::string& server, uint16_t port, 
@@ -116,3 +120,123 @@ fc::variant call( const std::string& server, uint16_t port,
     FC_ASSERT( !"unable to connect" );
   } FC_CAPTURE_AND_RETHROW( (server)(port)(path)(postdata) ) 
 }
+
+http_connection::http_connection( const std::string& server, uint16_t port )
+:_server(server), _socket(_io_service)
+{ try {
+   tcp::resolver resolver(_io_service);
+   tcp::resolver::query query(server, std::to_string(port));
+   for( auto itr = resolver.resolve(query); itr != tcp::resolver::iterator(); ++itr )
+      _endpoints.push_back(itr->endpoint());
+   FC_ASSERT( !_endpoints.empty(), "unable to resolve ${server}", ("server", server) );
+} FC_CAPTURE_AND_RETHROW( (server)(port) ) }
+
+void http_connection::connect() {
+   close();
+   boost::asio::connect(_socket, _endpoints.begin(), _endpoints.end());
+   _socket.set_option(tcp::no_delay(true));
+   _connected = true;
+   ++_connects;
+}
+
+void http_connection::close() {
+   boost::system::error_code ec;
+   _socket.close(ec);
+   _response.consume(_response.size());
+   _connected = false;
+}
+
+fc::variant http_connection::post( const std::string& path, const fc::variant& postdata ) {
+   std::string postjson;
+   if( !postdata.is_null() )
+      postjson = fc::json::to_string( postdata );
+   return post_json( path, postjson );
+}
+
+fc::variant http_connection::post_json( const std::string& path, const std::string& postjson )
+{ try {
+   fc::variant result;
+   try {
+      if( _connected && send(path, postjson, true, result) )
+         return result;
+
+      connect();
+      send(path, postjson, false, result);
+   } catch( ... ) {
+      // the connection is in an unknown state, somewhere in a request
+      close();
+      throw;
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (_server)(path) ) }
+
+bool http_connection::send( const std::string& path, const std::string& postjson, bool reused, fc::variant& result ) {
+
+   boost::asio::streambuf request;
+   std::ostream request_stream(&request);
+   request_stream << "POST " << path << " HTTP/1.1\r\n";
+   request_stream << "Host: " << _server << "\r\n";
+   request_stream << "content-length: " << postjson.size() << "\r\n";
+   request_stream << "Accept: */*\r\n";
+   request_stream << "Connection: keep-alive\r\n\r\n";
+   request_stream << postjson;
+
+   boost::system::error_code error;
+   boost::asio::write(_socket, request, error);
+   if( !error )
+      boost::asio::read_until(_socket, _response, "\r\n", error);
+   if( error ) {
+      close();
+      if( reused )
+         return false;
+      throw boost::system::system_error(error);
+   }
+
+   std::istream response_stream(&_response);
+   std::string http_version;
+   response_stream >> http_version;
+   unsigned int status_code;
+   response_stream >> status_code;
+   std::string status_message;
+   std::getline(response_stream, status_message);
+   FC_ASSERT( !(!response_stream || http_version.substr(0, 5) != "HTTP/"), "Invalid Response" );
+
+   // Read the response headers, which are terminated by a blank line, looking for how the body ends
+   boost::asio::read_until(_socket, _response, "\r\n\r\n");
+   std::string header;
+   fc::optional<size_t> content_length;
+   bool keep_alive = http_version != "HTTP/1.0";
+   while( std::getline(response_stream, header) && header != "\r" ) {
+      auto colon = header.find(':');
+      if( colon == std::string::npos )
+         continue;
+      auto name = boost::algorithm::to_lower_copy(header.substr(0, colon));
+      auto value = boost::algorithm::trim_copy(header.substr(colon + 1));
+      if( name == "content-length" )
+         content_length = std::stoull(value);
+      else if( name == "connection" )
+         keep_alive = !boost::algorithm::iequals(value, "close");
+   }
+
+   std::string body;
+   if( content_length ) {
+      if( _response.size() < *content_length )
+         boost::asio::read(_socket, _response, boost::asio::transfer_exactly(*content_length - _response.size()));
+      body.resize(*content_length);
+      response_stream.read(&body[0], body.size());
+   } else {
+      // Without a length the body ends when the server closes the connection
+      while( boost::asio::read(_socket, _response, boost::asio::transfer_at_least(1), error) ) {}
+      if( error != boost::asio::error::eof )
+         throw boost::system::system_error(error);
+      body.assign(std::istreambuf_iterator<char>(response_stream), std::istreambuf_iterator<char>());
+      keep_alive = false;
+   }
+   if( !keep_alive )
+      close();
+
+   FC_ASSERT( status_code == 200 || status_code == 201 || status_code == 202,
+              "Error code ${c}\n: ${msg}\n", ("c", status_code)("msg", body) );
+   result = fc::json::from_string(body);
+   return true;
+}
@@ -0,0 +1,47 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <boost/asio.hpp>
+#include <fc/variant.hpp>
+
+#include <string>
+#include <vector>
+
+fc::variant call( const std::string& server, uint16_t port,
+                  const std::string& path,
+                  const fc::variant& postdata = fc::variant() );
+
+/**
+ * An HTTP/1.1 connection which is kept open between requests, for clients making many of them
+ *
+ * The server is resolved once. When the server closes the connection after a response, or a kept connection turns out
+ * to have been closed before the request was read, the request is sent on a new connection, so callers never see the
+ * difference; connects() tells how often that happened.
+ */
+class http_connection {
+public:
+   http_connection( const std::string& server, uint16_t port );
+
+   fc::variant post( const std::string& path, const fc::variant& postdata = fc::variant() );
+   /// Posts a body which is already JSON, so it can be prepared ahead of time
+   fc::variant post_json( const std::string& path, const std::string& postjson );
+
+   uint64_t connects()const { return _connects; }
+
+private:
+   void connect();
+   void close();
+   /// @return false if a reused connection was closed before any of the response arrived
+   bool send( const std::string& path, const std::string& postjson, bool reused, fc::variant& result );
+
+   std::string                                   _server;
+   boost::asio::io_service                       _io_service;
+   std::vector<boost::asio::ip::tcp::endpoint>   _endpoints;
+   boost::asio::ip::tcp::socket                  _socket;
+   boost::asio::streambuf                        _response;
+   bool                                          _connected = false;
+   uint64_t                                      _connects = 0;
+};
@@ -0,0 +1,464 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include "load_generator.hpp"
+#include "httpc.hpp"
+
+#include <eos/chain/config.hpp>
+#include <eos/chain_plugin/chain_plugin.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+namespace eosio { namespace client {
+
+using namespace eosio::chain;
+
+namespace {
+   const std::string push_txn_batch_func = "/v1/chain/push_transaction_batch";
+   const std::string get_info_func = "/v1/chain/get_info";
+   const std::string get_block_func = "/v1/chain/get_block";
+
+   const name benchmark_account_base("benchmark");
+   const name exchange_account("exchange");
+   const name currency_account("currency");
+
+   /// the data of the currency contract's transfer message
+   struct currency_transfer {
+      uint64_t from;
+      uint64_t to;
+      uint64_t quantity;
+   };
+
+   /// the data of the exchange contract's buy message, laid out as the contract reads it
+   struct __attribute__((packed)) exchange_buy_order {
+      uint64_t           buyer;
+      uint64_t           number;
+      unsigned __int128  at_price;
+      uint64_t           quantity;
+      uint32_t           expiration;
+      uint8_t            fill_or_kill;
+   };
+   static_assert( sizeof(exchange_buy_order) == 45, "unexpected padding" );
+
+   name benchmark_account( uint32_t i ) {
+      return name(benchmark_account_base.value + i);
+   }
+
+   fc::time_point now() {
+      return fc::time_point::now();
+   }
+}
+
+void latency_histogram::record( fc::microseconds latency ) {
+   const uint64_t us = std::max<int64_t>(latency.count(), 0);
+   const auto bucket = bucket_of(us);
+   if( bucket >= _buckets.size() )
+      _buckets.resize(bucket + 1);
+   ++_buckets[bucket];
+   ++_count;
+   _max = std::max<int64_t>(_max, us);
+}
+
+void latency_histogram::merge( const latency_histogram& other ) {
+   if( other._buckets.size() > _buckets.size() )
+      _buckets.resize(other._buckets.size());
+   for( size_t i = 0; i < other._buckets.size(); ++i )
+      _buckets[i] += other._buckets[i];
+   _count += other._count;
+   _max = std::max(_max, other._max);
+}
+
+fc::microseconds latency_histogram::percentile( double fraction )const {
+   if( _count == 0 )
+      return fc::microseconds();
+   const uint64_t rank = std::max<uint64_t>(1, uint64_t(fraction * _count + 0.5));
+   uint64_t seen = 0;
+   for( size_t i = 0; i < _buckets.size(); ++i ) {
+      seen += _buckets[i];
+      if( seen >= rank )
+         return fc::microseconds(std::min<int64_t>(highest_in(i), _max));
+   }
+   return max();
+}
+
+// Values below 2 * sub_buckets have a bucket each; above that, each power of two is split into sub_buckets
+size_t latency_histogram::bucket_of( uint64_t us ) {
+   if( us < 2 * sub_buckets )
+      return us;
+   const uint32_t shift = 63 - __builtin_clzll(us) - 9;
+   return 2 * sub_buckets + (shift - 1) * sub_buckets + ((us >> shift) - sub_buckets);
+}
+
+uint64_t latency_histogram::highest_in( size_t bucket ) {
+   if( bucket < 2 * sub_buckets )
+      return bucket;
+   const uint32_t shift = (bucket - 2 * sub_buckets) / sub_buckets + 1;
+   const uint64_t mantissa = (bucket - 2 * sub_buckets) % sub_buckets + sub_buckets;
+   return ((mantissa + 1) << shift) - 1;
+}
+
+/// The transactions of one request, sent together
+struct load_request {
+   std::string                  body;
+   vector<transaction_id_type>  ids;
+   fc::microseconds             offset; ///< when the request is due, from the start of the run
+   fc::time_point               due;
+};
+
+class load_generator_impl {
+public:
+   load_generator_impl( const load_options& options )
+   :options(options), rng(std::random_device()())
+   {
+      FC_ASSERT( options.accounts >= 2, "must use at least 2 accounts" );
+      FC_ASSERT( options.rate > 0, "the rate must be positive" );
+      FC_ASSERT( options.connections > 0 && options.batch > 0, "at least one connection and one transaction per request" );
+      for( const auto& kind : options.mix ) {
+         FC_ASSERT( kind.first == "transfer" || kind.first == "currency" || kind.first == "exchange",
+                    "Unknown kind of transaction ${k}", ("k", kind.first) );
+         for( uint32_t i = 0; i < kind.second; ++i )
+            kinds.push_back(kind.first);
+      }
+      FC_ASSERT( !kinds.empty(), "the mix must have a kind of transaction with a weight" );
+   }
+
+   bool mixes( const std::string& kind )const {
+      return options.mix.count(kind) && options.mix.at(kind) > 0;
+   }
+
+   chain_apis::read_only::get_info_results get_info( http_connection& connection ) {
+      return connection.post(get_info_func).as<chain_apis::read_only::get_info_results>();
+   }
+
+   /// @param sign whether the benchmark accounts authorize trx, so it can be signed with the key they were created with
+   void reference( signed_transaction& trx, const chain_apis::read_only::get_info_results& info, fc::microseconds lifetime,
+                   bool sign = true ) {
+      trx.expiration = info.head_block_time + lifetime;
+      transaction_set_reference_block(trx, info.head_block_id);
+      std::sort(trx.scope.begin(), trx.scope.end());
+      if( sign && options.key )
+         trx.sign(*options.key, chain_id_type{});
+   }
+
+   std::string request_body( const vector<signed_transaction>& trxs ) {
+      chain_apis::read_write::push_transaction_batch_params params;
+      params.ids_only = true;
+      params.transactions.reserve(trxs.size());
+      for( const auto& trx : trxs )
+         params.transactions.emplace_back(fc::variant(trx).get_object());
+      return fc::json::to_string(params);
+   }
+
+   /// Pushes transactions which have to succeed for the run to make sense
+   void push_all( http_connection& connection, const vector<signed_transaction>& trxs ) {
+      for( size_t i = 0; i < trxs.size(); i += 100 ) {
+         vector<signed_transaction> batch(trxs.begin() + i, trxs.begin() + std::min(trxs.size(), i + 100));
+         auto results = connection.post_json(push_txn_batch_func, request_body(batch))
+                                  .as<chain_apis::read_write::push_transaction_batch_results>();
+         for( const auto& result : results ) {
+            if( result.processed.is_object() && result.processed.get_object().contains("error") )
+               FC_THROW( "Unable to fund the benchmark accounts: ${e}", ("e", result.processed["error"]) );
+         }
+      }
+   }
+
+   void fund_accounts() {
+      http_connection connection(options.host, options.port);
+      auto info = get_info(connection);
+
+      vector<signed_transaction> trxs;
+      for( uint32_t i = 0; i < options.accounts; ++i ) {
+         signed_transaction trx;
+         const name sender("initb");
+         trx.scope = {sender, benchmark_account(i)};
+         transaction_emplace_message(trx, config::eos_contract_name, vector<types::account_permission>{{sender, "active"}},
+                                     "transfer", types::transfer{sender, benchmark_account(i), 100000, "benchmark"});
+         reference(trx, info, options.expiration, false);
+         trxs.push_back(std::move(trx));
+      }
+      if( mixes("currency") ) {
+         for( uint32_t i = 0; i < options.accounts; ++i ) {
+            signed_transaction trx;
+            trx.scope = {currency_account, benchmark_account(i)};
+            chain::message msg(currency_account, vector<types::account_permission>{{currency_account, "active"}}, "transfer");
+            msg.set_packed("transfer", currency_transfer{currency_account.value, benchmark_account(i).value, 100000});
+            transaction_emplace_message(trx, msg);
+            reference(trx, info, options.expiration, false);
+            trxs.push_back(std::move(trx));
+         }
+      }
+      if( mixes("exchange") ) {
+         // deposit EOS with the exchange to pay for the buy orders
+         for( uint32_t i = 0; i < options.accounts; ++i ) {
+            signed_transaction trx;
+            trx.scope = {exchange_account, benchmark_account(i)};
+            transaction_emplace_message(trx, config::eos_contract_name,
+                                        vector<types::account_permission>{{benchmark_account(i), "active"}},
+                                        "transfer", types::transfer{benchmark_account(i), exchange_account, 50000, "benchmark"});
+            reference(trx, info, options.expiration);
+            trxs.push_back(std::move(trx));
+         }
+      }
+      push_all(connection, trxs);
+   }
+
+   signed_transaction make_transaction( const std::string& kind, uint64_t sequence, fc::time_point_sec expiration ) {
+      std::uniform_int_distribution<uint32_t> pick(0, options.accounts - 1);
+      const name sender = benchmark_account(pick(rng));
+      name recipient = sender;
+      while( recipient == sender )
+         recipient = benchmark_account(pick(rng));
+      const vector<types::account_permission> auth{{sender, "active"}};
+
+      signed_transaction trx;
+      if( kind == "transfer" ) {
+         trx.scope = {sender, recipient};
+         transaction_emplace_message(trx, config::eos_contract_name, auth,
+                                     "transfer", types::transfer{sender, recipient, 1, std::to_string(sequence)});
+      } else if( kind == "currency" ) {
+         trx.scope = {sender, recipient};
+         chain::message msg(currency_account, auth, "transfer");
+         msg.set_packed("transfer", currency_transfer{sender.value, recipient.value, 1});
+         transaction_emplace_message(trx, msg);
+         // the same transfer is sent many times, so a nonce keeps the transactions apart
+         transaction_emplace_message(trx, config::eos_contract_name, vector<types::account_permission>{},
+                                     "nonce", types::nonce{std::to_string(sequence)});
+      } else {
+         // a bid at the lowest price rests in the book without matching
+         trx.scope = {exchange_account, sender};
+         chain::message msg(exchange_account, auth, "buy");
+         msg.set_packed("buy", exchange_buy_order{sender.value, sequence, 1, 1, expiration.sec_since_epoch(), 0});
+         transaction_emplace_message(trx, msg);
+      }
+      return trx;
+   }
+
+   void prepare() {
+      const double total_seconds = options.duration;
+      const auto lifetime = fc::seconds(options.duration) + options.expiration;
+      FC_ASSERT( lifetime.to_seconds() < config::default_max_trx_lifetime,
+                 "the duration and expiration must be under ${max} seconds", ("max", config::default_max_trx_lifetime) );
+
+      http_connection connection(options.host, options.port);
+      auto info = get_info(connection);
+      const auto expiration = info.head_block_time + lifetime;
+
+      const uint64_t total = std::max<uint64_t>(1, uint64_t(options.rate * total_seconds));
+      const double interval_us = 1000000.0 * options.batch / options.rate;
+      std::uniform_int_distribution<size_t> pick_kind(0, kinds.size() - 1);
+
+      requests.clear();
+      requests.reserve((total + options.batch - 1) / options.batch);
+      vector<signed_transaction> batch;
+      for( uint64_t sequence = 0; sequence < total; ++sequence ) {
+         auto trx = make_transaction(kinds[pick_kind(rng)], sequence, expiration);
+         reference(trx, info, lifetime);
+         batch.push_back(std::move(trx));
+         if( batch.size() == options.batch || sequence + 1 == total ) {
+            load_request request;
+            request.body = request_body(batch);
+            for( const auto& trx : batch )
+               request.ids.push_back(trx.id());
+            request.offset = fc::microseconds(int64_t(interval_us * requests.size()));
+            requests.push_back(std::move(request));
+            batch.clear();
+         }
+      }
+      first_block = info.head_block_num + 1;
+   }
+
+   /// Sends the requests due to it, as the connections of the pool
+   void send_requests( load_report& report ) {
+      http_connection connection(options.host, options.port);
+      latency_histogram response_latency;
+      uint64_t accepted = 0, rejected = 0, failed = 0;
+
+      while( true ) {
+         std::unique_lock<std::mutex> lock(mtx);
+         dispatched.wait(lock, [&]{ return !due_requests.empty() || dispatching_done; });
+         if( due_requests.empty() )
+            break;
+         auto& request = requests[due_requests.front()];
+         due_requests.pop_front();
+         lock.unlock();
+
+         try {
+            auto results = connection.post_json(push_txn_batch_func, request.body)
+                                     .as<chain_apis::read_write::push_transaction_batch_results>();
+            response_latency.record(now() - request.due);
+            for( size_t i = 0; i < results.size() && i < request.ids.size(); ++i ) {
+               const auto& processed = results[i].processed;
+               if( processed.is_object() && processed.get_object().contains("error") ) {
+                  ++rejected;
+                  forget(request.ids[i]);
+               } else {
+                  ++accepted;
+               }
+            }
+         } catch( const fc::exception& e ) {
+            elog( "Request failed: ${e}", ("e", e.to_string()) );
+            failed += request.ids.size();
+            for( const auto& id : request.ids )
+               forget(id);
+         }
+      }
+
+      std::lock_guard<std::mutex> lock(mtx);
+      report.response_latency.merge(response_latency);
+      report.accepted += accepted;
+      report.rejected += rejected;
+      report.failed += failed;
+      report.connects += connection.connects();
+   }
+
+   void forget( const transaction_id_type& id ) {
+      std::lock_guard<std::mutex> lock(mtx);
+      in_flight.erase(id);
+   }
+
+   /// Follows the blocks, timing each transaction sent from when it was due until a block with it is seen
+   void track_blocks( load_report& report ) {
+      http_connection connection(options.host, options.port);
+      uint32_t next_block = first_block;
+      fc::time_point give_up;
+
+      while( true ) {
+         try {
+            const auto head = get_info(connection).head_block_num;
+            for( ; next_block <= head; ++next_block ) {
+               auto block = connection.post(get_block_func, fc::mutable_variant_object("block_num_or_id", next_block))
+                                      .as<signed_block>();
+               const auto seen = now();
+               std::lock_guard<std::mutex> lock(mtx);
+               for( const auto& cycle : block.cycles ) {
+                  for( const auto& thread : cycle ) {
+                     for( const auto& trx : thread.user_input ) {
+                        auto itr = in_flight.find(trx.id());
+                        if( itr == in_flight.end() )
+                           continue;
+                        report.inclusion_latency.record(seen - itr->second);
+                        ++report.included;
+                        in_flight.erase(itr);
+                     }
+                  }
+               }
+            }
+         } catch( const fc::exception& e ) {
+            elog( "Unable to follow the blocks: ${e}", ("e", e.to_string()) );
+         }
+
+         {
+            std::unique_lock<std::mutex> lock(mtx);
+            if( sending_done ) {
+               if( give_up == fc::time_point() )
+                  give_up = now() + options.inclusion_timeout;
+               if( in_flight.empty() || now() > give_up )
+                  break;
+            }
+            tracked.wait_for(lock, std::chrono::milliseconds(20));
+         }
+      }
+   }
+
+   load_report run() {
+      FC_ASSERT( !requests.empty(), "prepare the transactions first" );
+      load_report report;
+
+      {
+         std::lock_guard<std::mutex> lock(mtx);
+         due_requests.clear();
+         in_flight.clear();
+         dispatching_done = sending_done = false;
+      }
+
+      std::vector<std::thread> senders;
+      for( uint32_t i = 0; i < options.connections; ++i )
+         senders.emplace_back([this, &report]{ send_requests(report); });
+      std::thread tracker([this, &report]{ track_blocks(report); });
+
+      // Each request is queued when it is due, however far behind the connections are
+      const auto start = now();
+      for( size_t i = 0; i < requests.size(); ++i ) {
+         auto& request = requests[i];
+         request.due = start + request.offset;
+         auto wait = request.due - now();
+         if( wait.count() > 0 )
+            std::this_thread::sleep_for(std::chrono::microseconds(wait.count()));
+         report.max_dispatch_lag = std::max(report.max_dispatch_lag, now() - request.due);
+
+         std::lock_guard<std::mutex> lock(mtx);
+         for( const auto& id : request.ids )
+            in_flight[id] = request.due;
+         due_requests.push_back(i);
+         report.sent += request.ids.size();
+         dispatched.notify_one();
+      }
+      {
+         std::lock_guard<std::mutex> lock(mtx);
+         dispatching_done = true;
+      }
+      dispatched.notify_all();
+      for( auto& sender : senders )
+         sender.join();
+      report.elapsed = now() - start;
+
+      {
+         std::lock_guard<std::mutex> lock(mtx);
+         sending_done = true;
+      }
+      tracked.notify_all();
+      tracker.join();
+
+      // the requests are spent, as the node now knows their transactions
+      requests.clear();
+      return report;
+   }
+
+   struct id_hash {
+      size_t operator()( const transaction_id_type& id )const { return id._hash[0]; }
+   };
+
+   load_options                  options;
+   std::mt19937_64               rng;
+   vector<std::string>           kinds; ///< each kind of transaction as many times as its weight
+   vector<load_request>          requests;
+   uint32_t                      first_block = 1;
+
+   std::mutex                    mtx;
+   std::condition_variable       dispatched;
+   std::condition_variable       tracked;
+   std::deque<size_t>            due_requests;
+   bool                          dispatching_done = false;
+   bool                          sending_done = false;
+   std::unordered_map<transaction_id_type, fc::time_point, id_hash>  in_flight; ///< by when each was due
+};
+
+load_generator::load_generator( const load_options& options )
+:my(new load_generator_impl(options)) {}
+
+load_generator::~load_generator() {}
+
+void load_generator::fund_accounts() {
+   my->fund_accounts();
+}
+
+void load_generator::prepare() {
+   my->prepare();
+}
+
+load_report load_generator::run() {
+   return my->run();
+}
+
+} } // eosio::client
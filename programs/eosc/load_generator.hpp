@@ -0,0 +1,92 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eos/chain/transaction.hpp>
+
+#include <fc/crypto/elliptic.hpp>
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace client {
+
+   /**
+    * Counts latencies in buckets of about 0.2% of their value, so percentiles can be read without keeping every sample
+    */
+   class latency_histogram {
+      public:
+         void             record( fc::microseconds latency );
+         void             merge( const latency_histogram& other );
+         /// The latency which fraction of the samples do not exceed, to the precision of a bucket
+         fc::microseconds percentile( double fraction )const;
+         uint64_t         count()const { return _count; }
+         fc::microseconds max()const { return fc::microseconds(_max); }
+
+      private:
+         static const uint32_t sub_buckets = 512;
+         static size_t   bucket_of( uint64_t us );
+         static uint64_t highest_in( size_t bucket );
+
+         std::vector<uint64_t> _buckets;
+         uint64_t              _count = 0;
+         int64_t               _max = 0;
+   };
+
+   struct load_options {
+      std::string  host = "localhost";
+      uint16_t     port = 8888;
+      uint32_t     accounts = 2;            ///< the benchmark accounts created by `benchmark setup`
+      double       rate = 1000;             ///< transactions per second, whether or not the node keeps up
+      uint32_t     duration = 10;           ///< seconds
+      uint32_t     connections = 4;
+      uint32_t     batch = 1;               ///< transactions per request
+      /// the weight of each kind of transaction: transfer, currency and exchange
+      std::map<std::string, uint32_t>      mix = {{"transfer", 1}};
+      fc::optional<fc::ecc::private_key>   key; ///< signs the transactions; without it they are sent unsigned
+      fc::microseconds                     expiration = fc::seconds(30);
+      fc::microseconds                     inclusion_timeout = fc::seconds(10); ///< how long to wait for blocks after sending
+   };
+
+   struct load_report {
+      uint64_t           sent = 0;           ///< transactions
+      uint64_t           accepted = 0;
+      uint64_t           rejected = 0;
+      uint64_t           failed = 0;         ///< in requests which got no response
+      uint64_t           included = 0;
+      uint64_t           connects = 0;
+      fc::microseconds   elapsed;            ///< from the first request to the last response
+      fc::microseconds   max_dispatch_lag;   ///< the most a request was sent after it was due
+      latency_histogram  response_latency;   ///< from when a request was due to its response
+      latency_histogram  inclusion_latency;  ///< from when a transaction was due to finding it in a block
+   };
+
+   /**
+    * An open loop load generator
+    *
+    * Requests are due at fixed times set by the rate, and are sent by a pool of kept-alive connections whether or not
+    * earlier ones have been answered, so a slow node is measured rather than slowing the load down. The transactions
+    * are built, signed and serialized ahead of the run, and their latencies are measured from when they were due, so
+    * the time a request waits for a free connection counts against the node rather than being hidden.
+    */
+   class load_generator {
+      public:
+         explicit load_generator( const load_options& options );
+         ~load_generator();
+
+         /// Gives the benchmark accounts EOS, currency, and an exchange deposit, as the mix needs
+         void        fund_accounts();
+         /// Builds the transactions of the run
+         void        prepare();
+         load_report run();
+
+      private:
+         std::unique_ptr<class load_generator_impl> my;
+   };
+
+} } // eosio::client
@@ -93,6 +93,8 @@ Options:
 
 #include "CLI11.hpp"
 #include "help_text.hpp"
+#include "httpc.hpp"
+#include "load_generator.hpp"
 #include "localize.hpp"
 #include <config.hpp>
 
@@ -239,11 +241,6 @@ vector<types::account_permission> get_account_permissions(const vector<string>&
    return accountPermissions;
 }
 
-fc::variant call( const std::string& server, uint16_t port,
-                  const std::string& path,
-                  const fc::variant& postdata = fc::variant() );
-
-
 template<typename T>
 fc::variant call( const std::string& server, uint16_t port,
                   const std::string& path,
@@ -906,19 +903,28 @@ int main( int argc, char** argv ) {
    benchmark->require_subcommand();
    auto benchmark_setup = benchmark->add_subcommand( "setup", localized("Configures initial condition for benchmark") );
    uint64_t number_of_accounts = 2;
+   string benchmark_key;
    benchmark_setup->add_option("accounts", number_of_accounts, localized("the number of accounts in transfer among"))->required();
+   benchmark_setup->add_option("-k,--key", benchmark_key, localized("WIF private key whose public key the accounts are created with, for signed benchmarks"));
    add_standard_transaction_options(benchmark_setup);
    benchmark_setup->set_callback([&]{
       std::cerr << localized("Creating ${number_of_accounts} accounts with initial balances", ("number_of_accounts",number_of_accounts)) << std::endl;
       EOSC_ASSERT( number_of_accounts >= 2, "must create at least 2 accounts" );
 
+      public_key_type account_key;
+      if( !benchmark_key.empty() ) {
+         auto key = utilities::wif_to_key(benchmark_key);
+         EOSC_ASSERT( key, "invalid private key: ${k}", ("k",benchmark_key) );
+         account_key = key->get_public_key();
+      }
+
       auto info = get_info();
 
       vector<signed_transaction> batch;
       batch.reserve( number_of_accounts );
       for( uint32_t i = 0; i < number_of_accounts; ++i ) {
         name newaccount( name("benchmark").value + i );
-        public_key_type owner, active;
+        public_key_type owner = account_key, active = account_key;
         name creator("inita" );
 
         auto owner_auth   = eosio::chain::authority{1, {{owner, 1}}, {}};
@@ -1016,6 +1022,71 @@ int main( int argc, char** argv ) {
       }
    });
 
+   auto benchmark_load = benchmark->add_subcommand( "load", localized("Offers transactions at a steady rate and reports their latencies") );
+   client::load_options load_opts;
+   vector<string> load_mix;
+   bool load_no_fund = false;
+   benchmark_load->add_option("accounts", number_of_accounts, localized("the number of accounts in transfer among"))->required();
+   benchmark_load->add_option("-r,--rate", load_opts.rate, localized("transactions per second to offer, whether or not the node keeps up"), true);
+   benchmark_load->add_option("-d,--duration", load_opts.duration, localized("the number of seconds to offer transactions for"), true);
+   benchmark_load->add_option("-c,--connections", load_opts.connections, localized("the number of connections sending transactions"), true);
+   benchmark_load->add_option("-b,--batch", load_opts.batch, localized("the number of transactions in each request"), true);
+   benchmark_load->add_option("-m,--mix", load_mix, localized("kind=weight of the transactions to send, where kind is transfer, currency or exchange; defaults to transfer=1"));
+   benchmark_load->add_option("-k,--key", benchmark_key, localized("WIF private key to sign the transactions with, as given to benchmark setup; without it they are not signed"));
+   benchmark_load->add_flag("--no-fund", load_no_fund, localized("do not fund the accounts before the run"));
+   add_standard_transaction_options(benchmark_load);
+   benchmark_load->set_callback([&]{
+      EOSC_ASSERT( number_of_accounts >= 2, "must create at least 2 accounts" );
+      load_opts.host = host;
+      load_opts.port = port;
+      load_opts.accounts = number_of_accounts;
+      load_opts.expiration = tx_expiration;
+      if( !load_mix.empty() ) {
+         load_opts.mix.clear();
+         for( const auto& kind_weight : load_mix ) {
+            vector<string> pieces;
+            split(pieces, kind_weight, boost::algorithm::is_any_of("="));
+            EOSC_ASSERT( pieces.size() <= 2, "Invalid mix: ${m}", ("m", kind_weight) );
+            load_opts.mix[pieces[0]] = pieces.size() == 2 ? std::stoul(pieces[1]) : 1;
+         }
+      }
+      if( !benchmark_key.empty() ) {
+         load_opts.key = utilities::wif_to_key(benchmark_key);
+         EOSC_ASSERT( load_opts.key, "invalid private key: ${k}", ("k",benchmark_key) );
+      }
+
+      client::load_generator generator(load_opts);
+      if( !load_no_fund ) {
+         std::cerr << localized("Funding ${number_of_accounts} accounts", ("number_of_accounts",number_of_accounts)) << std::endl;
+         generator.fund_accounts();
+      }
+      std::cerr << localized("Preparing ${n} transactions", ("n", uint64_t(load_opts.rate * load_opts.duration))) << std::endl;
+      generator.prepare();
+      std::cerr << localized("Offering ${rate} transactions per second for ${duration} seconds", ("rate", load_opts.rate)("duration", load_opts.duration)) << std::endl;
+      auto report = generator.run();
+
+      auto percentiles = [](const client::latency_histogram& h) {
+         return fc::mutable_variant_object
+               ("count", h.count())
+               ("p50_ms", h.percentile(0.5).count() / 1000.0)
+               ("p99_ms", h.percentile(0.99).count() / 1000.0)
+               ("p999_ms", h.percentile(0.999).count() / 1000.0)
+               ("max_ms", h.max().count() / 1000.0);
+      };
+      const double seconds = std::max<double>(report.elapsed.count(), 1) / 1000000.0;
+      std::cout << fc::json::to_pretty_string(fc::mutable_variant_object
+            ("sent", report.sent)
+            ("accepted", report.accepted)
+            ("rejected", report.rejected)
+            ("failed", report.failed)
+            ("included", report.included)
+            ("accepted_per_second", report.accepted / seconds)
+            ("connects", report.connects)
+            ("max_dispatch_lag_ms", report.max_dispatch_lag.count() / 1000.0)
+            ("response_latency", percentiles(report.response_latency))
+            ("inclusion_latency", percentiles(report.inclusion_latency))) << std::endl;
+   });
+
    
 
    // Push subcommand
@@ -90,7 +90,8 @@ INITB_PRV_KEY="5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3"
 LOG_FILE=eosd_run_test.log
 
 # eosd
-programs/launcher/launcher --eosd "--mongodb-uri $DB"
+# a small queue, so that a stalled MongoDB fills it quickly in the backpressure test
+programs/launcher/launcher --eosd "--mongodb-uri $DB --queue-size 2"
 verifyErrorCode "launcher"
 sleep 60
 count=`grep -c "generated block" tn_data_0/stderr.txt`
@@ -433,6 +434,33 @@ verifyErrorCode "eosc unapprove producer"
 #
 # not implemented
 
+#
+# Backpressure
+#
+
+# While MongoDB is stalled the queue of irreversible blocks fills up; read only API calls must still be answered,
+# so the node may not wait for room in the queue while it holds the chain's write lock
+MONGOD_PROC_ID="$(pgrep -x mongod | head -1)"
+if [ -z "$MONGOD_PROC_ID" ]; then
+  echo "Skipping backpressure test, mongod is not running on this machine"
+else
+  kill -STOP $MONGOD_PROC_ID
+  verifyErrorCode "stop mongod"
+  for i in $(seq 1 20); do
+    INFO="$(timeout 5 programs/eosc/eosc --wallet-port 8899 get info)"
+    rc=$?
+    if [[ $rc != 0 ]]; then
+      kill -CONT $MONGOD_PROC_ID
+      error "FAILURE - get info did not respond while MongoDB was stalled: $INFO"
+    fi
+    sleep 1
+  done
+  kill -CONT $MONGOD_PROC_ID
+  verifyErrorCode "resume mongod"
+  # the queued blocks are written once MongoDB is back
+  waitForNextBlock
+fi
+
 # should be able to get every block from beginning to end
 getHeadBlockNum
 CURRENT_BLOCK_NUM=$HEAD_BLOCK_NUM
@@ -451,6 +451,200 @@ BOOST_FIXTURE_TEST_CASE(abi_cycle, testing_fixture)
 
 } FC_LOG_AND_RETHROW() }
 
+/// Typedef cycles must not overflow the stack while an ABI is loaded, only fail validation and use
+BOOST_FIXTURE_TEST_CASE(abi_typedef_cycle, testing_fixture)
+{ try {
+
+   // uint64 may be redefined, so these typedefs loop; S names the loop both as its base and as a field
+   const char* typedef_cycle_abi = R"=====(
+   {
+       "types": [{
+          "new_type_name": "A",
+          "type": "uint64"
+        },{
+          "new_type_name": "uint64",
+          "type": "A"
+        }],
+       "structs": [{
+         "name": "S",
+         "base": "A",
+         "fields": {
+           "a": "A"
+         }
+       },{
+         "name": "T",
+         "base": "",
+         "fields": {
+           "a": "A"
+         }
+       }],
+       "actions": [],
+       "tables": []
+   }
+   )=====";
+
+   auto abi = fc::json::from_string(typedef_cycle_abi).as<types::abi>();
+   abi_serializer abis(abi);
+
+   auto is_circular = [](fc::assert_exception const & e) -> bool { return e.to_detail_string().find("Circular reference") != std::string::npos; };
+   BOOST_CHECK_EXCEPTION( abis.validate(), fc::assert_exception, is_circular );
+   BOOST_CHECK_THROW( abis.resolve_type("A"), fc::assert_exception );
+
+   fc::variant var = fc::mutable_variant_object("a", 1);
+   BOOST_CHECK_THROW( abis.variant_to_binary("S", var), fc::exception );
+   BOOST_CHECK_THROW( abis.variant_to_binary("T", var), fc::exception );
+
+} FC_LOG_AND_RETHROW() }
+
+/// A struct whose base leads back to itself through a typedef must fail validation without looping
+BOOST_FIXTURE_TEST_CASE(abi_base_cycle_through_typedef, testing_fixture)
+{ try {
+
+   // X derives from name, through the typedef N, and the struct name derives from X
+   const char* base_cycle_abi = R"=====(
+   {
+       "types": [{
+          "new_type_name": "N",
+          "type": "name"
+        }],
+       "structs": [{
+         "name": "X",
+         "base": "N",
+         "fields": {
+           "x": "uint32"
+         }
+       },{
+         "name": "name",
+         "base": "X",
+         "fields": {}
+       }],
+       "actions": [],
+       "tables": []
+   }
+   )=====";
+
+   auto abi = fc::json::from_string(base_cycle_abi).as<types::abi>();
+   abi_serializer abis(abi);
+
+   auto is_circular = [](fc::assert_exception const & e) -> bool { return e.to_detail_string().find("Circular reference") != std::string::npos; };
+   BOOST_CHECK_EXCEPTION( abis.validate(), fc::assert_exception, is_circular );
+   BOOST_CHECK_THROW( abis.variant_to_binary("X", fc::mutable_variant_object("x", 1)), fc::exception );
+
+} FC_LOG_AND_RETHROW() }
+
+/// An array of structs is its length followed by each struct's fields, and reads back the same
+BOOST_FIXTURE_TEST_CASE(abi_struct_array, testing_fixture)
+{ try {
+
+   const char* struct_array_abi = R"=====(
+   {
+       "types": [],
+       "structs": [{
+         "name": "point",
+         "base": "",
+         "fields": {
+           "x": "uint32",
+           "y": "uint16"
+         }
+       },{
+         "name": "ring",
+         "base": "",
+         "fields": {
+           "corners": "point[]"
+         }
+       },{
+         "name": "polygon",
+         "base": "",
+         "fields": {
+           "name": "name",
+           "corners": "point[]",
+           "holes": "ring[]"
+         }
+       }],
+       "actions": [],
+       "tables": []
+   }
+   )=====";
+
+   const char* polygon = R"=====(
+   {
+     "name": "",
+     "corners": [{"x": 1, "y": 2}, {"x": 3, "y": 4}],
+     "holes": [{"corners": []}, {"corners": [{"x": 5, "y": 6}]}]
+   }
+   )=====";
+
+   auto abi = fc::json::from_string(struct_array_abi).as<types::abi>();
+   abi_serializer abis(abi);
+   abis.validate();
+
+   auto var = fc::json::from_string(polygon);
+   auto bytes = abis.variant_to_binary("polygon", var);
+   BOOST_CHECK_EQUAL( fc::to_hex(bytes), "0000000000000000" "02" "01000000" "0200" "03000000" "0400"
+                                         "02" "00" "01" "05000000" "0600" );
+
+   auto var2 = verify_round_trip_conversion(abis, "polygon", var);
+   BOOST_CHECK_EQUAL( fc::json::to_string(var2), fc::json::to_string(var) );
+
+   auto corners = abis.binary_to_variant("point[]", abis.variant_to_binary("point[]", var["corners"]));
+   BOOST_CHECK_EQUAL( fc::json::to_string(corners), fc::json::to_string(var["corners"]) );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE(abi_recursive_struct_array, testing_fixture)
+{ try {
+
+   // node[] is compiled while node is, before node's plan is finished
+   const char* recursive_abi = R"=====(
+   {
+       "types": [],
+       "structs": [{
+         "name": "node",
+         "base": "",
+         "fields": {
+           "id": "uint32",
+           "children": "node[]"
+         }
+       },{
+         "name": "tree",
+         "base": "",
+         "fields": {
+           "root": "node",
+           "others": "node[]"
+         }
+       }],
+       "actions": [],
+       "tables": []
+   }
+   )=====";
+
+   const char* node = R"=====(
+   {
+     "id": 1,
+     "children": [{"id": 2, "children": []}, {"id": 3, "children": [{"id": 4, "children": []}]}]
+   }
+   )=====";
+
+   auto abi = fc::json::from_string(recursive_abi).as<types::abi>();
+   abi_serializer abis(abi);
+   abis.validate();
+
+   auto var = fc::json::from_string(node);
+   auto bytes = abis.variant_to_binary("node", var);
+   BOOST_CHECK_EQUAL( fc::to_hex(bytes), "01000000" "02" "02000000" "00" "03000000" "01" "04000000" "00" );
+
+   auto var2 = verify_round_trip_conversion(abis, "node", var);
+   BOOST_CHECK_EQUAL( fc::json::to_string(var2), fc::json::to_string(var) );
+
+   auto tree = fc::mutable_variant_object()("root", var)("others", fc::variants{var["children"][1], var});
+   auto tree2 = verify_round_trip_conversion(abis, "tree", tree);
+   BOOST_CHECK_EQUAL( fc::json::to_string(tree2), fc::json::to_string(fc::variant(tree)) );
+
+   auto children = abis.binary_to_variant("node[]", abis.variant_to_binary("node[]", var["children"]));
+   BOOST_CHECK_EQUAL( fc::json::to_string(children), fc::json::to_string(var["children"]) );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE(transfer, testing_fixture)
 { try {
 
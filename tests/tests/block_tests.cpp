@@ -10,11 +10,15 @@
 #include <eos/chain/account_object.hpp>
 #include <eos/chain/key_value_object.hpp>
 #include <eos/chain/block_summary_object.hpp>
+#include <eos/chain/block_view.hpp>
 
 #include <eos/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 #include <Inline/BasicTypes.h>
@@ -174,6 +178,60 @@ BOOST_FIXTURE_TEST_CASE(irrelevant_auth, testing_fixture) {
    BOOST_CHECK_THROW(chain.push_transaction(trx, chain_controller::skip_transaction_signatures), tx_irrelevant_auth);
 } FC_LOG_AND_RETHROW() }
 
+// The read only API is served from other threads while blocks are pushed; undoing the pending transactions must not
+// change the database under it
+BOOST_FIXTURE_TEST_CASE(read_only_api_during_push_block, testing_fixture)
+{ try {
+   Make_Blockchains((chain)(source))
+   chain.produce_blocks();
+   source.push_block(*chain.fetch_block_by_number(1));
+   const auto total = chain.get_liquid_balance("inita") + chain.get_liquid_balance("initb");
+
+   chain_apis::read_only api(chain);
+   std::atomic<bool> done{false};
+   std::atomic<uint32_t> reads{0}, bad_reads{0}, failed_reads{0};
+   vector<std::thread> readers;
+   for (int i = 0; i < 4; ++i)
+      readers.emplace_back([&]() {
+         while (!done) {
+            try {
+               chain.get_database().with_read_lock([&]() {
+                  api.get_info(chain_apis::empty());
+                  auto inita = api.get_account({"inita"});
+                  auto initb = api.get_account({"initb"});
+                  if (inita.eos_balance + initb.eos_balance != total)
+                     ++bad_reads;
+               });
+               ++reads;
+            } catch (...) {
+               ++failed_reads;
+            }
+         }
+      });
+
+   for (uint32_t i = 0; i < 50; ++i) {
+      // pending transfers are undone and pushed again by every block pushed from the other chain
+      Transfer_Asset(chain, inita, initb, asset(1));
+      Transfer_Asset(chain, initb, inita, asset(2));
+      source.produce_blocks();
+      chain.push_block(*source.fetch_block_by_number(source.head_block_num()));
+      if (i % 10 == 9)
+         chain.clear_pending();
+      else if (i % 10 == 4)
+         chain.produce_blocks();
+      if (chain.head_block_num() > source.head_block_num())
+         source.push_block(*chain.fetch_block_by_number(chain.head_block_num()));
+   }
+   done = true;
+   for (auto& reader : readers)
+      reader.join();
+
+   BOOST_CHECK_GT(reads.load(), 0u);
+   BOOST_CHECK_EQUAL(bad_reads.load(), 0u);
+   BOOST_CHECK_EQUAL(failed_reads.load(), 0u);
+   BOOST_CHECK_EQUAL(chain.get_liquid_balance("inita") + chain.get_liquid_balance("initb"), total);
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(name_test) {
    using eosio::types::name;
    name temp;
@@ -221,6 +279,94 @@ BOOST_FIXTURE_TEST_CASE(order_dependent_transactions, testing_fixture)
       BOOST_CHECK_EQUAL(chain.get_liquid_balance("inita"), asset(100000-199));
 } FC_LOG_AND_RETHROW() }
 
+// Test that transactions are forgotten in expiration order, and each is rejected as a duplicate until it expires
+BOOST_FIXTURE_TEST_CASE(staggered_expirations, testing_fixture)
+{ try {
+      Make_Blockchain(chain);
+      chain.produce_blocks(10);
+
+      auto make_transfer = [&chain](uint64_t amount, uint32_t lifetime) {
+         signed_transaction trx;
+         trx.scope = sort_names({"inita", "initb"});
+         transaction_emplace_message(trx, config::eos_contract_name,
+                                     vector<types::account_permission>{{"inita", "active"}},
+                                     "transfer", types::transfer{"inita", "initb", amount, ""});
+         trx.expiration = chain.head_block_time() + lifetime;
+         transaction_set_reference_block(trx, chain.head_block_id());
+         return trx;
+      };
+      // pushed out of expiration order, so the index order is what is being tested
+      auto late = make_transfer(3, 60);
+      auto early = make_transfer(1, chain.block_interval());
+      auto middle = make_transfer(2, 5 * chain.block_interval());
+      for (const auto& trx : {late, early, middle})
+         chain.push_transaction(trx);
+      chain.produce_blocks();
+
+      for (const auto& trx : {late, early, middle}) {
+         BOOST_CHECK(chain.is_known_transaction(trx.id()));
+         BOOST_CHECK_THROW(chain.push_transaction(trx), tx_duplicate);
+      }
+
+      while (chain.head_block_time() <= early.expiration)
+         chain.produce_blocks();
+      BOOST_CHECK(!chain.is_known_transaction(early.id()));
+      BOOST_CHECK(chain.is_known_transaction(middle.id()));
+      BOOST_CHECK(chain.is_known_transaction(late.id()));
+      BOOST_CHECK_THROW(chain.push_transaction(middle), tx_duplicate);
+      BOOST_CHECK_THROW(chain.push_transaction(late), tx_duplicate);
+
+      while (chain.head_block_time() <= middle.expiration)
+         chain.produce_blocks();
+      BOOST_CHECK(!chain.is_known_transaction(early.id()));
+      BOOST_CHECK(!chain.is_known_transaction(middle.id()));
+      BOOST_CHECK(chain.is_known_transaction(late.id()));
+      BOOST_CHECK_THROW(chain.push_transaction(late), tx_duplicate);
+
+      while (chain.head_block_time() <= late.expiration)
+         chain.produce_blocks();
+      BOOST_CHECK(!chain.is_known_transaction(late.id()));
+
+      // once forgotten the transactions are rejected as expired, so none is applied twice
+      for (const auto& trx : {late, early, middle})
+         BOOST_CHECK_THROW(chain.push_transaction(trx), transaction_exception);
+      BOOST_CHECK_EQUAL(chain.get_liquid_balance("inita"), asset(100000 - 6));
+} FC_LOG_AND_RETHROW() }
+
+// Test that a block finished from the candidate block is the one scheduling the pending transactions makes
+BOOST_FIXTURE_TEST_CASE(candidate_block, testing_fixture)
+{ try {
+      Make_Blockchains((chain1)(chain2))
+      Make_Network(net, (chain1)(chain2))
+      chain1.maintain_candidate_block(true);
+
+      Make_Account(chain1, newguy);
+      chain1.produce_blocks();
+      BOOST_CHECK_EQUAL(chain2.head_block_num(), 1);
+      BOOST_CHECK(chain2.get_database().find<account_object, by_name>("newguy") != nullptr);
+
+      Transfer_Asset(chain1, inita, newguy, asset(100));
+      Transfer_Asset(chain1, newguy, inita, asset(1));
+      chain1.produce_blocks();
+
+      auto block = chain1.fetch_block_by_number(2);
+      BOOST_REQUIRE(block.valid());
+      BOOST_REQUIRE_EQUAL(block->cycles.size(), 1);
+      BOOST_REQUIRE_EQUAL(block->cycles.front().size(), 1);
+      BOOST_CHECK_EQUAL(block->cycles.front().front().user_input.size(), 2);
+      BOOST_CHECK(block->transaction_merkle_root == block->calculate_merkle_root());
+
+      BOOST_CHECK_EQUAL(chain2.head_block_id().str(), chain1.head_block_id().str());
+      BOOST_CHECK_EQUAL(chain1.get_liquid_balance("newguy"), asset(99));
+      BOOST_CHECK_EQUAL(chain2.get_liquid_balance("newguy"), asset(99));
+      BOOST_CHECK_EQUAL(chain2.get_liquid_balance("inita"), chain1.get_liquid_balance("inita"));
+
+      // an empty candidate makes an empty block
+      chain1.produce_blocks();
+      BOOST_CHECK(chain1.fetch_block_by_number(3)->cycles.empty());
+      BOOST_CHECK_EQUAL(chain2.head_block_num(), 3);
+} FC_LOG_AND_RETHROW() }
+
 // Simple test of block production when a block is missed
 BOOST_FIXTURE_TEST_CASE(missed_blocks, testing_fixture)
 { try {
@@ -517,6 +663,125 @@ BOOST_FIXTURE_TEST_CASE(reindex, testing_fixture)
       }
 } FC_LOG_AND_RETHROW() }
 
+// Test reading blocks back from the block log before and after they are synced to disk
+BOOST_FIXTURE_TEST_CASE(block_log_reads, testing_fixture)
+{ try {
+      Make_Blockchain(chain)
+      chain.produce_blocks(50);
+      auto irreversible = chain.last_irreversible_block_num();
+      BOOST_REQUIRE(irreversible > 0);
+
+      vector<char> packed;
+      auto check_blocks = [&] {
+         BOOST_CHECK_EQUAL(chain_log.head()->block_num(), irreversible);
+         BOOST_CHECK_EQUAL(chain_log.head_num(), irreversible);
+         BOOST_CHECK_EQUAL(chain_log.read_head()->block_num(), irreversible);
+         for (uint32_t num = 1; num <= irreversible; ++num) {
+            auto block = chain_log.read_block_by_num(num);
+            BOOST_REQUIRE(block);
+            BOOST_CHECK_EQUAL(block->id().str(), chain.fetch_block_by_number(num)->id().str());
+            BOOST_CHECK_EQUAL(chain_log.read_block(chain_log.get_block_pos(num)).first.id().str(), block->id().str());
+            BOOST_CHECK_EQUAL(chain_log.read_block_id(num)->str(), block->id().str());
+            BOOST_REQUIRE(chain_log.read_packed_block(num, packed));
+            BOOST_CHECK(packed == fc::raw::pack(*block));
+         }
+         BOOST_CHECK(!chain_log.read_block_by_num(irreversible + 1));
+         BOOST_CHECK(!chain_log.read_block_id(irreversible + 1));
+         BOOST_CHECK(!chain_log.read_packed_block(irreversible + 1, packed));
+         BOOST_CHECK_EQUAL(chain_log.get_block_pos(irreversible + 1), block_log::npos);
+      };
+
+      check_blocks();
+      chain_log.flush();
+      check_blocks();
+} FC_LOG_AND_RETHROW() }
+
+// Test replaying a compressed block log, with its index reconstructed
+BOOST_FIXTURE_TEST_CASE(compressed_block_log, testing_fixture)
+{ try {
+      auto lag = eos_percent(config::blocks_per_round, config::irreversible_threshold_percent);
+      vector<block_id_type> ids;
+      {
+         chainbase::database db(get_temp_dir(), chainbase::database::read_write, TEST_DB_SIZE);
+         block_log log(get_temp_dir("log"), config::default_block_log_sync_blocks,
+                       fc::milliseconds(config::default_block_log_sync_interval_ms), true);
+         fork_database fdb;
+         native_contract::native_contract_chain_initializer initr(genesis_state());
+         testing_blockchain chain(db, fdb, log, initr, *this);
+
+         chain.produce_blocks(100);
+         BOOST_CHECK_EQUAL(chain.last_irreversible_block_num(), 100 - lag);
+         for (uint32_t num = 1; num <= 100 - lag; ++num)
+            ids.push_back(chain.fetch_block_by_number(num)->id());
+      }
+
+      fc::remove(get_temp_dir("log") / "blocks.index");
+      {
+         chainbase::database db(get_temp_dir("replay"), chainbase::database::read_write, TEST_DB_SIZE);
+         block_log log(get_temp_dir("log"));
+         fork_database fdb;
+         native_contract::native_contract_chain_initializer initr(genesis_state());
+         testing_blockchain chain(db, fdb, log, initr, *this);
+
+         BOOST_CHECK_EQUAL(chain.head_block_num(), 100 - lag);
+         auto blocks = log.read_blocks(1, ids.size());
+         BOOST_REQUIRE_EQUAL(blocks.size(), ids.size());
+         for (uint32_t num = 1; num <= ids.size(); ++num) {
+            BOOST_CHECK_EQUAL(blocks[num - 1].id().str(), ids[num - 1].str());
+            BOOST_CHECK_EQUAL(log.read_block_by_num(num)->id().str(), ids[num - 1].str());
+            BOOST_CHECK_EQUAL(log.read_block_id(num)->str(), ids[num - 1].str());
+         }
+         BOOST_CHECK(chain.is_known_block(ids.back()));
+         BOOST_CHECK_EQUAL(chain.get_block_id_for_num(ids.size()).str(), ids.back().str());
+      }
+} FC_LOG_AND_RETHROW() }
+
+// Test reading packed blocks in place, without decoding them
+BOOST_FIXTURE_TEST_CASE(block_view_reads, testing_fixture)
+{ try {
+      Make_Blockchain(chain)
+      Make_Account(chain, alice);
+      chain.produce_blocks(1);
+      for (int i = 1; i <= 5; ++i)
+         Transfer_Asset(chain, inita, alice, asset(i));
+      chain.produce_blocks(1);
+
+      auto block = chain.fetch_block_by_number(chain.head_block_num());
+      BOOST_REQUIRE(block);
+      vector<transaction_id_type> ids;
+      for (const auto& cycle : block->cycles)
+         for (const auto& thread : cycle)
+            for (const auto& trx : thread.user_input)
+               ids.push_back(trx.id());
+      BOOST_REQUIRE_EQUAL(ids.size(), 5);
+
+      vector<char> packed;
+      BOOST_REQUIRE(chain.fetch_packed_block_by_number(block->block_num(), packed));
+      BOOST_REQUIRE(packed == fc::raw::pack(*block));
+
+      block_view view(packed.data(), packed.size());
+      BOOST_CHECK_EQUAL(view.id().str(), block->id().str());
+      BOOST_CHECK_EQUAL(view.block_num(), block->block_num());
+      BOOST_CHECK(view.header().producer == block->producer);
+      BOOST_CHECK(view.unpack().cycles.size() == block->cycles.size());
+
+      uint32_t count = 0;
+      view.for_each_transaction([&](const transaction_view& trx) {
+         BOOST_REQUIRE(count < ids.size());
+         BOOST_CHECK_EQUAL(trx.id().str(), ids[count].str());
+         BOOST_CHECK_EQUAL(trx.unpack().id().str(), ids[count].str());
+         BOOST_CHECK(vector<char>(trx.data(), trx.data() + trx.size()) == fc::raw::pack(trx.unpack()));
+         ++count;
+      });
+      BOOST_CHECK_EQUAL(count, ids.size());
+
+      // a block cut short is rejected while it is walked, and a header cut short when the view is made
+      block_view truncated(packed.data(), packed.size() - 1);
+      BOOST_CHECK_EQUAL(truncated.id().str(), block->id().str());
+      BOOST_CHECK_THROW(truncated.for_each_transaction([](const transaction_view&) {}), fc::exception);
+      BOOST_CHECK_THROW(block_view(packed.data(), fc::raw::pack_size(signed_block_header(*block)) - 1), fc::exception);
+} FC_LOG_AND_RETHROW() }
+
 // Test wiping a database and resyncing with an ongoing network
 BOOST_FIXTURE_TEST_CASE(wipe, testing_fixture)
 { try {
@@ -9,12 +9,18 @@
 #include <eos/chain/authority_checker.hpp>
 
 #include <eos/native_contract/producer_objects.hpp>
+#include <eos/chain_plugin/chain_plugin.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/asio/io_service.hpp>
 
 #include <boost/range/algorithm/find_if.hpp>
 #include <boost/range/algorithm/permutation.hpp>
 
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 using namespace eosio;
@@ -54,6 +60,151 @@ BOOST_FIXTURE_TEST_CASE(get_required_keys, testing_fixture)
 
 } FC_LOG_AND_RETHROW() }
 
+/// A transfer from inita to initb, signed with inita's key unless sign is false
+static signed_transaction make_transfer(testing_blockchain& chain, uint64_t amount, bool sign = true) {
+   signed_transaction trx;
+   trx.scope = sort_names({"inita", "initb"});
+   transaction_emplace_message(trx, config::eos_contract_name, vector<types::account_permission>{{"inita", "active"}},
+                               "transfer", types::transfer{"inita", "initb", amount, ""});
+   trx.expiration = chain.head_block_time() + 100;
+   transaction_set_reference_block(trx, chain.head_block_id());
+   if (sign)
+      chain.sign_transaction(trx);
+   return trx;
+}
+
+/// Valid transfers of 1, 2 and 4, a duplicate of the first and an unsigned transfer of 3
+static vector<signed_transaction> make_transfer_batch(testing_blockchain& chain) {
+   vector<signed_transaction> trxs;
+   trxs.push_back(make_transfer(chain, 1));
+   trxs.push_back(make_transfer(chain, 2));
+   trxs.push_back(trxs[0]);
+   trxs.push_back(make_transfer(chain, 3, false));
+   trxs.push_back(make_transfer(chain, 4));
+   return trxs;
+}
+
+/// Pushes trx the way push_transaction always has, returning the error instead of throwing it
+static optional<processed_transaction> push_serially(testing_blockchain& chain, const signed_transaction& trx,
+                                                     fc::exception_ptr* error = nullptr) {
+   try {
+      return chain.chain_controller::push_transaction(trx);
+   } catch (const fc::exception& e) {
+      if (error)
+         *error = e.dynamic_copy_exception();
+   }
+   return optional<processed_transaction>();
+}
+
+// Test chain_controller::push_transactions has the same results as pushing the transactions one at a time
+BOOST_FIXTURE_TEST_CASE(push_transactions, testing_fixture)
+{ try {
+      Make_Blockchains((batch)(unrecovered)(serial))
+      auto trxs = make_transfer_batch(batch);
+
+      vector<flat_set<public_key_type>> keys;
+      for (const auto& trx : trxs)
+         keys.push_back(chain_controller::recover_signature_keys(trx));
+      BOOST_CHECK(keys[0] == batch.get_required_keys(trxs[0], available_keys()));
+      BOOST_CHECK(keys[2] == keys[0]);
+      BOOST_CHECK(keys[3].empty());
+
+      // keys are given for every transaction or for none
+      BOOST_CHECK_THROW(batch.push_transactions(trxs, {keys[0]}), fc::exception);
+
+      auto results = batch.push_transactions(trxs, keys);
+      // without recovered keys the keys are recovered while pushing
+      auto unrecovered_results = unrecovered.push_transactions(trxs, {});
+      BOOST_REQUIRE_EQUAL(results.size(), trxs.size());
+      BOOST_REQUIRE_EQUAL(unrecovered_results.size(), trxs.size());
+
+      for (size_t i = 0; i < trxs.size(); ++i) {
+         BOOST_TEST_CHECKPOINT("transaction " << i);
+         fc::exception_ptr error;
+         auto expected = push_serially(serial, trxs[i], &error);
+
+         for (const auto& result : {results[i], unrecovered_results[i]}) {
+            BOOST_REQUIRE_EQUAL(bool(result.processed), bool(expected));
+            BOOST_REQUIRE_EQUAL(bool(result.error), bool(error));
+            if (expected)
+               BOOST_CHECK(fc::raw::pack(*result.processed) == fc::raw::pack(*expected));
+            else
+               BOOST_CHECK_EQUAL(result.error->code(), error->code());
+         }
+      }
+
+      BOOST_CHECK(results[0].processed && results[1].processed && results[4].processed);
+      BOOST_REQUIRE(results[2].error);
+      BOOST_CHECK_EQUAL(results[2].error->code(), tx_duplicate::code_value);
+      BOOST_REQUIRE(results[3].error);
+      BOOST_CHECK_EQUAL(results[3].error->code(), tx_missing_sigs::code_value);
+
+      BOOST_CHECK_EQUAL(batch.get_liquid_balance("inita"), asset(100000 - 7));
+      BOOST_CHECK_EQUAL(batch.get_liquid_balance("initb"), asset(100000 + 7));
+      BOOST_CHECK_EQUAL(unrecovered.get_liquid_balance("inita"), serial.get_liquid_balance("inita"));
+      BOOST_CHECK_EQUAL(serial.get_liquid_balance("inita"), asset(100000 - 7));
+} FC_LOG_AND_RETHROW() }
+
+// Test the push_transaction_batch API reports each transaction the way a serial push does, with and without ids_only
+BOOST_FIXTURE_TEST_CASE(push_transaction_batch, testing_fixture)
+{ try {
+      Make_Blockchains((batch)(ids_only)(serial))
+      auto trxs = make_transfer_batch(batch);
+
+      boost::asio::io_service validation_ios;
+      std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(validation_ios));
+      vector<std::thread> validation_threads;
+      for (int i = 0; i < 2; ++i)
+         validation_threads.emplace_back([&validation_ios]() { validation_ios.run(); });
+
+      chain_apis::read_write::push_transaction_batch_params params;
+      for (const auto& trx : trxs)
+         params.transactions.push_back(batch.transaction_to_variant(processed_transaction(trx)).get_object());
+      // a transaction which cannot be decoded
+      params.transactions.push_back(fc::mutable_variant_object("expiration", "not a time"));
+
+      auto results = chain_apis::read_write(batch, chain_controller::skip_nothing, validation_ios, 2)
+                        .push_transaction_batch(params);
+      params.ids_only = true;
+      auto id_results = chain_apis::read_write(ids_only, chain_controller::skip_nothing, validation_ios, 2)
+                           .push_transaction_batch(params);
+
+      work.reset();
+      for (auto& thread : validation_threads)
+         thread.join();
+
+      BOOST_REQUIRE_EQUAL(results.size(), params.transactions.size());
+      BOOST_REQUIRE_EQUAL(id_results.size(), params.transactions.size());
+      for (size_t i = 0; i < params.transactions.size(); ++i) {
+         BOOST_TEST_CHECKPOINT("transaction " << i);
+         optional<processed_transaction> expected;
+         if (i < trxs.size())
+            expected = push_serially(serial, trxs[i]);
+
+         if (expected) {
+            BOOST_CHECK_EQUAL(results[i].transaction_id.str(), trxs[i].id().str());
+            BOOST_CHECK_EQUAL(fc::json::to_string(results[i].processed),
+                              fc::json::to_string(serial.transaction_to_variant(*expected)));
+            BOOST_CHECK_EQUAL(id_results[i].transaction_id.str(), trxs[i].id().str());
+            BOOST_CHECK(id_results[i].processed.is_null());
+         } else {
+            // errors are reported per item, even with ids_only
+            for (const auto& result : {results[i], id_results[i]}) {
+               BOOST_CHECK(result.transaction_id == transaction_id_type());
+               BOOST_REQUIRE(result.processed.is_object());
+               BOOST_CHECK(result.processed.get_object().contains("error"));
+            }
+         }
+      }
+      BOOST_CHECK(results[0].processed.is_object() && !results[0].processed.get_object().contains("error"));
+      BOOST_CHECK(results[2].processed.get_object().contains("error"));
+      BOOST_CHECK(results[3].processed.get_object().contains("error"));
+
+      BOOST_CHECK_EQUAL(batch.get_liquid_balance("inita"), asset(100000 - 7));
+      BOOST_CHECK_EQUAL(ids_only.get_liquid_balance("inita"), asset(100000 - 7));
+      BOOST_CHECK_EQUAL(serial.get_liquid_balance("inita"), asset(100000 - 7));
+} FC_LOG_AND_RETHROW() }
+
 // Test chain_controller::_transaction_message_rate message rate calculation
 template< typename tx_msgs_exceeded >
 void transaction_msg_rate_calculation(rate_limiting_type account_type)
@@ -0,0 +1,180 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/net_plugin/compact_block.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+namespace eosio {
+using namespace std;
+
+/// A block of count user transactions over two threads, with its transaction merkle root set
+static signed_block make_block(uint32_t count) {
+   signed_block sb;
+   sb.timestamp = fc::time_point_sec(1000);
+   sb.producer = "inita";
+   sb.cycles.emplace_back();
+   sb.cycles.back().resize(2);
+   for (uint32_t i = 0; i < count; ++i) {
+      signed_transaction trx;
+      trx.ref_block_num = i;
+      trx.expiration = fc::time_point_sec(2000 + i);
+      processed_transaction ptrx(trx);
+      ptrx.output.resize(i % 2);
+      sb.cycles.back()[i % 2].user_input.push_back(ptrx);
+   }
+   sb.transaction_merkle_root = sb.calculate_merkle_root();
+   return sb;
+}
+
+/// The user transactions of sb in cycle, thread, user_input order, without their outputs
+static vector<signed_transaction> user_transactions(const signed_block& sb) {
+   vector<signed_transaction> trxs;
+   for (const auto& cyc : sb.cycles)
+      for (const auto& thr : cyc)
+         for (const auto& trx : thr.user_input)
+            trxs.push_back(trx);
+   return trxs;
+}
+
+static bool match(pending_compact_block& pcb, const signed_transaction& trx) {
+   return pcb.match(trx.id(), fc::raw::pack(trx));
+}
+
+static void check_rebuilt(const pending_compact_block& pcb, const signed_block& sb) {
+   auto rebuilt = pcb.block();
+   BOOST_REQUIRE(rebuilt);
+   BOOST_CHECK(fc::raw::pack(*rebuilt) == fc::raw::pack(sb));
+   BOOST_CHECK(rebuilt->id() == sb.id());
+}
+
+BOOST_AUTO_TEST_SUITE(compact_block_tests)
+
+// Test a compact block is rebuilt from transactions which are all known locally
+BOOST_AUTO_TEST_CASE(known_transactions)
+{ try {
+   auto sb = make_block(5);
+   auto trxs = user_transactions(sb);
+   auto cbm = make_compact_block(sb, 42);
+   BOOST_CHECK(cbm.block_header.id() == sb.id());
+   BOOST_REQUIRE_EQUAL(cbm.cycles.size(), 1);
+   BOOST_REQUIRE_EQUAL(cbm.cycles[0].size(), 2);
+   BOOST_CHECK_EQUAL(cbm.cycles[0][0].user_input.size(), 3);
+   BOOST_CHECK_EQUAL(cbm.cycles[0][0].user_input[1].short_id, compact_short_id(42, trxs[1].id()));
+   BOOST_CHECK(cbm.cycles[0][0].user_input[1].short_id != compact_short_id(43, trxs[1].id()));
+
+   pending_compact_block pcb(cbm);
+   BOOST_CHECK_EQUAL(pcb.transaction_count(), 5);
+   // in any order, and with transactions not in the block
+   signed_transaction other;
+   other.ref_block_num = 100;
+   BOOST_CHECK(!match(pcb, other));
+   for (auto trx = trxs.rbegin(); trx != trxs.rend(); ++trx)
+      BOOST_CHECK(match(pcb, *trx));
+   // offering the same transaction again is not a collision
+   BOOST_CHECK(!match(pcb, trxs[0]));
+   pcb.end_matching();
+
+   BOOST_CHECK(pcb.missing().empty());
+   check_rebuilt(pcb, sb);
+} FC_LOG_AND_RETHROW() }
+
+// Test the transactions which are not known locally are listed and filled in from the peer's reply
+BOOST_AUTO_TEST_CASE(missing_transactions)
+{ try {
+   auto sb = make_block(5);
+   auto trxs = user_transactions(sb);
+   auto cbm = make_compact_block(sb, 7);
+
+   pending_compact_block pcb(cbm);
+   for (auto i : {0, 2, 4})
+      match(pcb, trxs[i]);
+   pcb.end_matching();
+   BOOST_CHECK(pcb.missing() == vector<uint32_t>({1, 3}));
+   BOOST_CHECK(!pcb.block());
+
+   // a reply which does not have every missing transaction falls back to fetching the whole block
+   BOOST_CHECK(!pcb.add_missing({trxs[1]}));
+   BOOST_CHECK(!pcb.add_missing({}));
+   BOOST_CHECK(pcb.missing() == vector<uint32_t>({1, 3}));
+
+   BOOST_CHECK(pcb.add_missing({trxs[1], trxs[3]}));
+   BOOST_CHECK(pcb.missing().empty());
+   check_rebuilt(pcb, sb);
+
+   // the wrong transactions do not rebuild the block, which is then fetched whole
+   pending_compact_block swapped(cbm);
+   swapped.end_matching();
+   BOOST_CHECK_EQUAL(swapped.missing().size(), 5);
+   BOOST_CHECK(swapped.add_missing({trxs[1], trxs[0], trxs[2], trxs[3], trxs[4]}));
+   BOOST_CHECK(!swapped.block());
+} FC_LOG_AND_RETHROW() }
+
+// Test a short id matched by two different local transactions is fetched from the peer
+BOOST_AUTO_TEST_CASE(collided_short_ids)
+{ try {
+   auto sb = make_block(3);
+   auto trxs = user_transactions(sb);
+   auto cbm = make_compact_block(sb, 9);
+   const auto short_id = compact_short_id(cbm.salt, trxs[1].id());
+
+   signed_transaction impostor;
+   impostor.ref_block_num = 100;
+   auto packed_impostor = fc::raw::pack(impostor);
+
+   // whichever is matched first, neither is used
+   for (bool impostor_first : {false, true}) {
+      BOOST_TEST_CHECKPOINT("impostor first: " << impostor_first);
+      pending_compact_block pcb(cbm);
+      match(pcb, trxs[0]);
+      match(pcb, trxs[2]);
+      if (impostor_first) {
+         BOOST_CHECK(pcb.match(short_id, impostor.id(), packed_impostor));
+         BOOST_CHECK(!match(pcb, trxs[1]));
+      } else {
+         BOOST_CHECK(match(pcb, trxs[1]));
+         BOOST_CHECK(!pcb.match(short_id, impostor.id(), packed_impostor));
+      }
+      pcb.end_matching();
+      BOOST_CHECK(pcb.missing() == vector<uint32_t>({1}));
+
+      BOOST_CHECK(pcb.add_missing({trxs[1]}));
+      check_rebuilt(pcb, sb);
+   }
+
+   // a collision with only the wrong transaction known is caught by the merkle root
+   pending_compact_block pcb(cbm);
+   match(pcb, trxs[0]);
+   match(pcb, trxs[2]);
+   BOOST_CHECK(pcb.match(short_id, impostor.id(), packed_impostor));
+   pcb.end_matching();
+   BOOST_CHECK(pcb.missing().empty());
+   BOOST_CHECK(!pcb.block());
+} FC_LOG_AND_RETHROW() }
+
+// Test a short id appearing twice in a block is matched at its first position and fetched for the others
+BOOST_AUTO_TEST_CASE(duplicate_short_ids)
+{ try {
+   auto sb = make_block(4);
+   auto trxs = user_transactions(sb);
+   auto cbm = make_compact_block(sb, 11);
+   // trxs[3] is the second transaction of the second thread
+   auto& duplicate = cbm.cycles[0][1].user_input[1];
+   duplicate.short_id = compact_short_id(cbm.salt, trxs[0].id());
+
+   pending_compact_block pcb(cbm);
+   for (const auto& trx : trxs)
+      match(pcb, trx);
+   pcb.end_matching();
+   BOOST_CHECK(pcb.missing() == vector<uint32_t>({3}));
+
+   BOOST_CHECK(pcb.add_missing({trxs[3]}));
+   check_rebuilt(pcb, sb);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace eosio
@@ -5,6 +5,7 @@
 
 #include <eos/chain/chain_controller.hpp>
 #include <eos/chain/account_object.hpp>
+#include <eos/account_history_plugin/account_transaction_history_object.hpp>
 
 #include <chainbase/chainbase.hpp>
 
@@ -68,4 +69,75 @@ BOOST_FIXTURE_TEST_CASE(get_blocks, testing_fixture)
       // Check that block 21 can now be found
       BOOST_CHECK_EQUAL(chain.get_block_id_for_num(21), chain.head_block_id());
 } FC_LOG_AND_RETHROW() }
+
+// Test paging an account's transaction history newest first through the by_account_seq index
+BOOST_FIXTURE_TEST_CASE(account_transaction_history_pages, testing_fixture)
+{ try {
+      auto db = database(get_temp_dir(), database::read_write, 8*1024*1024);
+      db.add_index<account_transaction_history_index>();
+
+      auto trx_id = [](const account_name& account, uint32_t seq) {
+         return fc::sha256::hash(string(account) + std::to_string(seq));
+      };
+      // interleave the accounts, so a page must not run into the history of its neighbours in the index
+      const vector<std::pair<account_name, uint32_t>> histories = {{"alice", 5}, {"bob", 7}, {"carol", 3}};
+      for (uint32_t seq = 0; seq < 7; ++seq)
+         for (const auto& history : histories)
+            if (seq < history.second)
+               db.create<account_transaction_history_object>([&](account_transaction_history_object& obj) {
+                  obj.name = history.first;
+                  obj.seq = seq;
+                  obj.transaction_id = trx_id(history.first, seq);
+               });
+
+      for (const auto& history : histories)
+         BOOST_CHECK_EQUAL(next_account_transaction_seq(db, history.first), history.second);
+      BOOST_CHECK_EQUAL(next_account_transaction_seq(db, "dave"), 0);
+
+      // the seqs of bob's transactions in a page
+      auto page = [&](const optional<uint32_t>& skip_seq, const optional<uint32_t>& num_seq) {
+         vector<uint32_t> seqs;
+         for (const auto* obj : account_transaction_history_page(db, "bob", skip_seq, num_seq)) {
+            BOOST_CHECK_EQUAL(string(obj->name), "bob");
+            BOOST_CHECK(obj->transaction_id == trx_id("bob", obj->seq));
+            seqs.push_back(obj->seq);
+         }
+         return seqs;
+      };
+      using seqs = vector<uint32_t>;
+
+      BOOST_CHECK(page({}, {}) == seqs({6, 5, 4, 3, 2, 1, 0}));
+      // num_seq is only used with skip_seq
+      BOOST_CHECK(page({}, 2) == seqs({6, 5, 4, 3, 2, 1, 0}));
+      BOOST_CHECK(page(0, 3) == seqs({6, 5, 4}));
+      BOOST_CHECK(page(3, 3) == seqs({3, 2, 1}));
+      BOOST_CHECK(page(6, 3) == seqs({0}));
+      BOOST_CHECK(page(2, {}) == seqs({4, 3, 2, 1, 0}));
+      BOOST_CHECK(page(0, 7) == seqs({6, 5, 4, 3, 2, 1, 0}));
+      BOOST_CHECK(page(0, 8) == seqs({6, 5, 4, 3, 2, 1, 0}));
+      BOOST_CHECK(page(1, 0).empty());
+      // a start at or past the oldest transaction gives an empty page
+      BOOST_CHECK(page(7, 3).empty());
+      BOOST_CHECK(page(8, {}).empty());
+      BOOST_CHECK(page(std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max()).empty());
+      BOOST_CHECK(account_transaction_history_page(db, "dave", {}, {}).empty());
+      BOOST_CHECK(account_transaction_history_page(db, "dave", 0, 1).empty());
+
+      // paging through in pages of every size visits each transaction once, newest first
+      for (uint32_t page_size = 1; page_size <= 8; ++page_size) {
+         seqs all;
+         for (uint32_t skip = 0; ; skip += page_size) {
+            auto next = page(skip, page_size);
+            BOOST_CHECK_LE(next.size(), page_size);
+            if (next.empty())
+               break;
+            all.insert(all.end(), next.begin(), next.end());
+         }
+         BOOST_CHECK(all == page({}, {}));
+      }
+
+      // the oldest and newest transactions of the accounts beside bob are not mistaken for his
+      BOOST_CHECK_EQUAL(account_transaction_history_page(db, "alice", 4, 10).size(), 1);
+      BOOST_CHECK_EQUAL(account_transaction_history_page(db, "carol", 0, 10).size(), 3);
+} FC_LOG_AND_RETHROW() }
 } // namespace eos
@@ -0,0 +1,324 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain_plugin/chain_plugin.hpp>
+#include <eos/account_history_plugin/account_history_plugin.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/json_codec.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+struct integer_limits {
+   int64_t                   i64 = 0;
+   uint64_t                  u64 = 0;
+   int32_t                   i32 = 0;
+   uint32_t                  u32 = 0;
+   fc::optional<uint64_t>    opt;
+   std::vector<int64_t>      list;
+};
+}
+FC_REFLECT(integer_limits, (i64)(u64)(i32)(u32)(opt)(list))
+
+BOOST_AUTO_TEST_SUITE(json_tests)
+
+/// Whether two variants hold the same values with the same types, which json::to_string alone does not show
+static bool same_variant(const fc::variant& a, const fc::variant& b) {
+   if (a.get_type() != b.get_type())
+      return false;
+   if (a.is_object()) {
+      const auto& ao = a.get_object();
+      const auto& bo = b.get_object();
+      if (ao.size() != bo.size())
+         return false;
+      for (auto ai = ao.begin(), bi = bo.begin(); ai != ao.end(); ++ai, ++bi)
+         if (ai->key() != bi->key() || !same_variant(ai->value(), bi->value()))
+            return false;
+      return true;
+   }
+   if (a.is_array()) {
+      const auto& aa = a.get_array();
+      const auto& ba = b.get_array();
+      if (aa.size() != ba.size())
+         return false;
+      for (size_t i = 0; i < aa.size(); ++i)
+         if (!same_variant(aa[i], ba[i]))
+            return false;
+      return true;
+   }
+   return fc::json::to_string(a) == fc::json::to_string(b);
+}
+
+/// Parses with the in place reader behind from_string and with the stream parser it replaced
+static void check_same_parse(const std::string& json, fc::json::parse_type ptype = fc::json::legacy_parser) {
+   BOOST_TEST_CONTEXT(json) {
+      fc::optional<fc::variant> streamed, read;
+      fc::optional<int64_t> stream_error, read_error;
+      try {
+         std::stringstream in(json);
+         streamed = fc::json::from_stream(in, ptype);
+      } catch (const fc::exception& e) {
+         stream_error = e.code();
+      }
+      try {
+         read = fc::json::from_string(json, ptype);
+      } catch (const fc::exception& e) {
+         read_error = e.code();
+      }
+
+      BOOST_CHECK_EQUAL(bool(streamed), bool(read));
+      if (streamed && read)
+         BOOST_CHECK_MESSAGE(same_variant(*streamed, *read),
+                             fc::json::to_string(*streamed) + " != " + fc::json::to_string(*read));
+      if (stream_error && read_error)
+         BOOST_CHECK_EQUAL(*stream_error, *read_error);
+   }
+}
+
+/// The reader must parse valid JSON into exactly the values and types the legacy stream parser does
+BOOST_AUTO_TEST_CASE(json_reader_matches_legacy_parser)
+{ try {
+   const std::vector<std::string> inputs = {
+      R"({})", R"([])", R"("")", R"(0)", R"(-0)", R"(true)", R"(false)", R"(null)",
+      R"({"a":1,"b":[1,2,{"c":"d"}],"e":{"f":null,"g":true,"h":false}})",
+      "  \t\r\n{ \"a\" : [ 1 , 2 ] , \"b\" : { } }  ",
+      R"({"a":1,"a":2})",
+      R"([1,2,3,])",
+      // escapes, including ones the legacy parser passes through
+      R"("a\"b\\c\/d\be\ff\ng\rh\ti")",
+      R"("A\x\q")",
+      R"("tab	and utf8 é ✓")",
+      R"({"key \"quoted\"":"value\\"})",
+      // integers at and beyond the int64 and uint64 limits, and numbers of other shapes
+      R"(9223372036854775807)", R"(-9223372036854775808)", R"(9223372036854775808)",
+      R"(18446744073709551615)", R"(18446744073709551616)", R"(123456789012345678901234567890)",
+      R"(-1)", R"(1.5)", R"(-0.25)", R"(.5)", R"(1.)", R"(1e10)", R"(1E-3)", R"(2.5e+2)",
+      R"([1,-2,3.25,"4",18446744073709551615])",
+      // unquoted tokens are read as strings
+      R"(falfe)", R"(nul)", R"(trueish)", R"([tru,nan])",
+      // a value followed by trailing garbage parses the value alone
+      R"(1 2)", R"({} x)", R"([1]])", R"("a" "b")", R"({"a":1}})",
+   };
+   for (const auto& json : inputs) {
+      check_same_parse(json);
+      check_same_parse(json, fc::json::legacy_parser_with_string_doubles);
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// The reader must reject what the legacy parser rejects, with the same kind of exception
+BOOST_AUTO_TEST_CASE(json_reader_rejects_like_legacy_parser)
+{ try {
+   const std::vector<std::string> malformed = {
+      "", "   ", R"({)", R"([)", R"([1,2)", R"({"a":1)", R"({"a" 1})", R"({"a":})", R"({1:2})",
+      R"(})", R"(])", R"(:)", R"(,)", R"(@)", R"(1.2.3)", R"(--1)", R"(-)", "\x04",
+   };
+   for (const auto& json : malformed) {
+      BOOST_CHECK_THROW(fc::json::from_string(json), fc::exception);
+      check_same_parse(json);
+   }
+
+   // the stream parser never returns from an unterminated string, the reader reports it
+   BOOST_CHECK_THROW(fc::json::from_string(R"("abc)"), fc::parse_error_exception);
+   BOOST_CHECK_THROW(fc::json::from_string(R"({"a":"b)"), fc::parse_error_exception);
+   BOOST_CHECK_THROW(fc::json::from_string(R"("\)"), fc::parse_error_exception);
+} FC_LOG_AND_RETHROW() }
+
+/// Nesting is limited to a depth of 99 objects and 99 arrays, as the legacy parser's check did
+BOOST_AUTO_TEST_CASE(json_reader_nesting_depth)
+{ try {
+   auto nested = [](const std::string& open, const std::string& inner, const std::string& close, size_t depth) {
+      std::string json;
+      for (size_t i = 0; i < depth; ++i) json += open;
+      json += inner;
+      for (size_t i = 0; i < depth; ++i) json += close;
+      return json;
+   };
+
+   auto arrays = nested("[", "1", "]", 99);
+   check_same_parse(arrays);
+   BOOST_CHECK_EQUAL(fc::json::to_string(fc::json::from_string(arrays)), arrays);
+   BOOST_CHECK_THROW(fc::json::from_string(nested("[", "1", "]", 100)), fc::exception);
+
+   auto objects = nested(R"({"a":)", "1", "}", 99);
+   check_same_parse(objects);
+   BOOST_CHECK_THROW(fc::json::from_string(nested(R"({"a":)", "1", "}", 100)), fc::exception);
+
+   // objects and arrays are counted apart, and brackets within strings are not counted
+   check_same_parse(nested(R"({"a":[)", "1", "]}", 99));
+   BOOST_CHECK_NO_THROW(fc::json::from_string(R"([")" + std::string(200, '[') + R"("])"));
+} FC_LOG_AND_RETHROW() }
+
+static fc::sha256 digest(const std::string& s) {
+   return fc::sha256::hash(s);
+}
+
+/// json_codec must write exactly what json::to_string writes for the variant of a value, and read it back
+template<typename T>
+static void check_codec(const T& v) {
+   const auto expected = fc::json::to_string(fc::variant(v));
+   BOOST_TEST_CONTEXT(expected) {
+      BOOST_CHECK_EQUAL(fc::json_codec::to_string(v), expected);
+      BOOST_CHECK_EQUAL(fc::json_codec::to_string(v, fc::json::legacy_generator),
+                        fc::json::to_string(fc::variant(v), fc::json::legacy_generator));
+      BOOST_CHECK_EQUAL(fc::json::to_string(fc::variant(fc::json_codec::from_string<T>(expected))), expected);
+   }
+}
+
+/// Integers above 0xffffffff are quoted, whether they are members or inside a variant
+BOOST_AUTO_TEST_CASE(json_codec_quotes_large_ints)
+{ try {
+   integer_limits v;
+   check_codec(v);
+
+   v.i64 = std::numeric_limits<int64_t>::max();
+   v.u64 = std::numeric_limits<uint64_t>::max();
+   v.i32 = std::numeric_limits<int32_t>::min();
+   v.u32 = std::numeric_limits<uint32_t>::max();
+   v.opt = uint64_t(0x100000000ull);
+   v.list = { std::numeric_limits<int64_t>::min(), -1, 0xffffffffll, 0x100000000ll };
+   check_codec(v);
+   BOOST_CHECK_EQUAL(fc::json_codec::to_string(v),
+                     R"({"i64":"9223372036854775807","u64":"18446744073709551615","i32":-2147483648,"u32":4294967295,)"
+                     R"("opt":"4294967296","list":[-9223372036854775808,-1,4294967295,"4294967296"]})");
+
+   // quoted and unquoted forms both read back
+   auto read = fc::json_codec::from_string<integer_limits>(
+      R"({"i64":-5,"u64":18446744073709551615,"i32":"7","u32":"4294967295","opt":null,"list":["-9223372036854775808",1]})");
+   BOOST_CHECK_EQUAL(read.i64, -5);
+   BOOST_CHECK_EQUAL(read.u64, std::numeric_limits<uint64_t>::max());
+   BOOST_CHECK_EQUAL(read.i32, 7);
+   BOOST_CHECK_EQUAL(read.u32, std::numeric_limits<uint32_t>::max());
+   BOOST_CHECK(!read.opt.valid());
+   BOOST_REQUIRE_EQUAL(read.list.size(), 2u);
+   BOOST_CHECK_EQUAL(read.list[0], std::numeric_limits<int64_t>::min());
+} FC_LOG_AND_RETHROW() }
+
+/// The chain API results written by chain_api_plugin
+BOOST_AUTO_TEST_CASE(json_codec_matches_json_for_chain_api_results)
+{ try {
+   using namespace eosio::chain_apis;
+
+   read_only::get_info_results info;
+   check_codec(info);
+   info.head_block_num = std::numeric_limits<uint32_t>::max();
+   info.last_irreversible_block_num = 12345;
+   info.head_block_id = digest("head");
+   info.head_block_time = fc::time_point_sec(1500000000);
+   info.head_block_producer = "inita";
+   info.recent_slots = "1111011";
+   info.participation_rate = 0.875;
+   info.block_id_merkle_root = digest("root");
+   check_codec(info);
+
+   read_only::get_account_results account;
+   account.account_name = "inita";
+   account.eos_balance = eosio::types::asset(std::numeric_limits<int64_t>::max());
+   account.staked_balance = eosio::types::asset(-1);
+   account.last_unstaking_time = fc::time_point_sec(1500000000);
+   permission owner;
+   owner.perm_name = "owner";
+   owner.required_auth.threshold = 2;
+   owner.required_auth.accounts.push_back({{"initb", "active"}, 1});
+   owner.required_auth.accounts.push_back({{"initc", "active"}, 1});
+   account.permissions.push_back(owner);
+   check_codec(account);
+   account.producer = read_only::producer_info{"inita"};
+   check_codec(account);
+
+   read_only::get_code_results code;
+   code.account_name = "currency";
+   code.wast = "(module)\n\"quoted\"";
+   code.code_hash = fc::sha256::hash(code.wast);
+   check_codec(code);
+   code.abi = eosio::types::abi();
+   code.abi->types.push_back({"account_name", "name"});
+   check_codec(code);
+
+   read_only::get_table_rows_result rows;
+   rows.more = false;
+   check_codec(rows);
+   rows.rows.push_back(fc::mutable_variant_object()
+                          ("key", std::numeric_limits<uint64_t>::max())
+                          ("balance", std::numeric_limits<int64_t>::max())
+                          ("small", uint64_t(0xffffffff))
+                          ("negative", std::numeric_limits<int64_t>::min())
+                          ("rate", 1.5));
+   rows.rows.push_back("00000000000000000000000000000000");
+   rows.rows.push_back(fc::variant(uint64_t(0x100000000ull)));
+   rows.more = true;
+   check_codec(rows);
+
+   read_only::abi_json_to_bin_result to_bin;
+   to_bin.binargs = {char(0), char(1), char(0xff)};
+   to_bin.required_scope = {"inita", "initb"};
+   to_bin.required_auth = {"inita"};
+   check_codec(to_bin);
+
+   read_only::abi_bin_to_json_result to_json;
+   to_json.args = fc::mutable_variant_object()("from", "inita")("amount", std::numeric_limits<uint64_t>::max());
+   to_json.required_scope = {"inita"};
+   check_codec(to_json);
+
+   read_only::get_transaction_proof_results proof;
+   proof.block_id = digest("block");
+   proof.block_num = 7;
+   proof.transaction_merkle_root = digest("merkle");
+   proof.leaf_index = 2;
+   proof.leaf_count = 3;
+   proof.proof = {digest("a"), digest("b")};
+   check_codec(proof);
+
+   read_write::push_transaction_results pushed;
+   pushed.transaction_id = digest("trx");
+   check_codec(pushed);
+   pushed.processed = fc::mutable_variant_object()
+                         ("refBlockNum", 1)
+                         ("expiration", "2017-07-14T02:40:00")
+                         ("messages", fc::variants{fc::mutable_variant_object()
+                                                      ("code", "currency")
+                                                      ("data", fc::mutable_variant_object()
+                                                                  ("quantity", std::numeric_limits<uint64_t>::max())
+                                                                  ("delta", int64_t(-0x100000000ll)))});
+   check_codec(pushed);
+   check_codec(read_write::push_transactions_results{pushed, pushed});
+} FC_LOG_AND_RETHROW() }
+
+/// The account history API results written by account_history_api_plugin
+BOOST_AUTO_TEST_CASE(json_codec_matches_json_for_account_history_results)
+{ try {
+   using namespace eosio::account_history_apis;
+
+   read_only::get_transaction_results trx;
+   trx.transaction_id = digest("trx");
+   trx.transaction = fc::mutable_variant_object()("scope", fc::variants{"inita"})
+                                                   ("amount", std::numeric_limits<int64_t>::max());
+   check_codec(trx);
+
+   read_only::get_transactions_results trxs;
+   check_codec(trxs);
+   trxs.transactions.push_back({std::numeric_limits<uint32_t>::max(), trx.transaction_id, trx.transaction});
+   trxs.transactions.push_back({0, digest("other"), fc::variant()});
+   check_codec(trxs);
+   trxs.time_limit_exceeded_error = true;
+   check_codec(trxs);
+
+   read_only::get_key_accounts_results key_accounts;
+   check_codec(key_accounts);
+   key_accounts.account_names = {"inita", "initb"};
+   check_codec(key_accounts);
+
+   read_only::get_controlled_accounts_results controlled;
+   controlled.controlled_accounts = {"initc"};
+   check_codec(controlled);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
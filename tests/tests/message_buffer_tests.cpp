@@ -0,0 +1,185 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/net_plugin/message_buffer.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+namespace eosio {
+using namespace std;
+
+/// Appends data to buf through write_buffers, the way the socket reads fill it
+static void write(message_buffer& buf, const vector<char>& data) {
+   size_t written = 0;
+   while (written < data.size()) {
+      size_t filled = 0;
+      for (const auto& b : buf.write_buffers()) {
+         size_t n = std::min(boost::asio::buffer_size(b), data.size() - written - filled);
+         memcpy(boost::asio::buffer_cast<char*>(b), data.data() + written + filled, n);
+         filled += n;
+      }
+      buf.advance_write(filled);
+      written += filled;
+   }
+}
+
+/// size bytes counting up from first
+static vector<char> pattern(size_t size, char first = 0) {
+   vector<char> data(size);
+   for (size_t i = 0; i < size; ++i)
+      data[i] = char(first + i);
+   return data;
+}
+
+BOOST_AUTO_TEST_SUITE(message_buffer_tests)
+
+// Test copies and streams which straddle the boundaries between slabs
+BOOST_AUTO_TEST_CASE(reads_across_slabs)
+{ try {
+   auto pool = make_shared<slab_pool>(16, 4);
+   message_buffer buf(pool);
+
+   auto data = pattern(40);
+   write(buf, data);
+   BOOST_CHECK_EQUAL(buf.bytes_to_read(), 40);
+   BOOST_CHECK_EQUAL(pool->in_use(), 3);
+
+   // every span of the data, including those crossing one and two slab boundaries
+   for (size_t offset = 0; offset < data.size(); ++offset) {
+      for (size_t size = 0; offset + size <= data.size(); ++size) {
+         vector<char> read(size);
+         buf.copy(offset, size, read.data());
+         BOOST_CHECK(std::equal(read.begin(), read.end(), data.begin() + offset));
+      }
+   }
+
+   // values are unpacked straight from the slabs
+   buf.reset();
+   vector<char> packed(12);
+   fc::datastream<char*> ds(packed.data(), packed.size());
+   fc::raw::pack(ds, uint64_t(0x0123456789abcdefull));
+   fc::raw::pack(ds, uint32_t(0xfeedbeef));
+   auto big = fc::raw::pack(string(40, 'x'));
+   write(buf, packed);
+   write(buf, big);
+
+   auto s = buf.stream(0, packed.size() + big.size());
+   uint32_t small;
+   fc::raw::unpack(s, small);
+   uint64_t straddling; // bytes 4 to 11
+   fc::raw::unpack(s, straddling);
+   BOOST_CHECK_EQUAL(s.tellp(), 12);
+   string across_slabs;
+   fc::raw::unpack(s, across_slabs);
+   BOOST_CHECK_EQUAL(across_slabs, string(40, 'x'));
+   BOOST_CHECK_EQUAL(s.remaining(), 0);
+
+   uint32_t expected_small;
+   uint64_t expected_straddling;
+   memcpy(&expected_small, packed.data(), sizeof(expected_small));
+   memcpy(&expected_straddling, packed.data() + 4, sizeof(expected_straddling));
+   BOOST_CHECK_EQUAL(small, expected_small);
+   BOOST_CHECK_EQUAL(straddling, expected_straddling);
+
+   // reads are relative to the read position once earlier messages are consumed
+   buf.advance_read(packed.size());
+   auto rest = buf.stream(0, big.size());
+   string after_advance;
+   fc::raw::unpack(rest, after_advance);
+   BOOST_CHECK_EQUAL(after_advance, string(40, 'x'));
+} FC_LOG_AND_RETHROW() }
+
+// Test that slabs go back to the pool as soon as they are fully read
+BOOST_AUTO_TEST_CASE(slabs_returned)
+{ try {
+   auto pool = make_shared<slab_pool>(16, 2);
+   {
+      message_buffer buf(pool);
+      write(buf, pattern(40));
+      BOOST_CHECK_EQUAL(pool->in_use(), 3);
+
+      // a partly read slab is kept
+      buf.advance_read(10);
+      BOOST_CHECK_EQUAL(pool->in_use(), 3);
+      buf.advance_read(6);
+      BOOST_CHECK_EQUAL(pool->in_use(), 2);
+      vector<char> read(4);
+      buf.copy(0, read.size(), read.data());
+      BOOST_CHECK(read == pattern(4, 16));
+
+      // once everything is read one slab is kept for the next read
+      buf.advance_read(buf.bytes_to_read());
+      BOOST_CHECK_EQUAL(buf.bytes_to_read(), 0);
+      BOOST_CHECK_EQUAL(pool->in_use(), 1);
+
+      // little space left in the last slab adds the next one to the same read
+      write(buf, pattern(14));
+      auto bufs = buf.write_buffers();
+      BOOST_CHECK_EQUAL(bufs.size(), 2);
+      BOOST_CHECK_EQUAL(pool->in_use(), 2);
+
+      buf.reset();
+      BOOST_CHECK_EQUAL(pool->in_use(), 0);
+
+      write(buf, pattern(100));
+      BOOST_CHECK_EQUAL(pool->in_use(), 7);
+   }
+   // the buffer's slabs are released with it
+   BOOST_CHECK_EQUAL(pool->in_use(), 0);
+
+   // released slabs are reused for the next buffer
+   message_buffer buf(pool);
+   write(buf, pattern(16));
+   BOOST_CHECK_EQUAL(pool->in_use(), 1);
+
+   // a slab outliving its pool is freed rather than returned
+   auto slab = pool->acquire();
+   pool.reset();
+   slab.reset();
+} FC_LOG_AND_RETHROW() }
+
+// Test that reads past the end of a frame or of the received data are range errors
+BOOST_AUTO_TEST_CASE(truncated_frames)
+{ try {
+   auto pool = make_shared<slab_pool>(16, 4);
+   message_buffer buf(pool);
+
+   auto packed = fc::raw::pack(string(30, 'y'));
+   write(buf, packed);
+
+   // a frame shorter than the string its length prefix announces
+   auto truncated = buf.stream(0, packed.size() - 1);
+   string str;
+   BOOST_CHECK_THROW(fc::raw::unpack(truncated, str), fc::out_of_range_exception);
+
+   auto header_only = buf.stream(0, 1);
+   uint32_t value;
+   BOOST_CHECK_THROW(fc::raw::unpack(header_only, value), fc::out_of_range_exception);
+
+   auto skipped = buf.stream(0, 8);
+   BOOST_CHECK_THROW(skipped.skip(9), fc::out_of_range_exception);
+   skipped.skip(8);
+   BOOST_CHECK_EQUAL(skipped.remaining(), 0);
+
+   // a frame which is whole is still read
+   auto whole = buf.stream(0, packed.size());
+   fc::raw::unpack(whole, str);
+   BOOST_CHECK_EQUAL(str, string(30, 'y'));
+
+   // frames can not reach past the data received
+   vector<char> read(packed.size() + 1);
+   BOOST_CHECK_THROW(buf.copy(0, read.size(), read.data()), fc::assert_exception);
+   BOOST_CHECK_THROW(buf.copy(packed.size(), 1, read.data()), fc::assert_exception);
+   auto past_received = buf.stream(0, packed.size() + 4);
+   fc::raw::unpack(past_received, str);
+   BOOST_CHECK_THROW(fc::raw::unpack(past_received, value), fc::assert_exception);
+   BOOST_CHECK_THROW(buf.advance_read(packed.size() + 1), fc::assert_exception);
+   BOOST_CHECK_EQUAL(buf.bytes_to_read(), packed.size());
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace eosio
@@ -5,14 +5,22 @@
 #include <eos/chain/blockchain_configuration.hpp>
 #include <eos/chain/authority_checker.hpp>
 #include <eos/chain/authority.hpp>
+#include <eos/chain/merkle.hpp>
 
 #include <eos/utilities/key_conversion.hpp>
 #include <eos/utilities/rand.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/async_appender.hpp>
+#include <fc/variant_object.hpp>
 
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 using namespace eosio::chain;
 #include "../common/testing_macros.hpp"
 
@@ -267,6 +275,23 @@ BOOST_AUTO_TEST_CASE(authority_checker)
       BOOST_CHECK(!checker.all_keys_used());
       BOOST_CHECK_EQUAL(checker.unused_keys().count(c), 1);
    }
+
+   // A permission is looked up once per checker, and a remembered result still uses its keys
+   uint32_t lookups = 0;
+   auto GetCountedAuthority = [&lookups, c_public_key](auto) {
+      ++lookups;
+      return Complex_Authority(1, ((c, 1)),);
+   };
+   A = Complex_Authority(3, ((a, 1)), (("hello", "world", 1)));
+   {
+      auto checker = make_authority_checker(GetCountedAuthority, 2, {c});
+      BOOST_CHECK(!checker.satisfied(A));
+      BOOST_CHECK_EQUAL(checker.used_keys().size(), 0);
+      BOOST_CHECK(checker.satisfied(types::account_permission{"hello", "world"}, 1));
+      BOOST_CHECK(checker.satisfied(types::account_permission{"hello", "world"}, 1));
+      BOOST_CHECK(checker.all_keys_used());
+      BOOST_CHECK_EQUAL(lookups, 1);
+   }
 } FC_LOG_AND_RETHROW() }
 
 
@@ -319,6 +344,277 @@ BOOST_AUTO_TEST_CASE(alphabetic_sort)
 
 } FC_LOG_AND_RETHROW() }
 
+/// The incremental merkle must match the full calculation, and every proof must lead back to the root
+BOOST_AUTO_TEST_CASE(incremental_merkle_and_proofs)
+{ try {
+   BOOST_CHECK(incremental_merkle().get_root() == merkle({}));
+
+   vector<digest_type> leaves;
+   incremental_merkle accumulator;
+   for (uint32_t count = 1; count <= 33; ++count) {
+      leaves.push_back(digest_type::hash(count));
+      accumulator.append(leaves.back());
+      BOOST_CHECK_EQUAL(accumulator.size(), count);
+
+      const auto root = merkle(leaves);
+      BOOST_CHECK(accumulator.get_root() == root);
+      for (uint32_t i = 0; i < count; ++i) {
+         auto proof = merkle_proof(leaves, i);
+         BOOST_CHECK(merkle_root_from_proof(leaves[i], i, proof) == root);
+         if (count > 1)
+            BOOST_CHECK(merkle_root_from_proof(leaves[(i + 1) % count], i, proof) != root);
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// Keeps the messages it is given, taking delay_us to write each one
+struct capturing_appender : public fc::appender {
+   void log(const fc::log_message& m) override {
+      if (delay_us)
+         std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+      std::lock_guard<std::mutex> lock(mutex);
+      messages.push_back(m);
+   }
+
+   std::mutex                  mutex;
+   vector<fc::log_message>     messages;
+   uint32_t                    delay_us = 0;
+};
+
+/// The async appender must pass on every message in order, and when full, drop and count only the low level ones
+BOOST_AUTO_TEST_CASE(async_appender)
+{ try {
+   fc::shared_ptr<capturing_appender> target(new capturing_appender);
+   {
+      fc::shared_ptr<fc::async_appender> async(new fc::async_appender(fc::async_appender::config("target"), target));
+      fc::logger lgr("async_in_order");
+      lgr.set_log_level(fc::log_level::debug);
+      lgr.add_appender(async);
+      for (uint32_t i = 0; i < 1000; ++i)
+         fc_dlog(lgr, "message ${i}", ("i", i));
+      async->flush();
+
+      BOOST_REQUIRE_EQUAL(target->messages.size(), 1000);
+      for (uint32_t i = 0; i < 1000; ++i)
+         BOOST_CHECK_EQUAL(target->messages[i].get_message(), "message " + std::to_string(i));
+      BOOST_CHECK_EQUAL(async->dropped(), 0);
+   }
+
+   target->messages.clear();
+   target->delay_us = 1000;
+   {
+      fc::async_appender::config cfg("target");
+      cfg.capacity = 4;
+      cfg.drop_below = fc::log_level::warn;
+      fc::shared_ptr<fc::async_appender> async(new fc::async_appender(cfg, target));
+      fc::logger lgr("async_overflow");
+      lgr.set_log_level(fc::log_level::debug);
+      lgr.add_appender(async);
+      for (uint32_t i = 0; i < 100; ++i) {
+         fc_dlog(lgr, "debug ${i}", ("i", i));
+         fc_elog(lgr, "error ${i}", ("i", i));
+      }
+      async->flush();
+
+      uint64_t debugs = 0, errors = 0, reported = 0;
+      for (const auto& m : target->messages) {
+         if (m.get_format() == "debug ${i}") ++debugs;
+         if (m.get_format() == "error ${i}") ++errors;
+         if (m.get_format() == "dropped ${n} log messages because the queue was full")
+            reported += m.get_data()["n"].as_uint64();
+      }
+      BOOST_CHECK(async->dropped() > 0);
+      BOOST_CHECK_EQUAL(errors, 100);
+      BOOST_CHECK_EQUAL(debugs + async->dropped(), 100);
+      // the drops are reported to the wrapped appender, possibly over several messages
+      BOOST_CHECK_EQUAL(reported, async->dropped());
+   }
+} FC_LOG_AND_RETHROW() }
+
+static fc::mutable_variant_object numbered_object(uint32_t size, const string& prefix = "key") {
+   fc::mutable_variant_object obj;
+   for (uint32_t i = 0; i < size; ++i)
+      obj(prefix + std::to_string(i), i);
+   return obj;
+}
+
+/// Lookups must find the same entries whether or not the object is large enough to be indexed
+BOOST_AUTO_TEST_CASE(variant_object_lookup)
+{ try {
+   for (uint32_t size = 0; size <= 40; ++size) {
+      BOOST_TEST_CONTEXT("size " << size) {
+         auto mutable_obj = numbered_object(size);
+         fc::variant_object obj = mutable_obj;
+         for (uint32_t i = 0; i < size; ++i) {
+            const auto key = "key" + std::to_string(i);
+            BOOST_REQUIRE(obj.find(key) != obj.end());
+            BOOST_CHECK_EQUAL(obj.find(key) - obj.begin(), i);
+            BOOST_CHECK_EQUAL(obj[key].as_uint64(), i);
+            BOOST_CHECK_EQUAL(mutable_obj[key].as_uint64(), i);
+         }
+         for (const auto& missing : {string("key"), "key" + std::to_string(size), string()}) {
+            BOOST_CHECK(obj.find(missing) == obj.end());
+            BOOST_CHECK(!obj.contains(missing.c_str()));
+            BOOST_CHECK_THROW(obj[missing], fc::key_not_found_exception);
+            BOOST_CHECK(mutable_obj.find(missing) == mutable_obj.end());
+         }
+         BOOST_CHECK(obj.find(string("key0", 5)) == obj.end());
+
+         // keys added after the mutable object was looked up are found too
+         mutable_obj.set("added", size);
+         mutable_obj("key" + std::to_string(size), size);
+         BOOST_CHECK_EQUAL(mutable_obj["added"].as_uint64(), size);
+         BOOST_CHECK_EQUAL(mutable_obj["key" + std::to_string(size)].as_uint64(), size);
+         BOOST_CHECK_EQUAL(mutable_obj.size(), size + 2);
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// Of duplicate keys, lookups find the first, as a linear search does
+BOOST_AUTO_TEST_CASE(variant_object_duplicate_keys)
+{ try {
+   for (uint32_t size : {2u, 20u}) {
+      BOOST_TEST_CONTEXT("size " << size) {
+         auto mutable_obj = numbered_object(size);
+         // operator() only appends without looking for the key when given a variant
+         mutable_obj("key0", fc::variant("second"))("key1", fc::variant("second"));
+         fc::variant_object obj = mutable_obj;
+         BOOST_CHECK_EQUAL(obj.size(), size + 2);
+         BOOST_CHECK_EQUAL(obj["key0"].as_uint64(), 0);
+         BOOST_CHECK_EQUAL(obj.find("key1") - obj.begin(), 1);
+         BOOST_CHECK_EQUAL(mutable_obj["key0"].as_uint64(), 0);
+
+         // set() replaces the first, and erase() removes it so the second is found
+         mutable_obj.set("key1", "replaced");
+         BOOST_CHECK_EQUAL(mutable_obj["key1"].as_string(), "replaced");
+         mutable_obj.erase("key0");
+         BOOST_CHECK_EQUAL(mutable_obj["key0"].as_string(), "second");
+         BOOST_CHECK_EQUAL(obj["key0"].as_uint64(), 0);
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// Assigning to an object, or moving it, must not leave it or its copies with an index of other entries
+BOOST_AUTO_TEST_CASE(variant_object_assignment)
+{ try {
+   fc::variant_object obj = numbered_object(20);
+   BOOST_CHECK_EQUAL(obj["key10"].as_uint64(), 10);
+   fc::variant_object copy = obj;
+   BOOST_CHECK_EQUAL(copy["key11"].as_uint64(), 11);
+
+   // the copy keeps the old entries while the object gets new ones
+   obj = numbered_object(20, "other");
+   BOOST_CHECK(obj.find("key10") == obj.end());
+   BOOST_CHECK_EQUAL(obj["other10"].as_uint64(), 10);
+   BOOST_CHECK_EQUAL(copy["key10"].as_uint64(), 10);
+   BOOST_CHECK(copy.find("other10") == copy.end());
+
+   const fc::mutable_variant_object smaller = numbered_object(12, "small");
+   obj = smaller;
+   BOOST_CHECK(obj.find("other15") == obj.end());
+   BOOST_CHECK_EQUAL(obj["small11"].as_uint64(), 11);
+   BOOST_CHECK_EQUAL(copy["key15"].as_uint64(), 15);
+
+   copy = obj;
+   BOOST_CHECK(copy.find("key15") == copy.end());
+   BOOST_CHECK_EQUAL(copy["small5"].as_uint64(), 5);
+
+   fc::variant_object moved = std::move(copy);
+   BOOST_CHECK_EQUAL(moved["small6"].as_uint64(), 6);
+   BOOST_CHECK_EQUAL(copy.size(), 0);
+   BOOST_CHECK(copy.find("small6") == copy.end());
+
+   moved = numbered_object(9, "moved");
+   BOOST_CHECK(moved.find("small6") == moved.end());
+   BOOST_CHECK_EQUAL(moved["moved8"].as_uint64(), 8);
+
+   auto mutable_obj = numbered_object(20);
+   BOOST_CHECK_EQUAL(mutable_obj["key3"].as_uint64(), 3);
+   mutable_obj = obj;
+   BOOST_CHECK(mutable_obj.find("key3") == mutable_obj.end());
+   BOOST_CHECK_EQUAL(mutable_obj["small3"].as_uint64(), 3);
+} FC_LOG_AND_RETHROW() }
+
+/// One object looked up from several threads at once builds a single index that they all use
+BOOST_AUTO_TEST_CASE(variant_object_concurrent_lookup)
+{ try {
+   for (uint32_t round = 0; round < 20; ++round) {
+      const fc::variant_object obj = numbered_object(64);
+      std::atomic<uint32_t> found{0};
+      vector<std::thread> threads;
+      for (uint32_t t = 0; t < 4; ++t)
+         threads.emplace_back([&obj, &found, t]() {
+            for (uint32_t i = t; i < t + 64; ++i)
+               if (obj.find("key" + std::to_string(i % 64)) - obj.begin() == i % 64)
+                  ++found;
+         });
+      for (auto& thread : threads)
+         thread.join();
+      BOOST_CHECK_EQUAL(found, 4 * 64);
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// Strings are unpacked in place, reusing the storage of the string they are unpacked into
+BOOST_AUTO_TEST_CASE(raw_unpack_strings)
+{ try {
+   auto packed = fc::raw::pack(string("short"));
+
+   string target(100, 'x');
+   auto storage = target.data();
+   fc::datastream<const char*> ds(packed.data(), packed.size());
+   fc::raw::unpack(ds, target);
+   BOOST_CHECK_EQUAL(target, "short");
+   BOOST_CHECK(target.data() == storage);
+   BOOST_CHECK_EQUAL(ds.remaining(), 0);
+
+   string longer(1000, 'y');
+   packed = fc::raw::pack(longer);
+   ds = fc::datastream<const char*>(packed.data(), packed.size());
+   fc::raw::unpack(ds, target);
+   BOOST_CHECK_EQUAL(target, longer);
+
+   string empty;
+   packed = fc::raw::pack(empty);
+   ds = fc::datastream<const char*>(packed.data(), packed.size());
+   fc::raw::unpack(ds, target);
+   BOOST_CHECK(target.empty());
+
+   // a size which runs past the end of the data
+   packed = fc::raw::pack(longer);
+   ds = fc::datastream<const char*>(packed.data(), packed.size() - 1);
+   BOOST_CHECK_THROW(fc::raw::unpack(ds, target), fc::exception);
+} FC_LOG_AND_RETHROW() }
+
+/// A shared_string is unpacked with the allocator of the string it is unpacked into
+BOOST_AUTO_TEST_CASE(raw_unpack_shared_string)
+{ try {
+   namespace bip = boost::interprocess;
+   fc::temp_directory dir;
+   bip::managed_mapped_file segment(bip::create_only, (dir.path() / "segment").generic_string().c_str(), 1024 * 1024);
+   fc::raw::shared_string target(segment.get_segment_manager());
+
+   string longer(1000, 'y');
+   auto packed = fc::raw::pack(longer);
+   auto free = segment.get_free_memory();
+   fc::datastream<const char*> ds(packed.data(), packed.size());
+   fc::raw::unpack(ds, target);
+   BOOST_CHECK_EQUAL(string(target.begin(), target.end()), longer);
+   BOOST_CHECK(target.get_allocator().get_segment_manager() == segment.get_segment_manager());
+   BOOST_CHECK(segment.get_free_memory() < free);
+   BOOST_CHECK(segment.belongs_to_segment(target.data()));
+
+   auto storage = target.data();
+   packed = fc::raw::pack(string("short"));
+   ds = fc::datastream<const char*>(packed.data(), packed.size());
+   fc::raw::unpack(ds, target);
+   BOOST_CHECK_EQUAL(string(target.begin(), target.end()), "short");
+   BOOST_CHECK(target.data() == storage);
+
+   fc::datastream<size_t> size;
+   fc::raw::pack(size, target);
+   BOOST_CHECK_EQUAL(size.tellp(), packed.size());
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eos
@@ -0,0 +1,88 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eos/chain/transaction_pool.hpp>
+#include <eos/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace eosio;
+using namespace chain;
+
+namespace {
+   signed_transaction make_trx(account_name payer, uint32_t seq, size_t data_size = 0) {
+      signed_transaction trx;
+      trx.ref_block_num = seq;
+      trx.expiration = time_point_sec(1000 + seq);
+      trx.scope = {payer};
+      trx.messages.resize(1);
+      trx.messages.front().code = config::eos_contract_name;
+      trx.messages.front().type = "transfer";
+      trx.messages.front().authorization = {types::account_permission{payer, "active"}};
+      trx.messages.front().data.resize(data_size);
+      return trx;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(transaction_pool_tests)
+
+BOOST_AUTO_TEST_CASE(index_and_order)
+{ try {
+   transaction_pool pool;
+   auto a = make_trx("inita", 1);
+   auto b = make_trx("initb", 2);
+   auto c = make_trx("inita", 3);
+   pool.add(a);
+   pool.add(b);
+   pool.add(c, 5);
+   BOOST_CHECK_THROW(pool.add(a), tx_duplicate);
+
+   BOOST_CHECK_EQUAL(pool.size(), 3);
+   BOOST_REQUIRE(pool.find(b.id()) != nullptr);
+   BOOST_CHECK(*pool.find(b.id())->packed == fc::raw::pack(b));
+   BOOST_CHECK_EQUAL(pool.account_bytes("inita"), pool.find(a.id())->size() + pool.find(c.id())->size());
+   BOOST_CHECK_EQUAL(pool.ids_by_scope("inita").size(), 2);
+
+   // higher priority first, then arrival
+   vector<transaction_id_type> order;
+   for (const auto& e : pool.get<transaction_pool::by_priority>())
+      order.push_back(e.id);
+   BOOST_CHECK(order == (vector<transaction_id_type>{c.id(), a.id(), b.id()}));
+
+   BOOST_CHECK_EQUAL(pool.remove_expired(time_point_sec(1002)), 2);
+   BOOST_CHECK_EQUAL(pool.size(), 1);
+   BOOST_CHECK(pool.contains(c.id()));
+   BOOST_CHECK_EQUAL(pool.account_bytes("initb"), 0);
+   BOOST_CHECK(pool.ids_by_scope("initb").empty());
+
+   pool.remove(c.id());
+   BOOST_CHECK(pool.empty());
+   BOOST_CHECK_EQUAL(pool.bytes(), 0);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(limits)
+{ try {
+   const auto size = fc::raw::pack_size(make_trx("inita", 0, 100));
+   transaction_pool pool({3 * size, 2 * size});
+
+   pool.add(make_trx("inita", 1, 100));
+   pool.add(make_trx("inita", 2, 100));
+   BOOST_CHECK_THROW(pool.add(make_trx("inita", 3, 100)), tx_pool_account_quota_exceeded);
+
+   auto low = make_trx("initb", 4, 100);
+   pool.add(low);
+   BOOST_CHECK_THROW(pool.add(make_trx("initc", 5, 100)), tx_pool_full);
+
+   // room is made by evicting the newest of the lowest priority
+   auto high = make_trx("initc", 6, 100);
+   pool.add(high, 1);
+   BOOST_CHECK(pool.contains(high.id()));
+   BOOST_CHECK(!pool.contains(low.id()));
+   BOOST_CHECK_EQUAL(pool.size(), 3);
+   BOOST_CHECK_EQUAL(pool.bytes(), 3 * size);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
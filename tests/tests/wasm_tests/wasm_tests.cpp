@@ -6,6 +6,8 @@
 
 #include "../../common/database_fixture.hpp"
 
+#include <fc/io/json.hpp>
+
 #include <rate_limit_auth/rate_limit_auth.wast.hpp>
 #include <currency/currency.wast.hpp>
 
@@ -510,4 +512,72 @@ BOOST_FIXTURE_TEST_CASE(rate_limit_multi_authority_test, testing_fixture)
 
 } FC_LOG_AND_RETHROW() }
 
+// Test the abi_serializer_cache follows a contract's ABI across setcode
+BOOST_FIXTURE_TEST_CASE(abi_serializer_cache_setcode, testing_fixture)
+{ try {
+   Make_Blockchain(chain);
+   Make_Account(chain, currency);
+   chain.produce_blocks(1);
+
+   const char* first_abi = R"=====(
+   {
+      "types": [],
+      "structs": [{ "name": "greeting", "base": "", "fields": { "value": "uint64" } }],
+      "actions": [{ "action_name": "greet", "type": "greeting" }],
+      "tables": []
+   }
+   )=====";
+   const char* second_abi = R"=====(
+   {
+      "types": [],
+      "structs": [{ "name": "greeting", "base": "", "fields": { "value": "uint32", "memo": "string" } }],
+      "actions": [{ "action_name": "greet", "type": "greeting" }],
+      "tables": []
+   }
+   )=====";
+
+   auto wasm = testing_blockchain::assemble_wast( currency_wast );
+   auto set_code = [&]( const char* abi ) {
+      types::setcode handler;
+      handler.account = "currency";
+      handler.code.resize(wasm.size());
+      memcpy( handler.code.data(), wasm.data(), wasm.size() );
+      handler.code_abi = fc::json::from_string(abi).as<types::abi>();
+
+      eosio::chain::signed_transaction txn;
+      txn.scope = {"currency"};
+      transaction_emplace_message(txn, config::eos_contract_name,
+                                  vector<types::account_permission>{ {"currency","active"} }, "setcode", handler);
+      txn.expiration = chain.head_block_time() + 100;
+      transaction_set_reference_block(txn, chain.head_block_id());
+      chain.push_transaction(txn);
+      chain.produce_blocks(1);
+      return chain.get_database().get<account_object,by_name>("currency").abi_version;
+   };
+   auto& cache = chain.get_abi_serializer_cache();
+
+   auto first_version = set_code(first_abi);
+   auto bin = chain.message_to_binary("currency", "greet", fc::json::from_string(R"({"value": 5})"));
+   BOOST_CHECK_EQUAL( bin.size(), 8 );
+   BOOST_CHECK_EQUAL( chain.message_from_binary("currency", "greet", bin)["value"].as_uint64(), 5 );
+   BOOST_CHECK( cache.contains(first_version) );
+   auto first_serializer = chain.get_abi_serializer("currency");
+   BOOST_CHECK( first_serializer == chain.get_abi_serializer("currency") );
+
+   // the new ABI is used as soon as setcode is applied, and the serializer for the old one is dropped
+   auto second_version = set_code(second_abi);
+   BOOST_CHECK( second_version != first_version );
+   BOOST_CHECK( !cache.contains(first_version) );
+
+   bin = chain.message_to_binary("currency", "greet", fc::json::from_string(R"({"value": 5, "memo": "hi"})"));
+   BOOST_CHECK_EQUAL( bin.size(), 4 + 1 + 2 );
+   auto greeting = chain.message_from_binary("currency", "greet", bin).get_object();
+   BOOST_CHECK_EQUAL( greeting["value"].as_uint64(), 5 );
+   BOOST_CHECK_EQUAL( greeting["memo"].as_string(), "hi" );
+   BOOST_CHECK( cache.contains(second_version) );
+   BOOST_CHECK( !cache.contains(first_version) );
+   BOOST_CHECK( chain.get_abi_serializer("currency") != first_serializer );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()